@@ -0,0 +1,256 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include "common_struct.h"
+#include "cpu_half.h"
+#include "cpu_int8.h"
+#include "cpu_sgd_kernel.h"
+#include "cpu_mascot_sgd_kernel.h"
+using namespace std;
+
+// Compares the 16-bit formats of the -v 11 groups (-hf) on synthetic data: the same ratings and initial features
+// are trained with fp16 groups (-hf 0), bf16 groups (-hf 1) and fp16 groups that go to bf16 when they widen out
+// of range (-hf 2), with the MASCOT update loop and its gradient diversity switching (checks every epoch from
+// -s on, calibrated at the first one, groups over -e widened by wider_group_prec).
+// Reports the groups that end up in fp32 and bf16, the footprint of the groups and the update time per epoch.
+// -ms scales the ratings by s, the features by sqrt(s), the learning rate by 1/s and lambda by s. Only the
+// rounding changes, and the rows move toward the edges of the range of fp16.
+
+// Users are drawn uniformly and items with a power-law skew (x^skew), so the item groups differ in degree.
+void generate_ratings(Node* R, size_t n, unsigned int max_user, unsigned int max_item, float skew, float scale, unsigned int num_threads){
+    vector<thread> workers;
+    size_t slice = (n + num_threads - 1) / num_threads;
+    for (unsigned int t = 0; t < num_threads; t++){
+        workers.push_back(thread([=](){
+            mt19937 gen(1234 + t);
+            uniform_real_distribution<float> unif(0.0f, 1.0f);
+            for (size_t j = min(t * slice, n); j < min((t + 1) * slice, n); j++){
+                R[j].u = min((unsigned int)(unif(gen) * max_user), max_user - 1);
+                R[j].i = min((unsigned int)(powf(unif(gen), skew) * max_item), max_item - 1);
+                R[j].r = (1.0f + (unsigned int)(unif(gen) * 5) % 5) * scale;
+            }
+        }));
+    }
+    for (unsigned int t = 0; t < num_threads; t++) workers[t].join();
+}
+
+void init_features(float* feature_vec, size_t n, float stddev, unsigned int seed){
+    mt19937 gen(seed);
+    normal_distribution<float> d(0, stddev);
+    for (size_t i = 0; i < n; i++) feature_vec[i] = d(gen);
+}
+
+// Equal-size groups in id order, stored in prec.
+void build_groups(const float* feature_vec, unsigned int num, unsigned int k, unsigned int group_num, unsigned char prec,
+                  void** group_ptr, unsigned char* group_prec, unsigned int* group_end_idx, unsigned int* group_size){
+    unsigned int size = (num + group_num - 1) / group_num;
+    for (unsigned int g = 0; g < group_num; g++){
+        unsigned int start_idx = min(g * size, num);
+        unsigned int end_idx = min(start_idx + size, num);
+        group_ptr[g] = new_grouped_params(prec, max(end_idx - start_idx, 1u), k);
+        for (unsigned int s = start_idx; s < end_idx; s++)
+            cpu_float2grouped_row((char*)group_ptr[g] + (size_t)(s - start_idx) * grouped_row_bytes(prec, k), prec, feature_vec + (size_t)s * k, k, NULL);
+        group_prec[g] = prec;
+        group_end_idx[g] = end_idx - 1;
+        group_size[g] = end_idx - start_idx;
+    }
+}
+
+// Gradient diversity of the groups below fp32 from the per-thread sums, as in cpu_mascot_training_mf.
+void group_errors(const float* grad_sum_norm, const float* norm_sum, const unsigned char* group_prec, unsigned int group_num,
+                  unsigned int k, unsigned int num_threads, const vector<float>& initial_error, vector<float>* error){
+    for (unsigned int g = 0; g < group_num; g++){
+        if (group_prec[g] == 1){
+            (*error)[g] = -1;
+            continue;
+        }
+        float grad_sum_norm_acc = 0, norm_acc = 0;
+        for (unsigned int d = 0; d < k; d++){
+            float grad_sum = 0;
+            for (unsigned int t = 0; t < num_threads; t++) grad_sum += grad_sum_norm[((size_t)t * group_num + g) * k + d];
+            grad_sum_norm_acc += grad_sum * grad_sum;
+        }
+        for (unsigned int t = 0; t < num_threads; t++) norm_acc += norm_sum[(size_t)t * group_num + g];
+        (*error)[g] = grad_sum_norm_acc / norm_acc / initial_error[g];
+    }
+}
+
+size_t groups_footprint(const unsigned char* group_prec, const unsigned int* group_size, unsigned int group_num, unsigned int k){
+    size_t bytes = 0;
+    for (unsigned int g = 0; g < group_num; g++) bytes += group_size[g] * grouped_row_bytes(group_prec[g], k);
+    return bytes;
+}
+
+int main(int argc, const char* argv[]){
+    unsigned int max_user = 480189;
+    unsigned int max_item = 17770;
+    size_t n = 100480507;
+    unsigned int k = 128;
+    unsigned int num_threads = thread::hardware_concurrency();
+    unsigned int epoch = 10;
+    unsigned int start_idx = 2;
+    unsigned int group_num = 100;
+    float skew = 2.0f;
+    float scale = 1.0f;
+    float lrate = 0.005f;
+    float lambda = 0.015f;
+    float error_threshold = 1.0f;
+    float sample_ratio = 0.05f;
+
+    for (int i = 0; i < argc; i++){
+        if (string(argv[i]) == "-m" && i < argc-1) max_user = atoi(argv[i+1]);
+        if (string(argv[i]) == "-n" && i < argc-1) max_item = atoi(argv[i+1]);
+        if (string(argv[i]) == "-nnz" && i < argc-1) n = atoll(argv[i+1]);
+        if (string(argv[i]) == "-k" && i < argc-1) k = atoi(argv[i+1]);
+        if (string(argv[i]) == "-t" && i < argc-1) num_threads = atoi(argv[i+1]);
+        if (string(argv[i]) == "-l" && i < argc-1) epoch = atoi(argv[i+1]);
+        if (string(argv[i]) == "-s" && i < argc-1) start_idx = atoi(argv[i+1]);
+        if (string(argv[i]) == "-z" && i < argc-1) skew = atof(argv[i+1]);
+        if (string(argv[i]) == "-g" && i < argc-1) group_num = atoi(argv[i+1]);
+        if (string(argv[i]) == "-e" && i < argc-1) error_threshold = atof(argv[i+1]);
+        if (string(argv[i]) == "-a" && i < argc-1) lrate = atof(argv[i+1]);
+        if (string(argv[i]) == "-ms" && i < argc-1) scale = atof(argv[i+1]);
+        if (string(argv[i]) == "-h"){
+            cout << argv[0] << " [-m <users> -n <items> -nnz <ratings> -k <dim> -t <threads> -l <epochs> -s <first check> -z <item skew> -g <groups> -e <threshold> -a <lrate> -ms <magnitude scale>]" << endl;
+            return(0);
+        }
+    }
+
+    cout << endl;
+    cout << "The number of users         : " << max_user << endl;
+    cout << "The number of items         : " << max_item << endl;
+    cout << "The number of nonzeros      : " << n << endl;
+    cout << "Latent features             : " << k << endl;
+    cout << "Num of CPU threads          : " << num_threads << endl;
+    cout << "Epochs / first check        : " << epoch << " / " << start_idx << endl;
+    cout << "Error threshold             : " << error_threshold << endl;
+    cout << "Magnitude scale             : " << scale << endl;
+#if defined(__AVX512BF16__)
+    cout << "bf16 dot products           : AVX-512 BF16" << endl;
+#else
+    cout << "bf16 dot products           : shift to fp32" << endl;
+#endif
+
+    Node* R = new Node[n];
+    float* p = new float[(size_t)max_user * k];
+    float* q = new float[(size_t)max_item * k];
+    generate_ratings(R, n, max_user, max_item, skew, scale, num_threads);
+    init_features(p, (size_t)max_user * k, 0.1f * sqrtf(scale), 1);
+    init_features(q, (size_t)max_item * k, 0.1f * sqrtf(scale), 2);
+
+    unsigned int user_group_num = min(group_num, max_user);
+    unsigned int item_group_num = min(group_num, max_item);
+    unsigned int shard_size = (n + num_threads - 1) / num_threads;
+    unsigned int sample_ratings_num = shard_size * sample_ratio;
+    const unsigned char formats[3] = {0, GROUP_PREC_BF16, 0};
+    const char* format_names[3] = {"fp16", "bf16", "per group"};
+
+    cout << "\n" << setw(10) << "-hf" << setw(16) << "fp32 (u / i)" << setw(16) << "bf16 (u / i)" << setw(16) << "bytes before" << setw(16) << "bytes after"
+         << setw(16) << "ms/epoch" << setw(14) << "train RMSE" << endl;
+    for (unsigned int f = 0; f < 3; f++){
+        void** user_group_ptr = new void*[user_group_num];
+        void** item_group_ptr = new void*[item_group_num];
+        unsigned char* user_group_prec = new unsigned char[user_group_num];
+        unsigned char* item_group_prec = new unsigned char[item_group_num];
+        unsigned int* user_group_end_idx = new unsigned int[user_group_num];
+        unsigned int* item_group_end_idx = new unsigned int[item_group_num];
+        unsigned int* user_group_size = new unsigned int[user_group_num];
+        unsigned int* item_group_size = new unsigned int[item_group_num];
+        build_groups(p, max_user, k, user_group_num, formats[f], user_group_ptr, user_group_prec, user_group_end_idx, user_group_size);
+        build_groups(q, max_item, k, item_group_num, formats[f], item_group_ptr, item_group_prec, item_group_end_idx, item_group_size);
+        Cpu_group_layout user_layout, item_layout;
+        build_cpu_group_layout(&user_layout, user_group_ptr, user_group_prec, user_group_end_idx, user_group_num);
+        build_cpu_group_layout(&item_layout, item_group_ptr, item_group_prec, item_group_end_idx, item_group_num);
+        size_t bytes_before = groups_footprint(user_group_prec, user_group_size, user_group_num, k) + groups_footprint(item_group_prec, item_group_size, item_group_num, k);
+
+        float* grad_sum_norm_p = new float[(size_t)num_threads * user_group_num * k];
+        float* grad_sum_norm_q = new float[(size_t)num_threads * item_group_num * k];
+        float* norm_sum_p = new float[(size_t)num_threads * user_group_num];
+        float* norm_sum_q = new float[(size_t)num_threads * item_group_num];
+        float* work = new float[(size_t)num_threads * 2 * MAX_INTERLEAVE * k];
+        vector<double> user_group_loss((size_t)num_threads * user_group_num), item_group_loss((size_t)num_threads * item_group_num);
+        vector<float> initial_user_error(user_group_num, 1.0f), initial_item_error(item_group_num, 1.0f);
+        vector<float> user_error(user_group_num), item_error(item_group_num);
+        double update_time = 0, loss = 0;
+
+        for (unsigned int e = 0; e < epoch; e++){
+            bool error_check = e >= start_idx && e + 1 != epoch;
+            unsigned int first_sample_rating_idx = error_check ? shard_size - sample_ratings_num : shard_size;
+            memset(grad_sum_norm_p, 0, sizeof(float) * num_threads * user_group_num * k);
+            memset(grad_sum_norm_q, 0, sizeof(float) * num_threads * item_group_num * k);
+            memset(norm_sum_p, 0, sizeof(float) * num_threads * user_group_num);
+            memset(norm_sum_q, 0, sizeof(float) * num_threads * item_group_num);
+            fill(user_group_loss.begin(), user_group_loss.end(), 0.0);
+            fill(item_group_loss.begin(), item_group_loss.end(), 0.0);
+
+            std::chrono::time_point<std::chrono::system_clock> start_time = std::chrono::system_clock::now();
+            vector<thread> workers;
+            for (unsigned int t = 0; t < num_threads; t++){
+                unsigned int begin = min((size_t)t * shard_size, n);
+                unsigned int end = min((size_t)begin + shard_size, n);
+                workers.push_back(thread(cpu_mascot_sgd_worker, R, begin, end, &user_layout, &item_layout, lrate / scale / (1.0f + 0.1f * powf(e, 1.5f)), k, lambda * scale,
+                                         grad_sum_norm_p + (size_t)t * user_group_num * k, grad_sum_norm_q + (size_t)t * item_group_num * k,
+                                         norm_sum_p + (size_t)t * user_group_num, norm_sum_q + (size_t)t * item_group_num,
+                                         first_sample_rating_idx, 8u, 4u, work + (size_t)t * 2 * MAX_INTERLEAVE * k,
+                                         &user_group_loss[(size_t)t * user_group_num], &item_group_loss[(size_t)t * item_group_num], e * num_threads + t));
+            }
+            for (unsigned int t = 0; t < num_threads; t++) workers[t].join();
+            update_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_time).count();
+            loss = 0;
+            for (size_t j = 0; j < user_group_loss.size(); j++) loss += user_group_loss[j];
+
+            if (!error_check) continue;
+            group_errors(grad_sum_norm_p, norm_sum_p, user_group_prec, user_group_num, k, num_threads, initial_user_error, &user_error);
+            group_errors(grad_sum_norm_q, norm_sum_q, item_group_prec, item_group_num, k, num_threads, initial_item_error, &item_error);
+            if (e == start_idx){
+                initial_user_error = user_error;
+                initial_item_error = item_error;
+                continue;
+            }
+            for (unsigned int g = 0; g < user_group_num; g++)
+                if (user_error[g] > error_threshold) convert_grouped_params(&user_group_ptr[g], &user_group_prec[g], wider_group_prec(user_group_ptr[g], user_group_prec[g], user_group_size[g], k, f), user_group_size[g], k);
+            for (unsigned int g = 0; g < item_group_num; g++)
+                if (item_error[g] > error_threshold) convert_grouped_params(&item_group_ptr[g], &item_group_prec[g], wider_group_prec(item_group_ptr[g], item_group_prec[g], item_group_size[g], k, f), item_group_size[g], k);
+        }
+
+        unsigned int user_widened = 0, item_widened = 0, user_bf16 = 0, item_bf16 = 0;
+        for (unsigned int g = 0; g < user_group_num; g++) user_widened += user_group_prec[g] == 1;
+        for (unsigned int g = 0; g < item_group_num; g++) item_widened += item_group_prec[g] == 1;
+        for (unsigned int g = 0; g < user_group_num; g++) user_bf16 += user_group_prec[g] == GROUP_PREC_BF16;
+        for (unsigned int g = 0; g < item_group_num; g++) item_bf16 += item_group_prec[g] == GROUP_PREC_BF16;
+        size_t bytes_after = groups_footprint(user_group_prec, user_group_size, user_group_num, k) + groups_footprint(item_group_prec, item_group_size, item_group_num, k);
+        cout << setw(10) << format_names[f] << setw(16) << (to_string(user_widened) + " / " + to_string(item_widened))
+             << setw(16) << (to_string(user_bf16) + " / " + to_string(item_bf16))
+             << setw(16) << bytes_before << setw(16) << bytes_after << setw(16) << fixed << setprecision(2) << update_time / 1000 / epoch
+             << setw(14) << setprecision(4) << sqrt(loss / n) / scale << endl;
+
+        for (unsigned int g = 0; g < user_group_num; g++) delete_grouped_params(user_group_ptr[g], user_group_prec[g]);
+        for (unsigned int g = 0; g < item_group_num; g++) delete_grouped_params(item_group_ptr[g], item_group_prec[g]);
+        delete [] user_group_ptr;
+        delete [] item_group_ptr;
+        delete [] user_group_prec;
+        delete [] item_group_prec;
+        delete [] user_group_end_idx;
+        delete [] item_group_end_idx;
+        delete [] user_group_size;
+        delete [] item_group_size;
+        delete [] user_layout.sorted_idx2group;
+        delete [] user_layout.group_start_idx;
+        delete [] item_layout.sorted_idx2group;
+        delete [] item_layout.group_start_idx;
+        delete [] grad_sum_norm_p;
+        delete [] grad_sum_norm_q;
+        delete [] norm_sum_p;
+        delete [] norm_sum_q;
+        delete [] work;
+    }
+
+    cout << "\nfp32 and bf16 count the groups after the last epoch; bytes are the grouped parameters before and after;" << endl;
+    cout << "ms/epoch is the update loop alone; train RMSE is that of the last epoch, divided by -ms." << endl;
+    return 0;
+}
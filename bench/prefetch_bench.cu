@@ -0,0 +1,181 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cmath>
+#include "common_struct.h"
+#include "cpu_half.h"
+#include "cpu_sgd_kernel.h"
+#include "cpu_mascot_sgd_kernel.h"
+using namespace std;
+
+// Sweeps the prefetch distance and interleave width of the CPU SGD update loops (-v 10 and -v 11)
+// on synthetic data. The default shape follows Netflix (480,189 users, 17,770 items, 100,480,507 ratings).
+
+vector<unsigned int> parse_list(const string& s){
+    vector<unsigned int> out;
+    stringstream ss(s);
+    string tok;
+    while (getline(ss, tok, ',')) if (tok != "") out.push_back(atoi(tok.c_str()));
+    return out;
+}
+
+// Users are drawn uniformly and items with a power-law skew (x^skew) so that popular item rows stay cached
+// like they do on real data. Each thread fills its own slice with its own generator.
+void generate_ratings(Node* R, size_t n, unsigned int max_user, unsigned int max_item, float skew, unsigned int num_threads){
+    vector<thread> workers;
+    size_t slice = (n + num_threads - 1) / num_threads;
+    for (unsigned int t = 0; t < num_threads; t++){
+        workers.push_back(thread([=](){
+            mt19937 gen(1234 + t);
+            uniform_real_distribution<float> unif(0.0f, 1.0f);
+            for (size_t j = min(t * slice, n); j < min((t + 1) * slice, n); j++){
+                R[j].u = min((unsigned int)(unif(gen) * max_user), max_user - 1);
+                R[j].i = min((unsigned int)(powf(unif(gen), skew) * max_item), max_item - 1);
+                R[j].r = 1.0f + (unsigned int)(unif(gen) * 5) % 5;
+            }
+        }));
+    }
+    for (unsigned int t = 0; t < num_threads; t++) workers[t].join();
+}
+
+void init_features(float* feature_vec, size_t n, unsigned int seed){
+    mt19937 gen(seed);
+    normal_distribution<float> d(0, 0.1f);
+    for (size_t i = 0; i < n; i++) feature_vec[i] = d(gen);
+}
+
+// Equal-size fp16 groups in id order; enough to exercise the grouped decode and conversion path.
+void build_fp16_groups(float* feature_vec, unsigned int num, unsigned int k, unsigned int group_num, void** group_ptr, unsigned char* group_prec, unsigned int* group_end_idx){
+    unsigned int group_size = (num + group_num - 1) / group_num;
+    for (unsigned int g = 0; g < group_num; g++){
+        unsigned int start_idx = min(g * group_size, num);
+        unsigned int end_idx = min(start_idx + group_size, num);
+        unsigned short* group = new unsigned short[(size_t)max(end_idx - start_idx, 1u) * k];
+        cpu_float2half_row(group, feature_vec + (size_t)start_idx * k, (end_idx - start_idx) * k);
+        group_ptr[g] = group;
+        group_prec[g] = 0;
+        group_end_idx[g] = end_idx - 1;
+    }
+}
+
+int main(int argc, const char* argv[]){
+    unsigned int max_user = 480189;
+    unsigned int max_item = 17770;
+    size_t n = 100480507;
+    unsigned int k = 128;
+    unsigned int num_threads = thread::hardware_concurrency();
+    unsigned int repeat = 1;
+    unsigned int group_num = 100;
+    float skew = 2.0f;
+    float lrate = 0.005f;
+    float lambda = 0.015f;
+    string pd_list = "0,1,2,4,8,16,32,64";
+    string il_list = "1,4,8";
+    bool grouped = true;
+
+    for (int i = 0; i < argc; i++){
+        if (string(argv[i]) == "-m" && i < argc-1) max_user = atoi(argv[i+1]);
+        if (string(argv[i]) == "-n" && i < argc-1) max_item = atoi(argv[i+1]);
+        if (string(argv[i]) == "-nnz" && i < argc-1) n = atoll(argv[i+1]);
+        if (string(argv[i]) == "-k" && i < argc-1) k = atoi(argv[i+1]);
+        if (string(argv[i]) == "-t" && i < argc-1) num_threads = atoi(argv[i+1]);
+        if (string(argv[i]) == "-l" && i < argc-1) repeat = atoi(argv[i+1]);
+        if (string(argv[i]) == "-z" && i < argc-1) skew = atof(argv[i+1]);
+        if (string(argv[i]) == "-g" && i < argc-1) group_num = atoi(argv[i+1]);
+        if (string(argv[i]) == "-pd" && i < argc-1) pd_list = string(argv[i+1]);
+        if (string(argv[i]) == "-il" && i < argc-1) il_list = string(argv[i+1]);
+        if (string(argv[i]) == "-flat") grouped = false;
+        if (string(argv[i]) == "-h"){
+            cout << argv[0] << " [-m <users> -n <items> -nnz <ratings> -k <dim> -t <threads> -l <epochs/point> -z <item skew> -g <groups> -pd <list> -il <list> -flat]" << endl;
+            return(0);
+        }
+    }
+
+    vector<unsigned int> prefetch_distances = parse_list(pd_list);
+    vector<unsigned int> interleaves = parse_list(il_list);
+
+    cout << endl;
+    cout << "The number of users         : " << max_user << endl;
+    cout << "The number of items         : " << max_item << endl;
+    cout << "The number of nonzeros      : " << n << endl;
+    cout << "Latent features             : " << k << endl;
+    cout << "Num of CPU threads          : " << num_threads << endl;
+    cout << "Item skew                   : " << skew << endl;
+    cout << "Epochs per point            : " << repeat << endl;
+
+    Node* R = new Node[n];
+    float* p = new float[(size_t)max_user * k];
+    float* q = new float[(size_t)max_item * k];
+    generate_ratings(R, n, max_user, max_item, skew, num_threads);
+    init_features(p, (size_t)max_user * k, 1);
+    init_features(q, (size_t)max_item * k, 2);
+
+    unsigned int user_group_num = min(group_num, max_user);
+    unsigned int item_group_num = min(group_num, max_item);
+    void** user_group_ptr = new void*[user_group_num];
+    void** item_group_ptr = new void*[item_group_num];
+    unsigned char* user_group_prec = new unsigned char[user_group_num];
+    unsigned char* item_group_prec = new unsigned char[item_group_num];
+    unsigned int* user_group_end_idx = new unsigned int[user_group_num];
+    unsigned int* item_group_end_idx = new unsigned int[item_group_num];
+    Cpu_group_layout user_layout, item_layout;
+    float* grad_sum_norm_p = NULL;
+    float* grad_sum_norm_q = NULL;
+    float* norm_sum_p = NULL;
+    float* norm_sum_q = NULL;
+    float* work = NULL;
+
+    if (grouped){
+        build_fp16_groups(p, max_user, k, user_group_num, user_group_ptr, user_group_prec, user_group_end_idx);
+        build_fp16_groups(q, max_item, k, item_group_num, item_group_ptr, item_group_prec, item_group_end_idx);
+        build_cpu_group_layout(&user_layout, user_group_ptr, user_group_prec, user_group_end_idx, user_group_num);
+        build_cpu_group_layout(&item_layout, item_group_ptr, item_group_prec, item_group_end_idx, item_group_num);
+        grad_sum_norm_p = new float[(size_t)num_threads * user_group_num * k]();
+        grad_sum_norm_q = new float[(size_t)num_threads * item_group_num * k]();
+        norm_sum_p = new float[(size_t)num_threads * user_group_num]();
+        norm_sum_q = new float[(size_t)num_threads * item_group_num]();
+        work = new float[(size_t)num_threads * 2 * MAX_INTERLEAVE * k];
+    }
+
+    unsigned int shard_size = (n + num_threads - 1) / num_threads;
+
+    for (int layout = 0; layout < (grouped ? 2 : 1); layout++){
+        double baseline_ns = 0;
+        cout << "\n<" << (layout == 0 ? "FP32 flat layout (-v 10)" : "FP16 grouped layout (-v 11)") << ">" << endl;
+        cout << setw(10) << "distance" << setw(12) << "interleave" << setw(14) << "ns/update" << setw(16) << "Mupdates/s" << setw(10) << "speedup" << endl;
+
+        for (unsigned int il : interleaves){
+            for (unsigned int pd : prefetch_distances){
+                std::chrono::time_point<std::chrono::system_clock> start_time = std::chrono::system_clock::now();
+                for (unsigned int e = 0; e < repeat; e++){
+                    vector<thread> workers;
+                    for (unsigned int t = 0; t < num_threads; t++){
+                        unsigned int begin = min((size_t)t * shard_size, n);
+                        unsigned int end = min((size_t)begin + shard_size, n);
+                        if (layout == 0)
+                            workers.push_back(thread(cpu_prefetch_sgd_worker, R, begin, end, p, q, lrate, k, lambda, pd, il, (const unsigned int*)NULL, (float*)NULL, (double*)NULL));
+                        else
+                            workers.push_back(thread(cpu_mascot_sgd_worker, R, begin, end, &user_layout, &item_layout, lrate, k, lambda,
+                                                     grad_sum_norm_p + (size_t)t * user_group_num * k, grad_sum_norm_q + (size_t)t * item_group_num * k,
+                                                     norm_sum_p + (size_t)t * user_group_num, norm_sum_q + (size_t)t * item_group_num,
+                                                     end - begin, pd, il, work + (size_t)t * 2 * MAX_INTERLEAVE * k,
+                                                     (double*)NULL, (double*)NULL, e * num_threads + t));
+                    }
+                    for (unsigned int t = 0; t < num_threads; t++) workers[t].join();
+                }
+                double exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_time).count();
+                double ns_per_update = exec_time * 1000.0 / ((double)n * repeat);
+                if (baseline_ns == 0) baseline_ns = ns_per_update;
+
+                cout << setw(10) << pd << setw(12) << il << setw(14) << fixed << setprecision(3) << ns_per_update
+                     << setw(16) << setprecision(2) << 1000.0 / ns_per_update << setw(10) << baseline_ns / ns_per_update << endl;
+            }
+        }
+    }
+
+    cout << "\nns/update is wall time per rating over all threads; speedup is relative to the first point of each layout." << endl;
+    return 0;
+}
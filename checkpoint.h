@@ -0,0 +1,762 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <iostream>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include "common_struct.h"
+#include "cpu_half.h"
+#include "cpu_int8.h"
+using namespace std;
+
+// Checkpoint of a MASCOT run (-v 1, -v 11) at the end of an epoch. Together with the training file it is the
+// complete training state: the shuffle seed regenerates the order of R, the sorted permutations and group
+// boundaries replace the histogram and the grouping, the calibration errors of epoch start_idx and the group
+// precisions let a resumed run skip the calibration, and the groups are stored in the precision they have.
+// The GPU version also stores its curand states. The file is the header followed by the arrays in the order of
+// Training_checkpoint; a checkpoint is written next to its path and renamed over it, so the last complete one
+// survives a crash in the middle of a write. Training only serializes the image into one of CHECKPOINT_BUFFER_NUM
+// spare buffers; a background thread writes and syncs it while the next epochs run.
+#define CHECKPOINT_MAGIC "MFCKPT01"
+#define CHECKPOINT_BUFFER_NUM 2
+#define CHECKPOINT_WRITE_CHUNK (8 << 20)
+#define CHECKPOINT_DELTA_MAGIC "MFDELT01"
+#define CHECKPOINT_BLOCK_ROWS 256u
+
+struct Checkpoint_header{
+    char magic[8];
+    unsigned int version;
+    unsigned int k;
+    unsigned int max_user;
+    unsigned int max_item;
+    unsigned int n;                 // training ratings after the validation split
+    unsigned int user_group_num;
+    unsigned int item_group_num;
+    unsigned int workers;           // CPU threads or GPU workers, which decide the order of the updates
+    unsigned int shuffle_seed;
+    int epochs_done;
+    unsigned long long rand_state_bytes;
+};
+
+struct Training_checkpoint{
+    Checkpoint_header header;
+    vector<unsigned int> user2idx, item2idx;        // sorted index -> internal id
+    vector<unsigned int> user2cnt, item2cnt;        // degree per sorted index
+    vector<unsigned int> user_group_end_idx, item_group_end_idx;
+    vector<unsigned char> user_group_prec, item_group_prec;
+    vector<float> user_group_error, item_group_error;
+    vector<float> initial_user_group_error, initial_item_group_error;
+    vector<vector<char>> user_groups, item_groups;
+    vector<char> rand_state;
+};
+
+template <typename T>
+char* put_checkpoint_array(char* dst, const T* a, size_t n){
+    if (n) memcpy(dst, a, sizeof(T) * n);
+    return dst + sizeof(T) * n;
+}
+
+template <typename T>
+bool get_checkpoint_array(const char** src, const char* end, vector<T>* a, size_t n){
+    if ((size_t)(end - *src) < sizeof(T) * n) return false;
+    a->resize(n);
+    if (n) memcpy(a->data(), *src, sizeof(T) * n);
+    *src += sizeof(T) * n;
+    return true;
+}
+
+inline size_t checkpoint_group_bytes(unsigned int group_size, unsigned char prec, unsigned int k){
+    return (size_t)group_size * grouped_row_bytes(prec, k);
+}
+
+// Image of the state after epochs_done epochs in out, which keeps its capacity from one checkpoint to the
+// next. user_groups/item_groups are host copies of the groups, in the precision of *_group_prec_info;
+// rand_state is NULL on the CPU.
+void serialize_training_checkpoint(vector<char>* out, Mf_info* mf_info, void** user_groups, void** item_groups,
+                                   const float* initial_user_group_error, const float* initial_item_group_error, unsigned int workers,
+                                   unsigned int shuffle_seed, int epochs_done, const void* rand_state, size_t rand_state_bytes){
+    Checkpoint_header header;
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = mf_info->version;
+    header.k = mf_info->params.k;
+    header.max_user = mf_info->max_user;
+    header.max_item = mf_info->max_item;
+    header.n = mf_info->n;
+    header.user_group_num = mf_info->params.user_group_num;
+    header.item_group_num = mf_info->params.item_group_num;
+    header.workers = workers;
+    header.shuffle_seed = shuffle_seed;
+    header.epochs_done = epochs_done;
+    header.rand_state_bytes = rand_state_bytes;
+
+    unsigned int ugn = header.user_group_num, ign = header.item_group_num;
+    size_t bytes = sizeof(header) + sizeof(unsigned int) * 2 * ((size_t)header.max_user + header.max_item) +
+                   (sizeof(unsigned int) + sizeof(unsigned char) + 2 * sizeof(float)) * (ugn + ign) + rand_state_bytes;
+    for (unsigned int g = 0; g < ugn; g++) bytes += checkpoint_group_bytes(mf_info->user_group_size[g], mf_info->user_group_prec_info[g], header.k);
+    for (unsigned int g = 0; g < ign; g++) bytes += checkpoint_group_bytes(mf_info->item_group_size[g], mf_info->item_group_prec_info[g], header.k);
+    out->resize(bytes);
+
+    char* dst = out->data();
+    dst = put_checkpoint_array(dst, &header, 1);
+    dst = put_checkpoint_array(dst, mf_info->user2idx, mf_info->max_user);
+    dst = put_checkpoint_array(dst, mf_info->item2idx, mf_info->max_item);
+    dst = put_checkpoint_array(dst, mf_info->user2cnt, mf_info->max_user);
+    dst = put_checkpoint_array(dst, mf_info->item2cnt, mf_info->max_item);
+    dst = put_checkpoint_array(dst, mf_info->user_group_end_idx, ugn);
+    dst = put_checkpoint_array(dst, mf_info->item_group_end_idx, ign);
+    dst = put_checkpoint_array(dst, mf_info->user_group_prec_info, ugn);
+    dst = put_checkpoint_array(dst, mf_info->item_group_prec_info, ign);
+    dst = put_checkpoint_array(dst, mf_info->user_group_error, ugn);
+    dst = put_checkpoint_array(dst, mf_info->item_group_error, ign);
+    dst = put_checkpoint_array(dst, initial_user_group_error, ugn);
+    dst = put_checkpoint_array(dst, initial_item_group_error, ign);
+    for (unsigned int g = 0; g < ugn; g++)
+        dst = put_checkpoint_array(dst, (char*)user_groups[g], checkpoint_group_bytes(mf_info->user_group_size[g], mf_info->user_group_prec_info[g], header.k));
+    for (unsigned int g = 0; g < ign; g++)
+        dst = put_checkpoint_array(dst, (char*)item_groups[g], checkpoint_group_bytes(mf_info->item_group_size[g], mf_info->item_group_prec_info[g], header.k));
+    put_checkpoint_array(dst, (const char*)rand_state, rand_state_bytes);
+}
+
+// Writes an image to path + ".tmp" with pwrite in CHECKPOINT_WRITE_CHUNK pieces, syncs it and renames it over
+// path, then syncs the directory so the rename itself survives a crash.
+bool write_checkpoint_file(const string& path, const char* data, size_t bytes){
+    string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0){
+        cout << "fail to write checkpoint " << tmp_path << ": " << strerror(errno) << endl;
+        return false;
+    }
+    size_t offset = 0;
+    bool ok = true;
+    while (ok && offset < bytes){
+        ssize_t written = pwrite(fd, data + offset, min((size_t)CHECKPOINT_WRITE_CHUNK, bytes - offset), offset);
+        if (written > 0) offset += written;
+        else ok = written < 0 && errno == EINTR;
+    }
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0){
+        cout << "fail to write checkpoint " << path << ": " << strerror(errno) << endl;
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    size_t slash = path.rfind('/');
+    int dir_fd = open(slash == string::npos ? "." : path.substr(0, max(slash, (size_t)1)).c_str(), O_RDONLY);
+    if (dir_fd >= 0){
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return true;
+}
+
+bool read_checkpoint_file(const string& path, vector<char>* image){
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == NULL) return false;
+    bool ok = fseek(f, 0, SEEK_END) == 0;
+    long bytes = ok ? ftell(f) : -1;
+    ok = bytes >= 0 && fseek(f, 0, SEEK_SET) == 0;
+    if (ok){
+        image->resize(bytes);
+        ok = bytes == 0 || fread(image->data(), 1, bytes, f) == (size_t)bytes;
+    }
+    fclose(f);
+    return ok;
+}
+
+// Offsets of the parts of a checkpoint image. The precisions and the four error arrays are contiguous from prec
+// to the first group; group_offset holds the user groups, then the item groups, then the offset of rand_state.
+struct Checkpoint_layout{
+    Checkpoint_header header;
+    size_t prec;
+    vector<size_t> group_offset;
+    vector<unsigned int> group_rows;
+    vector<unsigned char> group_prec;
+};
+
+inline size_t checkpoint_state_bytes(const Checkpoint_header& h){
+    return (size_t)(h.user_group_num + h.item_group_num) * (sizeof(unsigned char) + 2 * sizeof(float));
+}
+
+// Layout of an image whose header, tables and precisions are in place; false when it is not a checkpoint or
+// they don't fit in bytes. The groups themselves need not be there yet, see checkpoint_image_complete.
+bool checkpoint_image_layout(const char* image, size_t bytes, Checkpoint_layout* l){
+    if (bytes < sizeof(Checkpoint_header)) return false;
+    memcpy(&l->header, image, sizeof(Checkpoint_header));
+    const Checkpoint_header& h = l->header;
+    if (memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0) return false;
+    unsigned int group_num = h.user_group_num + h.item_group_num;
+    size_t end_idx = sizeof(Checkpoint_header) + sizeof(unsigned int) * 2 * ((size_t)h.max_user + h.max_item);
+    l->prec = end_idx + sizeof(unsigned int) * group_num;
+    size_t offset = l->prec + checkpoint_state_bytes(h);
+    if (offset > bytes) return false;
+    vector<unsigned int> end(group_num);
+    memcpy(end.data(), image + end_idx, sizeof(unsigned int) * group_num);
+    l->group_offset.resize(group_num + 1);
+    l->group_rows.resize(group_num);
+    l->group_prec.assign(image + l->prec, image + l->prec + group_num);
+    for (unsigned int g = 0; g < group_num; g++){
+        unsigned int start_idx = g == 0 || g == h.user_group_num ? 0 : end[g - 1] + 1;
+        l->group_rows[g] = end[g] + 1 - start_idx;
+        l->group_offset[g] = offset;
+        offset += checkpoint_group_bytes(l->group_rows[g], l->group_prec[g], h.k);
+    }
+    l->group_offset[group_num] = offset;
+    return true;
+}
+
+inline bool checkpoint_image_complete(const Checkpoint_layout& l, size_t bytes){
+    return l.group_offset.back() + l.header.rand_state_bytes == bytes;
+}
+
+// Delta checkpoint (-cd): the rows of each group are split into blocks of block_rows, and a delta holds the
+// blocks that changed since the checkpoint it applies to. Its file is the delta header, the new checkpoint
+// header, the precisions and errors, rand_state, the ids of the dirty blocks (numbered over the user groups,
+// then the item groups) and their rows in the new precision. A group whose precision changed is dirty as a
+// whole. Deltas n = 1, 2, ... of the full checkpoint at path are path.delta.n.
+struct Delta_checkpoint_header{
+    char magic[8];
+    unsigned int base_seed;         // shuffle seed and epochs_done of the full checkpoint at the head of the chain
+    int base_epochs;
+    int prev_epochs;                // epochs_done of the checkpoint the delta applies to
+    unsigned int block_rows;
+    unsigned int dirty_block_num;
+    unsigned int block_num;
+};
+
+inline string checkpoint_delta_path(const string& path, unsigned int n){
+    return path + ".delta." + to_string(n);
+}
+
+// Removes the deltas of the previous chain once a full checkpoint replaced it, first to last so that a crash in
+// between never leaves a gap a reader could skip over.
+void remove_checkpoint_deltas(const string& path){
+    for (unsigned int n = 1; unlink(checkpoint_delta_path(path, n).c_str()) == 0; n++);
+}
+
+inline unsigned int checkpoint_block_num(unsigned int rows, unsigned int block_rows){
+    return (rows + block_rows - 1) / block_rows;
+}
+
+// Whether a block of rows moved by more than threshold in some value; threshold 0 compares the bits.
+bool checkpoint_block_changed(const char* a, const char* b, size_t rows, unsigned int k, unsigned char prec, float threshold){
+    size_t row_bytes = grouped_row_bytes(prec, k);
+    if (threshold == 0) return memcmp(a, b, rows * row_bytes) != 0;
+    vector<float> x(k), y(k);
+    for (size_t r = 0; r < rows; r++){
+        cpu_grouped2float_row(x.data(), a + r * row_bytes, prec, k);
+        cpu_grouped2float_row(y.data(), b + r * row_bytes, prec, k);
+        for (unsigned int d = 0; d < k; d++) if (!(fabs(x[d] - y[d]) <= threshold)) return true;
+    }
+    return false;
+}
+
+// Delta from the image prev (the state of the chain so far) to image. False when the grouping differs, in which
+// case only a full checkpoint can describe image.
+bool build_checkpoint_delta(const vector<char>& prev, const vector<char>& image, float threshold, unsigned int base_seed, int base_epochs,
+                            vector<char>* delta, unsigned int* dirty_block_num, unsigned int* block_num){
+    Checkpoint_layout pl, nl;
+    if (!checkpoint_image_layout(prev.data(), prev.size(), &pl) || !checkpoint_image_layout(image.data(), image.size(), &nl) ||
+        !checkpoint_image_complete(pl, prev.size()) || !checkpoint_image_complete(nl, image.size())) return false;
+    const Checkpoint_header& h = nl.header;
+    if (h.k != pl.header.k || h.user_group_num != pl.header.user_group_num || h.item_group_num != pl.header.item_group_num ||
+        h.rand_state_bytes != pl.header.rand_state_bytes || pl.prec != nl.prec ||
+        memcmp(prev.data() + sizeof(Checkpoint_header), image.data() + sizeof(Checkpoint_header), nl.prec - sizeof(Checkpoint_header)) != 0) return false;
+
+    unsigned int group_num = h.user_group_num + h.item_group_num;
+    vector<unsigned int> dirty;
+    unsigned int id = 0;
+    for (unsigned int g = 0; g < group_num; g++){
+        unsigned int blocks = checkpoint_block_num(nl.group_rows[g], CHECKPOINT_BLOCK_ROWS);
+        for (unsigned int b = 0; b < blocks; b++, id++){
+            size_t row = (size_t)b * CHECKPOINT_BLOCK_ROWS;
+            size_t rows = min(CHECKPOINT_BLOCK_ROWS, nl.group_rows[g] - (unsigned int)row);
+            size_t offset = checkpoint_group_bytes(row, nl.group_prec[g], h.k);
+            if (pl.group_prec[g] != nl.group_prec[g] ||
+                checkpoint_block_changed(prev.data() + pl.group_offset[g] + offset, image.data() + nl.group_offset[g] + offset, rows, h.k, nl.group_prec[g], threshold))
+                dirty.push_back(id);
+        }
+    }
+    *dirty_block_num = dirty.size();
+    *block_num = id;
+
+    Delta_checkpoint_header dh;
+    memcpy(dh.magic, CHECKPOINT_DELTA_MAGIC, sizeof(dh.magic));
+    dh.base_seed = base_seed;
+    dh.base_epochs = base_epochs;
+    dh.prev_epochs = pl.header.epochs_done;
+    dh.block_rows = CHECKPOINT_BLOCK_ROWS;
+    dh.dirty_block_num = dirty.size();
+    dh.block_num = id;
+    size_t state_bytes = checkpoint_state_bytes(h);
+    size_t bytes = sizeof(dh) + sizeof(h) + state_bytes + h.rand_state_bytes + sizeof(unsigned int) * dirty.size();
+    // The dirty blocks are found group by group, so their data is gathered the same way.
+    size_t data_bytes = 0;
+    id = 0;
+    size_t d = 0;
+    for (unsigned int g = 0; g < group_num && d < dirty.size(); g++){
+        unsigned int blocks = checkpoint_block_num(nl.group_rows[g], CHECKPOINT_BLOCK_ROWS);
+        for (; d < dirty.size() && dirty[d] < id + blocks; d++){
+            unsigned int row = (dirty[d] - id) * CHECKPOINT_BLOCK_ROWS;
+            data_bytes += checkpoint_group_bytes(min(CHECKPOINT_BLOCK_ROWS, nl.group_rows[g] - row), nl.group_prec[g], h.k);
+        }
+        id += blocks;
+    }
+    delta->resize(bytes + data_bytes);
+
+    char* dst = delta->data();
+    dst = put_checkpoint_array(dst, &dh, 1);
+    dst = put_checkpoint_array(dst, &h, 1);
+    dst = put_checkpoint_array(dst, image.data() + nl.prec, state_bytes);
+    dst = put_checkpoint_array(dst, image.data() + nl.group_offset[group_num], h.rand_state_bytes);
+    dst = put_checkpoint_array(dst, dirty.data(), dirty.size());
+    id = 0;
+    d = 0;
+    for (unsigned int g = 0; g < group_num && d < dirty.size(); g++){
+        unsigned int blocks = checkpoint_block_num(nl.group_rows[g], CHECKPOINT_BLOCK_ROWS);
+        for (; d < dirty.size() && dirty[d] < id + blocks; d++){
+            unsigned int row = (dirty[d] - id) * CHECKPOINT_BLOCK_ROWS;
+            dst = put_checkpoint_array(dst, image.data() + nl.group_offset[g] + checkpoint_group_bytes(row, nl.group_prec[g], h.k),
+                                       checkpoint_group_bytes(min(CHECKPOINT_BLOCK_ROWS, nl.group_rows[g] - row), nl.group_prec[g], h.k));
+        }
+        id += blocks;
+    }
+    return true;
+}
+
+// Applies a delta to the image base into out. The delta must continue base (prev_epochs) and describe the same
+// grouping; a group that changed precision must be complete in it.
+bool apply_checkpoint_delta(const vector<char>& base, const char* delta, size_t delta_bytes, vector<char>* out){
+    Checkpoint_layout bl;
+    Delta_checkpoint_header dh;
+    Checkpoint_header h;
+    if (!checkpoint_image_layout(base.data(), base.size(), &bl) || !checkpoint_image_complete(bl, base.size()) ||
+        delta_bytes < sizeof(dh) + sizeof(h)) return false;
+    memcpy(&dh, delta, sizeof(dh));
+    memcpy(&h, delta + sizeof(dh), sizeof(h));
+    if (memcmp(dh.magic, CHECKPOINT_DELTA_MAGIC, sizeof(dh.magic)) != 0 || dh.prev_epochs != bl.header.epochs_done || dh.block_rows == 0 ||
+        memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0 || h.k != bl.header.k || h.max_user != bl.header.max_user ||
+        h.max_item != bl.header.max_item || h.user_group_num != bl.header.user_group_num || h.item_group_num != bl.header.item_group_num) return false;
+    size_t state_bytes = checkpoint_state_bytes(h);
+    const char* src = delta + sizeof(dh) + sizeof(h);
+    const char* end = delta + delta_bytes;
+    vector<char> state, rand_state;
+    vector<unsigned int> dirty;
+    if (!get_checkpoint_array(&src, end, &state, state_bytes) || !get_checkpoint_array(&src, end, &rand_state, h.rand_state_bytes) ||
+        !get_checkpoint_array(&src, end, &dirty, dh.dirty_block_num)) return false;
+
+    // Header, tables and state first, which gives the layout of the new image.
+    out->assign(base.begin(), base.begin() + bl.prec);
+    memcpy(out->data(), &h, sizeof(h));
+    out->insert(out->end(), state.begin(), state.end());
+    Checkpoint_layout nl;
+    if (!checkpoint_image_layout(out->data(), out->size(), &nl)) return false;
+    unsigned int group_num = h.user_group_num + h.item_group_num;
+    out->resize(nl.group_offset[group_num] + h.rand_state_bytes);
+    memcpy(out->data() + nl.group_offset[group_num], rand_state.data(), h.rand_state_bytes);
+
+    unsigned int id = 0;
+    size_t d = 0;
+    for (unsigned int g = 0; g < group_num; g++){
+        unsigned int blocks = checkpoint_block_num(nl.group_rows[g], dh.block_rows);
+        bool same_prec = bl.group_prec[g] == nl.group_prec[g];
+        if (same_prec) memcpy(out->data() + nl.group_offset[g], base.data() + bl.group_offset[g], nl.group_offset[g + 1] - nl.group_offset[g]);
+        unsigned int patched = 0;
+        for (; d < dirty.size() && dirty[d] < id + blocks; d++, patched++){
+            unsigned int row = (dirty[d] - id) * dh.block_rows;
+            size_t bytes = checkpoint_group_bytes(min(dh.block_rows, nl.group_rows[g] - row), nl.group_prec[g], h.k);
+            if ((size_t)(end - src) < bytes) return false;
+            memcpy(out->data() + nl.group_offset[g] + checkpoint_group_bytes(row, nl.group_prec[g], h.k), src, bytes);
+            src += bytes;
+        }
+        if (!same_prec && patched != blocks) return false;
+        id += blocks;
+    }
+    return d == dirty.size() && id == dh.block_num && src == end;
+}
+
+// Image of the full checkpoint at path with the deltas of its chain applied. A delta that doesn't continue the
+// chain (left over from an earlier chain, or cut short by a crash) ends it.
+bool read_checkpoint_chain(const string& path, vector<char>* image, unsigned int* deltas_applied){
+    *deltas_applied = 0;
+    Checkpoint_layout head;
+    if (!read_checkpoint_file(path, image) || !checkpoint_image_layout(image->data(), image->size(), &head) ||
+        !checkpoint_image_complete(head, image->size())) return false;
+    vector<char> delta, next;
+    for (unsigned int n = 1; read_checkpoint_file(checkpoint_delta_path(path, n), &delta); n++){
+        Delta_checkpoint_header dh;
+        if (delta.size() < sizeof(dh)) break;
+        memcpy(&dh, delta.data(), sizeof(dh));
+        if (dh.base_seed != head.header.shuffle_seed || dh.base_epochs != head.header.epochs_done ||
+            !apply_checkpoint_delta(*image, delta.data(), delta.size(), &next)) break;
+        image->swap(next);
+        (*deltas_applied)++;
+    }
+    return true;
+}
+
+enum Checkpoint_buffer_state { CHECKPOINT_FREE, CHECKPOINT_PENDING, CHECKPOINT_WRITING };
+
+struct Checkpoint_record{
+    int epoch;
+    bool full;
+    unsigned int dirty_block_num;
+    unsigned int block_num;
+    size_t bytes;
+};
+
+// Double-buffered checkpoint writer, the counterpart of Async_evaluator: the training thread serializes into a
+// free buffer and goes on, the I/O thread writes the pending buffers in epoch order. A buffer is only reused
+// after its write finished, so the file on disk is always a complete checkpoint of some epoch. With delta
+// checkpoints the I/O thread also keeps the image the chain on disk adds up to, and diffs against it.
+struct Checkpoint_writer{
+    string path;
+    float delta_threshold;                  // -cd, negative without delta checkpoints
+    unsigned int full_interval;             // deltas between two full checkpoints
+    vector<char> chain_image;               // I/O thread: the state of the full checkpoint plus its deltas
+    Checkpoint_header chain_base;           // header of that full checkpoint
+    vector<char> delta_image;
+    vector<char> scratch;
+    unsigned int chain_len;
+    vector<Checkpoint_record> records;
+    vector<char> image[CHECKPOINT_BUFFER_NUM];
+    Checkpoint_buffer_state state[CHECKPOINT_BUFFER_NUM];
+    int epoch[CHECKPOINT_BUFFER_NUM];
+
+    mutex m;
+    condition_variable cv;
+    bool stop;
+    thread worker;
+
+    unsigned int written;
+    unsigned int failed;
+    int last_epoch;                         // epochs_done of the last checkpoint on disk
+    size_t written_bytes;
+    size_t full_bytes;
+    double snapshot_exec_time;              // training thread: serializing into a buffer
+    double stall_exec_time;                 // training thread: waiting for a free buffer and the final drain
+    double write_exec_time;                 // I/O thread: pwrite, fsync and rename
+};
+
+// Writes one image, as a delta of the chain when that is possible; runs on the I/O thread without the lock.
+bool write_checkpoint_image(Checkpoint_writer* w, const vector<char>& image, Checkpoint_record* record){
+    if (w->delta_threshold >= 0 && w->chain_image.size() && w->chain_len < w->full_interval &&
+        build_checkpoint_delta(w->chain_image, image, w->delta_threshold, w->chain_base.shuffle_seed, w->chain_base.epochs_done,
+                               &w->delta_image, &record->dirty_block_num, &record->block_num)){
+        record->full = false;
+        record->bytes = w->delta_image.size();
+        if (!write_checkpoint_file(checkpoint_delta_path(w->path, w->chain_len + 1), w->delta_image.data(), w->delta_image.size())) return false;
+        apply_checkpoint_delta(w->chain_image, w->delta_image.data(), w->delta_image.size(), &w->scratch);
+        w->chain_image.swap(w->scratch);
+        w->chain_len++;
+        return true;
+    }
+    record->full = true;
+    record->bytes = image.size();
+    if (!write_checkpoint_file(w->path, image.data(), image.size())) return false;
+    if (w->delta_threshold >= 0){
+        remove_checkpoint_deltas(w->path);
+        w->chain_image = image;
+        memcpy(&w->chain_base, image.data(), sizeof(Checkpoint_header));
+        w->chain_len = 0;
+    }
+    return true;
+}
+
+void checkpoint_writer_worker(Checkpoint_writer* w){
+    while (true){
+        unique_lock<mutex> lk(w->m);
+        int b = -1;
+        w->cv.wait(lk, [&]{
+            for (int s = 0; s < CHECKPOINT_BUFFER_NUM; s++)
+                if (w->state[s] == CHECKPOINT_PENDING && (b < 0 || w->epoch[s] < w->epoch[b])) b = s;
+            return w->stop || b >= 0;
+        });
+        if (b < 0) break;
+        w->state[b] = CHECKPOINT_WRITING;
+        lk.unlock();
+
+        std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+        Checkpoint_record record = {w->epoch[b], true, 0, 0, 0};
+        bool ok = write_checkpoint_image(w, w->image[b], &record);
+        double exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+
+        lk.lock();
+        w->write_exec_time += exec_time;
+        if (ok){
+            w->written++;
+            w->written_bytes += record.bytes;
+            if (record.full) w->full_bytes += record.bytes;
+            w->last_epoch = w->epoch[b];
+            w->records.push_back(record);
+        }else w->failed++;
+        w->state[b] = CHECKPOINT_FREE;
+        w->cv.notify_all();
+    }
+}
+
+void init_checkpoint_writer(Checkpoint_writer* w, const string& path, float delta_threshold, unsigned int full_interval){
+    w->path = path;
+    w->delta_threshold = delta_threshold;
+    w->full_interval = full_interval;
+    w->chain_len = 0;
+    for (int b = 0; b < CHECKPOINT_BUFFER_NUM; b++) w->state[b] = CHECKPOINT_FREE;
+    w->stop = false;
+    w->written = 0;
+    w->failed = 0;
+    w->last_epoch = -1;
+    w->written_bytes = 0;
+    w->full_bytes = 0;
+    w->snapshot_exec_time = 0;
+    w->stall_exec_time = 0;
+    w->write_exec_time = 0;
+    w->worker = thread(checkpoint_writer_worker, w);
+}
+
+// Waits for a free buffer, serializes the state after epochs_done epochs into it and queues it for the I/O
+// thread. The arguments are those of serialize_training_checkpoint.
+void queue_training_checkpoint(Checkpoint_writer* w, Mf_info* mf_info, void** user_groups, void** item_groups,
+                               const float* initial_user_group_error, const float* initial_item_group_error, unsigned int workers,
+                               unsigned int shuffle_seed, int epochs_done, const void* rand_state, size_t rand_state_bytes){
+    std::chrono::time_point<std::chrono::system_clock> stall_start_point = std::chrono::system_clock::now();
+    int b = -1;
+    {
+        unique_lock<mutex> lk(w->m);
+        w->cv.wait(lk, [&]{
+            for (int s = 0; s < CHECKPOINT_BUFFER_NUM && b < 0; s++) if (w->state[s] == CHECKPOINT_FREE) b = s;
+            return b >= 0;
+        });
+    }
+    w->stall_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - stall_start_point).count();
+
+    std::chrono::time_point<std::chrono::system_clock> snapshot_start_point = std::chrono::system_clock::now();
+    serialize_training_checkpoint(&w->image[b], mf_info, user_groups, item_groups, initial_user_group_error, initial_item_group_error,
+                                  workers, shuffle_seed, epochs_done, rand_state, rand_state_bytes);
+    w->snapshot_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - snapshot_start_point).count();
+
+    {
+        unique_lock<mutex> lk(w->m);
+        w->epoch[b] = epochs_done;
+        w->state[b] = CHECKPOINT_PENDING;
+        w->cv.notify_all();
+    }
+}
+
+// Waits for the queued checkpoints to reach the disk, stops the I/O thread and reports the time training spent
+// on checkpoints next to the time the writes took.
+void finish_checkpoint_writer(Checkpoint_writer* w){
+    std::chrono::time_point<std::chrono::system_clock> stall_start_point = std::chrono::system_clock::now();
+    {
+        unique_lock<mutex> lk(w->m);
+        w->cv.wait(lk, [&]{
+            for (int s = 0; s < CHECKPOINT_BUFFER_NUM; s++) if (w->state[s] != CHECKPOINT_FREE) return false;
+            return true;
+        });
+        w->stop = true;
+        w->cv.notify_all();
+    }
+    w->worker.join();
+    w->stall_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - stall_start_point).count();
+
+    cout << "\n<Checkpoints>" << endl;
+    cout << "Checkpoints written / failed     : " << w->written << " / " << w->failed << " (last after epoch " << w->last_epoch << ")" << endl;
+    cout << "Bytes written                    : " << w->written_bytes << endl;
+    if (w->delta_threshold >= 0){
+        // One line per checkpoint: with -ci 1 these are the bytes written per epoch.
+        unsigned int full_num = 0;
+        for (size_t r = 0; r < w->records.size(); r++) full_num += w->records[r].full;
+        cout << "Full / delta checkpoints         : " << full_num << " / " << w->records.size() - full_num << endl;
+        cout << "Full / delta bytes               : " << w->full_bytes << " / " << w->written_bytes - w->full_bytes << endl;
+        for (size_t r = 0; r < w->records.size(); r++){
+            string label = "Epoch " + to_string(w->records[r].epoch) + (w->records[r].full ? " full" : " delta");
+            cout << label << string(label.size() < 33 ? 33 - label.size() : 1, ' ') << ": " << w->records[r].bytes << " bytes";
+            if (!w->records[r].full) cout << " (" << w->records[r].dirty_block_num << " / " << w->records[r].block_num << " blocks)";
+            cout << endl;
+        }
+    }
+    cout << "Snapshot time (critical path)    : " << w->snapshot_exec_time << endl;
+    cout << "Stall time (critical path)       : " << w->stall_exec_time << endl;
+    cout << "Background write time            : " << w->write_exec_time << endl;
+    for (int b = 0; b < CHECKPOINT_BUFFER_NUM; b++) vector<char>().swap(w->image[b]);
+    vector<char>().swap(w->chain_image);
+    vector<char>().swap(w->delta_image);
+    vector<char>().swap(w->scratch);
+}
+
+// Full checkpoint at path with its chain of deltas applied.
+bool load_training_checkpoint(const string& path, Training_checkpoint* ckpt){
+    vector<char> image;
+    unsigned int deltas_applied;
+    if (!read_checkpoint_chain(path, &image, &deltas_applied)){
+        cout << "fail to read checkpoint " << path << endl;
+        return false;
+    }
+    if (deltas_applied) cout << "Checkpoint deltas applied   : " << deltas_applied << endl;
+    const char* src = image.data();
+    const char* end = src + image.size();
+    Checkpoint_header& h = ckpt->header;
+    memcpy(&h, src, sizeof(h));
+    src += sizeof(h);
+    bool ok = get_checkpoint_array(&src, end, &ckpt->user2idx, h.max_user) &&
+              get_checkpoint_array(&src, end, &ckpt->item2idx, h.max_item) &&
+              get_checkpoint_array(&src, end, &ckpt->user2cnt, h.max_user) &&
+              get_checkpoint_array(&src, end, &ckpt->item2cnt, h.max_item) &&
+              get_checkpoint_array(&src, end, &ckpt->user_group_end_idx, h.user_group_num) &&
+              get_checkpoint_array(&src, end, &ckpt->item_group_end_idx, h.item_group_num) &&
+              get_checkpoint_array(&src, end, &ckpt->user_group_prec, h.user_group_num) &&
+              get_checkpoint_array(&src, end, &ckpt->item_group_prec, h.item_group_num) &&
+              get_checkpoint_array(&src, end, &ckpt->user_group_error, h.user_group_num) &&
+              get_checkpoint_array(&src, end, &ckpt->item_group_error, h.item_group_num) &&
+              get_checkpoint_array(&src, end, &ckpt->initial_user_group_error, h.user_group_num) &&
+              get_checkpoint_array(&src, end, &ckpt->initial_item_group_error, h.item_group_num);
+    if (ok){
+        ckpt->user_groups.resize(h.user_group_num);
+        ckpt->item_groups.resize(h.item_group_num);
+        unsigned int start_idx = 0;
+        for (unsigned int g = 0; ok && g < h.user_group_num; g++){
+            ok = get_checkpoint_array(&src, end, &ckpt->user_groups[g], checkpoint_group_bytes(ckpt->user_group_end_idx[g] + 1 - start_idx, ckpt->user_group_prec[g], h.k));
+            start_idx = ckpt->user_group_end_idx[g] + 1;
+        }
+        start_idx = 0;
+        for (unsigned int g = 0; ok && g < h.item_group_num; g++){
+            ok = get_checkpoint_array(&src, end, &ckpt->item_groups[g], checkpoint_group_bytes(ckpt->item_group_end_idx[g] + 1 - start_idx, ckpt->item_group_prec[g], h.k));
+            start_idx = ckpt->item_group_end_idx[g] + 1;
+        }
+    }
+    ok = ok && get_checkpoint_array(&src, end, &ckpt->rand_state, h.rand_state_bytes);
+    if (!ok) cout << "fail to read checkpoint " << path << endl;
+    return ok;
+}
+
+// A checkpoint resumes a run of the same version, data and worker count; anything else would train on a
+// different order of updates.
+bool checkpoint_matches(const Training_checkpoint* ckpt, Mf_info* mf_info, unsigned int workers, size_t rand_state_bytes){
+    const Checkpoint_header& h = ckpt->header;
+    bool ok = h.version == mf_info->version && h.k == mf_info->params.k && h.max_user == mf_info->max_user &&
+              h.max_item == mf_info->max_item && h.n == mf_info->n && h.workers == workers &&
+              h.rand_state_bytes == rand_state_bytes && h.epochs_done <= (int)mf_info->params.epoch;
+    if (!ok){
+        cout << "The checkpoint (version " << h.version << ", k " << h.k << ", " << h.max_user << " users, " << h.max_item << " items, "
+             << h.n << " ratings, " << h.workers << " workers, " << h.epochs_done << " epochs) doesn't match this run" << endl;
+    }
+    return ok;
+}
+
+// Replaces user_item_rating_histogram(_cpu) and the grouping with the tables of the checkpoint, allocated the
+// way those functions allocate them; matrix_reconstruction(_cpu) then runs as usual.
+void restore_checkpoint_grouping(Mf_info* mf_info, const Training_checkpoint* ckpt, bool gpu){
+    const Checkpoint_header& h = ckpt->header;
+    if (gpu){
+        cudaMallocHost(&mf_info->user2cnt, sizeof(unsigned int) * h.max_user);
+        cudaMallocHost(&mf_info->item2cnt, sizeof(unsigned int) * h.max_item);
+        cudaMallocHost(&mf_info->user2idx, sizeof(unsigned int) * h.max_user);
+        cudaMallocHost(&mf_info->item2idx, sizeof(unsigned int) * h.max_item);
+        cudaMallocHost(&mf_info->user_group_end_idx, sizeof(unsigned int) * h.user_group_num);
+        cudaMallocHost(&mf_info->item_group_end_idx, sizeof(unsigned int) * h.item_group_num);
+    }else{
+        mf_info->user2cnt = new unsigned int[h.max_user];
+        mf_info->item2cnt = new unsigned int[h.max_item];
+        mf_info->user2idx = new unsigned int[h.max_user];
+        mf_info->item2idx = new unsigned int[h.max_item];
+        mf_info->user_group_end_idx = new unsigned int[h.user_group_num];
+        mf_info->item_group_end_idx = new unsigned int[h.item_group_num];
+    }
+    memcpy(mf_info->user2cnt, ckpt->user2cnt.data(), sizeof(unsigned int) * h.max_user);
+    memcpy(mf_info->item2cnt, ckpt->item2cnt.data(), sizeof(unsigned int) * h.max_item);
+    memcpy(mf_info->user2idx, ckpt->user2idx.data(), sizeof(unsigned int) * h.max_user);
+    memcpy(mf_info->item2idx, ckpt->item2idx.data(), sizeof(unsigned int) * h.max_item);
+    memcpy(mf_info->user_group_end_idx, ckpt->user_group_end_idx.data(), sizeof(unsigned int) * h.user_group_num);
+    memcpy(mf_info->item_group_end_idx, ckpt->item_group_end_idx.data(), sizeof(unsigned int) * h.item_group_num);
+    mf_info->params.user_group_num = h.user_group_num;
+    mf_info->params.item_group_num = h.item_group_num;
+
+    mf_info->user_group_idx = (unsigned int*)malloc(sizeof(unsigned int) * h.max_user);
+    mf_info->item_group_idx = (unsigned int*)malloc(sizeof(unsigned int) * h.max_item);
+    unsigned int start_idx = 0;
+    for (unsigned int g = 0; g < h.user_group_num; g++){
+        for (unsigned int s = start_idx; s <= mf_info->user_group_end_idx[g]; s++) mf_info->user_group_idx[mf_info->user2idx[s]] = g;
+        start_idx = mf_info->user_group_end_idx[g] + 1;
+    }
+    start_idx = 0;
+    for (unsigned int g = 0; g < h.item_group_num; g++){
+        for (unsigned int s = start_idx; s <= mf_info->item_group_end_idx[g]; s++) mf_info->item_group_idx[mf_info->item2idx[s]] = g;
+        start_idx = mf_info->item_group_end_idx[g] + 1;
+    }
+
+    cout << "Resumed from epoch          : " << h.epochs_done << endl;
+    cout << "The number of user groups   : " << h.user_group_num << endl;
+    cout << "The number of item groups   : " << h.item_group_num << endl;
+    if (!gpu) return;
+
+    cudaMalloc(&mf_info->d_user_group_end_idx, sizeof(unsigned int) * h.user_group_num);
+    cudaMalloc(&mf_info->d_item_group_end_idx, sizeof(unsigned int) * h.item_group_num);
+    cudaMemcpy(mf_info->d_user_group_end_idx, mf_info->user_group_end_idx, sizeof(unsigned int) * h.user_group_num, cudaMemcpyHostToDevice);
+    cudaMemcpy(mf_info->d_item_group_end_idx, mf_info->item_group_end_idx, sizeof(unsigned int) * h.item_group_num, cudaMemcpyHostToDevice);
+}
+
+// Grouped parameters of -v 11 from the checkpoint, allocated like cpy2grouped_parameters_cpu and the precision
+// switching do; *_group_prec_info must already hold the checkpoint's precisions.
+void restore_grouped_parameters_cpu(Mf_info* mf_info, SGD* sgd_info, Training_checkpoint* ckpt){
+    for (unsigned int g = 0; g < mf_info->params.user_group_num; g++){
+        sgd_info->user_group_ptr[g] = new_grouped_params(mf_info->user_group_prec_info[g], mf_info->user_group_size[g], mf_info->params.k);
+        memcpy(sgd_info->user_group_ptr[g], ckpt->user_groups[g].data(), ckpt->user_groups[g].size());
+        vector<char>().swap(ckpt->user_groups[g]);
+    }
+    for (unsigned int g = 0; g < mf_info->params.item_group_num; g++){
+        sgd_info->item_group_ptr[g] = new_grouped_params(mf_info->item_group_prec_info[g], mf_info->item_group_size[g], mf_info->params.k);
+        memcpy(sgd_info->item_group_ptr[g], ckpt->item_groups[g].data(), ckpt->item_groups[g].size());
+        vector<char>().swap(ckpt->item_groups[g]);
+    }
+}
+
+// Counterpart of cpy2grouped_parameters_gpu_for_comparison_indexing for -v 1: device groups and their pinned
+// host copies in the checkpoint's precisions, and the device pointer tables.
+void restore_grouped_parameters_gpu(Mf_info* mf_info, SGD* sgd_info, Training_checkpoint* ckpt){
+    for (unsigned int g = 0; g < mf_info->params.user_group_num; g++){
+        size_t bytes = ckpt->user_groups[g].size();
+        cudaMalloc(&sgd_info->user_group_d_ptr[g], bytes);
+        cudaMallocHost(&sgd_info->user_group_ptr[g], bytes);
+        memcpy(sgd_info->user_group_ptr[g], ckpt->user_groups[g].data(), bytes);
+        cudaMemcpy(sgd_info->user_group_d_ptr[g], sgd_info->user_group_ptr[g], bytes, cudaMemcpyHostToDevice);
+        vector<char>().swap(ckpt->user_groups[g]);
+    }
+    for (unsigned int g = 0; g < mf_info->params.item_group_num; g++){
+        size_t bytes = ckpt->item_groups[g].size();
+        cudaMalloc(&sgd_info->item_group_d_ptr[g], bytes);
+        cudaMallocHost(&sgd_info->item_group_ptr[g], bytes);
+        memcpy(sgd_info->item_group_ptr[g], ckpt->item_groups[g].data(), bytes);
+        cudaMemcpy(sgd_info->item_group_d_ptr[g], sgd_info->item_group_ptr[g], bytes, cudaMemcpyHostToDevice);
+        vector<char>().swap(ckpt->item_groups[g]);
+    }
+    cudaMemcpy(sgd_info->d_user_group_ptr, sgd_info->user_group_d_ptr, sizeof(void*) * mf_info->params.user_group_num, cudaMemcpyHostToDevice);
+    cudaMemcpy(sgd_info->d_item_group_ptr, sgd_info->item_group_d_ptr, sizeof(void*) * mf_info->params.item_group_num, cudaMemcpyHostToDevice);
+    cudaMemcpy(mf_info->d_user_group_prec_info, mf_info->user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num, cudaMemcpyHostToDevice);
+    cudaMemcpy(mf_info->d_item_group_prec_info, mf_info->item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num, cudaMemcpyHostToDevice);
+    cudaFree(mf_info->d_user2sorted_idx);
+    cudaFree(mf_info->d_item2sorted_idx);
+}
+
+// Copies the device groups of -v 1 into their pinned host copies for a checkpoint.
+void cpy_grouped_parameters_d2h(Mf_info* mf_info, SGD* sgd_info){
+    unsigned int k = mf_info->params.k;
+    for (unsigned int g = 0; g < mf_info->params.user_group_num; g++)
+        cudaMemcpy(sgd_info->user_group_ptr[g], sgd_info->user_group_d_ptr[g], checkpoint_group_bytes(mf_info->user_group_size[g], mf_info->user_group_prec_info[g], k), cudaMemcpyDeviceToHost);
+    for (unsigned int g = 0; g < mf_info->params.item_group_num; g++)
+        cudaMemcpy(sgd_info->item_group_ptr[g], sgd_info->item_group_d_ptr[g], checkpoint_group_bytes(mf_info->item_group_size[g], mf_info->item_group_prec_info[g], k), cudaMemcpyDeviceToHost);
+}
+
+// Checkpoints are written after every -ci epochs.
+inline bool checkpoint_due(Mf_info* mf_info, int e){
+    return mf_info->checkpoint_path != "" && mf_info->params.checkpoint_interval && (e + 1) % mf_info->params.checkpoint_interval == 0;
+}
+
+#endif
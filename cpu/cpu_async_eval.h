@@ -0,0 +1,269 @@
+#ifndef CPU_ASYNC_EVAL_H
+#define CPU_ASYNC_EVAL_H
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cmath>
+#include "common_struct.h"
+#include "cpu_rmse.h"
+#include "cpu_thread_pool.h"
+using namespace std;
+
+#define EVAL_STRATUM_NUM 32
+#define EVAL_SNAPSHOT_NUM 2
+
+// Stratified subsample of the test set. Pairs are stratified by the log2 of the user's training degree,
+// since the error of light users is both larger and more variable; every stratum is sampled in proportion.
+struct Eval_sample{
+    vector<unsigned int> idx;               // sampled test pairs, stratum by stratum
+    vector<unsigned int> stratum_begin;     // samples of stratum h are [stratum_begin[h], stratum_begin[h+1])
+    vector<double> stratum_weight;          // N_h / N
+    vector<double> stratum_fpc;             // finite population correction 1 - n_h / N_h
+};
+
+struct Eval_result{
+    int epoch;
+    float lrate;
+    double train_rmse;
+    double valid_rmse;
+    double sampled_rmse;
+    double ci;                              // half-width of the 95% confidence interval of sampled_rmse
+    bool full;
+    double full_rmse;
+};
+
+enum Snapshot_state { SNAPSHOT_FREE, SNAPSHOT_PENDING, SNAPSHOT_BUSY };
+
+// Background evaluator over double-buffered snapshots of P/Q. The training thread copies the model into a
+// free buffer after each epoch and goes on; the evaluator thread scores the pending buffers in epoch order.
+struct Async_evaluator{
+    Mf_info* mf_info;
+    Eval_sample sample;
+    float* snapshot_p[EVAL_SNAPSHOT_NUM];
+    float* snapshot_q[EVAL_SNAPSHOT_NUM];
+    Snapshot_state state[EVAL_SNAPSHOT_NUM];
+    Eval_result job[EVAL_SNAPSHOT_NUM];
+    vector<Eval_result> done;
+    double last_full_rmse;
+
+    mutex m;
+    condition_variable cv;
+    bool stop;
+    thread worker;
+
+    double snapshot_exec_time;              // training thread: copying the model into a snapshot
+    double stall_exec_time;                 // training thread: waiting for a free snapshot
+    double evaluation_exec_time;            // evaluator thread
+};
+
+// user_map maps test user ids to the id space of R (NULL when they are the same, user2sorted_idx for -v 11).
+void build_stratified_sample(Mf_info* mf_info, float ratio, const unsigned int* user_map, Eval_sample* sample){
+    vector<unsigned int> degree(mf_info->max_user, 0);
+    for (unsigned int j = 0; j < mf_info->n; j++) degree[mf_info->R[j].u]++;
+
+    vector<vector<unsigned int>> strata(EVAL_STRATUM_NUM);
+    for (unsigned int j = 0; j < mf_info->test_n; j++){
+        unsigned int u = user_map ? user_map[mf_info->test_COO[j].u] : mf_info->test_COO[j].u;
+        unsigned int h = 0;
+        for (unsigned int d = degree[u]; d > 1 && h + 1 < EVAL_STRATUM_NUM; d >>= 1) h++;
+        strata[h].push_back(j);
+    }
+
+    mt19937 gen(1234);
+    sample->idx.clear();
+    sample->stratum_begin.assign(1, 0);
+    sample->stratum_weight.clear();
+    sample->stratum_fpc.clear();
+    for (unsigned int h = 0; h < EVAL_STRATUM_NUM; h++){
+        size_t population = strata[h].size();
+        if (population == 0) continue;
+        size_t n_h = min(population, max((size_t)2, (size_t)llround(ratio * population)));
+        // Partial Fisher-Yates; the sample is fixed for the whole run so that epochs are comparable.
+        for (size_t s = 0; s < n_h; s++){
+            uniform_int_distribution<size_t> pick(s, population - 1);
+            swap(strata[h][s], strata[h][pick(gen)]);
+            sample->idx.push_back(strata[h][s]);
+        }
+        sort(sample->idx.end() - n_h, sample->idx.end());
+        sample->stratum_begin.push_back(sample->idx.size());
+        sample->stratum_weight.push_back(population / (double)mf_info->test_n);
+        sample->stratum_fpc.push_back(1.0 - n_h / (double)population);
+    }
+}
+
+// Stratified estimate of the MSE; the RMSE interval follows from the delta method (se_rmse = se_mse / 2 rmse).
+void sampled_rmse(const Mf_info* mf_info, const Eval_sample* sample, const float* p, const float* q, double* rmse, double* ci){
+    unsigned int k = mf_info->params.k;
+    double mse = 0;
+    double var_mse = 0;
+    for (size_t h = 0; h + 1 < sample->stratum_begin.size(); h++){
+        double sum = 0;
+        double sq_sum = 0;
+        size_t n_h = sample->stratum_begin[h + 1] - sample->stratum_begin[h];
+        for (size_t s = sample->stratum_begin[h]; s < sample->stratum_begin[h + 1]; s++){
+            const Node& node = mf_info->test_COO[sample->idx[s]];
+            double e = node.r - (double)cpu_dot(p + (size_t)node.u * k, q + (size_t)node.i * k, k);
+            sum += e * e;
+            sq_sum += e * e * e * e;
+        }
+        double mean = sum / n_h;
+        double var = n_h > 1 ? max(0.0, (sq_sum - n_h * mean * mean) / (n_h - 1)) : 0;
+        mse += sample->stratum_weight[h] * mean;
+        var_mse += sample->stratum_weight[h] * sample->stratum_weight[h] * sample->stratum_fpc[h] * var / n_h;
+    }
+    *rmse = sqrt(mse);
+    *ci = mse > 0 ? 1.96 * sqrt(var_mse) / (2 * *rmse) : 0;
+}
+
+// Full test RMSE on one thread, with the same blocks and summation order as cpu_test_rmse.
+double serial_test_rmse(const Mf_info* mf_info, const float* p, const float* q){
+    vector<double> block_sums;
+    for (size_t begin = 0; begin < mf_info->test_n; begin += EVAL_BLOCK_SIZE)
+        block_sums.push_back(cpu_squared_error_block(mf_info->test_COO, begin, min(begin + EVAL_BLOCK_SIZE, (size_t)mf_info->test_n), p, q, mf_info->params.k));
+    return sqrt(pairwise_sum(block_sums.data(), block_sums.size())/(double)mf_info->test_n);
+}
+
+void async_evaluator_worker(Async_evaluator* ev){
+    while (true){
+        unique_lock<mutex> lk(ev->m);
+        int b = -1;
+        ev->cv.wait(lk, [&]{
+            for (int s = 0; s < EVAL_SNAPSHOT_NUM; s++)
+                if (ev->state[s] == SNAPSHOT_PENDING && (b < 0 || ev->job[s].epoch < ev->job[b].epoch)) b = s;
+            return ev->stop || b >= 0;
+        });
+        if (b < 0) break;
+        ev->state[b] = SNAPSHOT_BUSY;
+        Eval_result result = ev->job[b];
+        lk.unlock();
+
+        std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+        sampled_rmse(ev->mf_info, &ev->sample, ev->snapshot_p[b], ev->snapshot_q[b], &result.sampled_rmse, &result.ci);
+        if (result.full) result.full_rmse = serial_test_rmse(ev->mf_info, ev->snapshot_p[b], ev->snapshot_q[b]);
+        double exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+
+        lk.lock();
+        ev->evaluation_exec_time += exec_time;
+        ev->done.push_back(result);
+        if (result.full) ev->last_full_rmse = result.full_rmse;
+        ev->state[b] = SNAPSHOT_FREE;
+        ev->cv.notify_all();
+    }
+}
+
+void init_async_evaluator(Async_evaluator* ev, Mf_info* mf_info, const unsigned int* user_map){
+    ev->mf_info = mf_info;
+    build_stratified_sample(mf_info, mf_info->params.eval_sample_ratio, user_map, &ev->sample);
+    for (int b = 0; b < EVAL_SNAPSHOT_NUM; b++){
+        ev->snapshot_p[b] = new float[(size_t)mf_info->max_user * mf_info->params.k];
+        ev->snapshot_q[b] = new float[(size_t)mf_info->max_item * mf_info->params.k];
+        ev->state[b] = SNAPSHOT_FREE;
+    }
+    ev->last_full_rmse = 0;
+    ev->stop = false;
+    ev->snapshot_exec_time = 0;
+    ev->stall_exec_time = 0;
+    ev->evaluation_exec_time = 0;
+    ev->worker = thread(async_evaluator_worker, ev);
+}
+
+// Per-epoch line "epoch lr sampled_rmse +-ci full_rmse [train_rmse] [valid_rmse]"; full_rmse is "-" on
+// sampled-only epochs.
+void print_eval_results(Async_evaluator* ev){
+    vector<Eval_result> results;
+    {
+        unique_lock<mutex> lk(ev->m);
+        results.swap(ev->done);
+    }
+    for (size_t r = 0; r < results.size(); r++){
+        cout << results[r].epoch + 1 << " " << results[r].lrate << " " << results[r].sampled_rmse << " +-" << results[r].ci << " ";
+        if (results[r].full) cout << results[r].full_rmse;
+        else cout << "-";
+        if (ev->mf_info->params.train_loss) cout << " " << results[r].train_rmse;
+        if (ev->mf_info->params.patience) cout << " " << results[r].valid_rmse;
+        cout << endl;
+    }
+}
+
+// Waits for a free snapshot, fills it with copy(p, q) and queues it. Results that are ready are printed.
+void publish_eval_snapshot(Async_evaluator* ev, int e, float lrate, double train_rmse, double valid_rmse, bool full, function<void(float*, float*)> copy){
+    std::chrono::time_point<std::chrono::system_clock> stall_start_point = std::chrono::system_clock::now();
+    int b = -1;
+    {
+        unique_lock<mutex> lk(ev->m);
+        ev->cv.wait(lk, [&]{
+            for (int s = 0; s < EVAL_SNAPSHOT_NUM && b < 0; s++) if (ev->state[s] == SNAPSHOT_FREE) b = s;
+            return b >= 0;
+        });
+    }
+    ev->stall_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - stall_start_point).count();
+
+    std::chrono::time_point<std::chrono::system_clock> snapshot_start_point = std::chrono::system_clock::now();
+    copy(ev->snapshot_p[b], ev->snapshot_q[b]);
+    ev->snapshot_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - snapshot_start_point).count();
+
+    {
+        unique_lock<mutex> lk(ev->m);
+        ev->job[b].epoch = e;
+        ev->job[b].lrate = lrate;
+        ev->job[b].train_rmse = train_rmse;
+        ev->job[b].valid_rmse = valid_rmse;
+        ev->job[b].full = full;
+        ev->job[b].full_rmse = 0;
+        ev->state[b] = SNAPSHOT_PENDING;
+        ev->cv.notify_all();
+    }
+    print_eval_results(ev);
+}
+
+// Drains the queued snapshots, prints their results and stops the evaluator. Returns the last full RMSE.
+double finish_async_evaluator(Async_evaluator* ev){
+    std::chrono::time_point<std::chrono::system_clock> stall_start_point = std::chrono::system_clock::now();
+    {
+        unique_lock<mutex> lk(ev->m);
+        ev->cv.wait(lk, [&]{
+            for (int s = 0; s < EVAL_SNAPSHOT_NUM; s++) if (ev->state[s] != SNAPSHOT_FREE) return false;
+            return true;
+        });
+        ev->stop = true;
+        ev->cv.notify_all();
+    }
+    ev->worker.join();
+    ev->stall_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - stall_start_point).count();
+    print_eval_results(ev);
+
+    cout << "\n<Asynchronous evaluation>" << endl;
+    cout << "Sampled test pairs               : " << ev->sample.idx.size() << " / " << ev->mf_info->test_n << " (" << ev->sample.stratum_weight.size() << " strata)" << endl;
+    cout << "Snapshot copy time               : " << ev->snapshot_exec_time << endl;
+    cout << "Evaluation stall time            : " << ev->stall_exec_time << endl;
+    cout << "Background evaluation time       : " << ev->evaluation_exec_time << endl;
+
+    for (int b = 0; b < EVAL_SNAPSHOT_NUM; b++){
+        delete [] ev->snapshot_p[b];
+        delete [] ev->snapshot_q[b];
+    }
+    return ev->last_full_rmse;
+}
+
+// Snapshot of flat P/Q, copied by all pool threads.
+void copy_flat_parameters(Cpu_thread_pool* pool, Mf_info* mf_info, SGD* sgd_info, float* p, float* q){
+    size_t p_size = (size_t)mf_info->max_user * mf_info->params.k;
+    size_t q_size = (size_t)mf_info->max_item * mf_info->params.k;
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        size_t begin = p_size * t / pool->num_threads;
+        size_t end = p_size * (t + 1) / pool->num_threads;
+        if (end > begin) memcpy(p + begin, sgd_info->p + begin, sizeof(float) * (end - begin));
+        begin = q_size * t / pool->num_threads;
+        end = q_size * (t + 1) / pool->num_threads;
+        if (end > begin) memcpy(q + begin, sgd_info->q + begin, sizeof(float) * (end - begin));
+    });
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef CPU_CONTENTION_SGD_KERNEL_H
+#define CPU_CONTENTION_SGD_KERNEL_H
+#include <cstring>
+#include "common_struct.h"
+#include "cpu_sgd_kernel.h"
+using namespace std;
+
+#define NOT_HOT 0xffffffffu
+
+// Per-thread buffer of the updates made to hot item rows since the last merge.
+struct Hot_item_buffer{
+    float* delta;               // hot_num x k
+    unsigned char* touched;     // hot_num
+};
+
+// Chooses the hot items from the ascending item2cnt/item2idx of user_item_rating_histogram_cpu.
+// With num_threads workers an update of item i collides with another worker with probability of about
+// (num_threads - 1) * cnt_i / n, so every item above the target contention rate is hot.
+unsigned int select_hot_items(Mf_info* mf_info, unsigned int num_threads, float target_contention, unsigned int* item2hot, unsigned int* hot_items){
+    double cnt_threshold = target_contention * (double)mf_info->n / max(1u, num_threads - 1);
+    unsigned int hot_num = 0;
+
+    for (unsigned int i = 0; i < mf_info->max_item; i++) item2hot[i] = NOT_HOT;
+    if (num_threads < 2) return 0;
+    for (int s = mf_info->max_item - 1; s >= 0 && mf_info->item2cnt[s] > cnt_threshold; s--){
+        hot_items[hot_num] = mf_info->item2idx[s];
+        item2hot[mf_info->item2idx[s]] = hot_num++;
+    }
+    return hot_num;
+}
+
+// Hogwild worker where cold item rows are updated in place and hot item rows are read from the shared Q
+// plus the worker's own pending delta. Q is not written for hot items until merge_hot_item_buffers.
+// The squared residuals of all updates are added to *loss unless it is NULL.
+void cpu_contention_aware_sgd_worker(
+                            const Node* R,
+                            unsigned int begin,
+                            unsigned int end,
+                            float* p,
+                            float* q,
+                            float lrate,
+                            unsigned int k,
+                            float lambda,
+                            unsigned int prefetch_distance,
+                            const unsigned int* item2hot,
+                            Hot_item_buffer* buf,
+                            double* loss
+                            )
+{
+    size_t row_bytes = sizeof(float) * k;
+    double loss_sum = 0;
+
+    for (unsigned int j = begin; j < end; j++){
+        if (prefetch_distance && j + prefetch_distance < end){
+            const Node& ahead = R[j + prefetch_distance];
+            prefetch_row(p + (size_t)ahead.u * k, row_bytes);
+            prefetch_row(q + (size_t)ahead.i * k, row_bytes);
+        }
+
+        float* p_row = p + (size_t)R[j].u * k;
+        float* q_row = q + (size_t)R[j].i * k;
+        const float r = R[j].r;
+        unsigned int h = item2hot[R[j].i];
+
+        if (h == NOT_HOT){
+            float tmp_product = 0;
+            for (unsigned int d = 0; d < k; d++) tmp_product += p_row[d] * q_row[d];
+            const float ruv = r - tmp_product;
+            loss_sum += ruv * ruv;
+
+            for (unsigned int d = 0; d < k; d++){
+                const float tmp_p = p_row[d];
+                const float tmp_q = q_row[d];
+                p_row[d] = tmp_p + lrate*(ruv*tmp_q - lambda*tmp_p);
+                q_row[d] = tmp_q + lrate*(ruv*tmp_p - lambda*tmp_q);
+            }
+        }
+        else{
+            float* delta = buf->delta + (size_t)h * k;
+            if (!buf->touched[h]){
+                memset(delta, 0, row_bytes);
+                buf->touched[h] = 1;
+            }
+
+            float tmp_product = 0;
+            for (unsigned int d = 0; d < k; d++) tmp_product += p_row[d] * (q_row[d] + delta[d]);
+            const float ruv = r - tmp_product;
+            loss_sum += ruv * ruv;
+
+            for (unsigned int d = 0; d < k; d++){
+                const float tmp_p = p_row[d];
+                const float tmp_q = q_row[d] + delta[d];
+                p_row[d] = tmp_p + lrate*(ruv*tmp_q - lambda*tmp_p);
+                delta[d] += lrate*(ruv*tmp_p - lambda*tmp_q);
+            }
+        }
+    }
+    if (loss) *loss += loss_sum;
+}
+
+// Applies the mean of the pending deltas of hot rows [hot_begin, hot_end) over the workers that touched them
+// and clears them. Each worker may have taken many steps on a hot row since the last merge, so summing the
+// deltas would overshoot; averaging treats the workers' views as local models.
+void merge_hot_item_buffers(float* q, const unsigned int* hot_items, Hot_item_buffer* bufs, unsigned int num_threads,
+                            unsigned int hot_begin, unsigned int hot_end, unsigned int k, float* sum)
+{
+    for (unsigned int h = hot_begin; h < hot_end; h++){
+        unsigned int touched_cnt = 0;
+        for (unsigned int t = 0; t < num_threads; t++){
+            if (!bufs[t].touched[h]) continue;
+            const float* delta = bufs[t].delta + (size_t)h * k;
+            if (touched_cnt++ == 0) memcpy(sum, delta, sizeof(float) * k);
+            else for (unsigned int d = 0; d < k; d++) sum[d] += delta[d];
+            bufs[t].touched[h] = 0;
+        }
+        if (touched_cnt == 0) continue;
+
+        float* q_row = q + (size_t)hot_items[h] * k;
+        for (unsigned int d = 0; d < k; d++) q_row[d] += sum[d] / touched_cnt;
+    }
+}
+
+#endif
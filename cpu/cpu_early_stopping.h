@@ -0,0 +1,198 @@
+#ifndef CPU_EARLY_STOPPING_H
+#define CPU_EARLY_STOPPING_H
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include "common_struct.h"
+#include "cpu_thread_pool.h"
+#include "cpu_int8.h"
+using namespace std;
+
+// Early stopping on the validation RMSE. An epoch improves when it beats the best RMSE so far by more than
+// min_delta; training stops after patience epochs without improvement. The parameters of the best epoch are
+// kept in a shadow buffer: flat P/Q, or for -v 11 every group in the precision it had at that epoch.
+struct Early_stopping{
+    unsigned int patience;
+    float min_delta;
+    double best_rmse;
+    int best_epoch;
+    unsigned int bad_epochs;
+    bool stop;
+
+    float* best_p;
+    float* best_q;
+    vector<vector<char>> best_user_groups;
+    vector<vector<char>> best_item_groups;
+    vector<unsigned char> best_user_prec;
+    vector<unsigned char> best_item_prec;
+
+    double validation_exec_time;
+    double shadow_exec_time;
+};
+
+// Deterministic hash of a (user, item) pair (splitmix64 finalizer).
+inline unsigned long long pair_hash(unsigned int u, unsigned int i){
+    unsigned long long x = ((unsigned long long)u << 32 | i) + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Carves valid_ratio of R into valid_COO unless a validation file was given. Ratings are chosen by a hash of
+// the (user, item) pair, so the split does not depend on the order of the file or on the shuffle of R.
+void prepare_validation_set(Mf_info* mf_info){
+    if (mf_info->params.patience == 0 || mf_info->valid_n > 0) return;
+    if (mf_info->params.valid_ratio <= 0){
+        cout << "Early stopping (-pa) needs validation ratings: a positive -vs or a -vf file" << endl;
+        exit(1);
+    }
+    unsigned long long threshold = (unsigned long long)(mf_info->params.valid_ratio * 1000000.0);
+
+    unsigned int valid_n = 0;
+    for (unsigned int j = 0; j < mf_info->n; j++)
+        if (pair_hash(mf_info->R[j].u, mf_info->R[j].i) % 1000000 < threshold) valid_n++;
+
+    mf_info->valid_COO = new Node[valid_n];
+    unsigned int train_n = 0;
+    mf_info->valid_n = 0;
+    for (unsigned int j = 0; j < mf_info->n; j++){
+        if (pair_hash(mf_info->R[j].u, mf_info->R[j].i) % 1000000 < threshold) mf_info->valid_COO[mf_info->valid_n++] = mf_info->R[j];
+        else mf_info->R[train_n++] = mf_info->R[j];
+    }
+    mf_info->n = train_n;
+    if (mf_info->valid_n == 0){
+        cout << "-vs " << mf_info->params.valid_ratio << " leaves no validation ratings for early stopping (-pa)" << endl;
+        exit(1);
+    }
+}
+
+void init_early_stopping(Early_stopping* es, Mf_info* mf_info){
+    es->patience = mf_info->params.patience;
+    es->min_delta = mf_info->params.min_delta;
+    es->best_rmse = 1e30;
+    es->best_epoch = -1;
+    es->bad_epochs = 0;
+    es->stop = false;
+    es->best_p = NULL;
+    es->best_q = NULL;
+    es->validation_exec_time = 0;
+    es->shadow_exec_time = 0;
+}
+
+// Returns true when epoch e is the new best epoch and its parameters should be saved. A NaN RMSE (a diverging
+// run) never improves.
+bool update_early_stopping(Early_stopping* es, int e, double valid_rmse){
+    if (!std::isnan(valid_rmse) && valid_rmse < es->best_rmse - es->min_delta){
+        es->best_rmse = valid_rmse;
+        es->best_epoch = e;
+        es->bad_epochs = 0;
+        return true;
+    }
+    if (++es->bad_epochs >= es->patience) es->stop = true;
+    return false;
+}
+
+// Scores epoch e with validate() and, when it is the new best epoch, saves its parameters with save().
+double early_stopping_epoch(Early_stopping* es, int e, function<double()> validate, function<void()> save){
+    std::chrono::time_point<std::chrono::system_clock> validation_start_point = std::chrono::system_clock::now();
+    double valid_rmse = validate();
+    es->validation_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - validation_start_point).count();
+
+    std::chrono::time_point<std::chrono::system_clock> shadow_start_point = std::chrono::system_clock::now();
+    if (update_early_stopping(es, e, valid_rmse)) save();
+    es->shadow_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - shadow_start_point).count();
+    return valid_rmse;
+}
+
+// The parameters of the best epoch replace the last ones only when some epoch improved (none does when every
+// RMSE was NaN or a resumed run had no epochs left) and it was not the last epoch run.
+bool restore_best_epoch(const Early_stopping* es, int epochs_run){
+    return es->best_epoch >= 0 && es->best_epoch + 1 != epochs_run;
+}
+
+void parallel_copy(Cpu_thread_pool* pool, float* dst, const float* src, size_t count){
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        size_t begin = count * t / pool->num_threads;
+        size_t end = count * (t + 1) / pool->num_threads;
+        if (end > begin) memcpy(dst + begin, src + begin, sizeof(float) * (end - begin));
+    });
+}
+
+void save_flat_shadow(Early_stopping* es, Cpu_thread_pool* pool, Mf_info* mf_info, SGD* sgd_info){
+    size_t p_size = (size_t)mf_info->max_user * mf_info->params.k;
+    size_t q_size = (size_t)mf_info->max_item * mf_info->params.k;
+    if (es->best_p == NULL){
+        es->best_p = new float[p_size];
+        es->best_q = new float[q_size];
+    }
+    parallel_copy(pool, es->best_p, sgd_info->p, p_size);
+    parallel_copy(pool, es->best_q, sgd_info->q, q_size);
+}
+
+void restore_flat_shadow(Early_stopping* es, Cpu_thread_pool* pool, Mf_info* mf_info, SGD* sgd_info){
+    parallel_copy(pool, sgd_info->p, es->best_p, (size_t)mf_info->max_user * mf_info->params.k);
+    parallel_copy(pool, sgd_info->q, es->best_q, (size_t)mf_info->max_item * mf_info->params.k);
+}
+
+void save_groups(vector<vector<char>>* best_groups, vector<unsigned char>* best_prec, void** group_ptr,
+                 const unsigned char* group_prec, const unsigned int* group_size, unsigned int group_num, unsigned int k){
+    best_groups->resize(group_num);
+    best_prec->assign(group_prec, group_prec + group_num);
+    for (unsigned int g = 0; g < group_num; g++){
+        size_t bytes = (size_t)group_size[g] * grouped_row_bytes(group_prec[g], k);
+        (*best_groups)[g].resize(bytes);
+        memcpy((*best_groups)[g].data(), group_ptr[g], bytes);
+    }
+}
+
+// Groups that were switched to another precision after the best epoch are given back their storage.
+void restore_groups(const vector<vector<char>>& best_groups, const vector<unsigned char>& best_prec, void** group_ptr,
+                    unsigned char* group_prec, const unsigned int* group_size, unsigned int group_num, unsigned int k){
+    for (unsigned int g = 0; g < group_num; g++){
+        if (group_prec[g] != best_prec[g]){
+            delete_grouped_params(group_ptr[g], group_prec[g]);
+            group_ptr[g] = new_grouped_params(best_prec[g], group_size[g], k);
+            group_prec[g] = best_prec[g];
+        }
+        memcpy(group_ptr[g], best_groups[g].data(), best_groups[g].size());
+    }
+}
+
+void save_grouped_shadow(Early_stopping* es, Mf_info* mf_info, SGD* sgd_info){
+    save_groups(&es->best_user_groups, &es->best_user_prec, sgd_info->user_group_ptr, mf_info->user_group_prec_info,
+                mf_info->user_group_size, mf_info->params.user_group_num, mf_info->params.k);
+    save_groups(&es->best_item_groups, &es->best_item_prec, sgd_info->item_group_ptr, mf_info->item_group_prec_info,
+                mf_info->item_group_size, mf_info->params.item_group_num, mf_info->params.k);
+}
+
+void restore_grouped_shadow(Early_stopping* es, Mf_info* mf_info, SGD* sgd_info){
+    restore_groups(es->best_user_groups, es->best_user_prec, sgd_info->user_group_ptr, mf_info->user_group_prec_info,
+                   mf_info->user_group_size, mf_info->params.user_group_num, mf_info->params.k);
+    restore_groups(es->best_item_groups, es->best_item_prec, sgd_info->item_group_ptr, mf_info->item_group_prec_info,
+                   mf_info->item_group_size, mf_info->params.item_group_num, mf_info->params.k);
+}
+
+void print_early_stopping(Early_stopping* es, Mf_info* mf_info, int epochs_run){
+    cout << "\n<Early stopping>" << endl;
+    cout << "Validation ratings               : " << mf_info->valid_n << endl;
+    cout << "Patience / min delta             : " << es->patience << " / " << es->min_delta << endl;
+    if (es->best_epoch >= 0){
+        cout << "Best epoch                       : " << es->best_epoch + 1 << endl;
+        cout << "Best validation RMSE             : " << es->best_rmse << endl;
+    }
+    else cout << "Best epoch                       : none, the last epoch is kept" << endl;
+    cout << "Epochs run                       : " << epochs_run << " / " << mf_info->params.epoch << endl;
+    cout << "Epochs saved                     : " << mf_info->params.epoch - epochs_run << endl;
+    cout << "Validation time                  : " << es->validation_exec_time << endl;
+    cout << "Shadow copy time                 : " << es->shadow_exec_time << endl;
+}
+
+void free_early_stopping(Early_stopping* es){
+    delete [] es->best_p;
+    delete [] es->best_q;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef CPU_HALF_H
+#define CPU_HALF_H
+#include <cstring>
+#if defined(__F16C__) || defined(__AVX512BF16__)
+#include <immintrin.h>
+#endif
+
+// IEEE fp16 <-> fp32 conversion for grouped parameters stored on the host as raw 16-bit words.
+inline float cpu_half2float(unsigned short h){
+#ifdef __F16C__
+    return _cvtsh_ss(h);
+#else
+    unsigned int sign = (h & 0x8000u) << 16;
+    unsigned int exp = (h >> 10) & 0x1f;
+    unsigned int mant = h & 0x3ffu;
+    unsigned int bits;
+
+    if (exp == 0x1f) bits = sign | 0x7f800000u | (mant << 13);
+    else if (exp != 0) bits = sign | ((exp + 112) << 23) | (mant << 13);
+    else if (mant == 0) bits = sign;
+    else {
+        exp = 113;
+        while (!(mant & 0x400u)) { mant <<= 1; exp--; }
+        bits = sign | (exp << 23) | ((mant & 0x3ffu) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(float));
+    return f;
+#endif
+}
+
+inline unsigned short cpu_float2half(float f){
+#ifdef __F16C__
+    return _cvtss_sh(f, 0);
+#else
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(float));
+    unsigned int sign = (bits >> 16) & 0x8000u;
+    int exp = (int)((bits >> 23) & 0xff) - 112;
+    unsigned int mant = bits & 0x7fffffu;
+
+    if (((bits >> 23) & 0xff) == 0xff) return sign | 0x7c00u | (mant ? 0x200u : 0);
+    if (exp >= 0x1f) return sign | 0x7c00u;
+    if (exp <= 0){
+        if (exp < -10) return sign;
+        mant |= 0x800000u;
+        unsigned int shift = 14 - exp;
+        unsigned int half_mant = mant >> shift;
+        unsigned int rem = mant & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half_mant & 1))) half_mant++;
+        return sign | half_mant;
+    }
+    unsigned int h = sign | (exp << 10) | (mant >> 13);
+    unsigned int rem = mant & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1))) h++;
+    return h;
+#endif
+}
+
+inline void cpu_half2float_row(float* out, const unsigned short* in, unsigned int k){
+    unsigned int d = 0;
+#ifdef __F16C__
+    for (; d + 8 <= k; d += 8) _mm256_storeu_ps(out + d, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(in + d))));
+#endif
+    for (; d < k; d++) out[d] = cpu_half2float(in[d]);
+}
+
+inline void cpu_float2half_row(unsigned short* out, const float* in, unsigned int k){
+    unsigned int d = 0;
+#ifdef __F16C__
+    for (; d + 8 <= k; d += 8) _mm_storeu_si128((__m128i*)(out + d), _mm256_cvtps_ph(_mm256_loadu_ps(in + d), 0));
+#endif
+    for (; d < k; d++) out[d] = cpu_float2half(in[d]);
+}
+
+// bfloat16 <-> fp32 for grouped parameters stored as bf16 (the upper half of an fp32). Widening is a shift;
+// narrowing rounds to nearest even, with cvtneps_pbh under AVX-512 BF16 and on the bits elsewhere.
+inline float cpu_bfloat162float(unsigned short h){
+    unsigned int bits = (unsigned int)h << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(float));
+    return f;
+}
+
+inline unsigned short cpu_float2bfloat16(float f){
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(float));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) return (bits >> 16) | 0x40u;
+    return (bits + 0x7fffu + ((bits >> 16) & 1)) >> 16;
+}
+
+inline void cpu_bfloat162float_row(float* out, const unsigned short* in, unsigned int k){
+    unsigned int d = 0;
+#if defined(__AVX512F__)
+    for (; d + 16 <= k; d += 16)
+        _mm512_storeu_ps(out + d, _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(in + d))), 16)));
+#endif
+    for (; d < k; d++) out[d] = cpu_bfloat162float(in[d]);
+}
+
+inline void cpu_float2bfloat16_row(unsigned short* out, const float* in, unsigned int k){
+    unsigned int d = 0;
+#if defined(__AVX512BF16__)
+    for (; d + 16 <= k; d += 16){
+        __m256bh v = _mm512_cvtneps_pbh(_mm512_loadu_ps(in + d));
+        memcpy(out + d, &v, sizeof(v));
+    }
+#endif
+    for (; d < k; d++) out[d] = cpu_float2bfloat16(in[d]);
+}
+
+// Dot product of two bf16 rows; vdpbf16ps multiplies pairs of bf16 lanes into fp32 accumulators.
+inline float cpu_dot_bfloat16(const unsigned short* a, const unsigned short* b, unsigned int k){
+    unsigned int d = 0;
+    float sum = 0;
+#if defined(__AVX512BF16__)
+    __m512 acc = _mm512_setzero_ps();
+    for (; d + 32 <= k; d += 32){
+        __m512bh va, vb;
+        memcpy(&va, a + d, sizeof(va));
+        memcpy(&vb, b + d, sizeof(vb));
+        acc = _mm512_dpbf16_ps(acc, va, vb);
+    }
+    sum = _mm512_reduce_add_ps(acc);
+#endif
+    for (; d < k; d++) sum += cpu_bfloat162float(a[d]) * cpu_bfloat162float(b[d]);
+    return sum;
+}
+
+#endif
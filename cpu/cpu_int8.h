@@ -0,0 +1,124 @@
+#ifndef CPU_INT8_H
+#define CPU_INT8_H
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "cpu_half.h"
+using namespace std;
+
+// int8 tier of the grouped parameters of -v 11, *_group_prec_info 2 next to 0 (fp16) and 1 (fp32). A row is
+// its k int8 values followed by a signed exponent byte e and stands for v * 2^-e; e is picked per row from its
+// extremes the way get_only_scaling_factor picks it for the MuPPET kernels. Updates write a row back with
+// stochastic rounding, so that steps smaller than 2^-e still move it on average.
+// bf16 (-hf) is the other 16-bit format, *_group_prec_info 3.
+#define GROUP_PREC_INT8 2
+#define GROUP_PREC_BF16 3
+
+inline size_t grouped_row_bytes(unsigned char prec, unsigned int k){
+    if (prec == GROUP_PREC_INT8) return (size_t)k + 1;
+    return (size_t)k * (prec == 1 ? sizeof(float) : sizeof(unsigned short));
+}
+
+// get_only_scaling_factor(8, max, min) on the host, clamped to the exponent byte.
+inline int cpu_int8_row_exponent(const float* row, unsigned int k){
+    float max_val = row[0], min_val = row[0];
+    for (unsigned int d = 1; d < k; d++){
+        max_val = max(max_val, row[d]);
+        min_val = min(min_val, row[d]);
+    }
+    if (max_val == 0 && min_val == 0) return 0;
+    float range_best = fminf(fabsf(127.5f / max_val), fabsf(-128.5f / min_val));
+    return max(-127, min(127, (int)floorf(log2f(range_best))));
+}
+
+inline unsigned int cpu_xorshift32(unsigned int* state){
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Rounds to nearest when rng is NULL (conversions), stochastically otherwise (updates).
+inline void cpu_float2int8_row(signed char* out, const float* in, unsigned int k, unsigned int* rng){
+    int e = cpu_int8_row_exponent(in, k);
+    float scale = ldexpf(1.0f, e);
+    for (unsigned int d = 0; d < k; d++){
+        float x = in[d] * scale;
+        x = rng ? floorf(x + (cpu_xorshift32(rng) >> 8) * (1.0f / 16777216)) : roundf(x);
+        out[d] = (signed char)max(-128.0f, min(127.0f, x));
+    }
+    out[k] = (signed char)e;
+}
+
+inline void cpu_int82float_row(float* out, const signed char* in, unsigned int k){
+    float scale = ldexpf(1.0f, -in[k]);
+    for (unsigned int d = 0; d < k; d++) out[d] = in[d] * scale;
+}
+
+inline void cpu_grouped2float_row(float* out, const void* row, unsigned char prec, unsigned int k){
+    if (prec == GROUP_PREC_INT8) cpu_int82float_row(out, (const signed char*)row, k);
+    else if (prec == GROUP_PREC_BF16) cpu_bfloat162float_row(out, (const unsigned short*)row, k);
+    else if (prec) memcpy(out, row, sizeof(float) * k);
+    else cpu_half2float_row(out, (const unsigned short*)row, k);
+}
+
+inline void cpu_float2grouped_row(void* row, unsigned char prec, const float* in, unsigned int k, unsigned int* rng){
+    if (prec == GROUP_PREC_INT8) cpu_float2int8_row((signed char*)row, in, k, rng);
+    else if (prec == GROUP_PREC_BF16) cpu_float2bfloat16_row((unsigned short*)row, in, k);
+    else if (prec) memcpy(row, in, sizeof(float) * k);
+    else cpu_float2half_row((unsigned short*)row, in, k);
+}
+
+inline void* new_grouped_params(unsigned char prec, size_t rows, unsigned int k){
+    if (prec == GROUP_PREC_INT8) return new signed char[rows * grouped_row_bytes(prec, k)];
+    if (prec == 1) return new float[rows * k];
+    return new unsigned short[rows * k];
+}
+
+inline void delete_grouped_params(void* group, unsigned char prec){
+    if (prec == GROUP_PREC_INT8) delete [] (signed char*)group;
+    else if (prec == 1) delete [] (float*)group;
+    else delete [] (unsigned short*)group;
+}
+
+// Re-stores a group of rows in precision to, row by row through fp32. Returns the bytes read and written.
+inline size_t convert_grouped_params(void** group, unsigned char* prec, unsigned char to, unsigned int rows, unsigned int k){
+    void* converted = new_grouped_params(to, rows, k);
+    float* buf = new float[k];
+    size_t from_bytes = grouped_row_bytes(*prec, k), to_bytes = grouped_row_bytes(to, k);
+    for (size_t r = 0; r < rows; r++){
+        cpu_grouped2float_row(buf, (const char*)*group + r * from_bytes, *prec, k);
+        cpu_float2grouped_row((char*)converted + r * to_bytes, to, buf, k, NULL);
+    }
+    delete [] buf;
+    delete_grouped_params(*group, *prec);
+    *group = converted;
+    *prec = to;
+    return (size_t)rows * (from_bytes + to_bytes);
+}
+
+// -hf 2 stores an fp16 group in bf16 when it widens with more than HALF_RANGE_MISS_RATIO of its nonzero values
+// out of the normal range of fp16: subnormal (below 2^-14, with fewer than 11 significant bits left) or at least
+// 2^15 (the last binade before overflow, or already infinite).
+#define HALF_RANGE_MISS_RATIO 0.01
+
+inline bool half_range_limited(const unsigned short* group, size_t count){
+    size_t nonzero = 0, missed = 0;
+    for (size_t x = 0; x < count; x++){
+        unsigned int e = (group[x] >> 10) & 0x1f;
+        nonzero += (group[x] & 0x7fff) != 0;
+        missed += (e == 0 && (group[x] & 0x3ff)) || e >= 30;
+    }
+    return missed > nonzero * HALF_RANGE_MISS_RATIO;
+}
+
+// Next wider tier of the precision switching: int8 -> the 16-bit format of the run -> fp32, where -hf 2
+// (half_format 2) takes an fp16 group that ran out of range to bf16 instead of fp32.
+inline unsigned char wider_group_prec(const void* group, unsigned char prec, unsigned int rows, unsigned int k, unsigned int half_format){
+    if (prec == GROUP_PREC_INT8) return half_format == 1 ? GROUP_PREC_BF16 : 0;
+    if (prec == 0 && half_format == 2 && half_range_limited((const unsigned short*)group, (size_t)rows * k)) return GROUP_PREC_BF16;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef CPU_MASCOT_SGD_KERNEL_H
+#define CPU_MASCOT_SGD_KERNEL_H
+#include "common_struct.h"
+#include "cpu_half.h"
+#include "cpu_int8.h"
+#include "cpu_sgd_kernel.h"
+using namespace std;
+
+// Host view of one side (users or items) of the grouped parameters.
+struct Cpu_group_layout{
+    void** group_ptr;
+    unsigned char* group_prec;
+    unsigned int* sorted_idx2group;
+    unsigned int* group_start_idx;
+};
+
+struct Decoded_rating{
+    float r;
+    void* p_row;
+    void* q_row;
+    unsigned int user_group;
+    unsigned int item_group;
+};
+
+void build_cpu_group_layout(Cpu_group_layout* layout, void** group_ptr, unsigned char* group_prec, unsigned int* group_end_idx, unsigned int group_num){
+    layout->group_ptr = group_ptr;
+    layout->group_prec = group_prec;
+    layout->group_start_idx = new unsigned int[group_num];
+    layout->sorted_idx2group = new unsigned int[group_end_idx[group_num - 1] + 1];
+
+    unsigned int start_idx = 0;
+    for (unsigned int g = 0; g < group_num; g++){
+        layout->group_start_idx[g] = start_idx;
+        for (unsigned int s = start_idx; s <= group_end_idx[g]; s++) layout->sorted_idx2group[s] = g;
+        start_idx = group_end_idx[g] + 1;
+    }
+}
+
+inline void* grouped_row(const Cpu_group_layout* layout, unsigned int sorted_idx, unsigned int k, unsigned int* group){
+    unsigned int g = layout->sorted_idx2group[sorted_idx];
+    *group = g;
+    return (char*)layout->group_ptr[g] + (size_t)(sorted_idx - layout->group_start_idx[g]) * grouped_row_bytes(layout->group_prec[g], k);
+}
+
+inline void decode_rating(const Node& node, const Cpu_group_layout* user_layout, const Cpu_group_layout* item_layout, unsigned int k, Decoded_rating* out){
+    out->r = node.r;
+    out->p_row = grouped_row(user_layout, node.u, k, &out->user_group);
+    out->q_row = grouped_row(item_layout, node.i, k, &out->item_group);
+}
+
+inline float* load_grouped_row(void* row, unsigned char prec, float* buf, unsigned int k){
+    if (prec == 1) return (float*)row;
+    cpu_grouped2float_row(buf, row, prec, k);
+    return buf;
+}
+
+// Slot of a row that already appeared among the first w ratings of the window, or NULL. A row below fp32 is
+// decoded into a private buffer, so a second copy must share the first one's buffer: otherwise each copy is
+// updated from the stale value and the last write-back discards the other updates.
+inline float* window_row(void* const* window_rows, float* const* slots, unsigned int w, const void* row){
+    for (unsigned int s = 0; s < w; s++) if (window_rows[s] == row) return slots[s];
+    return NULL;
+}
+
+// MASCOT update loop over the grouped mixed-precision layout. Ratings are decoded (group lookup and row
+// address) prefetch_distance ahead into a ring, their rows are prefetched, and interleave ratings are
+// processed together; a row that repeats within the window is shared by its copies. Gradient statistics of
+// the groups below fp32 are accumulated for the last ratings of the shard. int8 rows are written back with
+// stochastic rounding from a generator seeded with rounding_seed.
+// Unless user_group_loss is NULL, the squared residuals are also accumulated per user and per item group.
+void cpu_mascot_sgd_worker(
+                            const Node* R,
+                            unsigned int begin,
+                            unsigned int end,
+                            const Cpu_group_layout* user_layout,
+                            const Cpu_group_layout* item_layout,
+                            float lrate,
+                            unsigned int k,
+                            float lambda,
+                            float* grad_sum_norm_p,
+                            float* grad_sum_norm_q,
+                            float* norm_sum_p,
+                            float* norm_sum_q,
+                            unsigned int first_sample_rating_idx,
+                            unsigned int prefetch_distance,
+                            unsigned int interleave,
+                            float* work,
+                            double* user_group_loss,
+                            double* item_group_loss,
+                            unsigned int rounding_seed
+                            )
+{
+    interleave = max(1u, min(interleave, (unsigned int)MAX_INTERLEAVE));
+    unsigned int ring_size = prefetch_distance + interleave;
+    vector<Decoded_rating> ring(ring_size);
+    float* p_buf = work;
+    float* q_buf = work + (size_t)MAX_INTERLEAVE * k;
+    float* p_rows[MAX_INTERLEAVE];
+    float* q_rows[MAX_INTERLEAVE];
+    void* p_window[MAX_INTERLEAVE];
+    void* q_window[MAX_INTERLEAVE];
+    float ruv[MAX_INTERLEAVE];
+    unsigned int processed_cnt = 0;
+    unsigned int rng = rounding_seed * 2654435761u + 1;
+    if (rng == 0) rng = 1;
+
+    unsigned int decoded_end = min(begin + prefetch_distance, end);
+    for (unsigned int j = begin; j < decoded_end; j++){
+        Decoded_rating* dr = &ring[(j - begin) % ring_size];
+        decode_rating(R[j], user_layout, item_layout, k, dr);
+        prefetch_row(dr->p_row, grouped_row_bytes(user_layout->group_prec[dr->user_group], k));
+        prefetch_row(dr->q_row, grouped_row_bytes(item_layout->group_prec[dr->item_group], k));
+    }
+
+    for (unsigned int j = begin; j < end; j += interleave){
+        unsigned int w = min(interleave, end - j);
+
+        for (; decoded_end < min(j + w + prefetch_distance, end); decoded_end++){
+            Decoded_rating* dr = &ring[(decoded_end - begin) % ring_size];
+            decode_rating(R[decoded_end], user_layout, item_layout, k, dr);
+            if (prefetch_distance){
+                prefetch_row(dr->p_row, grouped_row_bytes(user_layout->group_prec[dr->user_group], k));
+                prefetch_row(dr->q_row, grouped_row_bytes(item_layout->group_prec[dr->item_group], k));
+            }
+        }
+
+        for (unsigned int t = 0; t < w; t++){
+            const Decoded_rating* dr = &ring[(j + t - begin) % ring_size];
+            p_rows[t] = window_row(p_window, p_rows, t, dr->p_row);
+            q_rows[t] = window_row(q_window, q_rows, t, dr->q_row);
+            if (!p_rows[t]) p_rows[t] = load_grouped_row(dr->p_row, user_layout->group_prec[dr->user_group], p_buf + (size_t)t * k, k);
+            if (!q_rows[t]) q_rows[t] = load_grouped_row(dr->q_row, item_layout->group_prec[dr->item_group], q_buf + (size_t)t * k, k);
+            p_window[t] = dr->p_row;
+            q_window[t] = dr->q_row;
+            float tmp_product = 0;
+#if defined(__AVX512BF16__)
+            // bf16 pairs are multiplied straight from the stored rows.
+            if (user_layout->group_prec[dr->user_group] == GROUP_PREC_BF16 && item_layout->group_prec[dr->item_group] == GROUP_PREC_BF16)
+                tmp_product = cpu_dot_bfloat16((const unsigned short*)dr->p_row, (const unsigned short*)dr->q_row, k);
+            else
+#endif
+            for (unsigned int d = 0; d < k; d++) tmp_product += p_rows[t][d] * q_rows[t][d];
+            ruv[t] = dr->r - tmp_product;
+            if (user_group_loss){
+                user_group_loss[dr->user_group] += ruv[t] * ruv[t];
+                item_group_loss[dr->item_group] += ruv[t] * ruv[t];
+            }
+        }
+
+        for (unsigned int t = 0; t < w; t++){
+            const Decoded_rating* dr = &ring[(j + t - begin) % ring_size];
+            unsigned char user_prec = user_layout->group_prec[dr->user_group];
+            unsigned char item_prec = item_layout->group_prec[dr->item_group];
+            bool sample = processed_cnt >= first_sample_rating_idx;
+            float* p_row = p_rows[t];
+            float* q_row = q_rows[t];
+            float* user_grad_sum = grad_sum_norm_p + (size_t)dr->user_group * k;
+            float* item_grad_sum = grad_sum_norm_q + (size_t)dr->item_group * k;
+            float norm_p = 0;
+            float norm_q = 0;
+
+            for (unsigned int d = 0; d < k; d++){
+                const float tmp_p = p_row[d];
+                const float tmp_q = q_row[d];
+                const float grad_p = ruv[t]*tmp_q - lambda*tmp_p;
+                const float grad_q = ruv[t]*tmp_p - lambda*tmp_q;
+                p_row[d] = tmp_p + lrate*grad_p;
+                q_row[d] = tmp_q + lrate*grad_q;
+
+                if (sample && user_prec != 1) { user_grad_sum[d] += grad_p; norm_p += grad_p*grad_p; }
+                if (sample && item_prec != 1) { item_grad_sum[d] += grad_q; norm_q += grad_q*grad_q; }
+            }
+
+            if (sample){
+                norm_sum_p[dr->user_group] += norm_p;
+                norm_sum_q[dr->item_group] += norm_q;
+            }
+            if (user_prec != 1) cpu_float2grouped_row(dr->p_row, user_prec, p_row, k, &rng);
+            if (item_prec != 1) cpu_float2grouped_row(dr->q_row, item_prec, q_row, k, &rng);
+            processed_cnt++;
+        }
+    }
+}
+
+#endif
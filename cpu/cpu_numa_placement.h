@@ -0,0 +1,152 @@
+#ifndef CPU_NUMA_PLACEMENT_H
+#define CPU_NUMA_PLACEMENT_H
+#include <algorithm>
+#include "common_struct.h"
+#include "cpu_sgd_kernel.h"
+#include "cpu_thread_pool.h"
+using namespace std;
+
+struct Numa_plan{
+    vector<unsigned int> thread_rating_begin;   // shard of thread t is [thread_rating_begin[t], thread_rating_begin[t+1])
+    vector<unsigned int> node_user_begin;       // users [node_user_begin[n], node_user_begin[n+1]) are placed on node n
+    unsigned int hot_num;
+    unsigned int* hot_items;
+    unsigned int* item2replica;
+    vector<float*> q_replica;                   // one copy of the hot item rows per node
+};
+
+// Copies the rows [thread_row_begin[t], thread_row_begin[t+1]) with thread t, so they are placed on its node.
+void first_touch_copy(Cpu_thread_pool* pool, float* dst, const float* src, const vector<unsigned int>& thread_row_begin, unsigned int k){
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        size_t begin = (size_t)thread_row_begin[t] * k;
+        size_t end = (size_t)thread_row_begin[t + 1] * k;
+        if (end > begin) memcpy(dst + begin, src + begin, sizeof(float) * (end - begin));
+    });
+}
+
+// Splits [begin, end) of node n among the node's threads.
+void split_node_range(Cpu_thread_pool* pool, unsigned int n, unsigned int begin, unsigned int end, vector<unsigned int>* thread_begin){
+    unsigned int node_threads = pool->node_thread_start[n + 1] - pool->node_thread_start[n];
+    for (unsigned int t = 0; t < node_threads; t++)
+        (*thread_begin)[pool->node_thread_start[n] + t] = begin + (unsigned long long)(end - begin) * t / node_threads;
+}
+
+// Re-places R, P and Q so that every page is first-touched by the node whose threads use it most.
+// Users are split into contiguous ranges per node weighted by the node's share of threads, and R is
+// regrouped (stably, keeping the shuffle) so that a node's threads only train its own users. Q is used by
+// every node, so its rows are spread over all threads; the hot_num items with the most ratings are in
+// addition replicated per node and averaged by average_item_replicas.
+void numa_place_parameters(Mf_info* mf_info, SGD* sgd_info, Cpu_thread_pool* pool, Numa_plan* plan, unsigned int hot_num){
+    unsigned int k = mf_info->params.k;
+    unsigned int node_num = pool->node_num;
+
+    vector<unsigned long long> user_cnt(mf_info->max_user, 0);
+    vector<unsigned int> item_cnt(mf_info->max_item, 0);
+    for (unsigned int j = 0; j < mf_info->n; j++){
+        user_cnt[mf_info->R[j].u]++;
+        item_cnt[mf_info->R[j].i]++;
+    }
+
+    plan->node_user_begin.assign(node_num + 1, mf_info->max_user);
+    plan->node_user_begin[0] = 0;
+    unsigned long long acc_ratings = 0;
+    unsigned int n = 0;
+    for (unsigned int u = 0; u < mf_info->max_user && n + 1 < node_num; u++){
+        acc_ratings += user_cnt[u];
+        while (n + 1 < node_num && acc_ratings * pool->num_threads >= (unsigned long long)mf_info->n * pool->node_thread_start[n + 1]){
+            plan->node_user_begin[++n] = u + 1;
+        }
+    }
+
+    vector<unsigned int> user2node(mf_info->max_user);
+    for (n = 0; n < node_num; n++)
+        for (unsigned int u = plan->node_user_begin[n]; u < plan->node_user_begin[n + 1]; u++) user2node[u] = n;
+
+    vector<unsigned int> node_rating_begin(node_num + 1, 0);
+    for (unsigned int j = 0; j < mf_info->n; j++) node_rating_begin[user2node[mf_info->R[j].u] + 1]++;
+    for (n = 0; n < node_num; n++) node_rating_begin[n + 1] += node_rating_begin[n];
+
+    Node* regrouped_R = new Node[mf_info->n];
+    vector<unsigned int> fill(node_rating_begin.begin(), node_rating_begin.end() - 1);
+    for (unsigned int j = 0; j < mf_info->n; j++) regrouped_R[fill[user2node[mf_info->R[j].u]]++] = mf_info->R[j];
+
+    // R shards and P rows: node n's threads split node n's ratings and users.
+    plan->thread_rating_begin.assign(pool->num_threads + 1, mf_info->n);
+    vector<unsigned int> thread_user_begin(pool->num_threads + 1, mf_info->max_user);
+    for (n = 0; n < node_num; n++){
+        split_node_range(pool, n, node_rating_begin[n], node_rating_begin[n + 1], &plan->thread_rating_begin);
+        split_node_range(pool, n, plan->node_user_begin[n], plan->node_user_begin[n + 1], &thread_user_begin);
+    }
+
+    Node* placed_R = (Node*)alloc_untouched(sizeof(Node) * mf_info->n);
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        unsigned int begin = plan->thread_rating_begin[t];
+        unsigned int end = plan->thread_rating_begin[t + 1];
+        if (end > begin) memcpy(placed_R + begin, regrouped_R + begin, sizeof(Node) * (end - begin));
+    });
+    delete [] regrouped_R;
+    delete [] mf_info->R;
+    mf_info->R = placed_R;
+
+    float* placed_p = (float*)alloc_untouched(sizeof(float) * mf_info->max_user * k);
+    first_touch_copy(pool, placed_p, sgd_info->p, thread_user_begin, k);
+    delete [] sgd_info->p;
+    sgd_info->p = placed_p;
+
+    vector<unsigned int> thread_item_begin(pool->num_threads + 1);
+    for (unsigned int t = 0; t <= pool->num_threads; t++) thread_item_begin[t] = (unsigned long long)mf_info->max_item * t / pool->num_threads;
+    float* placed_q = (float*)alloc_untouched(sizeof(float) * mf_info->max_item * k);
+    first_touch_copy(pool, placed_q, sgd_info->q, thread_item_begin, k);
+    delete [] sgd_info->q;
+    sgd_info->q = placed_q;
+
+    // Hot items are only worth replicating when more than one node updates them.
+    plan->hot_num = node_num > 1 ? min(hot_num, mf_info->max_item) : 0;
+    plan->hot_items = new unsigned int[max(plan->hot_num, 1u)];
+    plan->item2replica = NULL;
+    plan->q_replica.assign(node_num, (float*)NULL);
+    if (plan->hot_num == 0) return;
+
+    vector<unsigned int> items(mf_info->max_item);
+    for (unsigned int i = 0; i < mf_info->max_item; i++) items[i] = i;
+    nth_element(items.begin(), items.begin() + plan->hot_num - 1, items.end(),
+                [&](unsigned int a, unsigned int b){ return item_cnt[a] > item_cnt[b]; });
+    sort(items.begin(), items.begin() + plan->hot_num);
+
+    plan->item2replica = new unsigned int[mf_info->max_item];
+    for (unsigned int i = 0; i < mf_info->max_item; i++) plan->item2replica[i] = NO_REPLICA;
+    for (unsigned int h = 0; h < plan->hot_num; h++){
+        plan->hot_items[h] = items[h];
+        plan->item2replica[items[h]] = h;
+    }
+
+    for (n = 0; n < node_num; n++) plan->q_replica[n] = (float*)alloc_untouched(sizeof(float) * plan->hot_num * k);
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        if (t != pool->node_thread_start[pool->thread2node[t]]) return;
+        float* replica = plan->q_replica[pool->thread2node[t]];
+        for (unsigned int h = 0; h < plan->hot_num; h++) memcpy(replica + (size_t)h * k, sgd_info->q + (size_t)plan->hot_items[h] * k, sizeof(float) * k);
+    });
+}
+
+// Averages the per-node replicas of the hot item rows, writes the mean back into every replica and into Q.
+void average_item_replicas(Mf_info* mf_info, SGD* sgd_info, Cpu_thread_pool* pool, Numa_plan* plan){
+    if (plan->hot_num == 0) return;
+    unsigned int k = mf_info->params.k;
+    unsigned int node_num = pool->node_num;
+
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        unsigned int begin = (unsigned long long)plan->hot_num * t / pool->num_threads;
+        unsigned int end = (unsigned long long)plan->hot_num * (t + 1) / pool->num_threads;
+        for (unsigned int h = begin; h < end; h++){
+            float* q_row = sgd_info->q + (size_t)plan->hot_items[h] * k;
+            for (unsigned int d = 0; d < k; d++){
+                float sum = 0;
+                for (unsigned int n = 0; n < node_num; n++) sum += plan->q_replica[n][(size_t)h * k + d];
+                q_row[d] = sum / node_num;
+            }
+            for (unsigned int n = 0; n < node_num; n++) memcpy(plan->q_replica[n] + (size_t)h * k, q_row, sizeof(float) * k);
+        }
+    });
+}
+
+#endif
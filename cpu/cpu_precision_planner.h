@@ -0,0 +1,191 @@
+#ifndef CPU_PRECISION_PLANNER_H
+#define CPU_PRECISION_PLANNER_H
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <malloc.h>
+#include "common_struct.h"
+#include "cpu_half.h"
+#include "cpu_int8.h"
+using namespace std;
+
+// Precision planner of -v 11 for a memory budget (-pb), in place of the error threshold. Every group gets one
+// of the storage formats in PLAN_FORMATS so that the groups fit in the budget and the sum over the groups of
+// ratings * score * penalty of the format is smallest: a multiple-choice knapsack, solved by dynamic
+// programming over the budget in PLAN_UNITS units (group sizes are rounded up, so a plan never exceeds the
+// budget). The score of a group is its last gradient diversity estimate (-ps 0), or 1 with -ps 1, which leaves
+// the degree as the proxy: a group is then worth its ratings per byte. Groups whose estimate is unknown (fp32
+// since the start or since a resume) are scored like the highest known estimate.
+#define PLAN_UNITS 4096
+
+struct Plan_format{
+    unsigned char prec;             // value of *_group_prec_info
+    float penalty;                  // relative squared quantization error
+};
+
+// fp16 keeps 11 significant bits; its penalty is the unit, fp32 is exact by comparison. int8 keeps 7 or 8 bits
+// of the largest value of the row, (2^4)^2 times the squared error of fp16.
+const Plan_format PLAN_FORMATS[] = {{GROUP_PREC_INT8, 256.0f}, {0, 1.0f}, {1, 0.0f}};
+const unsigned int PLAN_FORMAT_NUM = sizeof(PLAN_FORMATS) / sizeof(PLAN_FORMATS[0]);
+
+struct Precision_planner{
+    size_t budget;
+    bool degree_proxy;
+    vector<double> ratings[2];          // per user (0) and item (1) group
+    vector<float> score[2];             // last estimate, negative while unknown
+    vector<unsigned char> plan[2];
+    size_t predicted_bytes;
+    bool feasible;
+    unsigned int plans;
+    unsigned int switched_groups;
+    size_t converted_bytes;
+    double exec_time;
+};
+
+inline size_t plan_format_bytes(unsigned int group_size, unsigned int k, unsigned int f){
+    return (size_t)group_size * grouped_row_bytes(PLAN_FORMATS[f].prec, k);
+}
+
+inline unsigned int plan_format_of(unsigned char prec){
+    for (unsigned int f = 0; f < PLAN_FORMAT_NUM; f++) if (PLAN_FORMATS[f].prec == prec) return f;
+    return 0;
+}
+
+void init_precision_planner(Precision_planner* pp, Mf_info* mf_info, const unsigned int* user_sorted_idx2group,
+                            const unsigned int* item_sorted_idx2group, size_t budget, bool degree_proxy){
+    pp->budget = budget;
+    pp->degree_proxy = degree_proxy;
+    unsigned int group_num[2] = {(unsigned int)mf_info->params.user_group_num, (unsigned int)mf_info->params.item_group_num};
+    for (int side = 0; side < 2; side++){
+        pp->ratings[side].assign(group_num[side], 0);
+        pp->score[side].assign(group_num[side], -1.0f);
+        pp->plan[side].assign(group_num[side], 0);
+    }
+    for (unsigned int j = 0; j < mf_info->n; j++){
+        pp->ratings[0][user_sorted_idx2group[mf_info->R[j].u]]++;
+        pp->ratings[1][item_sorted_idx2group[mf_info->R[j].i]]++;
+    }
+    pp->predicted_bytes = 0;
+    pp->feasible = true;
+    pp->plans = 0;
+    pp->switched_groups = 0;
+    pp->converted_bytes = 0;
+    pp->exec_time = 0;
+}
+
+// Takes the estimates of the groups measured in this epoch (the others are -1) and plans the formats.
+void plan_group_precisions(Precision_planner* pp, Mf_info* mf_info){
+    std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+    unsigned int k = mf_info->params.k;
+    unsigned int group_num[2] = {(unsigned int)mf_info->params.user_group_num, (unsigned int)mf_info->params.item_group_num};
+    float* group_error[2] = {mf_info->user_group_error, mf_info->item_group_error};
+    unsigned int* group_size[2] = {mf_info->user_group_size, mf_info->item_group_size};
+    float max_score = 0;
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < group_num[side]; g++){
+            if (pp->degree_proxy) pp->score[side][g] = 1.0f;
+            else if (group_error[side][g] >= 0) pp->score[side][g] = group_error[side][g];
+            max_score = max(max_score, pp->score[side][g]);
+        }
+    if (max_score == 0) max_score = 1.0f;
+
+    // cost[c] is the least penalty of the groups so far within c units; choice keeps the format per group.
+    double unit = max((double)pp->budget / PLAN_UNITS, 1.0);
+    unsigned int total = group_num[0] + group_num[1];
+    const double inf = 1e300;
+    vector<double> cost(PLAN_UNITS + 1, 0), next(PLAN_UNITS + 1);
+    vector<unsigned char> choice((size_t)total * (PLAN_UNITS + 1), 0);
+    pp->feasible = true;
+    for (unsigned int j = 0; j < total; j++){
+        int side = j >= group_num[0];
+        unsigned int g = j - side * group_num[0];
+        float score = pp->score[side][g] >= 0 ? pp->score[side][g] : max_score;
+        fill(next.begin(), next.end(), inf);
+        for (unsigned int f = 0; f < PLAN_FORMAT_NUM; f++){
+            size_t units = (size_t)ceil(plan_format_bytes(group_size[side][g], k, f) / unit);
+            double penalty = pp->ratings[side][g] * score * PLAN_FORMATS[f].penalty;
+            for (size_t c = units; c <= PLAN_UNITS; c++)
+                if (cost[c - units] + penalty < next[c]){
+                    next[c] = cost[c - units] + penalty;
+                    choice[(size_t)j * (PLAN_UNITS + 1) + c] = f;
+                }
+        }
+        cost.swap(next);
+    }
+
+    unsigned int c = PLAN_UNITS;
+    if (cost[c] >= inf){
+        // Not even the narrowest formats fit: every group takes the narrowest one.
+        pp->feasible = false;
+        unsigned int narrowest = 0;
+        for (unsigned int f = 1; f < PLAN_FORMAT_NUM; f++) if (grouped_row_bytes(PLAN_FORMATS[f].prec, k) < grouped_row_bytes(PLAN_FORMATS[narrowest].prec, k)) narrowest = f;
+        for (int side = 0; side < 2; side++) pp->plan[side].assign(group_num[side], PLAN_FORMATS[narrowest].prec);
+    }else{
+        for (unsigned int j = total; j-- > 0;){
+            int side = j >= group_num[0];
+            unsigned int g = j - side * group_num[0];
+            unsigned int f = choice[(size_t)j * (PLAN_UNITS + 1) + c];
+            pp->plan[side][g] = PLAN_FORMATS[f].prec;
+            c -= (unsigned int)ceil(plan_format_bytes(group_size[side][g], k, f) / unit);
+        }
+    }
+    pp->predicted_bytes = 0;
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < group_num[side]; g++)
+            pp->predicted_bytes += plan_format_bytes(group_size[side][g], k, plan_format_of(pp->plan[side][g]));
+    pp->plans++;
+    pp->exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+}
+
+// Converts the groups whose format differs from the plan, widening or narrowing them on the heap.
+void apply_precision_plan(Precision_planner* pp, Mf_info* mf_info, SGD* sgd_info){
+    std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+    unsigned int k = mf_info->params.k;
+    unsigned int group_num[2] = {(unsigned int)mf_info->params.user_group_num, (unsigned int)mf_info->params.item_group_num};
+    unsigned char* group_prec[2] = {mf_info->user_group_prec_info, mf_info->item_group_prec_info};
+    unsigned int* group_size[2] = {mf_info->user_group_size, mf_info->item_group_size};
+    void** group_ptr[2] = {sgd_info->user_group_ptr, sgd_info->item_group_ptr};
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < group_num[side]; g++){
+            if (group_prec[side][g] == pp->plan[side][g]) continue;
+            pp->converted_bytes += convert_grouped_params(&group_ptr[side][g], &group_prec[side][g], pp->plan[side][g], group_size[side][g], k);
+            pp->switched_groups++;
+        }
+    pp->exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+}
+
+// Footprint of the groups as allocated, including the allocator's rounding.
+size_t grouped_parameters_footprint(Mf_info* mf_info, SGD* sgd_info){
+    size_t bytes = 0;
+    for (int g = 0; g < mf_info->params.user_group_num; g++) bytes += malloc_usable_size(sgd_info->user_group_ptr[g]);
+    for (int g = 0; g < mf_info->params.item_group_num; g++) bytes += malloc_usable_size(sgd_info->item_group_ptr[g]);
+    return bytes;
+}
+
+string precision_plan_string(const vector<unsigned char>& plan){
+    string s;
+    for (size_t g = 0; g < plan.size(); g++) s += (char)('0' + plan[g]);
+    return s;
+}
+
+void print_precision_plan(Precision_planner* pp, Mf_info* mf_info, SGD* sgd_info, int e){
+    cout << "Precision plan after epoch " << e + 1 << " : user " << precision_plan_string(pp->plan[0]) << " item " << precision_plan_string(pp->plan[1])
+         << ", predicted / actual " << pp->predicted_bytes << " / " << grouped_parameters_footprint(mf_info, sgd_info) << " bytes"
+         << (pp->feasible ? "" : " (over budget)") << endl;
+}
+
+void print_precision_planner(Precision_planner* pp, Mf_info* mf_info, SGD* sgd_info){
+    cout << "\n<Precision planner>" << endl;
+    cout << "Budget (bytes)                   : " << pp->budget << endl;
+    cout << "Score                            : " << (pp->degree_proxy ? "degree" : "gradient diversity") << endl;
+    cout << "Plans / switched groups          : " << pp->plans << " / " << pp->switched_groups << endl;
+    cout << "Predicted / actual footprint     : " << pp->predicted_bytes << " / " << grouped_parameters_footprint(mf_info, sgd_info) << endl;
+    cout << "Bytes converted                  : " << pp->converted_bytes << endl;
+    cout << "Planning time                    : " << pp->exec_time << endl;
+}
+
+#endif
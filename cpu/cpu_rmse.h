@@ -0,0 +1,200 @@
+#ifndef CPU_RMSE_H
+#define CPU_RMSE_H
+#include <cmath>
+#include <atomic>
+#include <vector>
+#include <immintrin.h>
+#include "common_struct.h"
+#include "cpu_half.h"
+#include "cpu_sgd_kernel.h"
+#include "cpu_mascot_sgd_kernel.h"
+#include "cpu_thread_pool.h"
+using namespace std;
+
+#define EVAL_BLOCK_SIZE 4096
+#define EVAL_PREFETCH_DISTANCE 8
+
+// Dot product of two k-float rows for any k. The tail is masked (AVX-512) or handled in scalar code.
+inline float cpu_dot(const float* a, const float* b, unsigned int k){
+    unsigned int d = 0;
+    float sum = 0;
+#if defined(__AVX512F__)
+    __m512 acc = _mm512_setzero_ps();
+    for (; d + 16 <= k; d += 16) acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + d), _mm512_loadu_ps(b + d), acc);
+    if (d < k){
+        __mmask16 mask = (__mmask16)((1u << (k - d)) - 1);
+        acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + d), _mm512_maskz_loadu_ps(mask, b + d), acc);
+        d = k;
+    }
+    sum = _mm512_reduce_add_ps(acc);
+#elif defined(__AVX2__) && defined(__FMA__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; d + 8 <= k; d += 8) acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + d), _mm256_loadu_ps(b + d), acc);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    sum = _mm_cvtss_f32(half);
+#endif
+    for (; d < k; d++) sum += a[d] * b[d];
+    return sum;
+}
+
+// int8 values come unscaled; grouped_row_scale is their factor.
+inline float grouped_elem(const void* row, unsigned char prec, unsigned int d){
+    if (prec == GROUP_PREC_INT8) return ((const signed char*)row)[d];
+    if (prec == GROUP_PREC_BF16) return cpu_bfloat162float(((const unsigned short*)row)[d]);
+    return prec ? ((const float*)row)[d] : cpu_half2float(((const unsigned short*)row)[d]);
+}
+
+inline float grouped_row_scale(const void* row, unsigned char prec, unsigned int k){
+    return prec == GROUP_PREC_INT8 ? ldexpf(1.0f, -((const signed char*)row)[k]) : 1.0f;
+}
+
+#if defined(__AVX512F__)
+inline __m512 load_grouped16(const void* row, unsigned char prec, unsigned int d){
+    if (prec == GROUP_PREC_BF16)
+        return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)((const unsigned short*)row + d))), 16));
+    if (prec) return _mm512_loadu_ps((const float*)row + d);
+    return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)((const unsigned short*)row + d)));
+}
+#elif defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+inline __m256 load_grouped8(const void* row, unsigned char prec, unsigned int d){
+    if (prec == GROUP_PREC_BF16)
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)((const unsigned short*)row + d))), 16));
+    if (prec) return _mm256_loadu_ps((const float*)row + d);
+    return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)((const unsigned short*)row + d)));
+}
+#endif
+
+// Dot product of two grouped rows (fp16 when prec is 0, fp32 when 1, else GROUP_PREC_INT8 or GROUP_PREC_BF16).
+// 16-bit lanes are widened in registers, so the groups are evaluated in place without materializing P and Q.
+inline float cpu_dot_grouped(const void* a, unsigned char prec_a, const void* b, unsigned char prec_b, unsigned int k){
+    if (prec_a == 1 && prec_b == 1) return cpu_dot((const float*)a, (const float*)b, k);
+    if (prec_a == GROUP_PREC_BF16 && prec_b == GROUP_PREC_BF16) return cpu_dot_bfloat16((const unsigned short*)a, (const unsigned short*)b, k);
+    if (prec_a == GROUP_PREC_INT8 || prec_b == GROUP_PREC_INT8){
+        float sum = 0;
+        for (unsigned int d = 0; d < k; d++) sum += grouped_elem(a, prec_a, d) * grouped_elem(b, prec_b, d);
+        return sum * grouped_row_scale(a, prec_a, k) * grouped_row_scale(b, prec_b, k);
+    }
+    unsigned int d = 0;
+    float sum = 0;
+#if defined(__AVX512F__)
+    __m512 acc = _mm512_setzero_ps();
+    for (; d + 16 <= k; d += 16) acc = _mm512_fmadd_ps(load_grouped16(a, prec_a, d), load_grouped16(b, prec_b, d), acc);
+    sum = _mm512_reduce_add_ps(acc);
+#elif defined(__AVX2__) && defined(__FMA__) && defined(__F16C__)
+    __m256 acc = _mm256_setzero_ps();
+    for (; d + 8 <= k; d += 8) acc = _mm256_fmadd_ps(load_grouped8(a, prec_a, d), load_grouped8(b, prec_b, d), acc);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    sum = _mm_cvtss_f32(half);
+#endif
+    for (; d < k; d++) sum += grouped_elem(a, prec_a, d) * grouped_elem(b, prec_b, d);
+    return sum;
+}
+
+// Pairwise (cascade) summation; the rounding error grows with log(n) instead of n.
+double pairwise_sum(const double* v, size_t n){
+    if (n <= 8){
+        double sum = 0;
+        for (size_t i = 0; i < n; i++) sum += v[i];
+        return sum;
+    }
+    size_t half = n / 2;
+    return pairwise_sum(v, half) + pairwise_sum(v + half, n - half);
+}
+
+// Pairwise-summed squared error of the test pairs [begin, end), at most EVAL_BLOCK_SIZE of them.
+double cpu_squared_error_block(const Node* test, size_t begin, size_t end, const float* p, const float* q, unsigned int k){
+    double err[EVAL_BLOCK_SIZE];
+    for (size_t j = begin; j < end; j++){
+        if (j + EVAL_PREFETCH_DISTANCE < end){
+            prefetch_row(p + (size_t)test[j + EVAL_PREFETCH_DISTANCE].u * k, sizeof(float) * k);
+            prefetch_row(q + (size_t)test[j + EVAL_PREFETCH_DISTANCE].i * k, sizeof(float) * k);
+        }
+        double e = test[j].r - (double)cpu_dot(p + (size_t)test[j].u * k, q + (size_t)test[j].i * k, k);
+        err[j - begin] = e * e;
+    }
+    return pairwise_sum(err, end - begin);
+}
+
+// Squared-error sums of [test, test+n) in fixed blocks of EVAL_BLOCK_SIZE pairs, appended to block_sums in
+// block order. Blocks are handed out dynamically, but each block is reduced on its own, so the result does
+// not depend on the number of threads.
+void cpu_squared_error_blocks(Cpu_thread_pool* pool, const Node* test, size_t n, const float* p, const float* q, unsigned int k, vector<double>* block_sums){
+    size_t block_num = (n + EVAL_BLOCK_SIZE - 1) / EVAL_BLOCK_SIZE;
+    size_t first_block = block_sums->size();
+    block_sums->resize(first_block + block_num);
+    atomic<size_t> next_block(0);
+
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        for (size_t b = next_block.fetch_add(1); b < block_num; b = next_block.fetch_add(1)){
+            size_t begin = b * EVAL_BLOCK_SIZE;
+            (*block_sums)[first_block + b] = cpu_squared_error_block(test, begin, min(begin + EVAL_BLOCK_SIZE, n), p, q, k);
+        }
+    });
+}
+
+float cpu_set_rmse(Cpu_thread_pool* pool, const Node* set, size_t n, const float* p, const float* q, unsigned int k){
+    vector<double> block_sums;
+    cpu_squared_error_blocks(pool, set, n, p, q, k, &block_sums);
+    return sqrt(pairwise_sum(block_sums.data(), block_sums.size())/(double)n);
+}
+
+float cpu_test_rmse(Mf_info* mf_info, SGD* sgd_info, Cpu_thread_pool* pool){
+    return cpu_set_rmse(pool, mf_info->test_COO, mf_info->test_n, sgd_info->p, sgd_info->q, mf_info->params.k);
+}
+
+// RMSE on the grouped parameters of -v 11. Test and validation sets are kept in original ids, so pairs are
+// mapped to the sorted index space first; blocks and summation order are the same as cpu_test_rmse.
+float cpu_set_rmse_grouped(Mf_info* mf_info, const Node* test, size_t n, const Cpu_group_layout* user_layout, const Cpu_group_layout* item_layout, Cpu_thread_pool* pool){
+    unsigned int k = mf_info->params.k;
+    size_t block_num = (n + EVAL_BLOCK_SIZE - 1) / EVAL_BLOCK_SIZE;
+    vector<double> block_sums(block_num);
+    atomic<size_t> next_block(0);
+
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        double err[EVAL_BLOCK_SIZE];
+        unsigned int user_group, item_group;
+        for (size_t b = next_block.fetch_add(1); b < block_num; b = next_block.fetch_add(1)){
+            size_t begin = b * EVAL_BLOCK_SIZE;
+            size_t end = min(begin + EVAL_BLOCK_SIZE, n);
+            for (size_t j = begin; j < end; j++){
+                const void* p_row = grouped_row(user_layout, mf_info->user2sorted_idx[test[j].u], k, &user_group);
+                const void* q_row = grouped_row(item_layout, mf_info->item2sorted_idx[test[j].i], k, &item_group);
+                double e = test[j].r - (double)cpu_dot_grouped(p_row, user_layout->group_prec[user_group], q_row, item_layout->group_prec[item_group], k);
+                err[j - begin] = e * e;
+            }
+            block_sums[b] = pairwise_sum(err, end - begin);
+        }
+    });
+    return sqrt(pairwise_sum(block_sums.data(), block_sums.size())/(double)n);
+}
+
+float cpu_test_rmse_grouped(Mf_info* mf_info, const Cpu_group_layout* user_layout, const Cpu_group_layout* item_layout, Cpu_thread_pool* pool){
+    return cpu_set_rmse_grouped(mf_info, mf_info->test_COO, mf_info->test_n, user_layout, item_layout, pool);
+}
+
+// The test set is evaluated every -ei epochs and after the last epoch.
+inline bool cpu_eval_epoch(Mf_info* mf_info, int e){
+    return (e + 1) % max(1u, mf_info->params.eval_interval) == 0 || e + 1 == (int)mf_info->params.epoch;
+}
+
+// Training RMSE from the squared residuals accumulated in the update loop (before each update is applied).
+double cpu_train_rmse(const vector<double>& loss, size_t n){
+    return sqrt(pairwise_sum(loss.data(), loss.size())/(double)n);
+}
+
+// Per-epoch line "epoch lr test_rmse [train_rmse] [valid_rmse]". The test RMSE is "-" on epochs without
+// evaluation; the training RMSE is only printed with -tl 1 and the validation RMSE with early stopping.
+void print_cpu_epoch(Mf_info* mf_info, int e, float lrate, bool evaluated, double rmse, double train_rmse, double valid_rmse){
+    cout << e + 1 << " " << lrate << " ";
+    if (evaluated) cout << rmse;
+    else cout << "-";
+    if (mf_info->params.train_loss) cout << " " << train_rmse;
+    if (mf_info->params.patience) cout << " " << valid_rmse;
+    cout << endl;
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef CPU_SGD_KERNEL_H
+#define CPU_SGD_KERNEL_H
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include "common_struct.h"
+using namespace std;
+
+#define MAX_INTERLEAVE 16
+#define NO_REPLICA 0xffffffffu
+
+struct User_batch{
+    unsigned int u;
+    unsigned int begin;
+    unsigned int end;
+};
+
+// Builds a user-major CSR view of R. Counting sort is stable, so each user's items keep the shuffled order of R.
+void build_user_major_csr(Mf_info* mf_info, Csr* csr){
+    csr->row_ptr = new unsigned int[mf_info->max_user + 1];
+    csr->col_idx = new unsigned int[mf_info->n];
+    csr->val = new float[mf_info->n];
+
+    memset(csr->row_ptr, 0, sizeof(unsigned int) * (mf_info->max_user + 1));
+    for (unsigned int j = 0; j < mf_info->n; j++) csr->row_ptr[mf_info->R[j].u + 1]++;
+    for (unsigned int u = 0; u < mf_info->max_user; u++) csr->row_ptr[u + 1] += csr->row_ptr[u];
+
+    unsigned int* fill = new unsigned int[mf_info->max_user];
+    memcpy(fill, csr->row_ptr, sizeof(unsigned int) * mf_info->max_user);
+    for (unsigned int j = 0; j < mf_info->n; j++){
+        unsigned int pos = fill[mf_info->R[j].u]++;
+        csr->col_idx[pos] = mf_info->R[j].i;
+        csr->val[pos] = mf_info->R[j].r;
+    }
+    delete [] fill;
+}
+
+// Splits every user row into batches of at most batch_size ratings.
+vector<User_batch> split_user_batches(Mf_info* mf_info, Csr* csr, unsigned int batch_size){
+    vector<User_batch> batches;
+    for (unsigned int u = 0; u < mf_info->max_user; u++){
+        for (unsigned int b = csr->row_ptr[u]; b < csr->row_ptr[u + 1]; b += batch_size){
+            unsigned int e = min(b + batch_size, csr->row_ptr[u + 1]);
+            batches.push_back({u, b, e});
+        }
+    }
+    return batches;
+}
+
+// Hogwild worker over user batches. p_u is held in p_local for the whole batch and written back once.
+// The squared residuals of all updates are added to *loss unless it is NULL.
+void cpu_user_major_sgd_worker(
+                            const Csr* csr,
+                            const User_batch* batches,
+                            unsigned int batch_num,
+                            atomic<unsigned int>* next_batch,
+                            float* p,
+                            float* q,
+                            float* p_local,
+                            float lrate,
+                            unsigned int k,
+                            float lambda,
+                            double* loss
+                            )
+{
+    double loss_sum = 0;
+    for (unsigned int b = next_batch->fetch_add(1); b < batch_num; b = next_batch->fetch_add(1)){
+        const User_batch batch = batches[b];
+        float* p_row = p + (size_t)batch.u * k;
+        memcpy(p_local, p_row, sizeof(float) * k);
+
+        for (unsigned int j = batch.begin; j < batch.end; j++){
+            float* q_row = q + (size_t)csr->col_idx[j] * k;
+
+            float tmp_product = 0;
+            for (unsigned int d = 0; d < k; d++) tmp_product += p_local[d] * q_row[d];
+            const float ruv = csr->val[j] - tmp_product;
+            loss_sum += ruv * ruv;
+
+            for (unsigned int d = 0; d < k; d++){
+                const float tmp_p = p_local[d];
+                const float tmp_q = q_row[d];
+                p_local[d] = tmp_p + lrate*(ruv*tmp_q - lambda*tmp_p);
+                q_row[d] = tmp_q + lrate*(ruv*tmp_p - lambda*tmp_q);
+            }
+        }
+
+        memcpy(p_row, p_local, sizeof(float) * k);
+    }
+    if (loss) *loss += loss_sum;
+}
+
+inline void prefetch_row(const void* row, size_t bytes){
+    const char* ptr = (const char*)row;
+    for (size_t off = 0; off < bytes; off += 64) __builtin_prefetch(ptr + off, 1, 3);
+}
+
+// Item row used by a worker. Replicated (hot) items resolve to the replica of the worker's node.
+inline float* item_row(float* q, const unsigned int* item2replica, float* q_replica, unsigned int i, unsigned int k){
+    if (item2replica && item2replica[i] != NO_REPLICA) return q_replica + (size_t)item2replica[i] * k;
+    return q + (size_t)i * k;
+}
+
+// Hogwild worker over the contiguous shard [begin, end) of R. Rows of the rating prefetch_distance
+// ahead are prefetched, and interleave ratings are processed as a group so their row loads overlap.
+// item2replica may be NULL when no item rows are replicated. The squared residuals of all updates are
+// added to *loss unless it is NULL.
+void cpu_prefetch_sgd_worker(
+                            const Node* R,
+                            unsigned int begin,
+                            unsigned int end,
+                            float* p,
+                            float* q,
+                            float lrate,
+                            unsigned int k,
+                            float lambda,
+                            unsigned int prefetch_distance,
+                            unsigned int interleave,
+                            const unsigned int* item2replica,
+                            float* q_replica,
+                            double* loss
+                            )
+{
+    size_t row_bytes = sizeof(float) * k;
+    float* p_rows[MAX_INTERLEAVE];
+    float* q_rows[MAX_INTERLEAVE];
+    float ruv[MAX_INTERLEAVE];
+    double loss_sum = 0;
+    interleave = max(1u, min(interleave, (unsigned int)MAX_INTERLEAVE));
+
+    for (unsigned int j = begin; j < min(begin + prefetch_distance, end); j++){
+        prefetch_row(p + (size_t)R[j].u * k, row_bytes);
+        prefetch_row(item_row(q, item2replica, q_replica, R[j].i, k), row_bytes);
+    }
+
+    for (unsigned int j = begin; j < end; j += interleave){
+        unsigned int w = min(interleave, end - j);
+
+        if (prefetch_distance){
+            for (unsigned int t = 0; t < w && j + prefetch_distance + t < end; t++){
+                const Node& ahead = R[j + prefetch_distance + t];
+                prefetch_row(p + (size_t)ahead.u * k, row_bytes);
+                prefetch_row(item_row(q, item2replica, q_replica, ahead.i, k), row_bytes);
+            }
+        }
+
+        for (unsigned int t = 0; t < w; t++){
+            p_rows[t] = p + (size_t)R[j + t].u * k;
+            q_rows[t] = item_row(q, item2replica, q_replica, R[j + t].i, k);
+            float tmp_product = 0;
+            for (unsigned int d = 0; d < k; d++) tmp_product += p_rows[t][d] * q_rows[t][d];
+            ruv[t] = R[j + t].r - tmp_product;
+            loss_sum += ruv[t] * ruv[t];
+        }
+
+        for (unsigned int t = 0; t < w; t++){
+            float* p_row = p_rows[t];
+            float* q_row = q_rows[t];
+            for (unsigned int d = 0; d < k; d++){
+                const float tmp_p = p_row[d];
+                const float tmp_q = q_row[d];
+                p_row[d] = tmp_p + lrate*(ruv[t]*tmp_q - lambda*tmp_p);
+                q_row[d] = tmp_q + lrate*(ruv[t]*tmp_p - lambda*tmp_q);
+            }
+        }
+    }
+    if (loss) *loss += loss_sum;
+}
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef CPU_THREAD_POOL_H
+#define CPU_THREAD_POOL_H
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+using namespace std;
+
+struct Cpu_topology{
+    vector<vector<unsigned int>> node_cpus;
+};
+
+// Persistent pool of pinned workers. Threads are assigned to NUMA nodes in contiguous id ranges
+// (node n owns threads [node_thread_start[n], node_thread_start[n+1])) in proportion to the node's CPUs.
+struct Cpu_thread_pool{
+    unsigned int num_threads;
+    unsigned int node_num;
+    vector<unsigned int> thread2node;
+    vector<unsigned int> thread2cpu;
+    vector<unsigned int> node_thread_start;
+    vector<thread> workers;
+
+    mutex m;
+    condition_variable job_cv;
+    condition_variable done_cv;
+    function<void(unsigned int)> job;
+    unsigned long long job_id;
+    unsigned int running;
+    bool stop;
+
+    // node-loads / node-load-misses per thread, accumulated over all jobs
+    bool perf_available;
+    vector<unsigned long long> node_loads;
+    vector<unsigned long long> node_load_misses;
+};
+
+// Parses the kernel cpulist format ("0-3,8,10-11").
+vector<unsigned int> parse_cpu_list(const string& s){
+    vector<unsigned int> cpus;
+    stringstream ss(s);
+    string tok;
+    while (getline(ss, tok, ',')){
+        if (tok.find_first_of("0123456789") == string::npos) continue;
+        size_t dash = tok.find('-');
+        unsigned int first = atoi(tok.substr(0, dash).c_str());
+        unsigned int last = dash == string::npos ? first : atoi(tok.substr(dash + 1).c_str());
+        for (unsigned int c = first; c <= last; c++) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+// Reads the NUMA nodes and their CPUs from /sys. Falls back to a single node when /sys is unavailable.
+// numa_nodes > 0 splits the CPUs into that many virtual nodes instead (for testing placement on one socket).
+void read_cpu_topology(Cpu_topology* topo, unsigned int numa_nodes){
+    topo->node_cpus.clear();
+    ifstream online("/sys/devices/system/node/online");
+    string line;
+    if (online && getline(online, line)){
+        vector<unsigned int> nodes = parse_cpu_list(line);
+        for (unsigned int n : nodes){
+            ifstream cpulist("/sys/devices/system/node/node" + to_string(n) + "/cpulist");
+            string cpus;
+            if (cpulist && getline(cpulist, cpus) && parse_cpu_list(cpus).size()) topo->node_cpus.push_back(parse_cpu_list(cpus));
+        }
+    }
+    if (topo->node_cpus.empty()){
+        vector<unsigned int> cpus;
+        for (unsigned int c = 0; c < max(1u, thread::hardware_concurrency()); c++) cpus.push_back(c);
+        topo->node_cpus.push_back(cpus);
+    }
+
+    if (numa_nodes > 0){
+        vector<unsigned int> cpus;
+        for (unsigned int n = 0; n < topo->node_cpus.size(); n++) cpus.insert(cpus.end(), topo->node_cpus[n].begin(), topo->node_cpus[n].end());
+        topo->node_cpus.assign(numa_nodes, vector<unsigned int>());
+        for (unsigned int n = 0; n < numa_nodes; n++){
+            size_t begin = cpus.size() * n / numa_nodes;
+            size_t end = cpus.size() * (n + 1) / numa_nodes;
+            if (begin == end) topo->node_cpus[n].push_back(cpus[n % cpus.size()]);
+            for (size_t c = begin; c < end; c++) topo->node_cpus[n].push_back(cpus[c]);
+        }
+    }
+}
+
+int open_node_counter(unsigned long long result){
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_NODE | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+unsigned long long read_counter(int fd){
+    unsigned long long count = 0;
+    if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) return 0;
+    return count;
+}
+
+void cpu_thread_pool_worker(Cpu_thread_pool* pool, unsigned int t){
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(pool->thread2cpu[t], &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+
+    int loads_fd = open_node_counter(PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+    int misses_fd = open_node_counter(PERF_COUNT_HW_CACHE_RESULT_MISS);
+    unsigned long long seen_job_id = 0;
+
+    {
+        unique_lock<mutex> lk(pool->m);
+        if (loads_fd < 0 || misses_fd < 0) pool->perf_available = false;
+        if (--pool->running == 0) pool->done_cv.notify_all();
+    }
+
+    while (true){
+        unique_lock<mutex> lk(pool->m);
+        pool->job_cv.wait(lk, [&]{ return pool->stop || pool->job_id != seen_job_id; });
+        if (pool->stop) break;
+        seen_job_id = pool->job_id;
+        lk.unlock();
+
+        unsigned long long loads = read_counter(loads_fd);
+        unsigned long long misses = read_counter(misses_fd);
+        pool->job(t);
+        pool->node_loads[t] += read_counter(loads_fd) - loads;
+        pool->node_load_misses[t] += read_counter(misses_fd) - misses;
+
+        lk.lock();
+        if (--pool->running == 0) pool->done_cv.notify_all();
+    }
+
+    if (loads_fd >= 0) close(loads_fd);
+    if (misses_fd >= 0) close(misses_fd);
+}
+
+void init_cpu_thread_pool(Cpu_thread_pool* pool, unsigned int num_threads, unsigned int numa_nodes){
+    Cpu_topology topo;
+    read_cpu_topology(&topo, numa_nodes);
+
+    unsigned int total_cpus = 0;
+    for (unsigned int n = 0; n < topo.node_cpus.size(); n++) total_cpus += topo.node_cpus[n].size();
+
+    pool->num_threads = max(1u, num_threads);
+    pool->thread2node.resize(pool->num_threads);
+    pool->thread2cpu.resize(pool->num_threads);
+    pool->node_thread_start.assign(1, 0);
+
+    // Nodes that end up without threads (fewer threads than nodes) are dropped.
+    unsigned int acc_cpus = 0;
+    pool->node_num = 0;
+    for (unsigned int n = 0; n < topo.node_cpus.size(); n++){
+        acc_cpus += topo.node_cpus[n].size();
+        unsigned int begin = pool->node_thread_start[pool->node_num];
+        unsigned int end = (unsigned long long)pool->num_threads * acc_cpus / total_cpus;
+        if (end == begin) continue;
+        for (unsigned int t = begin; t < end; t++){
+            pool->thread2node[t] = pool->node_num;
+            pool->thread2cpu[t] = topo.node_cpus[n][(t - begin) % topo.node_cpus[n].size()];
+        }
+        pool->node_thread_start.push_back(end);
+        pool->node_num++;
+    }
+
+    pool->job_id = 0;
+    pool->stop = false;
+    pool->perf_available = true;
+    pool->node_loads.assign(pool->num_threads, 0);
+    pool->node_load_misses.assign(pool->num_threads, 0);
+    pool->running = pool->num_threads;
+    for (unsigned int t = 0; t < pool->num_threads; t++) pool->workers.push_back(thread(cpu_thread_pool_worker, pool, t));
+
+    unique_lock<mutex> lk(pool->m);
+    pool->done_cv.wait(lk, [&]{ return pool->running == 0; });
+}
+
+// Runs job(t) on every worker t and returns when all of them have finished.
+void run_cpu_thread_pool(Cpu_thread_pool* pool, function<void(unsigned int)> job){
+    unique_lock<mutex> lk(pool->m);
+    pool->job = job;
+    pool->running = pool->num_threads;
+    pool->job_id++;
+    pool->job_cv.notify_all();
+    pool->done_cv.wait(lk, [&]{ return pool->running == 0; });
+}
+
+void destroy_cpu_thread_pool(Cpu_thread_pool* pool){
+    {
+        unique_lock<mutex> lk(pool->m);
+        pool->stop = true;
+        pool->job_cv.notify_all();
+    }
+    for (unsigned int t = 0; t < pool->workers.size(); t++) pool->workers[t].join();
+    pool->workers.clear();
+}
+
+// Anonymous mapping that is not touched before it is returned, so the first write decides the page's node.
+void* alloc_untouched(size_t bytes){
+    void* ptr = mmap(NULL, max(bytes, (size_t)1), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED){
+        cout << "mmap of " << bytes << " bytes failed" << endl;
+        exit(1);
+    }
+    return ptr;
+}
+
+// Queries the node of up to 4096 evenly spaced pages of [ptr, ptr+bytes) and prints the share per node.
+void print_numa_placement(const string& name, const void* ptr, size_t bytes){
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t page_num = (bytes + page_size - 1) / page_size;
+    size_t sample_num = min(page_num, (size_t)4096);
+    vector<void*> pages(sample_num);
+    vector<int> status(sample_num, -1);
+    for (size_t s = 0; s < sample_num; s++) pages[s] = (char*)ptr + (page_num * s / sample_num) * page_size;
+
+    map<int, size_t> node_pages;
+    if (sample_num == 0 || syscall(__NR_move_pages, 0, sample_num, pages.data(), NULL, status.data(), 0) != 0) node_pages[-1] = sample_num;
+    else for (size_t s = 0; s < sample_num; s++) node_pages[status[s] >= 0 ? status[s] : -1]++;
+
+    cout << name;
+    for (map<int, size_t>::iterator it = node_pages.begin(); it != node_pages.end(); it++){
+        if (it->first < 0) cout << "unknown ";
+        else cout << "node" << it->first << " ";
+        cout << 100.0 * it->second / max(sample_num, (size_t)1) << "%  ";
+    }
+    cout << endl;
+}
+
+void print_remote_access_ratio(Cpu_thread_pool* pool){
+    unsigned long long loads = 0;
+    unsigned long long misses = 0;
+    for (unsigned int t = 0; t < pool->num_threads; t++){
+        loads += pool->node_loads[t];
+        misses += pool->node_load_misses[t];
+    }
+    cout << "Remote access ratio              : ";
+    if (!pool->perf_available || loads == 0) cout << "n/a (node-loads perf counters unavailable)" << endl;
+    else cout << 100.0 * misses / loads << "% (" << misses << " / " << loads << " node loads)" << endl;
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef CPU_TIERED_STORAGE_H
+#define CPU_TIERED_STORAGE_H
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "common_struct.h"
+#include "cpu_mascot_sgd_kernel.h"
+using namespace std;
+
+// Tiered storage of the grouped parameters of -v 11 (-tb). Hot groups stay on the heap. Cold groups are fp16
+// rows in a shared mapping of a file (-tf) that is unlinked once it is mapped. The kernel pages them in on
+// access and writes them back when they are dropped. group_ptr of a cold group points into the mapping, so the
+// update loop, the evaluation and the checkpoints read and write it like any other group. Every group has a
+// page-aligned fp16 slot in the file; fp32 groups (widened by the precision switching) are always hot.
+//
+// The plan keeps the fp16 groups with the most accesses per byte hot within the budget, after the fp32 groups.
+// Every epoch visits each rating once, so the accesses of a group per epoch are its ratings, counted once from R
+// rather than in the update loop. The plan is redone after every precision switch, which grows the hot set.
+struct Tiered_storage{
+    size_t budget;                          // bytes of grouped parameters kept on the heap
+    int fd;
+    char* base;
+    size_t file_bytes;
+    vector<size_t> slot[2];                 // offset in the file of each user (0) and item (1) group
+    vector<unsigned long long> accesses[2];
+    vector<unsigned char> cold[2];
+    size_t hot_bytes;
+    size_t max_resident;                    // hot bytes plus resident cold pages, after an epoch
+    size_t max_trimmed_resident;            // the same after the cold pages were paged out
+    unsigned int promotions;
+    unsigned int demotions;
+    size_t promoted_bytes;
+    size_t demoted_bytes;
+    double exec_time;
+};
+
+inline void** tiered_group_ptr(SGD* sgd_info, int side){
+    return side ? sgd_info->item_group_ptr : sgd_info->user_group_ptr;
+}
+
+inline unsigned char* tiered_group_prec(Mf_info* mf_info, int side){
+    return side ? mf_info->item_group_prec_info : mf_info->user_group_prec_info;
+}
+
+inline size_t tiered_group_bytes(Mf_info* mf_info, int side, unsigned int g){
+    unsigned int size = side ? mf_info->item_group_size[g] : mf_info->user_group_size[g];
+    return (size_t)size * mf_info->params.k * (tiered_group_prec(mf_info, side)[g] ? sizeof(float) : sizeof(unsigned short));
+}
+
+// Writes the dirty pages of a slot back and drops them from the process and the page cache. Reclaim doesn't
+// write dirty file pages from madvise, so they are synced first and the clean pages are then released.
+inline void page_out_slot(Tiered_storage* ts, size_t offset, size_t bytes){
+    if (bytes == 0) return;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t span = (bytes + page - 1) / page * page;
+    msync(ts->base + offset, span, MS_SYNC);
+    madvise(ts->base + offset, span, MADV_DONTNEED);
+    posix_fadvise(ts->fd, offset, span, POSIX_FADV_DONTNEED);
+}
+
+void demote_group(Tiered_storage* ts, Mf_info* mf_info, SGD* sgd_info, int side, unsigned int g){
+    void** group_ptr = tiered_group_ptr(sgd_info, side);
+    size_t bytes = tiered_group_bytes(mf_info, side, g);
+    char* dst = ts->base + ts->slot[side][g];
+    memcpy(dst, group_ptr[g], bytes);
+    delete [] (unsigned short*)group_ptr[g];
+    group_ptr[g] = dst;
+    page_out_slot(ts, ts->slot[side][g], bytes);
+    ts->cold[side][g] = 1;
+    ts->hot_bytes -= bytes;
+    ts->demotions++;
+    ts->demoted_bytes += bytes;
+}
+
+void promote_group(Tiered_storage* ts, Mf_info* mf_info, SGD* sgd_info, int side, unsigned int g){
+    void** group_ptr = tiered_group_ptr(sgd_info, side);
+    size_t bytes = tiered_group_bytes(mf_info, side, g);
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t span = (bytes + page - 1) / page * page;
+    unsigned short* group = new unsigned short[bytes / sizeof(unsigned short)];
+    madvise(ts->base + ts->slot[side][g], span, MADV_WILLNEED);
+    memcpy(group, group_ptr[g], bytes);
+    group_ptr[g] = group;
+    // The heap copy is the only live one now; the slot is reused if the group is demoted again.
+    madvise(ts->base + ts->slot[side][g], span, MADV_DONTNEED);
+    ts->cold[side][g] = 0;
+    ts->hot_bytes += bytes;
+    ts->promotions++;
+    ts->promoted_bytes += bytes;
+}
+
+// Chooses the hot groups for the current precisions and moves the groups whose tier changed, demotions first so
+// that the heap never holds more than the budget plus one group.
+void plan_tiers(Tiered_storage* ts, Mf_info* mf_info, SGD* sgd_info){
+    std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+    unsigned int group_num[2] = {(unsigned int)mf_info->params.user_group_num, (unsigned int)mf_info->params.item_group_num};
+    size_t fixed_bytes = 0;
+    vector<pair<double, unsigned int>> candidates;      // accesses per byte, side * user_group_num + group
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < group_num[side]; g++){
+            size_t bytes = tiered_group_bytes(mf_info, side, g);
+            if (tiered_group_prec(mf_info, side)[g]) fixed_bytes += bytes;
+            else candidates.push_back(make_pair(-(double)ts->accesses[side][g] / max(bytes, (size_t)1), side * group_num[0] + g));
+        }
+    stable_sort(candidates.begin(), candidates.end());
+
+    vector<unsigned char> want_cold[2] = {vector<unsigned char>(group_num[0], 0), vector<unsigned char>(group_num[1], 0)};
+    size_t hot_bytes = fixed_bytes;
+    for (size_t c = 0; c < candidates.size(); c++){
+        int side = candidates[c].second >= group_num[0];
+        unsigned int g = candidates[c].second - side * group_num[0];
+        size_t bytes = tiered_group_bytes(mf_info, side, g);
+        if (hot_bytes + bytes <= ts->budget) hot_bytes += bytes;
+        else want_cold[side][g] = 1;
+    }
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < group_num[side]; g++)
+            if (want_cold[side][g] && !ts->cold[side][g]) demote_group(ts, mf_info, sgd_info, side, g);
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < group_num[side]; g++)
+            if (!want_cold[side][g] && ts->cold[side][g]) promote_group(ts, mf_info, sgd_info, side, g);
+    // Widened groups grew on the heap since the last plan.
+    ts->hot_bytes = 0;
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < group_num[side]; g++)
+            if (!ts->cold[side][g]) ts->hot_bytes += tiered_group_bytes(mf_info, side, g);
+    ts->exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+}
+
+// Maps the backing file and demotes the groups that don't fit in the budget. The groups must be on the heap in
+// fp16 or fp32, as cpy2grouped_parameters_cpu and restore_grouped_parameters_cpu leave them.
+bool init_tiered_storage(Tiered_storage* ts, Mf_info* mf_info, SGD* sgd_info, const Cpu_group_layout* user_layout,
+                         const Cpu_group_layout* item_layout, size_t budget, const string& path){
+    std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+    unsigned int group_num[2] = {(unsigned int)mf_info->params.user_group_num, (unsigned int)mf_info->params.item_group_num};
+    size_t page = sysconf(_SC_PAGESIZE);
+    ts->budget = budget;
+    ts->file_bytes = 0;
+    ts->hot_bytes = 0;
+    for (int side = 0; side < 2; side++){
+        unsigned int* group_size = side ? mf_info->item_group_size : mf_info->user_group_size;
+        ts->slot[side].resize(group_num[side]);
+        ts->cold[side].assign(group_num[side], 0);
+        ts->accesses[side].assign(group_num[side], 0);
+        for (unsigned int g = 0; g < group_num[side]; g++){
+            ts->slot[side][g] = ts->file_bytes;
+            ts->file_bytes += ((size_t)group_size[g] * mf_info->params.k * sizeof(unsigned short) + page - 1) / page * page;
+            ts->hot_bytes += tiered_group_bytes(mf_info, side, g);
+        }
+    }
+    for (unsigned int j = 0; j < mf_info->n; j++){
+        ts->accesses[0][user_layout->sorted_idx2group[mf_info->R[j].u]]++;
+        ts->accesses[1][item_layout->sorted_idx2group[mf_info->R[j].i]]++;
+    }
+
+    // The file is created fresh and unlinked once mapped, so an existing file is never truncated or removed.
+    ts->fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (ts->fd < 0 || ftruncate(ts->fd, ts->file_bytes) != 0){
+        cout << "fail to create the cold group file " << path << ": " << strerror(errno) << endl;
+        if (ts->fd >= 0){
+            close(ts->fd);
+            unlink(path.c_str());
+        }
+        return false;
+    }
+    ts->base = (char*)mmap(NULL, ts->file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, ts->fd, 0);
+    unlink(path.c_str());
+    if (ts->base == MAP_FAILED){
+        cout << "fail to map the cold group file " << path << ": " << strerror(errno) << endl;
+        close(ts->fd);
+        return false;
+    }
+    // Cold rows are read one at a time in rating order; readahead would only page in more cold rows.
+    madvise(ts->base, ts->file_bytes, MADV_RANDOM);
+
+    ts->max_resident = 0;
+    ts->max_trimmed_resident = 0;
+    ts->promotions = 0;
+    ts->demotions = 0;
+    ts->promoted_bytes = 0;
+    ts->demoted_bytes = 0;
+    ts->exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+    plan_tiers(ts, mf_info, sgd_info);
+    ts->demotions = 0;
+    ts->demoted_bytes = 0;
+    return true;
+}
+
+// The precision switching widens fp16 groups on the heap; cold groups it is about to widen come back first.
+void promote_groups_to_widen(Tiered_storage* ts, Mf_info* mf_info, SGD* sgd_info){
+    std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+    for (int side = 0; side < 2; side++){
+        unsigned int group_num = side ? mf_info->params.item_group_num : mf_info->params.user_group_num;
+        float* group_error = side ? mf_info->item_group_error : mf_info->user_group_error;
+        for (unsigned int g = 0; g < group_num; g++)
+            if (ts->cold[side][g] && group_error[g] > mf_info->params.error_threshold) promote_group(ts, mf_info, sgd_info, side, g);
+    }
+    ts->exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+}
+
+size_t resident_cold_bytes(Tiered_storage* ts){
+    size_t page = sysconf(_SC_PAGESIZE);
+    vector<unsigned char> vec((ts->file_bytes + page - 1) / page);
+    if (ts->file_bytes == 0 || mincore(ts->base, ts->file_bytes, vec.data()) != 0) return 0;
+    size_t pages = 0;
+    for (size_t j = 0; j < vec.size(); j++) pages += vec[j] & 1;
+    return pages * page;
+}
+
+// After an epoch: every cold row was paged in by the epoch, so the cold pages are paged out again and the
+// resident memory before and after is recorded.
+void trim_tiered_storage(Tiered_storage* ts, Mf_info* mf_info){
+    std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+    ts->max_resident = max(ts->max_resident, ts->hot_bytes + resident_cold_bytes(ts));
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < ts->cold[side].size(); g++)
+            if (ts->cold[side][g]) page_out_slot(ts, ts->slot[side][g], tiered_group_bytes(mf_info, side, g));
+    ts->max_trimmed_resident = max(ts->max_trimmed_resident, ts->hot_bytes + resident_cold_bytes(ts));
+    ts->exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+}
+
+// Brings every group back to the heap for what follows training (early stopping, the flat copy of the model)
+// and unmaps the file.
+void release_tiered_storage(Tiered_storage* ts, Mf_info* mf_info, SGD* sgd_info){
+    unsigned int cold_groups[2] = {0, 0};
+    size_t cold_bytes = 0;
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < ts->cold[side].size(); g++)
+            if (ts->cold[side][g]){
+                cold_groups[side]++;
+                cold_bytes += tiered_group_bytes(mf_info, side, g);
+            }
+    size_t hot_bytes = ts->hot_bytes;
+    unsigned int promotions = ts->promotions;
+    size_t promoted_bytes = ts->promoted_bytes;
+    for (int side = 0; side < 2; side++)
+        for (unsigned int g = 0; g < ts->cold[side].size(); g++)
+            if (ts->cold[side][g]) promote_group(ts, mf_info, sgd_info, side, g);
+    munmap(ts->base, ts->file_bytes);
+    close(ts->fd);
+
+    cout << "\n<Tiered storage>" << endl;
+    cout << "Budget (bytes)                   : " << ts->budget << endl;
+    cout << "Hot bytes at the end             : " << hot_bytes << endl;
+    cout << "Cold groups (user/item)          : " << cold_groups[0] << " / " << cold_groups[1] << " (" << cold_bytes << " bytes in " << ts->file_bytes << ")" << endl;
+    cout << "Max resident after an epoch      : " << ts->max_resident << endl;
+    cout << "Max resident after paging out    : " << ts->max_trimmed_resident << endl;
+    cout << "Promotions / demotions           : " << promotions << " / " << ts->demotions << endl;
+    cout << "Bytes promoted / demoted         : " << promoted_bytes << " / " << ts->demoted_bytes << endl;
+    cout << "Tiering time                     : " << ts->exec_time << endl;
+}
+
+#endif
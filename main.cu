@@ -1,176 +1,422 @@
-#include <iostream>
-#include <sys/stat.h>
-#include "common_struct.h"
-#include "io_utils.h"
-#include "model_init.h"
-#include "mf_methods.h"
-using namespace std;
-
-// Helper functions to check if file exists
-bool exists (const std::string& name) {
-    struct stat buffer;   
-    return (stat(name.c_str(), &buffer) == 0); 
-}
-
-int main (int argc, const char* argv[]){
-    string infile = "";
-    string outfile = "";
-    string testfile = "None";
-    float lambda = 0.015;
-    float alpha = 0.01f;
-    float decay = 0.1f;
-    float sample_ratio = 0.01f;
-    float error_threshold = 0.001f;
-    unsigned int k = 128;
-    unsigned int iteration = 50;
-    unsigned int work_groups = 2048;
-    unsigned int thread_block_size = 128;
-    unsigned int user_group_num = 10;
-    unsigned int item_group_num = 10;
-    unsigned int version = 7;
-    unsigned int interval = 1;
-    unsigned int reconst_save = 0;
-
-    if(argc < 2){
-        cout << argv[0] << " [-t <threads> -p <predictions/user> -o <output-tsv>] <input-tsv>" << endl;
-        return(0);
-    }else if(argc == 2){    
-        infile = string(argv[1]);
-    }else{
-        for(int i = 0; i < argc; i++){
-        
-            if(string(argv[i]) == "-i" && i < argc-1){
-                infile = string(argv[i+1]);
-            }
-            if(string(argv[i]) == "-o" && i < argc-1){
-                outfile = string(argv[i+1]);
-            }
-            if(string(argv[i]) == "-y" && i < argc-1){
-                testfile = string(argv[i+1]);
-            }
-            if(string(argv[i]) == "-l" && i < argc-1){
-                iteration = atoi(argv[i+1]);
-            }
-            if(string(argv[i]) == "-k" && i < argc-1){
-                k = atoi(argv[i+1]);
-            }
-            if(string(argv[i]) == "-b" && i < argc-1){
-                lambda = atof(argv[i+1]);
-            }
-            if(string(argv[i]) == "-a" && i < argc-1){
-                alpha = atof(argv[i+1]);
-            }           
-            if(string(argv[i]) == "-wg" && i < argc-1){
-                work_groups = atoi(argv[i+1]);
-            }
-            if(string(argv[i]) == "-d" && i < argc-1){
-                decay = atof(argv[i+1]);
-            }
-            if(string(argv[i]) == "-bl" && i < argc-1){
-                thread_block_size = atoi(argv[i+1]);
-            }
-            if(string(argv[i]) == "-v" && i < argc-1){
-                version = atoi(argv[i+1]);
-            }      
-            if(string(argv[i]) == "-r" && i < argc-1){
-                sample_ratio = atof(argv[i+1]);
-            }    
-            if(string(argv[i]) == "-ug" && i < argc-1){
-                user_group_num = atoi(argv[i+1]);
-            }
-            if(string(argv[i]) == "-ig" && i < argc-1){
-                item_group_num = atoi(argv[i+1]);
-            }      
-            if(string(argv[i]) == "-e" && i < argc-1){
-                error_threshold = atof(argv[i+1]);
-            }    
-            if(string(argv[i]) == "-s" && i < argc-1){
-                sample_ratio = atof(argv[i+1]);
-            }          
-            if(string(argv[i]) == "-it" && i < argc-1){
-                interval = atoi(argv[i+1]);
-            }    
-            if(string(argv[i]) == "-rc" && i < argc-1){
-                reconst_save = atoi(argv[i+1]);
-            }                
-            if(string(argv[i]) == "-h"){
-                cout << argv[0] << " [-t <threads> -p <predictions/user> -o <output-tsv>] <input-tsv>" << endl;
-                return(0);
-            }
-        }
-    }
-
-    if(!exists(infile)){
-        cout << infile << " doesn't exist!" << endl;
-        return(0);
-    }
-
-    cout << endl;
-    cout << "Input file                  : " << infile << endl;
-    cout << "Test file                   : " << testfile << endl;
-    cout << "Output file                 : " << outfile << endl;
-    cout << "Latent features             : " << k << endl;
-    cout << "Learning rate               : " << alpha << endl;
-    cout << "Decay                       : " << decay << endl;
-    cout << "Lambda                      : " << lambda << endl;
-	cout << "Iteration                   : " << iteration << endl;
-    cout << "Num of workers              : " << work_groups << endl;
-    cout << "Thread block size           : " << thread_block_size << endl;
-    cout << "Sample ratio                : " << sample_ratio << endl;
-    cout << "Error threshold             : " << error_threshold << endl;
-    cout << "Interval                    : " << interval << endl;
-    
-    SGD sgd_model;
-    Mf_info mf_info;
-
-    read_training_dataset(&mf_info, infile);
-    read_test_dataset(&mf_info, testfile);
-
-    cout << "The number of nonzeros      : " << mf_info.n << endl;
-    cout << "The number of users         : " << mf_info.max_user << endl;
-    cout << "The number of items         : " << mf_info.max_item << endl;
-    cout << "The number of test nonzeros : " << mf_info.test_n << endl;
-
-    mf_info.params.k = k;
-    mf_info.params.learning_rate = alpha;
-    mf_info.params.decay = decay;
-    mf_info.params.lambda = lambda;
-    mf_info.params.num_workers = work_groups;
-    mf_info.params.mean_val = 0;
-    mf_info.params.std_val = 0.1;
-    mf_info.params.epoch = iteration; 
-    mf_info.params.thread_block_size = thread_block_size;
-    mf_info.params.user_group_num = user_group_num;
-    mf_info.params.item_group_num = item_group_num;
-    mf_info.params.sample_ratio = sample_ratio;
-    mf_info.version = version;
-    mf_info.params.error_threshold = error_threshold;
-    mf_info.params.interval = interval;
-
-    if (infile.find("Yahoo") != string::npos) mf_info.is_yahoo = true;
-
-    if (version != 7 && version != 8 && version != 4) init_model_single(&mf_info, &sgd_model);
-    else init_model_half(&mf_info, &sgd_model);
-
-    if (version == 1) mascot_training_mf(&mf_info, &sgd_model);
-    else if (version == 2) adaptive_fixed_point_training_mf(&mf_info, &sgd_model);
-    else if (version == 3) muppet_training_mf(&mf_info, &sgd_model);
-    else if (version == 4) mixed_precision_training_mf(&mf_info, &sgd_model);
-    else if (version == 5) training_single_mf(&mf_info, &sgd_model);
-    else if (version == 6) mascot_training_mf_naive(&mf_info, &sgd_model);
-    else if (version == 7) training_mem_quant_mf(&mf_info, &sgd_model);
-    else if (version == 8) training_switching_only(&mf_info, &sgd_model);
-    if (outfile != "") {
-        if (version == 1) save_trained_model_reconst(&mf_info, &sgd_model, outfile);
-        else save_trained_model(&mf_info, &sgd_model, outfile);
-    }
-
-    if (version == 1 && reconst_save == 1) save_reconst_testset(&mf_info, testfile);
-    
-    cudaFree(sgd_model.d_p);
-    cudaFree(sgd_model.d_q);
-    cudaFree(sgd_model.d_half_p);
-    cudaFree(sgd_model.d_half_q);
-    
-    return 0;
+#include <iostream>
+#include <sys/stat.h>
+#include <thread>
+#include <chrono>
+#include "common_struct.h"
+#include "io_utils.h"
+#include "model_init.h"
+#include "mf_methods.h"
+using namespace std;
+
+// Helper functions to check if file exists
+bool exists (const std::string& name) {
+    struct stat buffer;   
+    return (stat(name.c_str(), &buffer) == 0); 
+}
+
+int main (int argc, const char* argv[]){
+    string infile = "";
+    string outfile = "";
+    string testfile = "None";
+    float lambda = 0.015;
+    float alpha = 0.01f;
+    float decay = 0.1f;
+    float sample_ratio = 0.01f;
+    float error_threshold = 0.001f;
+    unsigned int k = 128;
+    unsigned int iteration = 50;
+    unsigned int work_groups = 2048;
+    unsigned int thread_block_size = 128;
+    unsigned int user_group_num = 10;
+    unsigned int item_group_num = 10;
+    unsigned int version = 7;
+    unsigned int interval = 1;
+    unsigned int reconst_save = 0;
+    unsigned int num_threads = thread::hardware_concurrency();
+    unsigned int user_batch_size = 16;
+    unsigned int prefetch_distance = 8;
+    unsigned int interleave = 4;
+    unsigned int numa_nodes = 0;
+    unsigned int replica_sync = 4;
+    unsigned int merge_interval = 8192;
+    float target_contention = 0.01f;
+    unsigned int train_loss = 0;
+    unsigned int eval_interval = 1;
+    float eval_sample_ratio = 0;
+    unsigned int patience = 0;
+    float min_delta = 0.0001f;
+    float valid_ratio = 0.02f;
+    string validfile = "";
+    string snapshot_name = "";
+    unsigned int snapshot_interval = 0;
+    string deltafile = "";
+    string modelfile = "";
+    float replay_ratio = 1.0f;
+    float reference_rmse = 0;
+    float rmse_epsilon = 0.001f;
+    string checkpoint_path = "";
+    string resume_path = "";
+    unsigned int checkpoint_interval = 1;
+    float checkpoint_delta_threshold = -1;
+    unsigned int checkpoint_full_interval = 8;
+    float tier_budget_mb = 0;
+    string tier_path = "mascot_cold_groups.bin";
+    float precision_budget_mb = 0;
+    unsigned int precision_plan_proxy = 0;
+    float int8_group_ratio = 0;
+    unsigned int half_format = 0;
+
+    if(argc < 2){
+        cout << argv[0] << " [-t <threads> -p <predictions/user> -o <output-tsv>] <input-tsv>" << endl;
+        return(0);
+    }else if(argc == 2){    
+        infile = string(argv[1]);
+    }else{
+        for(int i = 0; i < argc; i++){
+        
+            if(string(argv[i]) == "-i" && i < argc-1){
+                infile = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-o" && i < argc-1){
+                outfile = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-y" && i < argc-1){
+                testfile = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-l" && i < argc-1){
+                iteration = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-k" && i < argc-1){
+                k = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-b" && i < argc-1){
+                lambda = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-a" && i < argc-1){
+                alpha = atof(argv[i+1]);
+            }           
+            if(string(argv[i]) == "-wg" && i < argc-1){
+                work_groups = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-d" && i < argc-1){
+                decay = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-bl" && i < argc-1){
+                thread_block_size = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-v" && i < argc-1){
+                version = atoi(argv[i+1]);
+            }      
+            if(string(argv[i]) == "-r" && i < argc-1){
+                sample_ratio = atof(argv[i+1]);
+            }    
+            if(string(argv[i]) == "-ug" && i < argc-1){
+                user_group_num = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-ig" && i < argc-1){
+                item_group_num = atoi(argv[i+1]);
+            }      
+            if(string(argv[i]) == "-e" && i < argc-1){
+                error_threshold = atof(argv[i+1]);
+            }    
+            if(string(argv[i]) == "-s" && i < argc-1){
+                sample_ratio = atof(argv[i+1]);
+            }          
+            if(string(argv[i]) == "-it" && i < argc-1){
+                interval = atoi(argv[i+1]);
+            }    
+            if(string(argv[i]) == "-rc" && i < argc-1){
+                reconst_save = atoi(argv[i+1]);
+            }                
+            if(string(argv[i]) == "-t" && i < argc-1){
+                num_threads = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-ub" && i < argc-1){
+                user_batch_size = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-pd" && i < argc-1){
+                prefetch_distance = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-il" && i < argc-1){
+                interleave = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-nn" && i < argc-1){
+                numa_nodes = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-rs" && i < argc-1){
+                replica_sync = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-cr" && i < argc-1){
+                target_contention = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-mi" && i < argc-1){
+                merge_interval = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-tl" && i < argc-1){
+                train_loss = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-ei" && i < argc-1){
+                eval_interval = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-es" && i < argc-1){
+                eval_sample_ratio = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-pa" && i < argc-1){
+                patience = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-md" && i < argc-1){
+                min_delta = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-vs" && i < argc-1){
+                valid_ratio = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-vf" && i < argc-1){
+                validfile = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-sn" && i < argc-1){
+                snapshot_name = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-sp" && i < argc-1){
+                snapshot_interval = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-dl" && i < argc-1){
+                deltafile = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-im" && i < argc-1){
+                modelfile = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-rr" && i < argc-1){
+                replay_ratio = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-rf" && i < argc-1){
+                reference_rmse = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-ep" && i < argc-1){
+                rmse_epsilon = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-cp" && i < argc-1){
+                checkpoint_path = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-ci" && i < argc-1){
+                checkpoint_interval = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-cd" && i < argc-1){
+                checkpoint_delta_threshold = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-cf" && i < argc-1){
+                checkpoint_full_interval = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-tb" && i < argc-1){
+                tier_budget_mb = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-tf" && i < argc-1){
+                tier_path = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-pb" && i < argc-1){
+                precision_budget_mb = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-ps" && i < argc-1){
+                precision_plan_proxy = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-i8" && i < argc-1){
+                int8_group_ratio = atof(argv[i+1]);
+            }
+            if(string(argv[i]) == "-hf" && i < argc-1){
+                half_format = atoi(argv[i+1]);
+            }
+            if(string(argv[i]) == "-rm" && i < argc-1){
+                resume_path = string(argv[i+1]);
+            }
+            if(string(argv[i]) == "-h"){
+                cout << argv[0] << " [-t <threads> -p <predictions/user> -o <output-tsv>] <input-tsv>" << endl;
+                return(0);
+            }
+        }
+    }
+
+    if(!exists(infile)){
+        cout << infile << " doesn't exist!" << endl;
+        return(0);
+    }
+    if((checkpoint_path != "" || resume_path != "") && ((version != 1 && version != 11) || deltafile != "")){
+        cout << "Checkpoints (-cp, -rm) are supported by -v 1 and -v 11 without -dl" << endl;
+        return(0);
+    }
+    if(resume_path != "" && !exists(resume_path)){
+        cout << resume_path << " doesn't exist!" << endl;
+        return(0);
+    }
+    if((patience > 0 || validfile != "") && (version < 9 || version > 12 || deltafile != "")){
+        cout << "Early stopping (-pa, -vf) is supported by -v 9 to -v 12 without -dl" << endl;
+        return(0);
+    }
+    if(validfile != "" && (patience == 0 || !exists(validfile))){
+        cout << "A validation file (-vf) needs early stopping (-pa) and an existing file" << endl;
+        return(0);
+    }
+    if(tier_budget_mb > 0 && (version != 11 || deltafile != "" || snapshot_name != "")){
+        cout << "Tiered storage (-tb) is supported by -v 11 without -dl and -sn" << endl;
+        return(0);
+    }
+    if(precision_budget_mb > 0 && (version != 11 || tier_budget_mb > 0)){
+        cout << "Precision planning (-pb) is supported by -v 11 without -tb" << endl;
+        return(0);
+    }
+    if(int8_group_ratio > 0 && (version != 11 || deltafile != "" || tier_budget_mb > 0)){
+        cout << "int8 groups (-i8) are supported by -v 11 without -dl and -tb" << endl;
+        return(0);
+    }
+    if(half_format > 0 && (version != 11 || deltafile != "" || tier_budget_mb > 0 || precision_budget_mb > 0)){
+        cout << "bf16 groups (-hf) are supported by -v 11 without -dl, -tb and -pb" << endl;
+        return(0);
+    }
+    if(deltafile != "" && (version != 11 || !exists(deltafile) || !exists(modelfile))){
+        cout << "Incremental training (-dl) needs -v 11, the delta file and the model of the training set (-im)" << endl;
+        return(0);
+    }
+
+    cout << endl;
+    cout << "Input file                  : " << infile << endl;
+    cout << "Test file                   : " << testfile << endl;
+    cout << "Output file                 : " << outfile << endl;
+    cout << "Latent features             : " << k << endl;
+    cout << "Learning rate               : " << alpha << endl;
+    cout << "Decay                       : " << decay << endl;
+    cout << "Lambda                      : " << lambda << endl;
+	cout << "Iteration                   : " << iteration << endl;
+    cout << "Num of workers              : " << work_groups << endl;
+    cout << "Thread block size           : " << thread_block_size << endl;
+    cout << "Sample ratio                : " << sample_ratio << endl;
+    cout << "Error threshold             : " << error_threshold << endl;
+    cout << "Interval                    : " << interval << endl;
+    cout << "Num of CPU threads          : " << num_threads << endl;
+    if (checkpoint_path != "") cout << "Checkpoint / interval       : " << checkpoint_path << " / " << checkpoint_interval << endl;
+    if (checkpoint_path != "" && checkpoint_delta_threshold >= 0) cout << "Delta threshold / deltas    : " << checkpoint_delta_threshold << " / " << checkpoint_full_interval << endl;
+    if (resume_path != "") cout << "Resume from                 : " << resume_path << endl;
+    if (tier_budget_mb > 0) cout << "Tier budget (MB) / file     : " << tier_budget_mb << " / " << tier_path << endl;
+    if (int8_group_ratio > 0) cout << "int8 group ratio            : " << int8_group_ratio << endl;
+    if (half_format > 0) cout << "16-bit group format         : " << (half_format == 1 ? "bf16" : "fp16, bf16 for groups out of its range") << endl;
+    if (precision_budget_mb > 0) cout << "Precision budget (MB)       : " << precision_budget_mb << (precision_plan_proxy ? " (degree)" : " (gradient diversity)") << endl;
+    if (deltafile != ""){
+        cout << "Delta file                  : " << deltafile << endl;
+        cout << "Base model                  : " << modelfile << endl;
+        cout << "Replay ratio                : " << replay_ratio << endl;
+    }
+    
+    SGD sgd_model;
+    Mf_info mf_info;
+
+    read_training_dataset(&mf_info, infile);
+    if (deltafile != "") read_delta_dataset(&mf_info, deltafile);
+    if (validfile != "" && patience > 0){
+        read_validation_dataset(&mf_info, validfile);
+        if (mf_info.valid_n == 0){
+            cout << validfile << " has no ratings of the users and items of the training set" << endl;
+            return(1);
+        }
+    }
+    read_test_dataset(&mf_info, testfile);
+
+    cout << "The number of nonzeros      : " << mf_info.n << endl;
+    cout << "The number of users         : " << mf_info.max_user << endl;
+    cout << "The number of items         : " << mf_info.max_item << endl;
+    cout << "The number of test nonzeros : " << mf_info.test_n << endl;
+
+    mf_info.params.k = k;
+    mf_info.params.learning_rate = alpha;
+    mf_info.params.decay = decay;
+    mf_info.params.lambda = lambda;
+    mf_info.params.num_workers = work_groups;
+    mf_info.params.mean_val = 0;
+    mf_info.params.std_val = 0.1;
+    mf_info.params.epoch = iteration; 
+    mf_info.params.thread_block_size = thread_block_size;
+    mf_info.params.user_group_num = user_group_num;
+    mf_info.params.item_group_num = item_group_num;
+    mf_info.params.sample_ratio = sample_ratio;
+    mf_info.version = version;
+    mf_info.params.error_threshold = error_threshold;
+    mf_info.params.interval = interval;
+    mf_info.params.num_threads = num_threads;
+    mf_info.params.user_batch_size = user_batch_size;
+    mf_info.params.prefetch_distance = prefetch_distance;
+    mf_info.params.interleave = interleave;
+    mf_info.params.numa_nodes = numa_nodes;
+    mf_info.params.replica_sync = replica_sync;
+    mf_info.params.merge_interval = merge_interval;
+    mf_info.params.target_contention = target_contention;
+    mf_info.params.train_loss = train_loss;
+    mf_info.params.eval_interval = eval_interval;
+    mf_info.params.eval_sample_ratio = eval_sample_ratio;
+    mf_info.params.patience = patience;
+    mf_info.params.min_delta = min_delta;
+    mf_info.params.valid_ratio = valid_ratio;
+    mf_info.params.snapshot_interval = snapshot_interval;
+    mf_info.snapshot_name = snapshot_name;
+    mf_info.params.replay_ratio = replay_ratio;
+    mf_info.params.reference_rmse = reference_rmse;
+    mf_info.params.rmse_epsilon = rmse_epsilon;
+    mf_info.params.checkpoint_interval = checkpoint_interval;
+    mf_info.params.checkpoint_delta_threshold = checkpoint_delta_threshold;
+    mf_info.params.checkpoint_full_interval = checkpoint_full_interval;
+    mf_info.params.tier_budget_mb = tier_budget_mb;
+    mf_info.tier_path = tier_path;
+    mf_info.params.precision_budget_mb = precision_budget_mb;
+    mf_info.params.precision_plan_proxy = precision_plan_proxy;
+    mf_info.params.int8_group_ratio = int8_group_ratio;
+    mf_info.params.half_format = half_format;
+    mf_info.checkpoint_path = checkpoint_path;
+    mf_info.resume_path = resume_path;
+
+    if (infile.find("Yahoo") != string::npos) mf_info.is_yahoo = true;
+
+    bool cpu_version = version >= 9;
+
+    if (cpu_version) init_model_single_cpu(&mf_info, &sgd_model);
+    else if (version != 7 && version != 8 && version != 4) init_model_single(&mf_info, &sgd_model);
+    else init_model_half(&mf_info, &sgd_model);
+
+    // Incremental runs start from the model of the training set; the delta's new entities keep their random rows.
+    if (deltafile != ""){
+        unsigned int user_rows, item_rows;
+        std::chrono::time_point<std::chrono::system_clock> model_load_start_point = std::chrono::system_clock::now();
+        if (!read_trained_model_rows(&mf_info, &sgd_model, modelfile, &user_rows, &item_rows)){
+            cout << "fail to read " << modelfile << " with k = " << k << endl;
+            return(0);
+        }
+        cout << "Base model rows (user/item) : " << user_rows << " / " << item_rows << " of " << mf_info.base_max_user << " / " << mf_info.base_max_item << endl;
+        cout << "Model load time (usec)      : " << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - model_load_start_point).count() << endl;
+    }
+
+    if (version == 1) mascot_training_mf(&mf_info, &sgd_model);
+    else if (version == 2) adaptive_fixed_point_training_mf(&mf_info, &sgd_model);
+    else if (version == 3) muppet_training_mf(&mf_info, &sgd_model);
+    else if (version == 4) mixed_precision_training_mf(&mf_info, &sgd_model);
+    else if (version == 5) training_single_mf(&mf_info, &sgd_model);
+    else if (version == 6) mascot_training_mf_naive(&mf_info, &sgd_model);
+    else if (version == 7) training_mem_quant_mf(&mf_info, &sgd_model);
+    else if (version == 8) training_switching_only(&mf_info, &sgd_model);
+    else if (version == 9) cpu_user_major_training_mf(&mf_info, &sgd_model);
+    else if (version == 10) cpu_hogwild_training_mf(&mf_info, &sgd_model);
+    else if (version == 11 && deltafile != "") cpu_incremental_training_mf(&mf_info, &sgd_model);
+    else if (version == 11) cpu_mascot_training_mf(&mf_info, &sgd_model);
+    else if (version == 12) cpu_contention_aware_training_mf(&mf_info, &sgd_model);
+    if (outfile != "") {
+        // Grouped versions evaluate on the groups directly; P and Q are only materialized for saving.
+        if (version == 1 || version == 6) cpy_grouped2flat_parameters_gpu(&mf_info, &sgd_model);
+        else if (version == 11) cpy_grouped2flat_parameters_cpu(&mf_info, &sgd_model);
+        if (version == 1) save_trained_model_reconst(&mf_info, &sgd_model, outfile);
+        else save_trained_model(&mf_info, &sgd_model, outfile);
+    }
+
+    if (version == 1 && reconst_save == 1) save_reconst_testset(&mf_info, testfile);
+    
+    if (!cpu_version){
+        cudaFree(sgd_model.d_p);
+        cudaFree(sgd_model.d_q);
+        cudaFree(sgd_model.d_half_p);
+        cudaFree(sgd_model.d_half_q);
+    }
+    
+    return 0;
 }
\ No newline at end of file
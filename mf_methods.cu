@@ -1,1562 +1,2346 @@
-#include <iostream>
-#include <string>
-#include <random>
-#include <curand.h>
-#include <chrono>
-#include <curand_kernel.h>
-#include <algorithm>
-#include <limits>
-#include <cuda_fp16.h>
-#include <thrust/host_vector.h>
-#include <thrust/device_vector.h>
-#include <thrust/sort.h>
-#include <iomanip>
-#include "common.h"
-#include "common_struct.h"
-#include "preprocess_utils.h"
-#include "model_init.h"
-#include "reduce_kernel.h"
-#include "afp_sgd_kernel.h"
-#include "afp_sgd_kernel_k64.h"
-#include "mascot_sgd_kernel.h"
-#include "mascot_sgd_kernel_k64.h"
-#include "muppet_sgd_kernel.h"
-#include "muppet_sgd_kernel_k64.h"
-#include "mpt_sgd_kernel.h"
-#include "mpt_sgd_kernel_k64.h"
-#include "sgd_kernel.h"
-#include "sgd_kernel_k64.h"
-#include "rmse.h"
-#include "precision_switching.h"
-
-using namespace std;
-
-extern __global__ void init_rand_state(curandState*state, int size);
-
-void mascot_training_mf(Mf_info* mf_info, SGD* sgd_info){
-    // Random shuffle rating matrix
-    srand(time(0)); 
-    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
-
-    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
-    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-    
-    // Testset format conversion
-    mf_info->test_COO = test_set_preprocess(mf_info);
-    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
-    gpuErr(cudaPeekAtLastError());
-    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
-
-    // Histogram
-    double rating_histogram_execution_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> rating_histogram_start_point = std::chrono::system_clock::now();
-    user_item_rating_histogram(mf_info);
-    rating_histogram_execution_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - rating_histogram_start_point).count();
-
-    // Grouping methods
-    double grouping_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> grouping_start_point = std::chrono::system_clock::now();
-    split_group_based_equal_size_not_strict_ret_end_idx(mf_info);
-    grouping_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - grouping_start_point).count();
-
-    // Matrix reconstruction
-    double reconst_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> reconst_start_point = std::chrono::system_clock::now();
-    matrix_reconstruction(mf_info);
-    reconst_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - reconst_start_point).count();
-    
-    // Random state initialization
-    curandState* d_rand_state;
-    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
-    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
-    cudaDeviceSynchronize();
-    gpuErr(cudaPeekAtLastError());
-
-    double cpy2grouped_parameters_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> cpy2grouped_parameters_start_point = std::chrono::system_clock::now();
-
-    // Group info allocation on host
-    cudaMallocHost(&sgd_info->user_group_d_ptr, sizeof(void*) * mf_info->params.user_group_num);
-    cudaMallocHost(&sgd_info->item_group_d_ptr, sizeof(void*) * mf_info->params.item_group_num);
-    cudaMallocHost(&sgd_info->user_group_ptr, sizeof(void*) * mf_info->params.user_group_num);
-    cudaMallocHost(&sgd_info->item_group_ptr, sizeof(void*) * mf_info->params.item_group_num);
-
-    // Group info allocation on device
-    cudaMalloc(&sgd_info->d_user_group_ptr, sizeof(void*) * mf_info->params.user_group_num);
-    cudaMalloc(&sgd_info->d_item_group_ptr, sizeof(void*) * mf_info->params.item_group_num);
-
-    // Copy grouped parameter from cpu to device    
-    cpy2grouped_parameters_gpu_for_comparison_indexing(mf_info, sgd_info);
-    cpy2grouped_parameters_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - cpy2grouped_parameters_start_point).count();
-
-    // Learning rate scheduling 
-    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
-    for (int i = 0; i < mf_info->params.epoch; i++){
-        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
-    }
-
-    // Variables initialization
-    unsigned int update_vector_size = 128;
-    unsigned int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
-    unsigned int sample_ratings_num = (float)(update_count * update_vector_size) * mf_info->params.sample_ratio;
-    unsigned int first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
-    unsigned int div = mf_info->params.thread_block_size/32;
-    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
-    unsigned int group_error_size = error_kernel_work_groups;
-    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
-    unsigned int seg_size = 32;
-    unsigned int block_num = mf_info->params.num_workers/div;
-    unsigned int start_idx = 5;
-    unsigned int num_workers_other_kernels = 10000;
-
-    float* d_e_group;
-    float *grad_sum_norm_p;
-    float *grad_sum_norm_q;
-    float *d_grad_sum_norm_p;
-    float *d_grad_sum_norm_q;
-    float *norm_sum_p;
-    float *norm_sum_q;
-    float *d_norm_sum_p;
-    float *d_norm_sum_q;
-
-    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
-    cudaMalloc(&(sgd_info->d_p), sizeof(float) * mf_info->max_user * mf_info->params.k);
-    cudaMalloc(&(sgd_info->d_q), sizeof(float) * mf_info->max_item * mf_info->params.k);
-
-    double additional_info_init_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
-
-    cudaMallocHost(&mf_info->user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num);
-    cudaMallocHost(&mf_info->item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num);
-    cudaMalloc(&mf_info->d_user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num);
-    cudaMalloc(&mf_info->d_item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num);
-    cudaMemset(mf_info->d_user_group_prec_info, 0, sizeof(unsigned char) * mf_info->params.user_group_num);
-    cudaMemset(mf_info->d_item_group_prec_info, 0, sizeof(unsigned char) * mf_info->params.item_group_num);
-    cudaMallocHost(&mf_info->user_group_error, sizeof(float) * mf_info->params.user_group_num);
-    cudaMallocHost(&mf_info->item_group_error, sizeof(float) * mf_info->params.item_group_num);
-
-    cudaMalloc(&d_grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num);
-    cudaMalloc(&d_grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num);
-    cudaMallocHost(&grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num);
-    cudaMallocHost(&grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num);
-    cudaMalloc(&d_norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num);
-    cudaMalloc(&d_norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num);
-    cudaMallocHost(&norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num);
-    cudaMallocHost(&norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num);
-    
-    float* initial_user_group_error = new float[mf_info->params.user_group_num];
-    float* initial_item_group_error = new float[mf_info->params.item_group_num];
-
-    for (int i = 0; i <mf_info->params.user_group_num; i++) initial_user_group_error[i] = 1.0f;
-    for (int i = 0; i <mf_info->params.item_group_num; i++) initial_item_group_error[i] = 1.0f;
-
-    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
-
-    size_t user_idx_table_cache_size = mf_info->params.user_group_num > 62 ? sizeof(unsigned int) * (mf_info->params.user_group_num - 62) : 0;
-    size_t item_idx_table_cache_size = mf_info->params.item_group_num > 62 ? sizeof(unsigned int) * (mf_info->params.item_group_num - 62) : 0;
-    size_t shared_mem_size = (3*sizeof(unsigned int)*(mf_info->params.user_group_num + mf_info->params.item_group_num)) +
-                              user_idx_table_cache_size +
-                              item_idx_table_cache_size + 
-                              (sizeof(unsigned char)*(mf_info->params.user_group_num + mf_info->params.item_group_num));
-
-    double error_computation_time = 0;
-    double precision_switching_exec_time = 0;
-    double sgd_update_execution_time = 0;
-    double rmse;  
-
-    for (int e = 0; e < mf_info->params.epoch; e++){
-        bool error_check = false;
-        first_sample_rating_idx = (update_count * update_vector_size) - 0;
-
-        if ((e >= start_idx ) && (e % mf_info->params.interval == (start_idx % mf_info->params.interval)) && mf_info->params.epoch - 1 != e) {
-            error_check = true;
-            first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
-        }
-
-        std::chrono::time_point<std::chrono::system_clock> error_computation_start_time = std::chrono::system_clock::now();
-        if (error_check && mf_info->params.epoch -1 != e){
-            initialize_float_array_to_val<<<num_workers_other_kernels, 512>>>(d_grad_sum_norm_p, mf_info->params.user_group_num * mf_info->params.k, 0.0f);
-            initialize_float_array_to_val<<<num_workers_other_kernels, 512>>>(d_grad_sum_norm_q, mf_info->params.item_group_num * mf_info->params.k, 0.0f);
-            cudaDeviceSynchronize();
-        }
-
-        double error_init_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-        error_computation_time += error_init_time;
-    
-        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
-        if (mf_info->params.k == 128){
-            mascot_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size, shared_mem_size>>>(
-                                                        mf_info->d_R,
-                                                        mf_info->n,
-                                                        (void**)sgd_info->d_user_group_ptr,
-                                                        (void**)sgd_info->d_item_group_ptr,
-                                                        d_rand_state,
-                                                        lr_decay_arr[e],
-                                                        mf_info->params.k,
-                                                        update_count,
-                                                        update_vector_size,
-                                                        mf_info->params.lambda,
-                                                        mf_info->d_user_group_end_idx,
-                                                        mf_info->d_item_group_end_idx,
-                                                        mf_info->d_user_group_prec_info,
-                                                        mf_info->d_item_group_prec_info,
-                                                        d_grad_sum_norm_p,
-                                                        d_grad_sum_norm_q,
-                                                        d_norm_sum_p,
-                                                        d_norm_sum_q,
-                                                        first_sample_rating_idx,
-                                                        (int)mf_info->params.user_group_num,
-                                                        (int)mf_info->params.item_group_num
-                                                        );
-        }
-        else if (mf_info->params.k == 64){
-            mascot_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size, shared_mem_size>>>(
-                                                        mf_info->d_R,
-                                                        mf_info->n,
-                                                        (void**)sgd_info->d_user_group_ptr,
-                                                        (void**)sgd_info->d_item_group_ptr,
-                                                        d_rand_state,
-                                                        lr_decay_arr[e],
-                                                        mf_info->params.k,
-                                                        update_count,
-                                                        update_vector_size,
-                                                        mf_info->params.lambda,
-                                                        mf_info->d_user_group_end_idx,
-                                                        mf_info->d_item_group_end_idx,
-                                                        mf_info->d_user_group_prec_info,
-                                                        mf_info->d_item_group_prec_info,
-                                                        d_grad_sum_norm_p,
-                                                        d_grad_sum_norm_q,
-                                                        d_norm_sum_p,
-                                                        d_norm_sum_q,
-                                                        first_sample_rating_idx,
-                                                        (int)mf_info->params.user_group_num,
-                                                        (int)mf_info->params.item_group_num
-                                                        );
-        }
-
-        cudaDeviceSynchronize();
-        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
-        sgd_update_execution_time += sgd_update_time_per_epoch;
-        gpuErr(cudaPeekAtLastError());  
-
-        error_computation_start_time = std::chrono::system_clock::now();
-        double error_copy_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-        error_computation_time += error_copy_time;
-
-        //* TRANSFER GROUPED PARAMETER FROM GPU TO HOST
-        unsigned user_group_start_idx = 0;
-        for (int i = 0; i < mf_info->params.user_group_num; i++){
-            unsigned int group_params_size = mf_info->user_group_size[i] * mf_info->params.k;
-            if (mf_info->user_group_prec_info[i] == 0) {
-                cudaMemcpy(sgd_info->user_group_ptr[i], sgd_info->user_group_d_ptr[i], sizeof(__half) * group_params_size, cudaMemcpyDeviceToHost);
-            }
-            else {
-                cudaMemcpy(sgd_info->user_group_ptr[i], sgd_info->user_group_d_ptr[i], sizeof(float) * group_params_size, cudaMemcpyDeviceToHost);
-            }
-        }
-        gpuErr(cudaPeekAtLastError());
-
-        unsigned item_group_start_idx = 0;
-        for (int i = 0; i < mf_info->params.item_group_num; i++){
-            unsigned int group_params_size = mf_info->item_group_size[i] * mf_info->params.k; 
-            if (mf_info->item_group_prec_info[i] == 0) cudaMemcpy(sgd_info->item_group_ptr[i], sgd_info->item_group_d_ptr[i], sizeof(__half) * group_params_size, cudaMemcpyDeviceToHost);
-            else cudaMemcpy(sgd_info->item_group_ptr[i], sgd_info->item_group_d_ptr[i], sizeof(float) * group_params_size, cudaMemcpyDeviceToHost);
-        }
-        gpuErr(cudaPeekAtLastError());
-
-        user_group_start_idx = 0;
-        unsigned int user_group_end_idx = 0;
-        for (int g = 0; g < mf_info->params.user_group_num; g++){
-            user_group_end_idx += mf_info->user_group_size[g];
-            unsigned int user_idx_in_group = 0;
-            if (mf_info->user_group_prec_info[g] == 0){
-                for (int u = user_group_start_idx; u < user_group_end_idx; u++){
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        sgd_info->p[u * mf_info->params.k + k] = __half2float(((__half*)sgd_info->user_group_ptr[g])[user_idx_in_group * mf_info->params.k + k]);
-                    }
-                    user_idx_in_group += 1;
-                }
-            }else{
-                for (int u = user_group_start_idx; u < user_group_end_idx; u++){
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        sgd_info->p[u * mf_info->params.k + k] = (((float*)sgd_info->user_group_ptr[g])[user_idx_in_group * mf_info->params.k + k]);
-                    }
-                    user_idx_in_group += 1;
-                }
-            }
-            user_group_start_idx = user_group_end_idx;
-        }
-
-       item_group_start_idx = 0;
-        unsigned int item_group_end_idx = 0;
-        for (int g = 0; g < mf_info->params.item_group_num; g++){
-            item_group_end_idx += mf_info->item_group_size[g];
-            unsigned int item_idx_in_group = 0;
-            if (mf_info->item_group_prec_info[g] == 0){
-                for (int i = item_group_start_idx; i < item_group_end_idx; i++){
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        sgd_info->q[i * mf_info->params.k + k] = __half2float(((__half*)sgd_info->item_group_ptr[g])[item_idx_in_group * mf_info->params.k + k]);
-                    }
-                    item_idx_in_group += 1;
-                }
-            }else{
-                for (int i = item_group_start_idx; i < item_group_end_idx; i++){
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        sgd_info->q[i * mf_info->params.k + k] = (((float*)sgd_info->item_group_ptr[g])[item_idx_in_group * mf_info->params.k + k]);
-                    }
-                    item_idx_in_group += 1;
-                }
-            }
-            item_group_start_idx = item_group_end_idx;
-        }
-
-        error_computation_start_time = std::chrono::system_clock::now();
-        if (error_check && e != mf_info->params.epoch - 1){
-            cudaMemcpy(grad_sum_norm_p, d_grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num, cudaMemcpyDeviceToHost);
-            cudaMemcpy(grad_sum_norm_q, d_grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num, cudaMemcpyDeviceToHost);
-            cudaMemcpy(norm_sum_p, d_norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num, cudaMemcpyDeviceToHost);
-            cudaMemcpy(norm_sum_q, d_norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num, cudaMemcpyDeviceToHost);
-        }
-        double error_transfer_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-        error_computation_time += error_transfer_time;
-        
-        if (error_check && e != mf_info->params.epoch - 1){
-
-            cout << "\n<User groups>\n";
-            for (int i = 0; i < mf_info->params.user_group_num; i++){
-                error_computation_start_time = std::chrono::system_clock::now();
-                float each_group_grad_sum_norm_acc = 0;
-                float each_group_norm_acc = 0;
-                if (mf_info->user_group_prec_info[i] == 0){
-                    
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        each_group_grad_sum_norm_acc+=powf(grad_sum_norm_p[i*mf_info->params.k + k],2);
-                        grad_sum_norm_p[i*mf_info->params.k + k] = 0;
-                    }
-                    for (int j = 0; j < block_num; j++){
-                        each_group_norm_acc += norm_sum_p[i * block_num + j];
-                    }
-                    mf_info->user_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
-                    mf_info->user_group_error[i] /= initial_user_group_error[i];
-                }
-                else{
-                    mf_info->user_group_error[i] = -1;
-                }
-                error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-                
-                if (mf_info->user_group_error[i] == -1) cout << "-1" << " ";
-                else cout << mf_info->user_group_error[i] << " ";
-            }
-
-            cout << "\n<Item groups>\n";
-            for (int i = 0; i < mf_info->params.item_group_num; i++){
-                error_computation_start_time = std::chrono::system_clock::now();
-                float each_group_grad_sum_norm_acc = 0;
-                float each_group_norm_acc = 0;
-                if (mf_info->item_group_prec_info[i] == 0){
-
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        each_group_grad_sum_norm_acc+=powf(grad_sum_norm_q[i*mf_info->params.k + k],2);
-                        grad_sum_norm_q[i*mf_info->params.k + k] = 0;
-                    }
-
-                    for (int j = 0; j < block_num; j++){
-                        each_group_norm_acc += norm_sum_q[i * block_num + j];
-                    }
-                    mf_info->item_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
-                    mf_info->item_group_error[i] /= initial_item_group_error[i];
-                }
-                else{
-                    mf_info->item_group_error[i] = -1;
-                }
-                error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-                
-                if (mf_info->item_group_error[i] == -1) cout << "-1" << " ";    
-                else cout << mf_info->item_group_error[i] << " ";
-            }
-            cout << "\n";
-
-            if (e == start_idx){
-                for (int i = 0; i < mf_info->params.user_group_num; i++){
-                    initial_user_group_error[i] = mf_info->user_group_error[i];
-                }
-                for (int i = 0; i < mf_info->params.item_group_num; i++){
-                    initial_item_group_error[i] = mf_info->item_group_error[i];
-                }
-            }
-        }
-        
-        std::chrono::time_point<std::chrono::system_clock> precision_switching_start_point = std::chrono::system_clock::now();
-        if (error_check && e > start_idx && e != mf_info->params.epoch - 1) precision_switching_by_groups_grad_diversity(mf_info, sgd_info);
-        precision_switching_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_start_point).count();
-
-        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
-        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;         
-    }
-
-    cudaMemcpy(mf_info->test_COO, mf_info->d_test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyDeviceToHost);
-
-    double preprocess_exec_time = rating_histogram_execution_time + grouping_exec_time + reconst_exec_time + cpy2grouped_parameters_exec_time + additional_info_init_exec_time;
-    cout << "\n<Preprocessing time (micro sec)>" << endl;
-    cout << "Rating histogram                 : " << rating_histogram_execution_time << endl;
-    cout << "Grouping                         : " << grouping_exec_time << endl;
-    cout << "Matrix reconstruction            : " << reconst_exec_time << endl;
-    cout << "Copy to grouped params           : " << cpy2grouped_parameters_exec_time << endl;
-    cout << "Additional info init             : " << additional_info_init_exec_time << endl;
-    cout << "Total preprocessing time         : " << preprocess_exec_time << endl;
-    cout << "\n<User & item parameter copy exec time (micro sec)>" << endl;
-    cout << "Precision switching              : " << precision_switching_exec_time / mf_info->params.epoch << endl; 
-    cout << "Total precision switching time   : " << precision_switching_exec_time << endl;
-    cout << "\n<User & item group error comp exec time (micro sec)>" << endl;
-    cout << "Error computation time           : " << error_computation_time / mf_info->params.epoch << endl; 
-    cout << "Total error computation time     : " << error_computation_time << endl;
-    cout << "\n<User & item parameter update exec time (micro sec)>" << endl;
-    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
-    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
-    cout << "Total MF time(ms)                : " << (preprocess_exec_time + precision_switching_exec_time + error_computation_time + sgd_update_execution_time)/1000 << endl;
-
-    cudaFree(mf_info->d_R);
-    cudaFree(mf_info->d_test_COO);
-    cudaFree(d_rand_state);
-    cudaFree(d_e_group);
-    cudaFree(sgd_info->d_user_group_ptr);
-    cudaFree(sgd_info->d_item_group_ptr);
-    cudaFree(mf_info->d_user_group_prec_info);
-    cudaFree(mf_info->d_item_group_prec_info);
-    cudaFree(d_grad_sum_norm_p);
-    cudaFree(d_grad_sum_norm_q);
-    cudaFree(d_norm_sum_p);
-    cudaFree(d_norm_sum_q);
-    cudaFree(mf_info->d_user_group_end_idx);
-    cudaFree(mf_info->d_item_group_end_idx);
-}
-
-void adaptive_fixed_point_training_mf(Mf_info* mf_info, SGD* sgd_info){
-    srand(time(0)); 
-    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
-
-    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
-    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-    
-    mf_info->test_COO = test_set_preprocess(mf_info);
-    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
-    gpuErr(cudaPeekAtLastError());
-    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
-    
-    curandState* d_rand_state;
-    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
-    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
-    cudaDeviceSynchronize();
-    gpuErr(cudaPeekAtLastError());
-
-    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
-    for (int i = 0; i < mf_info->params.epoch; i++){
-        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
-    }
-    
-    int update_vector_size = 128;
-    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));    
-    unsigned int div = mf_info->params.thread_block_size/32;
-    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
-    unsigned int group_error_size = error_kernel_work_groups;
-    float* d_e_group;
-    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
-    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
-    unsigned int seg_size = 32;
-    unsigned int block_num = mf_info->params.num_workers/div;
-    int start_idx = 5;
-    unsigned int num_groups = 10000;
-    double precision_switching_and_error_comp_execution_time = 0;
-    double sgd_update_execution_time = 0;
-    double rmse;    
-
-    for (int e = 0; e < mf_info->params.epoch; e++){
-        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
-        
-        if (mf_info->params.k == 128){
-            afp_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                mf_info->d_R,
-                                mf_info->n,
-                                sgd_info->d_p,
-                                sgd_info->d_q,
-                                d_rand_state,
-                                lr_decay_arr[e],
-                                mf_info->params.k,
-                                e,
-                                update_count,
-                                update_vector_size,
-                                mf_info->params.lambda
-            );
-        }else if (mf_info->params.k == 64){
-            afp_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                mf_info->d_R,
-                                mf_info->n,
-                                sgd_info->d_p,
-                                sgd_info->d_q,
-                                d_rand_state,
-                                lr_decay_arr[e],
-                                mf_info->params.k,
-                                e,
-                                update_count,
-                                update_vector_size,
-                                mf_info->params.lambda
-            );
-        }
-        cudaDeviceSynchronize(); 
-        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
-        sgd_update_execution_time += sgd_update_time_per_epoch;
-
-        cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
-        cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
-        
-        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
-        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
-    }
-
-    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
-    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
-    cout << "Total MF time(ms)                : " << (sgd_update_execution_time)/1000 << endl;
-    
-    cudaFree(mf_info->d_R);
-    cudaFree(mf_info->d_test_COO);
-    cudaFree(d_rand_state);
-    cudaFree(d_e_group);
-}
-
-void muppet_training_mf(Mf_info* mf_info, SGD* sgd_info){
-    srand(time(0)); 
-    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
-
-    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
-    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-    
-    mf_info->test_COO = test_set_preprocess(mf_info);
-    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
-    gpuErr(cudaPeekAtLastError());
-    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
-    
-    curandState* d_rand_state;
-    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
-    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
-    cudaDeviceSynchronize();
-    gpuErr(cudaPeekAtLastError());
-
-    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
-    for (int i = 0; i < mf_info->params.epoch; i++){
-        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
-    }
-    
-    int update_vector_size = 128;
-    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
-    int sample_ratings_num = (float)(update_count * update_vector_size) * mf_info->params.sample_ratio;
-    unsigned int first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
-    unsigned int div = mf_info->params.thread_block_size/32;
-    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
-    unsigned int group_error_size = error_kernel_work_groups;
-    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
-    unsigned int seg_size = 32;
-    unsigned int block_num = mf_info->params.num_workers/div;
-    float* d_e_group;
-    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
-    float *sum_norms;
-    float *d_sum_norms;
-    float *sum_updated_val;
-    float *d_sum_updated_val;
-
-    double additional_info_init_exec_time = 0;
-    double sgd_update_execution_time = 0;
-    double error_computation_time = 0;
-
-    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
-    float *sum_norms_epoch = new float[mf_info->params.epoch];
-    float *sum_updated_val_epoch = new float[mf_info->params.k * mf_info->params.epoch];
-    float *gradient_diversity_per_epoch = new float[mf_info->params.epoch];
-    float *sum_updated_val_acc = new float[mf_info->params.k];
-    cudaMalloc(&d_sum_norms, sizeof(float) * mf_info->params.num_workers);
-    cudaMallocHost(&sum_norms, sizeof(float) * mf_info->params.num_workers);
-    cudaMalloc(&d_sum_updated_val, sizeof(float) * mf_info->params.k);
-    cudaMallocHost(&sum_updated_val, sizeof(float) * mf_info->params.k);
-    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
-
-    double rmse;    
-    int start_idx = 5;
-    unsigned int num_groups = 10000;
-    float initial_error = 1; 
-    int resolution_size = 3;
-    float max_grad_diversity = -1.f;
-    float alpha  = 1.0f;
-    float beta = 1.5f;
-    float lambda_for_threshold = 0.3f;
-    int gamma = 1;
-    int violation_times = 0;
-    unsigned char bit_width_set[5] = {8, 12, 14 ,16, 32};
-    int switched_epoch = -1;
-    int precision_idx;
-
-    if (mf_info->is_yahoo) precision_idx = 1;
-    else precision_idx = 0;
-
-    for (int e = 0; e < mf_info->params.epoch; e++){
-        float decaying_threshold = alpha + (beta * exp(-1*lambda_for_threshold*(e)));
-        std::chrono::time_point<std::chrono::system_clock> error_computation_start_time = std::chrono::system_clock::now();
-        //! clean device mem (not neccesary)
-        for (int k = 0; k < mf_info->params.k; k++) sum_updated_val[k] = 0;
-        cudaMemcpy(d_sum_updated_val, sum_updated_val, sizeof(float) * mf_info->params.k, cudaMemcpyHostToDevice);
-        error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
-        
-        if (mf_info->params.k == 128){
-            muppet_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                mf_info->d_R,
-                                mf_info->n,
-                                sgd_info->d_p,
-                                sgd_info->d_q,
-                                d_rand_state,
-                                lr_decay_arr[e],
-                                mf_info->params.k,
-                                update_count,
-                                update_vector_size,
-                                mf_info->params.lambda,
-                                first_sample_rating_idx,
-                                d_sum_updated_val,
-                                d_sum_norms,
-                                (unsigned char)bit_width_set[precision_idx],
-                                (unsigned char)bit_width_set[precision_idx]
-                            );
-        }else if (mf_info->params.k == 64){
-            muppet_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                mf_info->d_R,
-                                mf_info->n,
-                                sgd_info->d_p,
-                                sgd_info->d_q,
-                                d_rand_state,
-                                lr_decay_arr[e],
-                                mf_info->params.k,
-                                update_count,
-                                update_vector_size,
-                                mf_info->params.lambda,
-                                first_sample_rating_idx,
-                                d_sum_updated_val,
-                                d_sum_norms,
-                                (unsigned char)bit_width_set[precision_idx],
-                                (unsigned char)bit_width_set[precision_idx]
-                            );
-        }
-
-        cudaDeviceSynchronize(); 
-        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
-        sgd_update_execution_time += sgd_update_time_per_epoch;
-        
-        cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
-        cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
-        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
-        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
-
-        error_computation_start_time = std::chrono::system_clock::now();
-        cudaMemcpy(sum_norms, d_sum_norms, sizeof(float) * mf_info->params.num_workers, cudaMemcpyDeviceToHost);
-        cudaMemcpy(sum_updated_val, d_sum_updated_val, sizeof(float) * mf_info->params.k, cudaMemcpyDeviceToHost);
-        
-        float norm_acc = 0 ;
-        
-        for (int w = 0; w < mf_info->params.num_workers; w++) norm_acc += sum_norms[w];
-        sum_norms_epoch[e] = norm_acc;
-        for (int k = 0; k < mf_info->params.k; k++) {
-            sum_updated_val_acc[k] = 0;
-            sum_updated_val_epoch[e * mf_info->params.k + k] = sum_updated_val[k];
-        }
-        error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-
-        if (e - switched_epoch >= resolution_size){
-            error_computation_start_time = std::chrono::system_clock::now();
-            float sum_norms_resolution = 0;
-            float sum_updated_val_norm = 0;
-            for (int wi = e - resolution_size + 1; wi <= e; wi++){
-                sum_norms_resolution += sum_norms_epoch[wi];
-                for (int k = 0; k < mf_info->params.k; k++) sum_updated_val_acc[k] += sum_updated_val_epoch[wi * mf_info->params.k + k];
-            }
-
-            for (int k = 0; k < mf_info->params.k; k++) {
-                sum_updated_val_norm += powf(sum_updated_val_acc[k],2);
-            }
-
-            float grad_diversity_this_epoch = sum_norms_resolution/sum_updated_val_norm;
-            max_grad_diversity = max_grad_diversity < grad_diversity_this_epoch ? grad_diversity_this_epoch : max_grad_diversity;
-            float grad_ratio = max_grad_diversity/grad_diversity_this_epoch;
-            
-            if (grad_ratio > decaying_threshold && ++violation_times == gamma) {
-                precision_idx++;
-                switched_epoch = e;
-                max_grad_diversity = -1.f;
-                violation_times = 0;
-            }
-            error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-        }
-    }
-
-    cout << "Error computation time           : " << error_computation_time << endl; 
-    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
-    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
-    cout << "Total MF time(ms)                : " << (error_computation_time + sgd_update_execution_time)/1000 << endl;
-    
-    cudaFree(mf_info->d_R);
-    cudaFree(mf_info->d_test_COO);
-    cudaFree(d_rand_state);
-    cudaFree(d_e_group);
-    cudaFree(d_sum_norms);
-    cudaFree(d_sum_updated_val);
-}
-
-void mixed_precision_training_mf(Mf_info* mf_info, SGD* sgd_info){
-    
-    curandState* d_rand_state;
-    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
-    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
-    cudaDeviceSynchronize();
-    gpuErr(cudaPeekAtLastError());
-    
-    srand(time(0)); 
-    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
-
-    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
-    cudaMalloc(&(sgd_info->d_p), sizeof(float) * mf_info->max_user * mf_info->params.k);
-    cudaMalloc(&(sgd_info->d_q), sizeof(float) * mf_info->max_item * mf_info->params.k);
-    
-    double master_copy_setting_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> master_copy_setting_start_time = std::chrono::system_clock::now();
-    transform_feature_vector_half2float((short*)sgd_info->half_p, sgd_info->p, mf_info->max_user, mf_info->params.k);
-    transform_feature_vector_half2float((short*)sgd_info->half_q, sgd_info->q, mf_info->max_item, mf_info->params.k);
-    cudaMemcpy(sgd_info->d_p, sgd_info->p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyHostToDevice);
-    cudaMemcpy(sgd_info->d_q, sgd_info->q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyHostToDevice);
-    master_copy_setting_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - master_copy_setting_start_time).count();
-    
-    gpuErr(cudaPeekAtLastError());
-
-    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
-
-    //* Learning rate initialization
-    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
-    for (int i = 0; i < mf_info->params.epoch; i++){
-        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
-    }
-
-    int update_vector_size = 128;
-    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
-    unsigned int div = mf_info->params.thread_block_size/32;
-    
-    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
-    unsigned int group_error_size = error_kernel_work_groups;
-    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
-    unsigned int seg_size = 32;
-    float* d_e_group;
-    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
-
-    gpuErr(cudaPeekAtLastError());
-
-    mf_info->test_COO = test_set_preprocess(mf_info);
-    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
-    gpuErr(cudaPeekAtLastError());
-    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);  
-
-    float scaling_factor = 1000;
-    __half scaled_lambda = __float2half_rn(mf_info->params.lambda * scaling_factor);
-    double rmse;
-    double sgd_update_execution_time = 0;
-
-    for (int e = 0; e < mf_info->params.epoch; e++){
-        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
-        if (mf_info->params.k == 128){
-            mpt_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                                    mf_info->d_R,
-                                                    mf_info->n,
-                                                    sgd_info->d_p,
-                                                    sgd_info->d_q,
-                                                    d_rand_state,
-                                                    lr_decay_arr[e],
-                                                    mf_info->params.k,
-                                                    update_count,
-                                                    update_vector_size,
-                                                    scaled_lambda,
-                                                    scaling_factor
-                                                    );
-        }else{
-            mpt_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                                    mf_info->d_R,
-                                                    mf_info->n,
-                                                    sgd_info->d_p,
-                                                    sgd_info->d_q,
-                                                    d_rand_state,
-                                                    lr_decay_arr[e],
-                                                    mf_info->params.k,
-                                                    update_count,
-                                                    update_vector_size,
-                                                    scaled_lambda,
-                                                    scaling_factor
-                                                    );
-        }
-        cudaDeviceSynchronize();
-        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
-        sgd_update_execution_time += sgd_update_time_per_epoch;
-
-        cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
-        cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
-        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
-
-        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
-    }
-
-    cout << "Parameters update per epoch                     : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
-    cout << "Total parameters update                         : " << sgd_update_execution_time / 1000 << endl; 
-    
-    cudaFree(mf_info->d_R);
-    cudaFree(mf_info->d_test_COO);
-    cudaFree(d_rand_state);
-    cudaFree(d_e_group);
-}
-
-void training_single_mf(Mf_info *mf_info, SGD *sgd_info){
-
-    size_t triplet_host_to_device_transfer_size = 0;
-
-    size_t P_device_to_host_transfer_size = 0;
-    size_t Q_device_to_host_transfer_size = 0;
-    size_t total_device_to_host_transfer_size = 0;
-    
-    double triplet_host_to_device_transfer_time{};
-
-    double P_device_to_host_transfer_time{};
-    double Q_device_to_host_transfer_time{};
-    double total_device_to_host_transfer_time{};
-
-    curandState* d_rand_state;
-    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
-    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
-    gpuErr(cudaPeekAtLastError());
-    
-    srand(time(0)); 
-    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
-
-    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
-    cudaMalloc(&(sgd_info->d_p), sizeof(float) * mf_info->max_user * mf_info->params.k);
-    cudaMalloc(&(sgd_info->d_q), sizeof(float) * mf_info->max_item * mf_info->params.k);
-    gpuErr(cudaPeekAtLastError());
-
-    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
-    cudaMemcpy(sgd_info->d_p, sgd_info->p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyHostToDevice);
-    cudaMemcpy(sgd_info->d_q, sgd_info->q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-
-    float* lr_decay_arr = new float[2048];
-
-    for (int i = 0; i < mf_info->params.epoch + 4; i++){
-        lr_decay_arr[i] = static_cast<float>(mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5))));
-    }
-
-    int update_vector_size = 128;
-    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
-    unsigned int div = mf_info->params.thread_block_size/32;
-    double sgd_update_execution_time = 0;
-    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
-    unsigned int group_error_size = error_kernel_work_groups;
-    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
-    unsigned int seg_size = 32;
-    float* d_e_group;
-    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
-    float rmse = 0; 
-
-    mf_info->test_COO = test_set_preprocess(mf_info);
-    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
-    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-    
-
-    for (int e = 0; e < mf_info->params.epoch; e++){
-        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
-        if (mf_info->params.k == 128)
-        single_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                                        mf_info->d_R,
-                                                        mf_info->n,
-                                                        sgd_info->d_p,
-                                                        sgd_info->d_q,
-                                                        d_rand_state,
-                                                        lr_decay_arr[e],
-                                                        mf_info->params.k,
-                                                        update_count,
-                                                        update_vector_size,
-                                                        mf_info->params.lambda
-                                                        );
-
-        else if (mf_info->params.k == 64)
-        single_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                                        mf_info->d_R,
-                                                        mf_info->n,
-                                                        sgd_info->d_p,
-                                                        sgd_info->d_q,
-                                                        d_rand_state,
-                                                        lr_decay_arr[e],
-                                                        mf_info->params.k,
-                                                        update_count,
-                                                        update_vector_size,
-                                                        mf_info->params.lambda
-                                                        );
-
-        cudaDeviceSynchronize();
-        double sgd_execution_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
-        sgd_update_execution_time += sgd_execution_time_per_epoch;
-        
-        cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
-        cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
-        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
-
-        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
-    }
-
-    cout << "Execution time(avg per epoch)        : " << sgd_update_execution_time / mf_info->params.epoch << endl;
-    cout << "Total execution time                 : " << sgd_update_execution_time / 1000 << endl;
-    
-    cudaFree(mf_info->d_R);
-    cudaFree(mf_info->d_test_COO);
-    cudaFree(d_rand_state);
-    cudaFree(d_e_group);
-}
-
-void mascot_training_mf_naive(Mf_info* mf_info, SGD* sgd_info){
-    srand(time(0)); 
-    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
-
-    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
-    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-    
-    mf_info->test_COO = test_set_preprocess(mf_info);
-    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
-    gpuErr(cudaPeekAtLastError());
-    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
-
-    double rating_histogram_execution_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> rating_histogram_start_point = std::chrono::system_clock::now();
-    user_item_rating_histogram(mf_info);
-    rating_histogram_execution_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - rating_histogram_start_point).count();
-
-    double grouping_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> grouping_start_point = std::chrono::system_clock::now();
-    split_group_based_equal_size_not_strict_ret_end_idx(mf_info);
-    grouping_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - grouping_start_point).count();
-
-    double reconst_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> reconst_start_point = std::chrono::system_clock::now();
-    matrix_reconstruction(mf_info);
-    reconst_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - reconst_start_point).count();
-    
-    curandState* d_rand_state;
-    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
-    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
-    cudaDeviceSynchronize();
-    gpuErr(cudaPeekAtLastError());
-
-    double cpy2grouped_parameters_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> cpy2grouped_parameters_start_point = std::chrono::system_clock::now();
-
-    cudaMallocHost(&sgd_info->user_group_d_ptr, sizeof(void*) * mf_info->params.user_group_num);
-    cudaMallocHost(&sgd_info->item_group_d_ptr, sizeof(void*) * mf_info->params.item_group_num);
-    cudaMallocHost(&sgd_info->user_group_ptr, sizeof(void*) * mf_info->params.user_group_num);
-    cudaMallocHost(&sgd_info->item_group_ptr, sizeof(void*) * mf_info->params.item_group_num);
-
-    cudaMalloc(&sgd_info->d_user_group_ptr, sizeof(void*) * mf_info->params.user_group_num);
-    cudaMalloc(&sgd_info->d_item_group_ptr, sizeof(void*) * mf_info->params.item_group_num);
-
-    cpy2grouped_parameters_gpu_for_comparison_indexing(mf_info, sgd_info);
-    cpy2grouped_parameters_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - cpy2grouped_parameters_start_point).count();
-
-    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
-    for (int i = 0; i < mf_info->params.epoch; i++){
-        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
-    }
-
-    int update_vector_size = 128;
-    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
-    int sample_ratings_num = (float)(update_count * update_vector_size) * mf_info->params.sample_ratio;
-    unsigned int first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
-    unsigned int div = mf_info->params.thread_block_size/32;
-    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
-    unsigned int group_error_size = error_kernel_work_groups;
-    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
-    unsigned int seg_size = 32;
-    unsigned int block_num = mf_info->params.num_workers/div;
-    
-    float* d_e_group;
-    float *grad_sum_norm_p;
-    float *grad_sum_norm_q;
-    float *d_grad_sum_norm_p;
-    float *d_grad_sum_norm_q;
-    float *norm_sum_p;
-    float *norm_sum_q;
-    float *d_norm_sum_p;
-    float *d_norm_sum_q;
-    float* d_user_group_sum_updated_val;
-    float* d_item_group_sum_updated_val;
-
-    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
-    cudaMalloc(&(sgd_info->d_p), sizeof(float) * mf_info->max_user * mf_info->params.k);
-    cudaMalloc(&(sgd_info->d_q), sizeof(float) * mf_info->max_item * mf_info->params.k);
-
-    double additional_info_init_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
-
-    cudaMallocHost(&mf_info->user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num);
-    cudaMallocHost(&mf_info->item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num);
-    cudaMalloc(&mf_info->d_user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num);
-    cudaMalloc(&mf_info->d_item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num);
-    cudaMemset(mf_info->d_user_group_prec_info, 0, sizeof(unsigned char) * mf_info->params.user_group_num);
-    cudaMemset(mf_info->d_item_group_prec_info, 0, sizeof(unsigned char) * mf_info->params.item_group_num);
-    cudaMallocHost(&mf_info->user_group_error, sizeof(float) * mf_info->params.user_group_num);
-    cudaMallocHost(&mf_info->item_group_error, sizeof(float) * mf_info->params.item_group_num);
-
-    cudaMalloc(&d_grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num);
-    cudaMalloc(&d_grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num);
-    cudaMallocHost(&grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num);
-    cudaMallocHost(&grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num);
-    cudaMalloc(&d_norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num);
-    cudaMalloc(&d_norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num);
-    cudaMallocHost(&norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num);
-    cudaMallocHost(&norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num);
-
-    unsigned int* user_group_end_idx_shift = new unsigned int[mf_info->params.user_group_num + 1];
-    unsigned int* item_group_end_idx_shift = new unsigned int[mf_info->params.item_group_num + 1];
-    unsigned int* d_user_group_end_idx_shift;
-    unsigned int* d_item_group_end_idx_shift;
-
-    user_group_end_idx_shift[0] = -1;
-    item_group_end_idx_shift[0] = -1;
-
-    for (int i = 0; i < mf_info->params.user_group_num; i++){
-        user_group_end_idx_shift[i+1] = mf_info->user_group_end_idx[i];
-    }
-
-    for (int i = 0; i < mf_info->params.item_group_num; i++){
-        item_group_end_idx_shift[i+1] = mf_info->item_group_end_idx[i];
-    }
-
-    cudaMalloc(&d_user_group_end_idx_shift, sizeof(unsigned int) * (mf_info->params.user_group_num + 1));
-    cudaMalloc(&d_item_group_end_idx_shift, sizeof(unsigned int) * (mf_info->params.item_group_num + 1));
-    cudaMemcpy(d_user_group_end_idx_shift, user_group_end_idx_shift, sizeof(unsigned int) * (mf_info->params.user_group_num + 1), cudaMemcpyHostToDevice);
-    cudaMemcpy(d_item_group_end_idx_shift, item_group_end_idx_shift, sizeof(unsigned int) * (mf_info->params.item_group_num + 1), cudaMemcpyHostToDevice);
-
-    double error_computation_time = 0;
-    double precision_switching_exec_time = 0;
-    double sgd_update_execution_time = 0;
-    double rmse;    
-    int start_idx = 5;
-    unsigned int num_groups = 10000;
-
-    float* initial_user_group_error = new float[mf_info->params.user_group_num];
-    float* initial_item_group_error = new float[mf_info->params.item_group_num];
-
-    for (int i = 0; i <mf_info->params.user_group_num; i++) initial_user_group_error[i] = 1.0f;
-    for (int i = 0; i <mf_info->params.item_group_num; i++) initial_item_group_error[i] = 1.0f;
-    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
-
-    for (int e = 0; e < mf_info->params.epoch; e++){
-        bool error_check = false;
-        first_sample_rating_idx = (update_count * update_vector_size) - 0;
-
-        if ((e >= start_idx ) && (e % mf_info->params.interval == (start_idx % mf_info->params.interval)) && mf_info->params.epoch - 1 != e) {
-            error_check = true;
-            first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
-        }
-
-        std::chrono::time_point<std::chrono::system_clock> error_computation_start_time = std::chrono::system_clock::now();
-        if (error_check){
-            initialize_float_array_to_val<<<num_groups, 512>>>(d_grad_sum_norm_p, mf_info->params.user_group_num * mf_info->params.k, 0.0f);
-            initialize_float_array_to_val<<<num_groups, 512>>>(d_grad_sum_norm_q, mf_info->params.item_group_num * mf_info->params.k, 0.0f);
-            cudaDeviceSynchronize();
-        }
-
-        double error_init_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-        error_computation_time += error_init_time;
-    
-        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
-        if (mf_info->params.k == 128){
-            naive_mascot_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                                        mf_info->d_R,
-                                                        mf_info->n,
-                                                        (void**)sgd_info->d_user_group_ptr,
-                                                        (void**)sgd_info->d_item_group_ptr,
-                                                        d_rand_state,
-                                                        lr_decay_arr[e],
-                                                        mf_info->params.k,
-                                                        update_count,
-                                                        update_vector_size,
-                                                        mf_info->params.lambda,
-                                                        d_user_group_end_idx_shift,
-                                                        d_item_group_end_idx_shift,
-                                                        mf_info->d_user_group_prec_info,
-                                                        mf_info->d_item_group_prec_info,
-                                                        d_grad_sum_norm_p,
-                                                        d_grad_sum_norm_q,
-                                                        d_norm_sum_p,
-                                                        d_norm_sum_q,
-                                                        first_sample_rating_idx,
-                                                        (int)mf_info->params.user_group_num,
-                                                        (int)mf_info->params.item_group_num
-                                                        );
-        }
-
-        cudaDeviceSynchronize();
-        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
-        sgd_update_execution_time += sgd_update_time_per_epoch;
-        gpuErr(cudaPeekAtLastError());  
-
-        unsigned user_group_start_idx = 0;
-        for (int i = 0; i < mf_info->params.user_group_num; i++){
-            unsigned int group_params_size = mf_info->user_group_size[i] * mf_info->params.k;
-            if (mf_info->user_group_prec_info[i] == 0) {
-                cudaMemcpy(sgd_info->user_group_ptr[i], sgd_info->user_group_d_ptr[i], sizeof(__half) * group_params_size, cudaMemcpyDeviceToHost);
-                // gpuErr(cudaPeekAtLastError());
-            }
-            else {
-                cudaMemcpy(sgd_info->user_group_ptr[i], sgd_info->user_group_d_ptr[i], sizeof(float) * group_params_size, cudaMemcpyDeviceToHost);
-                // gpuErr(cudaPeekAtLastError());
-            }
-        }
-        gpuErr(cudaPeekAtLastError());
-
-        unsigned item_group_start_idx = 0;
-        for (int i = 0; i < mf_info->params.item_group_num; i++){
-            unsigned int group_params_size = mf_info->item_group_size[i] * mf_info->params.k; 
-            if (mf_info->item_group_prec_info[i] == 0) cudaMemcpy(sgd_info->item_group_ptr[i], sgd_info->item_group_d_ptr[i], sizeof(__half) * group_params_size, cudaMemcpyDeviceToHost);
-            else cudaMemcpy(sgd_info->item_group_ptr[i], sgd_info->item_group_d_ptr[i], sizeof(float) * group_params_size, cudaMemcpyDeviceToHost);
-        }
-        gpuErr(cudaPeekAtLastError());
-
-        user_group_start_idx = 0;
-        unsigned int user_group_end_idx = 0;
-        for (int g = 0; g < mf_info->params.user_group_num; g++){
-            user_group_end_idx += mf_info->user_group_size[g];
-            unsigned int user_idx_in_group = 0;
-            if (mf_info->user_group_prec_info[g] == 0){
-                for (int u = user_group_start_idx; u < user_group_end_idx; u++){
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        sgd_info->p[u * mf_info->params.k + k] = __half2float(((__half*)sgd_info->user_group_ptr[g])[user_idx_in_group * mf_info->params.k + k]);
-                    }
-                    user_idx_in_group += 1;
-                }
-            }else{
-                for (int u = user_group_start_idx; u < user_group_end_idx; u++){
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        sgd_info->p[u * mf_info->params.k + k] = (((float*)sgd_info->user_group_ptr[g])[user_idx_in_group * mf_info->params.k + k]);
-                    }
-                    user_idx_in_group += 1;
-                }
-            }
-            user_group_start_idx = user_group_end_idx;
-        }
-
-       item_group_start_idx = 0;
-        unsigned int item_group_end_idx = 0;
-        for (int g = 0; g < mf_info->params.item_group_num; g++){
-            item_group_end_idx += mf_info->item_group_size[g];
-            unsigned int item_idx_in_group = 0;
-            if (mf_info->item_group_prec_info[g] == 0){
-                for (int i = item_group_start_idx; i < item_group_end_idx; i++){
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        sgd_info->q[i * mf_info->params.k + k] = __half2float(((__half*)sgd_info->item_group_ptr[g])[item_idx_in_group * mf_info->params.k + k]);
-                    }
-                    item_idx_in_group += 1;
-                }
-            }else{
-                for (int i = item_group_start_idx; i < item_group_end_idx; i++){
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        sgd_info->q[i * mf_info->params.k + k] = (((float*)sgd_info->item_group_ptr[g])[item_idx_in_group * mf_info->params.k + k]);
-                    }
-                    item_idx_in_group += 1;
-                }
-            }
-            item_group_start_idx = item_group_end_idx;
-        }
-
-        error_computation_start_time = std::chrono::system_clock::now();
-        if (error_check && e != mf_info->params.epoch - 1){
-            cudaMemcpy(grad_sum_norm_p, d_grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num, cudaMemcpyDeviceToHost);
-            cudaMemcpy(grad_sum_norm_q, d_grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num, cudaMemcpyDeviceToHost);
-            cudaMemcpy(norm_sum_p, d_norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num, cudaMemcpyDeviceToHost);
-            cudaMemcpy(norm_sum_q, d_norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num, cudaMemcpyDeviceToHost);
-        }
-        double error_transfer_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-        error_computation_time += error_transfer_time;
-        
-        if (error_check && e != mf_info->params.epoch - 1){
-
-            cout << "\n<User groups>\n";
-            for (int i = 0; i < mf_info->params.user_group_num; i++){
-                error_computation_start_time = std::chrono::system_clock::now();
-                float each_group_grad_sum_norm_acc = 0;
-                float each_group_norm_acc = 0;
-                if (mf_info->user_group_prec_info[i] == 0){
-                    
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        each_group_grad_sum_norm_acc+=powf(grad_sum_norm_p[i*mf_info->params.k + k],2);
-                        grad_sum_norm_p[i*mf_info->params.k + k] = 0;
-                    }
-                    for (int j = 0; j < block_num; j++){
-                        each_group_norm_acc += norm_sum_p[i * block_num + j];
-                    }
-                    mf_info->user_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
-                    mf_info->user_group_error[i] /= initial_user_group_error[i];
-                }
-                else{
-                    mf_info->user_group_error[i] = -1;
-                }
-                error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-                
-                if (mf_info->user_group_error[i] == -1) cout << "-1" << " ";                        
-                else cout << mf_info->user_group_error[i] << " ";
-            }
-
-            cout << "\n<Item groups>\n";
-            for (int i = 0; i < mf_info->params.item_group_num; i++){
-                error_computation_start_time = std::chrono::system_clock::now();
-                float each_group_grad_sum_norm_acc = 0;
-                float each_group_norm_acc = 0;
-                if (mf_info->item_group_prec_info[i] == 0){
-
-                    for (int k = 0; k < mf_info->params.k; k++){
-                        each_group_grad_sum_norm_acc+=powf(grad_sum_norm_q[i*mf_info->params.k + k],2);
-                        grad_sum_norm_q[i*mf_info->params.k + k] = 0;
-                    }
-
-                    for (int j = 0; j < block_num; j++){
-                        each_group_norm_acc += norm_sum_q[i * block_num + j];
-                    }
-                    mf_info->item_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
-                    mf_info->item_group_error[i] /= initial_item_group_error[i];
-                }
-                else{
-                    mf_info->item_group_error[i] = -1;
-                }
-                error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
-                                
-                if (mf_info->item_group_error[i] == -1) cout << "-1" << " ";
-                else cout << mf_info->item_group_error[i] << " ";
-                
-            }
-            cout << "\n";
-
-            if (e == start_idx){
-                for (int i = 0; i < mf_info->params.user_group_num; i++){
-                    initial_user_group_error[i] = mf_info->user_group_error[i];
-                }
-                for (int i = 0; i < mf_info->params.item_group_num; i++){
-                    initial_item_group_error[i] = mf_info->item_group_error[i];
-                }
-            }
-        }
-        
-        std::chrono::time_point<std::chrono::system_clock> precision_switching_start_point = std::chrono::system_clock::now();
-        if (error_check && e > start_idx && e != mf_info->params.epoch - 1) precision_switching_by_groups_grad_diversity(mf_info, sgd_info);
-        precision_switching_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_start_point).count();
-
-        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
-        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
-    }
-
-    cudaMemcpy(mf_info->test_COO, mf_info->d_test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyDeviceToHost);
-
-    double preprocess_exec_time = rating_histogram_execution_time + grouping_exec_time + reconst_exec_time + cpy2grouped_parameters_exec_time + additional_info_init_exec_time;
-    cout << "\n<Preprocessing time (micro sec)>" << endl;
-    cout << "Rating histogram                 : " << rating_histogram_execution_time << endl;
-    cout << "Grouping                         : " << grouping_exec_time << endl;
-    cout << "Matrix reconstruction            : " << reconst_exec_time << endl;
-    cout << "Copy to grouped params           : " << cpy2grouped_parameters_exec_time << endl;
-    cout << "Additional info init             : " << additional_info_init_exec_time << endl;
-    cout << "Total preprocessing time         : " << preprocess_exec_time << endl;
-    cout << "\n<User & item parameter copy exec time (micro sec)>" << endl;
-    cout << "Precision switching              : " << precision_switching_exec_time / mf_info->params.epoch << endl; 
-    cout << "Total precision switching time   : " << precision_switching_exec_time << endl;
-    cout << "\n<User & item group error comp exec time (micro sec)>" << endl;
-    cout << "Error computation time           : " << error_computation_time / mf_info->params.epoch << endl; 
-    cout << "Total error computation time     : " << error_computation_time << endl;
-    cout << "\n<User & item parameter update exec time (micro sec)>" << endl;
-    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
-    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
-    cout << "Total MF time(ms)                : " << (preprocess_exec_time + precision_switching_exec_time + error_computation_time + sgd_update_execution_time)/1000 << endl;
-    
-    cudaFree(mf_info->d_R);
-    cudaFree(mf_info->d_test_COO);
-    cudaFree(d_rand_state);
-    cudaFree(sgd_info->d_user_group_ptr);
-    cudaFree(sgd_info->d_item_group_ptr);
-    cudaFree(mf_info->d_user_group_prec_info);
-    cudaFree(mf_info->d_item_group_prec_info);
-    cudaFree(d_grad_sum_norm_p);
-    cudaFree(d_grad_sum_norm_q);
-    cudaFree(d_norm_sum_p);
-    cudaFree(d_norm_sum_q);
-    cudaFree(d_e_group);
-    cudaFree(d_user_group_end_idx_shift);
-    cudaFree(d_item_group_end_idx_shift);
-}
-
-void training_mem_quant_mf(Mf_info *mf_info, SGD *sgd_info){
-    curandState* d_rand_state;
-    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
-    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
-
-    gpuErr(cudaPeekAtLastError());
-
-    srand(time(0)); 
-    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
-
-    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
-    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
-    cudaMalloc(&sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k);
-    cudaMalloc(&sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k);
-    gpuErr(cudaPeekAtLastError());
-
-    float* lr_decay_arr = new float[1024];
-
-    for (int i = 0; i < mf_info->params.epoch + 4; i++){
-        lr_decay_arr[i] = static_cast<float>(mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5))));
-    }
-
-    int update_vector_size = 128;
-    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
-    unsigned int div = mf_info->params.thread_block_size/32;
-    double sgd_update_execution_time = 0;
-    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
-    unsigned int group_error_size = error_kernel_work_groups;
-    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
-    unsigned int seg_size = 32;
-    float* d_e_group;
-    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
-    float rmse = 0;
-
-    mf_info->test_COO = test_set_preprocess(mf_info);
-    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
-    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-    
-    for (int e = 0; e < mf_info->params.epoch; e++){
-        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
-        if (mf_info->params.k == 128)        
-        mem_quant_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                                        mf_info->d_R,
-                                                        mf_info->n,
-                                                        sgd_info->d_half_p,
-                                                        sgd_info->d_half_q,
-                                                        d_rand_state,
-                                                        lr_decay_arr[e],
-                                                        mf_info->params.k,
-                                                        1,
-                                                        e,
-                                                        update_count,
-                                                        update_vector_size,
-                                                        mf_info->params.lambda
-                                                        );
-        else if (mf_info->params.k == 64)
-        mem_quant_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                                                        mf_info->d_R,
-                                                        mf_info->n,
-                                                        sgd_info->d_half_p,
-                                                        sgd_info->d_half_q,
-                                                        d_rand_state,
-                                                        lr_decay_arr[e],
-                                                        mf_info->params.k,
-                                                        1,
-                                                        e,
-                                                        update_count,
-                                                        update_vector_size,
-                                                        mf_info->params.lambda
-                                                        );
-        cudaDeviceSynchronize();
-        double sgd_execution_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
-        sgd_update_execution_time += sgd_execution_time_per_epoch;
-        
-        cudaMemcpy(sgd_info->half_p, sgd_info->d_half_p, sizeof(half) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
-        cudaMemcpy(sgd_info->half_q, sgd_info->d_half_q, sizeof(half) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
-        transform_feature_vector_half2float(sgd_info->half_p, sgd_info->p, mf_info->max_user, mf_info->params.k);
-        transform_feature_vector_half2float(sgd_info->half_q, sgd_info->q, mf_info->max_item, mf_info->params.k);
-
-        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
-        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
-    }
-
-    cout << "Execution time(avg per epoch)        : " << sgd_update_execution_time / mf_info->params.epoch << endl;
-    cout << "Total execution time                 : " << sgd_update_execution_time / 1000 << endl;
-    
-    cudaFree(mf_info->d_R);
-    cudaFree(mf_info->d_test_COO);
-    cudaFree(d_rand_state);
-    cudaFree(d_e_group);
-}
-
-void training_switching_only(Mf_info* mf_info, SGD* sgd_info){
-    srand(time(0)); 
-    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
-
-    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
-    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-    
-    mf_info->test_COO = test_set_preprocess(mf_info);
-    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
-    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
-    gpuErr(cudaPeekAtLastError());
-    
-    curandState* d_rand_state;
-    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
-    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
-    cudaDeviceSynchronize();
-    gpuErr(cudaPeekAtLastError());
-
-    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
-    for (int i = 0; i < mf_info->params.epoch; i++){
-        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
-    }
-
-    cudaMalloc(&sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k);
-    cudaMalloc(&sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k);
-    
-    int update_vector_size = 128;
-    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
-    int sample_ratings_num = (float)(update_count * update_vector_size) * mf_info->params.sample_ratio;
-    unsigned int first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
-    unsigned int div = mf_info->params.thread_block_size/32;
-    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
-    unsigned int group_error_size = error_kernel_work_groups;
-    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
-    unsigned int seg_size = 32;
-    float* d_e_group;
-    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
-
-    double additional_info_init_exec_time = 0;
-    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
-    float quantization_error = 0;
-    float *sum_norms;
-    float *d_sum_norms;
-    float *sum_updated_val;
-    float *d_sum_updated_val;
-    unsigned int block_num = mf_info->params.num_workers/div;
-    
-    cudaMalloc(&d_sum_norms, sizeof(float) * mf_info->params.num_workers);
-    cudaMallocHost(&sum_norms, sizeof(float) * mf_info->params.num_workers);
-    cudaMalloc(&d_sum_updated_val, sizeof(float) * mf_info->params.k);
-    cudaMallocHost(&sum_updated_val, sizeof(float) * mf_info->params.k);
-
-    double precision_switching_and_error_comp_execution_time = 0;
-    double sgd_update_execution_time = 0;
-    double rmse;    
-    int start_idx = 5;
-    unsigned int num_groups = 10000;
-
-    float initial_error = 1; 
-    void* p = (void*)(sgd_info->d_half_p);
-    void* q = (void*)(sgd_info->d_half_q);
-    unsigned char cur_precision = 0;//# 0 => half, 1 => single
-
-    int switching_point = 0;
-    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
-
-    for (int e = 0; e < mf_info->params.epoch; e++){
-        bool error_check = false;
-        first_sample_rating_idx = (update_count * update_vector_size) - 0;
-        if (!cur_precision &&(e >= start_idx ) && (e % mf_info->params.interval == (start_idx % mf_info->params.interval)) && mf_info->params.epoch - 1 != e) {
-            error_check = true;
-            first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
-        }
-        std::chrono::time_point<std::chrono::system_clock> precision_switching_and_error_comp_start_time = std::chrono::system_clock::now();
-        if (error_check){
-            initialize_float_array_to_val<<<num_groups, 512>>>(d_sum_updated_val, mf_info->params.k, 0.0f);
-            cudaDeviceSynchronize();
-        }
-        precision_switching_and_error_comp_execution_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_and_error_comp_start_time).count();
-
-        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
-        switching_only_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
-                            mf_info->d_R,
-                            mf_info->n,
-                            (void*)p,
-                            (void*)q,
-                            d_rand_state,
-                            lr_decay_arr[e],
-                            mf_info->params.k,
-                            update_count,
-                            update_vector_size,
-                            mf_info->params.lambda,
-                            cur_precision,
-                            first_sample_rating_idx,
-                            d_sum_updated_val,
-                            d_sum_norms
-                        );
-
-        cudaDeviceSynchronize();
-        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
-        sgd_update_execution_time += sgd_update_time_per_epoch;
-
-        gpuErr(cudaPeekAtLastError());
-        if (!cur_precision){
-            cudaMemcpy(sgd_info->half_p, sgd_info->d_half_p, sizeof(half) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
-            cudaMemcpy(sgd_info->half_q, sgd_info->d_half_q, sizeof(half) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
-
-            transform_feature_vector_half2float(sgd_info->half_p, sgd_info->p, mf_info->max_user, mf_info->params.k);
-            transform_feature_vector_half2float(sgd_info->half_q, sgd_info->q, mf_info->max_item, mf_info->params.k);
-        }else{
-            cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
-            cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
-        }
-
-        precision_switching_and_error_comp_start_time = std::chrono::system_clock::now();
-        if (error_check && e != mf_info->params.epoch - 1){
-
-            cudaMemcpy(sum_norms, d_sum_norms, sizeof(float) * mf_info->params.num_workers, cudaMemcpyDeviceToHost);
-            cudaMemcpy(sum_updated_val, d_sum_updated_val, sizeof(float) * mf_info->params.k, cudaMemcpyDeviceToHost);
-
-            float sum_norms_acc = 0;
-            float norm_acc = 0 ;
-            
-            for (int w = 0; w < mf_info->params.num_workers; w++){
-                norm_acc += sum_norms[w];
-            }
-
-            for (int k = 0; k < mf_info->params.k; k++){
-                sum_norms_acc += powf(sum_updated_val[k],2);
-                sum_updated_val[k] = 0.0f;
-            }
-
-            quantization_error = (float)sum_norms_acc/(float)norm_acc;
-            quantization_error = quantization_error/(float)initial_error;
-            cout << "Quantization error : " << quantization_error << endl;
-            
-            if (e == start_idx) initial_error = quantization_error;
-
-            if (e > start_idx && quantization_error > mf_info->params.error_threshold) {
-                transition_params_half2float(mf_info, sgd_info);
-                cur_precision = 1;
-                p = (void*)(sgd_info->d_p);
-                q = (void*)(sgd_info->d_q);
-                cudaFree(sgd_info->d_half_p);
-                cudaFree(sgd_info->d_half_q);
-                switching_point = e;
-            }
-        }
-        
-        precision_switching_and_error_comp_execution_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_and_error_comp_start_time).count();
-        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
-        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
-    }
-    cout << "Additional info init                            : " << additional_info_init_exec_time << endl;
-    cout << "Total error comp & precision switching time     : " << precision_switching_and_error_comp_execution_time << endl;
-    cout << "Parameters update per epoch                     : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
-    cout << "Total parameters update                         : " << sgd_update_execution_time << endl; 
-    cout << "Total MF time(ms)                               : " <<(additional_info_init_exec_time + precision_switching_and_error_comp_execution_time + sgd_update_execution_time)/1000 << endl;
-    
-    cudaFree(mf_info->d_R);
-    cudaFree(mf_info->d_test_COO);
-    cudaFree(d_rand_state);
-    cudaFree(d_e_group);
-    cudaFree(d_sum_norms);
-    cudaFree(d_sum_updated_val);
-}
+#include <iostream>
+#include <string>
+#include <random>
+#include <curand.h>
+#include <chrono>
+#include <curand_kernel.h>
+#include <algorithm>
+#include <limits>
+#include <cuda_fp16.h>
+#include <thrust/host_vector.h>
+#include <thrust/device_vector.h>
+#include <thrust/sort.h>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include "common.h"
+#include "common_struct.h"
+#include "preprocess_utils.h"
+#include "model_init.h"
+#include "reduce_kernel.h"
+#include "afp_sgd_kernel.h"
+#include "afp_sgd_kernel_k64.h"
+#include "mascot_sgd_kernel.h"
+#include "mascot_sgd_kernel_k64.h"
+#include "muppet_sgd_kernel.h"
+#include "muppet_sgd_kernel_k64.h"
+#include "mpt_sgd_kernel.h"
+#include "mpt_sgd_kernel_k64.h"
+#include "sgd_kernel.h"
+#include "sgd_kernel_k64.h"
+#include "rmse.h"
+#include "cpu_half.h"
+#include "cpu_sgd_kernel.h"
+#include "cpu_mascot_sgd_kernel.h"
+#include "cpu_thread_pool.h"
+#include "cpu_numa_placement.h"
+#include "cpu_contention_sgd_kernel.h"
+#include "cpu_rmse.h"
+#include "cpu_async_eval.h"
+#include "cpu_early_stopping.h"
+#include "cpu_tiered_storage.h"
+#include "cpu_precision_planner.h"
+#include "precision_switching.h"
+#include "shm_snapshot.h"
+#include "checkpoint.h"
+
+using namespace std;
+
+extern __global__ void init_rand_state(curandState*state, int size);
+
+void mascot_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    // Random shuffle rating matrix
+    // A resumed run (-rm) regenerates the order of R from the seed of the checkpoint and takes its grouping.
+    // A checkpoint that can't be read or doesn't match the run ends it; the loaders report why.
+    bool resume = mf_info->resume_path != "";
+    Training_checkpoint ckpt;
+    if (resume && !(load_training_checkpoint(mf_info->resume_path, &ckpt) &&
+                    checkpoint_matches(&ckpt, mf_info, mf_info->params.num_workers, sizeof(curandState) * mf_info->params.num_workers))) exit(1);
+    unsigned int shuffle_seed = resume ? ckpt.header.shuffle_seed : time(0);
+    srand(shuffle_seed); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+
+    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
+    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+    
+    // Testset format conversion
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
+    gpuErr(cudaPeekAtLastError());
+    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
+
+    // Histogram
+    double rating_histogram_execution_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> rating_histogram_start_point = std::chrono::system_clock::now();
+    if (!resume) user_item_rating_histogram(mf_info);
+    rating_histogram_execution_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - rating_histogram_start_point).count();
+
+    // Grouping methods
+    double grouping_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> grouping_start_point = std::chrono::system_clock::now();
+    if (resume) restore_checkpoint_grouping(mf_info, &ckpt, true);
+    else split_group_based_equal_size_not_strict_ret_end_idx(mf_info);
+    grouping_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - grouping_start_point).count();
+
+    // Matrix reconstruction
+    double reconst_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> reconst_start_point = std::chrono::system_clock::now();
+    matrix_reconstruction(mf_info);
+    reconst_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - reconst_start_point).count();
+    
+    // Random state initialization
+    curandState* d_rand_state;
+    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
+    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
+    cudaDeviceSynchronize();
+    if (resume) cudaMemcpy(d_rand_state, ckpt.rand_state.data(), ckpt.rand_state.size(), cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+
+    double cpy2grouped_parameters_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> cpy2grouped_parameters_start_point = std::chrono::system_clock::now();
+
+    // Group info allocation on host
+    cudaMallocHost(&sgd_info->user_group_d_ptr, sizeof(void*) * mf_info->params.user_group_num);
+    cudaMallocHost(&sgd_info->item_group_d_ptr, sizeof(void*) * mf_info->params.item_group_num);
+    cudaMallocHost(&sgd_info->user_group_ptr, sizeof(void*) * mf_info->params.user_group_num);
+    cudaMallocHost(&sgd_info->item_group_ptr, sizeof(void*) * mf_info->params.item_group_num);
+
+    // Group info allocation on device
+    cudaMalloc(&sgd_info->d_user_group_ptr, sizeof(void*) * mf_info->params.user_group_num);
+    cudaMalloc(&sgd_info->d_item_group_ptr, sizeof(void*) * mf_info->params.item_group_num);
+
+    // Copy grouped parameter from cpu to device; a resumed run restores them once the precisions are allocated
+    if (!resume) cpy2grouped_parameters_gpu_for_comparison_indexing(mf_info, sgd_info);
+    cpy2grouped_parameters_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - cpy2grouped_parameters_start_point).count();
+
+    // Learning rate scheduling 
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    // Variables initialization
+    unsigned int update_vector_size = 128;
+    unsigned int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
+    unsigned int sample_ratings_num = (float)(update_count * update_vector_size) * mf_info->params.sample_ratio;
+    unsigned int first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
+    unsigned int div = mf_info->params.thread_block_size/32;
+    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
+    unsigned int group_error_size = error_kernel_work_groups;
+    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
+    unsigned int seg_size = 32;
+    unsigned int block_num = mf_info->params.num_workers/div;
+    unsigned int start_idx = 5;
+    unsigned int num_workers_other_kernels = 10000;
+
+    float* d_e_group;
+    float *grad_sum_norm_p;
+    float *grad_sum_norm_q;
+    float *d_grad_sum_norm_p;
+    float *d_grad_sum_norm_q;
+    float *norm_sum_p;
+    float *norm_sum_q;
+    float *d_norm_sum_p;
+    float *d_norm_sum_q;
+
+    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
+
+    double additional_info_init_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
+
+    cudaMallocHost(&mf_info->user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num);
+    cudaMallocHost(&mf_info->item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num);
+    cudaMalloc(&mf_info->d_user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num);
+    cudaMalloc(&mf_info->d_item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num);
+    cudaMemset(mf_info->d_user_group_prec_info, 0, sizeof(unsigned char) * mf_info->params.user_group_num);
+    cudaMemset(mf_info->d_item_group_prec_info, 0, sizeof(unsigned char) * mf_info->params.item_group_num);
+    cudaMallocHost(&mf_info->user_group_error, sizeof(float) * mf_info->params.user_group_num);
+    cudaMallocHost(&mf_info->item_group_error, sizeof(float) * mf_info->params.item_group_num);
+
+    cudaMalloc(&d_grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num);
+    cudaMalloc(&d_grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num);
+    cudaMallocHost(&grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num);
+    cudaMallocHost(&grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num);
+    cudaMalloc(&d_norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num);
+    cudaMalloc(&d_norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num);
+    cudaMallocHost(&norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num);
+    cudaMallocHost(&norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num);
+    
+    float* initial_user_group_error = new float[mf_info->params.user_group_num];
+    float* initial_item_group_error = new float[mf_info->params.item_group_num];
+
+    for (int i = 0; i <mf_info->params.user_group_num; i++) initial_user_group_error[i] = 1.0f;
+    for (int i = 0; i <mf_info->params.item_group_num; i++) initial_item_group_error[i] = 1.0f;
+
+    int first_epoch = 0;
+    if (resume){
+        memcpy(mf_info->user_group_prec_info, ckpt.user_group_prec.data(), mf_info->params.user_group_num);
+        memcpy(mf_info->item_group_prec_info, ckpt.item_group_prec.data(), mf_info->params.item_group_num);
+        memcpy(mf_info->user_group_error, ckpt.user_group_error.data(), sizeof(float) * mf_info->params.user_group_num);
+        memcpy(mf_info->item_group_error, ckpt.item_group_error.data(), sizeof(float) * mf_info->params.item_group_num);
+        memcpy(initial_user_group_error, ckpt.initial_user_group_error.data(), sizeof(float) * mf_info->params.user_group_num);
+        memcpy(initial_item_group_error, ckpt.initial_item_group_error.data(), sizeof(float) * mf_info->params.item_group_num);
+        restore_grouped_parameters_gpu(mf_info, sgd_info, &ckpt);
+        first_epoch = ckpt.header.epochs_done;
+    }
+
+    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
+
+    size_t user_idx_table_cache_size = mf_info->params.user_group_num > 62 ? sizeof(unsigned int) * (mf_info->params.user_group_num - 62) : 0;
+    size_t item_idx_table_cache_size = mf_info->params.item_group_num > 62 ? sizeof(unsigned int) * (mf_info->params.item_group_num - 62) : 0;
+    size_t shared_mem_size = (3*sizeof(unsigned int)*(mf_info->params.user_group_num + mf_info->params.item_group_num)) +
+                              user_idx_table_cache_size +
+                              item_idx_table_cache_size + 
+                              (sizeof(unsigned char)*(mf_info->params.user_group_num + mf_info->params.item_group_num));
+
+    double error_computation_time = 0;
+    double precision_switching_exec_time = 0;
+    double sgd_update_execution_time = 0;
+    double rmse;  
+    vector<char> rand_state(mf_info->checkpoint_path != "" ? sizeof(curandState) * mf_info->params.num_workers : 0);
+    Checkpoint_writer checkpoint_writer;
+    if (mf_info->checkpoint_path != "") init_checkpoint_writer(&checkpoint_writer, mf_info->checkpoint_path, mf_info->params.checkpoint_delta_threshold, mf_info->params.checkpoint_full_interval);
+
+    // Shared memory snapshots (-sn): the grouped parameters are flattened in sorted index order on the host.
+    Shm_snapshot_publisher publisher;
+    bool publish_snapshots = mf_info->snapshot_name != "" && init_shm_snapshot_publisher(&publisher, mf_info->snapshot_name);
+    auto publish_snapshot = [&](int epochs_done){
+        cpy_grouped2flat_parameters_gpu(mf_info, sgd_info);
+        publish_shm_snapshot(&publisher, mf_info, sgd_info->p, sgd_info->q, SNAPSHOT_SORTED_ORDER, SNAPSHOT_INTERNAL_ORDER, true, epochs_done);
+    };
+
+    for (int e = first_epoch; e < mf_info->params.epoch; e++){
+        bool error_check = false;
+        first_sample_rating_idx = (update_count * update_vector_size) - 0;
+
+        if ((e >= start_idx ) && (e % mf_info->params.interval == (start_idx % mf_info->params.interval)) && mf_info->params.epoch - 1 != e) {
+            error_check = true;
+            first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
+        }
+
+        std::chrono::time_point<std::chrono::system_clock> error_computation_start_time = std::chrono::system_clock::now();
+        if (error_check && mf_info->params.epoch -1 != e){
+            initialize_float_array_to_val<<<num_workers_other_kernels, 512>>>(d_grad_sum_norm_p, mf_info->params.user_group_num * mf_info->params.k, 0.0f);
+            initialize_float_array_to_val<<<num_workers_other_kernels, 512>>>(d_grad_sum_norm_q, mf_info->params.item_group_num * mf_info->params.k, 0.0f);
+            cudaDeviceSynchronize();
+        }
+
+        double error_init_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+        error_computation_time += error_init_time;
+    
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        if (mf_info->params.k == 128){
+            mascot_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size, shared_mem_size>>>(
+                                                        mf_info->d_R,
+                                                        mf_info->n,
+                                                        (void**)sgd_info->d_user_group_ptr,
+                                                        (void**)sgd_info->d_item_group_ptr,
+                                                        d_rand_state,
+                                                        lr_decay_arr[e],
+                                                        mf_info->params.k,
+                                                        update_count,
+                                                        update_vector_size,
+                                                        mf_info->params.lambda,
+                                                        mf_info->d_user_group_end_idx,
+                                                        mf_info->d_item_group_end_idx,
+                                                        mf_info->d_user_group_prec_info,
+                                                        mf_info->d_item_group_prec_info,
+                                                        d_grad_sum_norm_p,
+                                                        d_grad_sum_norm_q,
+                                                        d_norm_sum_p,
+                                                        d_norm_sum_q,
+                                                        first_sample_rating_idx,
+                                                        (int)mf_info->params.user_group_num,
+                                                        (int)mf_info->params.item_group_num
+                                                        );
+        }
+        else if (mf_info->params.k == 64){
+            mascot_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size, shared_mem_size>>>(
+                                                        mf_info->d_R,
+                                                        mf_info->n,
+                                                        (void**)sgd_info->d_user_group_ptr,
+                                                        (void**)sgd_info->d_item_group_ptr,
+                                                        d_rand_state,
+                                                        lr_decay_arr[e],
+                                                        mf_info->params.k,
+                                                        update_count,
+                                                        update_vector_size,
+                                                        mf_info->params.lambda,
+                                                        mf_info->d_user_group_end_idx,
+                                                        mf_info->d_item_group_end_idx,
+                                                        mf_info->d_user_group_prec_info,
+                                                        mf_info->d_item_group_prec_info,
+                                                        d_grad_sum_norm_p,
+                                                        d_grad_sum_norm_q,
+                                                        d_norm_sum_p,
+                                                        d_norm_sum_q,
+                                                        first_sample_rating_idx,
+                                                        (int)mf_info->params.user_group_num,
+                                                        (int)mf_info->params.item_group_num
+                                                        );
+        }
+
+        cudaDeviceSynchronize();
+        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_update_time_per_epoch;
+        gpuErr(cudaPeekAtLastError());  
+
+        error_computation_start_time = std::chrono::system_clock::now();
+        double error_copy_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+        error_computation_time += error_copy_time;
+
+
+        error_computation_start_time = std::chrono::system_clock::now();
+        if (error_check && e != mf_info->params.epoch - 1){
+            cudaMemcpy(grad_sum_norm_p, d_grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num, cudaMemcpyDeviceToHost);
+            cudaMemcpy(grad_sum_norm_q, d_grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num, cudaMemcpyDeviceToHost);
+            cudaMemcpy(norm_sum_p, d_norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num, cudaMemcpyDeviceToHost);
+            cudaMemcpy(norm_sum_q, d_norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num, cudaMemcpyDeviceToHost);
+        }
+        double error_transfer_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+        error_computation_time += error_transfer_time;
+        
+        if (error_check && e != mf_info->params.epoch - 1){
+
+            cout << "\n<User groups>\n";
+            for (int i = 0; i < mf_info->params.user_group_num; i++){
+                error_computation_start_time = std::chrono::system_clock::now();
+                float each_group_grad_sum_norm_acc = 0;
+                float each_group_norm_acc = 0;
+                if (mf_info->user_group_prec_info[i] == 0){
+                    
+                    for (int k = 0; k < mf_info->params.k; k++){
+                        each_group_grad_sum_norm_acc+=powf(grad_sum_norm_p[i*mf_info->params.k + k],2);
+                        grad_sum_norm_p[i*mf_info->params.k + k] = 0;
+                    }
+                    for (int j = 0; j < block_num; j++){
+                        each_group_norm_acc += norm_sum_p[i * block_num + j];
+                    }
+                    mf_info->user_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
+                    mf_info->user_group_error[i] /= initial_user_group_error[i];
+                }
+                else{
+                    mf_info->user_group_error[i] = -1;
+                }
+                error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+                
+                if (mf_info->user_group_error[i] == -1) cout << "-1" << " ";
+                else cout << mf_info->user_group_error[i] << " ";
+            }
+
+            cout << "\n<Item groups>\n";
+            for (int i = 0; i < mf_info->params.item_group_num; i++){
+                error_computation_start_time = std::chrono::system_clock::now();
+                float each_group_grad_sum_norm_acc = 0;
+                float each_group_norm_acc = 0;
+                if (mf_info->item_group_prec_info[i] == 0){
+
+                    for (int k = 0; k < mf_info->params.k; k++){
+                        each_group_grad_sum_norm_acc+=powf(grad_sum_norm_q[i*mf_info->params.k + k],2);
+                        grad_sum_norm_q[i*mf_info->params.k + k] = 0;
+                    }
+
+                    for (int j = 0; j < block_num; j++){
+                        each_group_norm_acc += norm_sum_q[i * block_num + j];
+                    }
+                    mf_info->item_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
+                    mf_info->item_group_error[i] /= initial_item_group_error[i];
+                }
+                else{
+                    mf_info->item_group_error[i] = -1;
+                }
+                error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+                
+                if (mf_info->item_group_error[i] == -1) cout << "-1" << " ";    
+                else cout << mf_info->item_group_error[i] << " ";
+            }
+            cout << "\n";
+
+            if (e == start_idx){
+                for (int i = 0; i < mf_info->params.user_group_num; i++){
+                    initial_user_group_error[i] = mf_info->user_group_error[i];
+                }
+                for (int i = 0; i < mf_info->params.item_group_num; i++){
+                    initial_item_group_error[i] = mf_info->item_group_error[i];
+                }
+            }
+        }
+        
+        std::chrono::time_point<std::chrono::system_clock> precision_switching_start_point = std::chrono::system_clock::now();
+        if (error_check && e > start_idx && e != mf_info->params.epoch - 1) precision_switching_by_groups_grad_diversity(mf_info, sgd_info);
+        precision_switching_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_start_point).count();
+
+        rmse = gpu_test_rmse_grouped(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups);
+        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;         
+        if (publish_snapshots && shm_snapshot_due(mf_info, e)) publish_snapshot(e + 1);
+        if (checkpoint_due(mf_info, e)){
+            // The device to host copy is part of the snapshot; the host copies are only read while serializing.
+            std::chrono::time_point<std::chrono::system_clock> checkpoint_start_point = std::chrono::system_clock::now();
+            cpy_grouped_parameters_d2h(mf_info, sgd_info);
+            cudaMemcpy(rand_state.data(), d_rand_state, rand_state.size(), cudaMemcpyDeviceToHost);
+            checkpoint_writer.snapshot_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - checkpoint_start_point).count();
+            queue_training_checkpoint(&checkpoint_writer, mf_info, sgd_info->user_group_ptr, sgd_info->item_group_ptr, initial_user_group_error,
+                                      initial_item_group_error, mf_info->params.num_workers, shuffle_seed, e + 1, rand_state.data(), rand_state.size());
+        }
+    }
+    if (mf_info->checkpoint_path != "") finish_checkpoint_writer(&checkpoint_writer);
+    if (publish_snapshots){
+        if (shm_snapshot_pending(&publisher, mf_info->params.epoch)) publish_snapshot(mf_info->params.epoch);
+        close_shm_snapshot_publisher(&publisher);
+    }
+
+    cudaMemcpy(mf_info->test_COO, mf_info->d_test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyDeviceToHost);
+
+    double preprocess_exec_time = rating_histogram_execution_time + grouping_exec_time + reconst_exec_time + cpy2grouped_parameters_exec_time + additional_info_init_exec_time;
+    cout << "\n<Preprocessing time (micro sec)>" << endl;
+    cout << "Rating histogram                 : " << rating_histogram_execution_time << endl;
+    cout << "Grouping                         : " << grouping_exec_time << endl;
+    cout << "Matrix reconstruction            : " << reconst_exec_time << endl;
+    cout << "Copy to grouped params           : " << cpy2grouped_parameters_exec_time << endl;
+    cout << "Additional info init             : " << additional_info_init_exec_time << endl;
+    cout << "Total preprocessing time         : " << preprocess_exec_time << endl;
+    cout << "\n<User & item parameter copy exec time (micro sec)>" << endl;
+    cout << "Precision switching              : " << precision_switching_exec_time / mf_info->params.epoch << endl; 
+    cout << "Total precision switching time   : " << precision_switching_exec_time << endl;
+    cout << "\n<User & item group error comp exec time (micro sec)>" << endl;
+    cout << "Error computation time           : " << error_computation_time / mf_info->params.epoch << endl; 
+    cout << "Total error computation time     : " << error_computation_time << endl;
+    cout << "\n<User & item parameter update exec time (micro sec)>" << endl;
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
+    cout << "Total MF time(ms)                : " << (preprocess_exec_time + precision_switching_exec_time + error_computation_time + sgd_update_execution_time)/1000 << endl;
+
+    cudaFree(mf_info->d_R);
+    cudaFree(mf_info->d_test_COO);
+    cudaFree(d_rand_state);
+    cudaFree(d_e_group);
+    cudaFree(sgd_info->d_user_group_ptr);
+    cudaFree(sgd_info->d_item_group_ptr);
+    cudaFree(mf_info->d_user_group_prec_info);
+    cudaFree(mf_info->d_item_group_prec_info);
+    cudaFree(d_grad_sum_norm_p);
+    cudaFree(d_grad_sum_norm_q);
+    cudaFree(d_norm_sum_p);
+    cudaFree(d_norm_sum_q);
+    cudaFree(mf_info->d_user_group_end_idx);
+    cudaFree(mf_info->d_item_group_end_idx);
+}
+
+void adaptive_fixed_point_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+
+    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
+    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+    
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
+    gpuErr(cudaPeekAtLastError());
+    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
+    
+    curandState* d_rand_state;
+    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
+    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
+    cudaDeviceSynchronize();
+    gpuErr(cudaPeekAtLastError());
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+    
+    int update_vector_size = 128;
+    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));    
+    unsigned int div = mf_info->params.thread_block_size/32;
+    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
+    unsigned int group_error_size = error_kernel_work_groups;
+    float* d_e_group;
+    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
+    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
+    unsigned int seg_size = 32;
+    unsigned int block_num = mf_info->params.num_workers/div;
+    int start_idx = 5;
+    unsigned int num_groups = 10000;
+    double precision_switching_and_error_comp_execution_time = 0;
+    double sgd_update_execution_time = 0;
+    double rmse;    
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        
+        if (mf_info->params.k == 128){
+            afp_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                mf_info->d_R,
+                                mf_info->n,
+                                sgd_info->d_p,
+                                sgd_info->d_q,
+                                d_rand_state,
+                                lr_decay_arr[e],
+                                mf_info->params.k,
+                                e,
+                                update_count,
+                                update_vector_size,
+                                mf_info->params.lambda
+            );
+        }else if (mf_info->params.k == 64){
+            afp_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                mf_info->d_R,
+                                mf_info->n,
+                                sgd_info->d_p,
+                                sgd_info->d_q,
+                                d_rand_state,
+                                lr_decay_arr[e],
+                                mf_info->params.k,
+                                e,
+                                update_count,
+                                update_vector_size,
+                                mf_info->params.lambda
+            );
+        }
+        cudaDeviceSynchronize(); 
+        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_update_time_per_epoch;
+
+        cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
+        cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
+        
+        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
+        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
+    }
+
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
+    cout << "Total MF time(ms)                : " << (sgd_update_execution_time)/1000 << endl;
+    
+    cudaFree(mf_info->d_R);
+    cudaFree(mf_info->d_test_COO);
+    cudaFree(d_rand_state);
+    cudaFree(d_e_group);
+}
+
+void muppet_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+
+    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
+    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+    
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
+    gpuErr(cudaPeekAtLastError());
+    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
+    
+    curandState* d_rand_state;
+    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
+    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
+    cudaDeviceSynchronize();
+    gpuErr(cudaPeekAtLastError());
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+    
+    int update_vector_size = 128;
+    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
+    int sample_ratings_num = (float)(update_count * update_vector_size) * mf_info->params.sample_ratio;
+    unsigned int first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
+    unsigned int div = mf_info->params.thread_block_size/32;
+    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
+    unsigned int group_error_size = error_kernel_work_groups;
+    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
+    unsigned int seg_size = 32;
+    unsigned int block_num = mf_info->params.num_workers/div;
+    float* d_e_group;
+    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
+    float *sum_norms;
+    float *d_sum_norms;
+    float *sum_updated_val;
+    float *d_sum_updated_val;
+
+    double additional_info_init_exec_time = 0;
+    double sgd_update_execution_time = 0;
+    double error_computation_time = 0;
+
+    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
+    float *sum_norms_epoch = new float[mf_info->params.epoch];
+    float *sum_updated_val_epoch = new float[mf_info->params.k * mf_info->params.epoch];
+    float *gradient_diversity_per_epoch = new float[mf_info->params.epoch];
+    float *sum_updated_val_acc = new float[mf_info->params.k];
+    cudaMalloc(&d_sum_norms, sizeof(float) * mf_info->params.num_workers);
+    cudaMallocHost(&sum_norms, sizeof(float) * mf_info->params.num_workers);
+    cudaMalloc(&d_sum_updated_val, sizeof(float) * mf_info->params.k);
+    cudaMallocHost(&sum_updated_val, sizeof(float) * mf_info->params.k);
+    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
+
+    double rmse;    
+    int start_idx = 5;
+    unsigned int num_groups = 10000;
+    float initial_error = 1; 
+    int resolution_size = 3;
+    float max_grad_diversity = -1.f;
+    float alpha  = 1.0f;
+    float beta = 1.5f;
+    float lambda_for_threshold = 0.3f;
+    int gamma = 1;
+    int violation_times = 0;
+    unsigned char bit_width_set[5] = {8, 12, 14 ,16, 32};
+    int switched_epoch = -1;
+    int precision_idx;
+
+    if (mf_info->is_yahoo) precision_idx = 1;
+    else precision_idx = 0;
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        float decaying_threshold = alpha + (beta * exp(-1*lambda_for_threshold*(e)));
+        std::chrono::time_point<std::chrono::system_clock> error_computation_start_time = std::chrono::system_clock::now();
+        //! clean device mem (not neccesary)
+        for (int k = 0; k < mf_info->params.k; k++) sum_updated_val[k] = 0;
+        cudaMemcpy(d_sum_updated_val, sum_updated_val, sizeof(float) * mf_info->params.k, cudaMemcpyHostToDevice);
+        error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        
+        if (mf_info->params.k == 128){
+            muppet_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                mf_info->d_R,
+                                mf_info->n,
+                                sgd_info->d_p,
+                                sgd_info->d_q,
+                                d_rand_state,
+                                lr_decay_arr[e],
+                                mf_info->params.k,
+                                update_count,
+                                update_vector_size,
+                                mf_info->params.lambda,
+                                first_sample_rating_idx,
+                                d_sum_updated_val,
+                                d_sum_norms,
+                                (unsigned char)bit_width_set[precision_idx],
+                                (unsigned char)bit_width_set[precision_idx]
+                            );
+        }else if (mf_info->params.k == 64){
+            muppet_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                mf_info->d_R,
+                                mf_info->n,
+                                sgd_info->d_p,
+                                sgd_info->d_q,
+                                d_rand_state,
+                                lr_decay_arr[e],
+                                mf_info->params.k,
+                                update_count,
+                                update_vector_size,
+                                mf_info->params.lambda,
+                                first_sample_rating_idx,
+                                d_sum_updated_val,
+                                d_sum_norms,
+                                (unsigned char)bit_width_set[precision_idx],
+                                (unsigned char)bit_width_set[precision_idx]
+                            );
+        }
+
+        cudaDeviceSynchronize(); 
+        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_update_time_per_epoch;
+        
+        cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
+        cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
+        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
+        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
+
+        error_computation_start_time = std::chrono::system_clock::now();
+        cudaMemcpy(sum_norms, d_sum_norms, sizeof(float) * mf_info->params.num_workers, cudaMemcpyDeviceToHost);
+        cudaMemcpy(sum_updated_val, d_sum_updated_val, sizeof(float) * mf_info->params.k, cudaMemcpyDeviceToHost);
+        
+        float norm_acc = 0 ;
+        
+        for (int w = 0; w < mf_info->params.num_workers; w++) norm_acc += sum_norms[w];
+        sum_norms_epoch[e] = norm_acc;
+        for (int k = 0; k < mf_info->params.k; k++) {
+            sum_updated_val_acc[k] = 0;
+            sum_updated_val_epoch[e * mf_info->params.k + k] = sum_updated_val[k];
+        }
+        error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+
+        if (e - switched_epoch >= resolution_size){
+            error_computation_start_time = std::chrono::system_clock::now();
+            float sum_norms_resolution = 0;
+            float sum_updated_val_norm = 0;
+            for (int wi = e - resolution_size + 1; wi <= e; wi++){
+                sum_norms_resolution += sum_norms_epoch[wi];
+                for (int k = 0; k < mf_info->params.k; k++) sum_updated_val_acc[k] += sum_updated_val_epoch[wi * mf_info->params.k + k];
+            }
+
+            for (int k = 0; k < mf_info->params.k; k++) {
+                sum_updated_val_norm += powf(sum_updated_val_acc[k],2);
+            }
+
+            float grad_diversity_this_epoch = sum_norms_resolution/sum_updated_val_norm;
+            max_grad_diversity = max_grad_diversity < grad_diversity_this_epoch ? grad_diversity_this_epoch : max_grad_diversity;
+            float grad_ratio = max_grad_diversity/grad_diversity_this_epoch;
+            
+            if (grad_ratio > decaying_threshold && ++violation_times == gamma) {
+                precision_idx++;
+                switched_epoch = e;
+                max_grad_diversity = -1.f;
+                violation_times = 0;
+            }
+            error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+        }
+    }
+
+    cout << "Error computation time           : " << error_computation_time << endl; 
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
+    cout << "Total MF time(ms)                : " << (error_computation_time + sgd_update_execution_time)/1000 << endl;
+    
+    cudaFree(mf_info->d_R);
+    cudaFree(mf_info->d_test_COO);
+    cudaFree(d_rand_state);
+    cudaFree(d_e_group);
+    cudaFree(d_sum_norms);
+    cudaFree(d_sum_updated_val);
+}
+
+void mixed_precision_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    
+    curandState* d_rand_state;
+    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
+    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
+    cudaDeviceSynchronize();
+    gpuErr(cudaPeekAtLastError());
+    
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+
+    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
+    cudaMalloc(&(sgd_info->d_p), sizeof(float) * mf_info->max_user * mf_info->params.k);
+    cudaMalloc(&(sgd_info->d_q), sizeof(float) * mf_info->max_item * mf_info->params.k);
+    
+    double master_copy_setting_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> master_copy_setting_start_time = std::chrono::system_clock::now();
+    transform_feature_vector_half2float((short*)sgd_info->half_p, sgd_info->p, mf_info->max_user, mf_info->params.k);
+    transform_feature_vector_half2float((short*)sgd_info->half_q, sgd_info->q, mf_info->max_item, mf_info->params.k);
+    cudaMemcpy(sgd_info->d_p, sgd_info->p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyHostToDevice);
+    cudaMemcpy(sgd_info->d_q, sgd_info->q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyHostToDevice);
+    master_copy_setting_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - master_copy_setting_start_time).count();
+    
+    gpuErr(cudaPeekAtLastError());
+
+    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
+
+    //* Learning rate initialization
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    int update_vector_size = 128;
+    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
+    unsigned int div = mf_info->params.thread_block_size/32;
+    
+    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
+    unsigned int group_error_size = error_kernel_work_groups;
+    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
+    unsigned int seg_size = 32;
+    float* d_e_group;
+    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
+
+    gpuErr(cudaPeekAtLastError());
+
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
+    gpuErr(cudaPeekAtLastError());
+    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);  
+
+    float scaling_factor = 1000;
+    __half scaled_lambda = __float2half_rn(mf_info->params.lambda * scaling_factor);
+    double rmse;
+    double sgd_update_execution_time = 0;
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        if (mf_info->params.k == 128){
+            mpt_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                                    mf_info->d_R,
+                                                    mf_info->n,
+                                                    sgd_info->d_p,
+                                                    sgd_info->d_q,
+                                                    d_rand_state,
+                                                    lr_decay_arr[e],
+                                                    mf_info->params.k,
+                                                    update_count,
+                                                    update_vector_size,
+                                                    scaled_lambda,
+                                                    scaling_factor
+                                                    );
+        }else{
+            mpt_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                                    mf_info->d_R,
+                                                    mf_info->n,
+                                                    sgd_info->d_p,
+                                                    sgd_info->d_q,
+                                                    d_rand_state,
+                                                    lr_decay_arr[e],
+                                                    mf_info->params.k,
+                                                    update_count,
+                                                    update_vector_size,
+                                                    scaled_lambda,
+                                                    scaling_factor
+                                                    );
+        }
+        cudaDeviceSynchronize();
+        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_update_time_per_epoch;
+
+        cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
+        cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
+        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
+
+        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
+    }
+
+    cout << "Parameters update per epoch                     : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
+    cout << "Total parameters update                         : " << sgd_update_execution_time / 1000 << endl; 
+    
+    cudaFree(mf_info->d_R);
+    cudaFree(mf_info->d_test_COO);
+    cudaFree(d_rand_state);
+    cudaFree(d_e_group);
+}
+
+void training_single_mf(Mf_info *mf_info, SGD *sgd_info){
+
+    size_t triplet_host_to_device_transfer_size = 0;
+
+    size_t P_device_to_host_transfer_size = 0;
+    size_t Q_device_to_host_transfer_size = 0;
+    size_t total_device_to_host_transfer_size = 0;
+    
+    double triplet_host_to_device_transfer_time{};
+
+    double P_device_to_host_transfer_time{};
+    double Q_device_to_host_transfer_time{};
+    double total_device_to_host_transfer_time{};
+
+    curandState* d_rand_state;
+    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
+    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
+    gpuErr(cudaPeekAtLastError());
+    
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+
+    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
+    cudaMalloc(&(sgd_info->d_p), sizeof(float) * mf_info->max_user * mf_info->params.k);
+    cudaMalloc(&(sgd_info->d_q), sizeof(float) * mf_info->max_item * mf_info->params.k);
+    gpuErr(cudaPeekAtLastError());
+
+    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
+    cudaMemcpy(sgd_info->d_p, sgd_info->p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyHostToDevice);
+    cudaMemcpy(sgd_info->d_q, sgd_info->q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+
+    float* lr_decay_arr = new float[2048];
+
+    for (int i = 0; i < mf_info->params.epoch + 4; i++){
+        lr_decay_arr[i] = static_cast<float>(mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5))));
+    }
+
+    int update_vector_size = 128;
+    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
+    unsigned int div = mf_info->params.thread_block_size/32;
+    double sgd_update_execution_time = 0;
+    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
+    unsigned int group_error_size = error_kernel_work_groups;
+    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
+    unsigned int seg_size = 32;
+    float* d_e_group;
+    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
+    float rmse = 0; 
+
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
+    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+    
+    Shm_snapshot_publisher publisher;
+    bool publish_snapshots = mf_info->snapshot_name != "" && init_shm_snapshot_publisher(&publisher, mf_info->snapshot_name);
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        if (mf_info->params.k == 128)
+        single_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                                        mf_info->d_R,
+                                                        mf_info->n,
+                                                        sgd_info->d_p,
+                                                        sgd_info->d_q,
+                                                        d_rand_state,
+                                                        lr_decay_arr[e],
+                                                        mf_info->params.k,
+                                                        update_count,
+                                                        update_vector_size,
+                                                        mf_info->params.lambda
+                                                        );
+
+        else if (mf_info->params.k == 64)
+        single_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                                        mf_info->d_R,
+                                                        mf_info->n,
+                                                        sgd_info->d_p,
+                                                        sgd_info->d_q,
+                                                        d_rand_state,
+                                                        lr_decay_arr[e],
+                                                        mf_info->params.k,
+                                                        update_count,
+                                                        update_vector_size,
+                                                        mf_info->params.lambda
+                                                        );
+
+        cudaDeviceSynchronize();
+        double sgd_execution_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_execution_time_per_epoch;
+        
+        cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
+        cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
+        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
+
+        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
+        if (publish_snapshots && shm_snapshot_due(mf_info, e))
+            publish_shm_snapshot(&publisher, mf_info, sgd_info->p, sgd_info->q, SNAPSHOT_INTERNAL_ORDER, SNAPSHOT_INTERNAL_ORDER, false, e + 1);
+    }
+    if (publish_snapshots){
+        if (shm_snapshot_pending(&publisher, mf_info->params.epoch))
+            publish_shm_snapshot(&publisher, mf_info, sgd_info->p, sgd_info->q, SNAPSHOT_INTERNAL_ORDER, SNAPSHOT_INTERNAL_ORDER, false, mf_info->params.epoch);
+        close_shm_snapshot_publisher(&publisher);
+    }
+
+    cout << "Execution time(avg per epoch)        : " << sgd_update_execution_time / mf_info->params.epoch << endl;
+    cout << "Total execution time                 : " << sgd_update_execution_time / 1000 << endl;
+    
+    cudaFree(mf_info->d_R);
+    cudaFree(mf_info->d_test_COO);
+    cudaFree(d_rand_state);
+    cudaFree(d_e_group);
+}
+
+void mascot_training_mf_naive(Mf_info* mf_info, SGD* sgd_info){
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+
+    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
+    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+    
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
+    gpuErr(cudaPeekAtLastError());
+    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
+
+    double rating_histogram_execution_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> rating_histogram_start_point = std::chrono::system_clock::now();
+    user_item_rating_histogram(mf_info);
+    rating_histogram_execution_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - rating_histogram_start_point).count();
+
+    double grouping_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> grouping_start_point = std::chrono::system_clock::now();
+    split_group_based_equal_size_not_strict_ret_end_idx(mf_info);
+    grouping_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - grouping_start_point).count();
+
+    double reconst_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> reconst_start_point = std::chrono::system_clock::now();
+    matrix_reconstruction(mf_info);
+    reconst_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - reconst_start_point).count();
+    
+    curandState* d_rand_state;
+    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
+    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
+    cudaDeviceSynchronize();
+    gpuErr(cudaPeekAtLastError());
+
+    double cpy2grouped_parameters_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> cpy2grouped_parameters_start_point = std::chrono::system_clock::now();
+
+    cudaMallocHost(&sgd_info->user_group_d_ptr, sizeof(void*) * mf_info->params.user_group_num);
+    cudaMallocHost(&sgd_info->item_group_d_ptr, sizeof(void*) * mf_info->params.item_group_num);
+    cudaMallocHost(&sgd_info->user_group_ptr, sizeof(void*) * mf_info->params.user_group_num);
+    cudaMallocHost(&sgd_info->item_group_ptr, sizeof(void*) * mf_info->params.item_group_num);
+
+    cudaMalloc(&sgd_info->d_user_group_ptr, sizeof(void*) * mf_info->params.user_group_num);
+    cudaMalloc(&sgd_info->d_item_group_ptr, sizeof(void*) * mf_info->params.item_group_num);
+
+    cpy2grouped_parameters_gpu_for_comparison_indexing(mf_info, sgd_info);
+    cpy2grouped_parameters_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - cpy2grouped_parameters_start_point).count();
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    int update_vector_size = 128;
+    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
+    int sample_ratings_num = (float)(update_count * update_vector_size) * mf_info->params.sample_ratio;
+    unsigned int first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
+    unsigned int div = mf_info->params.thread_block_size/32;
+    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
+    unsigned int group_error_size = error_kernel_work_groups;
+    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
+    unsigned int seg_size = 32;
+    unsigned int block_num = mf_info->params.num_workers/div;
+    
+    float* d_e_group;
+    float *grad_sum_norm_p;
+    float *grad_sum_norm_q;
+    float *d_grad_sum_norm_p;
+    float *d_grad_sum_norm_q;
+    float *norm_sum_p;
+    float *norm_sum_q;
+    float *d_norm_sum_p;
+    float *d_norm_sum_q;
+    float* d_user_group_sum_updated_val;
+    float* d_item_group_sum_updated_val;
+
+    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
+
+    double additional_info_init_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
+
+    cudaMallocHost(&mf_info->user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num);
+    cudaMallocHost(&mf_info->item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num);
+    cudaMalloc(&mf_info->d_user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num);
+    cudaMalloc(&mf_info->d_item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num);
+    cudaMemset(mf_info->d_user_group_prec_info, 0, sizeof(unsigned char) * mf_info->params.user_group_num);
+    cudaMemset(mf_info->d_item_group_prec_info, 0, sizeof(unsigned char) * mf_info->params.item_group_num);
+    cudaMallocHost(&mf_info->user_group_error, sizeof(float) * mf_info->params.user_group_num);
+    cudaMallocHost(&mf_info->item_group_error, sizeof(float) * mf_info->params.item_group_num);
+
+    cudaMalloc(&d_grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num);
+    cudaMalloc(&d_grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num);
+    cudaMallocHost(&grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num);
+    cudaMallocHost(&grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num);
+    cudaMalloc(&d_norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num);
+    cudaMalloc(&d_norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num);
+    cudaMallocHost(&norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num);
+    cudaMallocHost(&norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num);
+
+    unsigned int* user_group_end_idx_shift = new unsigned int[mf_info->params.user_group_num + 1];
+    unsigned int* item_group_end_idx_shift = new unsigned int[mf_info->params.item_group_num + 1];
+    unsigned int* d_user_group_end_idx_shift;
+    unsigned int* d_item_group_end_idx_shift;
+
+    user_group_end_idx_shift[0] = -1;
+    item_group_end_idx_shift[0] = -1;
+
+    for (int i = 0; i < mf_info->params.user_group_num; i++){
+        user_group_end_idx_shift[i+1] = mf_info->user_group_end_idx[i];
+    }
+
+    for (int i = 0; i < mf_info->params.item_group_num; i++){
+        item_group_end_idx_shift[i+1] = mf_info->item_group_end_idx[i];
+    }
+
+    cudaMalloc(&d_user_group_end_idx_shift, sizeof(unsigned int) * (mf_info->params.user_group_num + 1));
+    cudaMalloc(&d_item_group_end_idx_shift, sizeof(unsigned int) * (mf_info->params.item_group_num + 1));
+    cudaMemcpy(d_user_group_end_idx_shift, user_group_end_idx_shift, sizeof(unsigned int) * (mf_info->params.user_group_num + 1), cudaMemcpyHostToDevice);
+    cudaMemcpy(d_item_group_end_idx_shift, item_group_end_idx_shift, sizeof(unsigned int) * (mf_info->params.item_group_num + 1), cudaMemcpyHostToDevice);
+
+    double error_computation_time = 0;
+    double precision_switching_exec_time = 0;
+    double sgd_update_execution_time = 0;
+    double rmse;    
+    int start_idx = 5;
+    unsigned int num_groups = 10000;
+
+    float* initial_user_group_error = new float[mf_info->params.user_group_num];
+    float* initial_item_group_error = new float[mf_info->params.item_group_num];
+
+    for (int i = 0; i <mf_info->params.user_group_num; i++) initial_user_group_error[i] = 1.0f;
+    for (int i = 0; i <mf_info->params.item_group_num; i++) initial_item_group_error[i] = 1.0f;
+    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        bool error_check = false;
+        first_sample_rating_idx = (update_count * update_vector_size) - 0;
+
+        if ((e >= start_idx ) && (e % mf_info->params.interval == (start_idx % mf_info->params.interval)) && mf_info->params.epoch - 1 != e) {
+            error_check = true;
+            first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
+        }
+
+        std::chrono::time_point<std::chrono::system_clock> error_computation_start_time = std::chrono::system_clock::now();
+        if (error_check){
+            initialize_float_array_to_val<<<num_groups, 512>>>(d_grad_sum_norm_p, mf_info->params.user_group_num * mf_info->params.k, 0.0f);
+            initialize_float_array_to_val<<<num_groups, 512>>>(d_grad_sum_norm_q, mf_info->params.item_group_num * mf_info->params.k, 0.0f);
+            cudaDeviceSynchronize();
+        }
+
+        double error_init_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+        error_computation_time += error_init_time;
+    
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        if (mf_info->params.k == 128){
+            naive_mascot_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                                        mf_info->d_R,
+                                                        mf_info->n,
+                                                        (void**)sgd_info->d_user_group_ptr,
+                                                        (void**)sgd_info->d_item_group_ptr,
+                                                        d_rand_state,
+                                                        lr_decay_arr[e],
+                                                        mf_info->params.k,
+                                                        update_count,
+                                                        update_vector_size,
+                                                        mf_info->params.lambda,
+                                                        d_user_group_end_idx_shift,
+                                                        d_item_group_end_idx_shift,
+                                                        mf_info->d_user_group_prec_info,
+                                                        mf_info->d_item_group_prec_info,
+                                                        d_grad_sum_norm_p,
+                                                        d_grad_sum_norm_q,
+                                                        d_norm_sum_p,
+                                                        d_norm_sum_q,
+                                                        first_sample_rating_idx,
+                                                        (int)mf_info->params.user_group_num,
+                                                        (int)mf_info->params.item_group_num
+                                                        );
+        }
+
+        cudaDeviceSynchronize();
+        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_update_time_per_epoch;
+        gpuErr(cudaPeekAtLastError());  
+
+
+        error_computation_start_time = std::chrono::system_clock::now();
+        if (error_check && e != mf_info->params.epoch - 1){
+            cudaMemcpy(grad_sum_norm_p, d_grad_sum_norm_p, sizeof(float) * mf_info->params.k * mf_info->params.user_group_num, cudaMemcpyDeviceToHost);
+            cudaMemcpy(grad_sum_norm_q, d_grad_sum_norm_q, sizeof(float) * mf_info->params.k * mf_info->params.item_group_num, cudaMemcpyDeviceToHost);
+            cudaMemcpy(norm_sum_p, d_norm_sum_p, sizeof(float) * block_num * mf_info->params.user_group_num, cudaMemcpyDeviceToHost);
+            cudaMemcpy(norm_sum_q, d_norm_sum_q, sizeof(float) * block_num * mf_info->params.item_group_num, cudaMemcpyDeviceToHost);
+        }
+        double error_transfer_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+        error_computation_time += error_transfer_time;
+        
+        if (error_check && e != mf_info->params.epoch - 1){
+
+            cout << "\n<User groups>\n";
+            for (int i = 0; i < mf_info->params.user_group_num; i++){
+                error_computation_start_time = std::chrono::system_clock::now();
+                float each_group_grad_sum_norm_acc = 0;
+                float each_group_norm_acc = 0;
+                if (mf_info->user_group_prec_info[i] == 0){
+                    
+                    for (int k = 0; k < mf_info->params.k; k++){
+                        each_group_grad_sum_norm_acc+=powf(grad_sum_norm_p[i*mf_info->params.k + k],2);
+                        grad_sum_norm_p[i*mf_info->params.k + k] = 0;
+                    }
+                    for (int j = 0; j < block_num; j++){
+                        each_group_norm_acc += norm_sum_p[i * block_num + j];
+                    }
+                    mf_info->user_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
+                    mf_info->user_group_error[i] /= initial_user_group_error[i];
+                }
+                else{
+                    mf_info->user_group_error[i] = -1;
+                }
+                error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+                
+                if (mf_info->user_group_error[i] == -1) cout << "-1" << " ";                        
+                else cout << mf_info->user_group_error[i] << " ";
+            }
+
+            cout << "\n<Item groups>\n";
+            for (int i = 0; i < mf_info->params.item_group_num; i++){
+                error_computation_start_time = std::chrono::system_clock::now();
+                float each_group_grad_sum_norm_acc = 0;
+                float each_group_norm_acc = 0;
+                if (mf_info->item_group_prec_info[i] == 0){
+
+                    for (int k = 0; k < mf_info->params.k; k++){
+                        each_group_grad_sum_norm_acc+=powf(grad_sum_norm_q[i*mf_info->params.k + k],2);
+                        grad_sum_norm_q[i*mf_info->params.k + k] = 0;
+                    }
+
+                    for (int j = 0; j < block_num; j++){
+                        each_group_norm_acc += norm_sum_q[i * block_num + j];
+                    }
+                    mf_info->item_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
+                    mf_info->item_group_error[i] /= initial_item_group_error[i];
+                }
+                else{
+                    mf_info->item_group_error[i] = -1;
+                }
+                error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+                                
+                if (mf_info->item_group_error[i] == -1) cout << "-1" << " ";
+                else cout << mf_info->item_group_error[i] << " ";
+                
+            }
+            cout << "\n";
+
+            if (e == start_idx){
+                for (int i = 0; i < mf_info->params.user_group_num; i++){
+                    initial_user_group_error[i] = mf_info->user_group_error[i];
+                }
+                for (int i = 0; i < mf_info->params.item_group_num; i++){
+                    initial_item_group_error[i] = mf_info->item_group_error[i];
+                }
+            }
+        }
+        
+        std::chrono::time_point<std::chrono::system_clock> precision_switching_start_point = std::chrono::system_clock::now();
+        if (error_check && e > start_idx && e != mf_info->params.epoch - 1) precision_switching_by_groups_grad_diversity(mf_info, sgd_info);
+        precision_switching_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_start_point).count();
+
+        rmse = gpu_test_rmse_grouped(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups);
+        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
+    }
+
+    cudaMemcpy(mf_info->test_COO, mf_info->d_test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyDeviceToHost);
+
+    double preprocess_exec_time = rating_histogram_execution_time + grouping_exec_time + reconst_exec_time + cpy2grouped_parameters_exec_time + additional_info_init_exec_time;
+    cout << "\n<Preprocessing time (micro sec)>" << endl;
+    cout << "Rating histogram                 : " << rating_histogram_execution_time << endl;
+    cout << "Grouping                         : " << grouping_exec_time << endl;
+    cout << "Matrix reconstruction            : " << reconst_exec_time << endl;
+    cout << "Copy to grouped params           : " << cpy2grouped_parameters_exec_time << endl;
+    cout << "Additional info init             : " << additional_info_init_exec_time << endl;
+    cout << "Total preprocessing time         : " << preprocess_exec_time << endl;
+    cout << "\n<User & item parameter copy exec time (micro sec)>" << endl;
+    cout << "Precision switching              : " << precision_switching_exec_time / mf_info->params.epoch << endl; 
+    cout << "Total precision switching time   : " << precision_switching_exec_time << endl;
+    cout << "\n<User & item group error comp exec time (micro sec)>" << endl;
+    cout << "Error computation time           : " << error_computation_time / mf_info->params.epoch << endl; 
+    cout << "Total error computation time     : " << error_computation_time << endl;
+    cout << "\n<User & item parameter update exec time (micro sec)>" << endl;
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
+    cout << "Total MF time(ms)                : " << (preprocess_exec_time + precision_switching_exec_time + error_computation_time + sgd_update_execution_time)/1000 << endl;
+    
+    cudaFree(mf_info->d_R);
+    cudaFree(mf_info->d_test_COO);
+    cudaFree(d_rand_state);
+    cudaFree(sgd_info->d_user_group_ptr);
+    cudaFree(sgd_info->d_item_group_ptr);
+    cudaFree(mf_info->d_user_group_prec_info);
+    cudaFree(mf_info->d_item_group_prec_info);
+    cudaFree(d_grad_sum_norm_p);
+    cudaFree(d_grad_sum_norm_q);
+    cudaFree(d_norm_sum_p);
+    cudaFree(d_norm_sum_q);
+    cudaFree(d_e_group);
+    cudaFree(d_user_group_end_idx_shift);
+    cudaFree(d_item_group_end_idx_shift);
+}
+
+void training_mem_quant_mf(Mf_info *mf_info, SGD *sgd_info){
+    curandState* d_rand_state;
+    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
+    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
+
+    gpuErr(cudaPeekAtLastError());
+
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+
+    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
+    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
+    cudaMalloc(&sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k);
+    cudaMalloc(&sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k);
+    gpuErr(cudaPeekAtLastError());
+
+    float* lr_decay_arr = new float[1024];
+
+    for (int i = 0; i < mf_info->params.epoch + 4; i++){
+        lr_decay_arr[i] = static_cast<float>(mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5))));
+    }
+
+    int update_vector_size = 128;
+    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
+    unsigned int div = mf_info->params.thread_block_size/32;
+    double sgd_update_execution_time = 0;
+    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
+    unsigned int group_error_size = error_kernel_work_groups;
+    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
+    unsigned int seg_size = 32;
+    float* d_e_group;
+    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
+    float rmse = 0;
+
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
+    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+    
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        if (mf_info->params.k == 128)        
+        mem_quant_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                                        mf_info->d_R,
+                                                        mf_info->n,
+                                                        sgd_info->d_half_p,
+                                                        sgd_info->d_half_q,
+                                                        d_rand_state,
+                                                        lr_decay_arr[e],
+                                                        mf_info->params.k,
+                                                        1,
+                                                        e,
+                                                        update_count,
+                                                        update_vector_size,
+                                                        mf_info->params.lambda
+                                                        );
+        else if (mf_info->params.k == 64)
+        mem_quant_sgd_k64_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                                                        mf_info->d_R,
+                                                        mf_info->n,
+                                                        sgd_info->d_half_p,
+                                                        sgd_info->d_half_q,
+                                                        d_rand_state,
+                                                        lr_decay_arr[e],
+                                                        mf_info->params.k,
+                                                        1,
+                                                        e,
+                                                        update_count,
+                                                        update_vector_size,
+                                                        mf_info->params.lambda
+                                                        );
+        cudaDeviceSynchronize();
+        double sgd_execution_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_execution_time_per_epoch;
+        
+        cudaMemcpy(sgd_info->half_p, sgd_info->d_half_p, sizeof(half) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
+        cudaMemcpy(sgd_info->half_q, sgd_info->d_half_q, sizeof(half) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
+        transform_feature_vector_half2float(sgd_info->half_p, sgd_info->p, mf_info->max_user, mf_info->params.k);
+        transform_feature_vector_half2float(sgd_info->half_q, sgd_info->q, mf_info->max_item, mf_info->params.k);
+
+        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
+        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
+    }
+
+    cout << "Execution time(avg per epoch)        : " << sgd_update_execution_time / mf_info->params.epoch << endl;
+    cout << "Total execution time                 : " << sgd_update_execution_time / 1000 << endl;
+    
+    cudaFree(mf_info->d_R);
+    cudaFree(mf_info->d_test_COO);
+    cudaFree(d_rand_state);
+    cudaFree(d_e_group);
+}
+
+void training_switching_only(Mf_info* mf_info, SGD* sgd_info){
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+
+    cudaMalloc(&(mf_info->d_R), sizeof(Node)*mf_info->n);
+    cudaMemcpy(mf_info->d_R, mf_info->R, sizeof(Node) * mf_info->n, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+    
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    cudaMalloc(&mf_info->d_test_COO, sizeof(Node)*mf_info->test_n);
+    cudaMemcpy(mf_info->d_test_COO, mf_info->test_COO, sizeof(Node) * mf_info->test_n, cudaMemcpyHostToDevice);
+    gpuErr(cudaPeekAtLastError());
+    
+    curandState* d_rand_state;
+    cudaMalloc(&d_rand_state, sizeof(curandState)*mf_info->params.num_workers);
+    init_rand_state<<<((mf_info->params.num_workers+255)/256),256>>>(d_rand_state, mf_info->params.num_workers);
+    cudaDeviceSynchronize();
+    gpuErr(cudaPeekAtLastError());
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    cudaMalloc(&sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k);
+    cudaMalloc(&sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k);
+    
+    int update_vector_size = 128;
+    int update_count = ceil(static_cast<double>(mf_info->n) / (mf_info->params.num_workers * update_vector_size));
+    int sample_ratings_num = (float)(update_count * update_vector_size) * mf_info->params.sample_ratio;
+    unsigned int first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
+    unsigned int div = mf_info->params.thread_block_size/32;
+    unsigned int error_kernel_work_groups = ceil(mf_info->test_n/(float)512);
+    unsigned int group_error_size = error_kernel_work_groups;
+    unsigned int iter_num = ceil(mf_info->test_n / (float) (512 * error_kernel_work_groups));
+    unsigned int seg_size = 32;
+    float* d_e_group;
+    cudaMalloc(&d_e_group, sizeof(float) * group_error_size);
+
+    double additional_info_init_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
+    float quantization_error = 0;
+    float *sum_norms;
+    float *d_sum_norms;
+    float *sum_updated_val;
+    float *d_sum_updated_val;
+    unsigned int block_num = mf_info->params.num_workers/div;
+    
+    cudaMalloc(&d_sum_norms, sizeof(float) * mf_info->params.num_workers);
+    cudaMallocHost(&sum_norms, sizeof(float) * mf_info->params.num_workers);
+    cudaMalloc(&d_sum_updated_val, sizeof(float) * mf_info->params.k);
+    cudaMallocHost(&sum_updated_val, sizeof(float) * mf_info->params.k);
+
+    double precision_switching_and_error_comp_execution_time = 0;
+    double sgd_update_execution_time = 0;
+    double rmse;    
+    int start_idx = 5;
+    unsigned int num_groups = 10000;
+
+    float initial_error = 1; 
+    void* p = (void*)(sgd_info->d_half_p);
+    void* q = (void*)(sgd_info->d_half_q);
+    unsigned char cur_precision = 0;//# 0 => half, 1 => single
+
+    int switching_point = 0;
+    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        bool error_check = false;
+        first_sample_rating_idx = (update_count * update_vector_size) - 0;
+        if (!cur_precision &&(e >= start_idx ) && (e % mf_info->params.interval == (start_idx % mf_info->params.interval)) && mf_info->params.epoch - 1 != e) {
+            error_check = true;
+            first_sample_rating_idx = (update_count * update_vector_size) - sample_ratings_num;
+        }
+        std::chrono::time_point<std::chrono::system_clock> precision_switching_and_error_comp_start_time = std::chrono::system_clock::now();
+        if (error_check){
+            initialize_float_array_to_val<<<num_groups, 512>>>(d_sum_updated_val, mf_info->params.k, 0.0f);
+            cudaDeviceSynchronize();
+        }
+        precision_switching_and_error_comp_execution_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_and_error_comp_start_time).count();
+
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        switching_only_sgd_k128_hogwild_kernel<<<mf_info->params.num_workers/div,mf_info->params.thread_block_size>>>(
+                            mf_info->d_R,
+                            mf_info->n,
+                            (void*)p,
+                            (void*)q,
+                            d_rand_state,
+                            lr_decay_arr[e],
+                            mf_info->params.k,
+                            update_count,
+                            update_vector_size,
+                            mf_info->params.lambda,
+                            cur_precision,
+                            first_sample_rating_idx,
+                            d_sum_updated_val,
+                            d_sum_norms
+                        );
+
+        cudaDeviceSynchronize();
+        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_update_time_per_epoch;
+
+        gpuErr(cudaPeekAtLastError());
+        if (!cur_precision){
+            cudaMemcpy(sgd_info->half_p, sgd_info->d_half_p, sizeof(half) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
+            cudaMemcpy(sgd_info->half_q, sgd_info->d_half_q, sizeof(half) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
+
+            transform_feature_vector_half2float(sgd_info->half_p, sgd_info->p, mf_info->max_user, mf_info->params.k);
+            transform_feature_vector_half2float(sgd_info->half_q, sgd_info->q, mf_info->max_item, mf_info->params.k);
+        }else{
+            cudaMemcpy(sgd_info->p, sgd_info->d_p, sizeof(float) * mf_info->max_user * mf_info->params.k, cudaMemcpyDeviceToHost);
+            cudaMemcpy(sgd_info->q, sgd_info->d_q, sizeof(float) * mf_info->max_item * mf_info->params.k, cudaMemcpyDeviceToHost);
+        }
+
+        precision_switching_and_error_comp_start_time = std::chrono::system_clock::now();
+        if (error_check && e != mf_info->params.epoch - 1){
+
+            cudaMemcpy(sum_norms, d_sum_norms, sizeof(float) * mf_info->params.num_workers, cudaMemcpyDeviceToHost);
+            cudaMemcpy(sum_updated_val, d_sum_updated_val, sizeof(float) * mf_info->params.k, cudaMemcpyDeviceToHost);
+
+            float sum_norms_acc = 0;
+            float norm_acc = 0 ;
+            
+            for (int w = 0; w < mf_info->params.num_workers; w++){
+                norm_acc += sum_norms[w];
+            }
+
+            for (int k = 0; k < mf_info->params.k; k++){
+                sum_norms_acc += powf(sum_updated_val[k],2);
+                sum_updated_val[k] = 0.0f;
+            }
+
+            quantization_error = (float)sum_norms_acc/(float)norm_acc;
+            quantization_error = quantization_error/(float)initial_error;
+            cout << "Quantization error : " << quantization_error << endl;
+            
+            if (e == start_idx) initial_error = quantization_error;
+
+            if (e > start_idx && quantization_error > mf_info->params.error_threshold) {
+                transition_params_half2float(mf_info, sgd_info);
+                cur_precision = 1;
+                p = (void*)(sgd_info->d_p);
+                q = (void*)(sgd_info->d_q);
+                cudaFree(sgd_info->d_half_p);
+                cudaFree(sgd_info->d_half_q);
+                switching_point = e;
+            }
+        }
+        
+        precision_switching_and_error_comp_execution_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_and_error_comp_start_time).count();
+        rmse = gpu_test_rmse(mf_info, sgd_info, mf_info->d_test_COO, d_e_group, error_kernel_work_groups, iter_num, seg_size, group_error_size);
+        cout << e + 1 << " " << lr_decay_arr[e] << " " << rmse << endl;
+    }
+    cout << "Additional info init                            : " << additional_info_init_exec_time << endl;
+    cout << "Total error comp & precision switching time     : " << precision_switching_and_error_comp_execution_time << endl;
+    cout << "Parameters update per epoch                     : " << sgd_update_execution_time / mf_info->params.epoch << endl; 
+    cout << "Total parameters update                         : " << sgd_update_execution_time << endl; 
+    cout << "Total MF time(ms)                               : " <<(additional_info_init_exec_time + precision_switching_and_error_comp_execution_time + sgd_update_execution_time)/1000 << endl;
+    
+    cudaFree(mf_info->d_R);
+    cudaFree(mf_info->d_test_COO);
+    cudaFree(d_rand_state);
+    cudaFree(d_e_group);
+    cudaFree(d_sum_norms);
+    cudaFree(d_sum_updated_val);
+}
+
+
+void cpu_user_major_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    prepare_validation_set(mf_info);
+
+    double csr_build_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> csr_build_start_point = std::chrono::system_clock::now();
+    Csr csr;
+    build_user_major_csr(mf_info, &csr);
+    vector<User_batch> batches = split_user_batches(mf_info, &csr, mf_info->params.user_batch_size);
+    csr_build_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - csr_build_start_point).count();
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    unsigned int num_threads = mf_info->params.num_threads;
+    unsigned int k = mf_info->params.k;
+    float* p_local = new float[(size_t)num_threads * k];
+    mt19937 gen(time(0));
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, mf_info->params.numa_nodes);
+    double sgd_update_execution_time = 0;
+    double evaluation_exec_time = 0;
+    bool async_eval = mf_info->params.eval_sample_ratio > 0;
+    Async_evaluator evaluator;
+    bool early_stopping = mf_info->params.patience > 0;
+    Early_stopping es;
+    init_early_stopping(&es, mf_info);
+    int epochs_run = 0;
+    if (async_eval) init_async_evaluator(&evaluator, mf_info, NULL);
+    double rmse = 0;
+    vector<double> thread_loss(num_threads);
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        shuffle(batches.begin(), batches.end(), gen);
+        atomic<unsigned int> next_batch(0);
+        fill(thread_loss.begin(), thread_loss.end(), 0.0);
+
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        run_cpu_thread_pool(&pool, [&](unsigned int t){
+            cpu_user_major_sgd_worker(&csr, batches.data(), (unsigned int)batches.size(), &next_batch,
+                                      sgd_info->p, sgd_info->q, p_local + (size_t)t * k, lr_decay_arr[e], k, mf_info->params.lambda,
+                                      mf_info->params.train_loss ? &thread_loss[t] : NULL);
+        });
+        sgd_update_execution_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+
+        double valid_rmse = 0;
+        if (early_stopping) valid_rmse = early_stopping_epoch(&es, e, [&](){ return (double)cpu_set_rmse(&pool, mf_info->valid_COO, mf_info->valid_n, sgd_info->p, sgd_info->q, k); },
+                                                              [&](){ save_flat_shadow(&es, &pool, mf_info, sgd_info); });
+        epochs_run = e + 1;
+
+        std::chrono::time_point<std::chrono::system_clock> evaluation_start_point = std::chrono::system_clock::now();
+        bool evaluated = cpu_eval_epoch(mf_info, e);
+        if (async_eval) publish_eval_snapshot(&evaluator, e, lr_decay_arr[e], cpu_train_rmse(thread_loss, mf_info->n), valid_rmse, evaluated,
+                                              [&](float* p, float* q){ copy_flat_parameters(&pool, mf_info, sgd_info, p, q); });
+        else if (evaluated) rmse = cpu_test_rmse(mf_info, sgd_info, &pool);
+        evaluation_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - evaluation_start_point).count();
+        if (!async_eval) print_cpu_epoch(mf_info, e, lr_decay_arr[e], evaluated, rmse, cpu_train_rmse(thread_loss, mf_info->n), valid_rmse);
+        if (es.stop) break;
+    }
+    if (async_eval) rmse = finish_async_evaluator(&evaluator);
+    if (early_stopping){
+        if (restore_best_epoch(&es, epochs_run)) restore_flat_shadow(&es, &pool, mf_info, sgd_info);
+        rmse = cpu_test_rmse(mf_info, sgd_info, &pool);
+        print_early_stopping(&es, mf_info, epochs_run);
+        cout << "Test RMSE of the best epoch      : " << rmse << endl;
+        free_early_stopping(&es);
+    }
+
+    // Hogwild reloads p_u, q_i and the rating triplet per update; user-major reloads p_u once per batch.
+    double hogwild_bytes_per_update = 2.0 * sizeof(float) * k + sizeof(Node);
+    double user_major_bytes_per_update = sizeof(float) * k + sizeof(unsigned int) + sizeof(float) +
+                                         (sizeof(float) * k + sizeof(User_batch)) * batches.size() / (double)mf_info->n;
+
+    cout << "\n<User-major batching>" << endl;
+    cout << "User batch size                  : " << mf_info->params.user_batch_size << endl;
+    cout << "The number of batches            : " << batches.size() << endl;
+    cout << "Avg ratings per batch            : " << mf_info->n / (double)batches.size() << endl;
+    cout << "Loaded bytes per update (hogwild): " << hogwild_bytes_per_update << endl;
+    cout << "Loaded bytes per update (batched): " << user_major_bytes_per_update << endl;
+    cout << "Loaded bytes reduction (%)       : " << 100.0 * (1.0 - user_major_bytes_per_update / hogwild_bytes_per_update) << endl;
+    cout << "Final RMSE                       : " << rmse << endl;
+    cout << "\nCSR build time                   : " << csr_build_exec_time << endl;
+    cout << "Total test evaluation time       : " << evaluation_exec_time << endl;
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / epochs_run << endl; 
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
+    cout << "Total MF time(ms)                : " << (csr_build_exec_time + sgd_update_execution_time)/1000 << endl;
+
+    destroy_cpu_thread_pool(&pool);
+    delete [] p_local;
+    delete [] csr.row_ptr;
+    delete [] csr.col_idx;
+    delete [] csr.val;
+}
+
+void cpu_hogwild_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    prepare_validation_set(mf_info);
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    unsigned int num_threads = mf_info->params.num_threads;
+    unsigned int k = mf_info->params.k;
+    unsigned int replica_sync = max(1u, mf_info->params.replica_sync);
+    double sgd_update_execution_time = 0;
+    double replica_averaging_exec_time = 0;
+    double evaluation_exec_time = 0;
+    bool async_eval = mf_info->params.eval_sample_ratio > 0;
+    Async_evaluator evaluator;
+    bool early_stopping = mf_info->params.patience > 0;
+    Early_stopping es;
+    init_early_stopping(&es, mf_info);
+    int epochs_run = 0;
+    if (async_eval) init_async_evaluator(&evaluator, mf_info, NULL);
+    double rmse = 0;
+    vector<double> thread_loss(num_threads);
+
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, mf_info->params.numa_nodes);
+
+    // The highest-degree item group (1/-ig of the items) is replicated per node.
+    double numa_placement_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> numa_placement_start_point = std::chrono::system_clock::now();
+    Numa_plan plan;
+    numa_place_parameters(mf_info, sgd_info, &pool, &plan, (mf_info->max_item + mf_info->params.item_group_num - 1) / mf_info->params.item_group_num);
+    numa_placement_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - numa_placement_start_point).count();
+
+    cout << "\n<NUMA placement>" << endl;
+    cout << "The number of nodes              : " << pool.node_num << endl;
+    for (unsigned int n = 0; n < pool.node_num; n++)
+        cout << "Node " << n << " threads / users / ratings : " << pool.node_thread_start[n + 1] - pool.node_thread_start[n] << " / "
+             << plan.node_user_begin[n + 1] - plan.node_user_begin[n] << " / "
+             << plan.thread_rating_begin[pool.node_thread_start[n + 1]] - plan.thread_rating_begin[pool.node_thread_start[n]] << endl;
+    cout << "Replicated hot items             : " << plan.hot_num << endl;
+    print_numa_placement("P pages                          : ", sgd_info->p, sizeof(float) * mf_info->max_user * k);
+    print_numa_placement("Q pages                          : ", sgd_info->q, sizeof(float) * mf_info->max_item * k);
+    print_numa_placement("R pages                          : ", mf_info->R, sizeof(Node) * mf_info->n);
+    cout << endl;
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        fill(thread_loss.begin(), thread_loss.end(), 0.0);
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        for (unsigned int s = 0; s < replica_sync; s++){
+            run_cpu_thread_pool(&pool, [&](unsigned int t){
+                unsigned int shard_begin = plan.thread_rating_begin[t];
+                unsigned int shard_len = plan.thread_rating_begin[t + 1] - shard_begin;
+                cpu_prefetch_sgd_worker(mf_info->R, shard_begin + (unsigned long long)shard_len * s / replica_sync,
+                                        shard_begin + (unsigned long long)shard_len * (s + 1) / replica_sync,
+                                        sgd_info->p, sgd_info->q, lr_decay_arr[e], k, mf_info->params.lambda,
+                                        mf_info->params.prefetch_distance, mf_info->params.interleave,
+                                        plan.item2replica, plan.q_replica[pool.thread2node[t]],
+                                        mf_info->params.train_loss ? &thread_loss[t] : NULL);
+            });
+
+            std::chrono::time_point<std::chrono::system_clock> replica_averaging_start_point = std::chrono::system_clock::now();
+            average_item_replicas(mf_info, sgd_info, &pool, &plan);
+            replica_averaging_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - replica_averaging_start_point).count();
+        }
+        double sgd_update_time_per_epoch = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+        sgd_update_execution_time += sgd_update_time_per_epoch;
+
+        double valid_rmse = 0;
+        if (early_stopping) valid_rmse = early_stopping_epoch(&es, e, [&](){ return (double)cpu_set_rmse(&pool, mf_info->valid_COO, mf_info->valid_n, sgd_info->p, sgd_info->q, k); },
+                                                              [&](){ save_flat_shadow(&es, &pool, mf_info, sgd_info); });
+        epochs_run = e + 1;
+
+        std::chrono::time_point<std::chrono::system_clock> evaluation_start_point = std::chrono::system_clock::now();
+        bool evaluated = cpu_eval_epoch(mf_info, e);
+        if (async_eval) publish_eval_snapshot(&evaluator, e, lr_decay_arr[e], cpu_train_rmse(thread_loss, mf_info->n), valid_rmse, evaluated,
+                                              [&](float* p, float* q){ copy_flat_parameters(&pool, mf_info, sgd_info, p, q); });
+        else if (evaluated) rmse = cpu_test_rmse(mf_info, sgd_info, &pool);
+        evaluation_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - evaluation_start_point).count();
+        if (!async_eval) print_cpu_epoch(mf_info, e, lr_decay_arr[e], evaluated, rmse, cpu_train_rmse(thread_loss, mf_info->n), valid_rmse);
+        if (es.stop) break;
+    }
+    if (async_eval) rmse = finish_async_evaluator(&evaluator);
+    if (early_stopping){
+        if (restore_best_epoch(&es, epochs_run)) restore_flat_shadow(&es, &pool, mf_info, sgd_info);
+        rmse = cpu_test_rmse(mf_info, sgd_info, &pool);
+        print_early_stopping(&es, mf_info, epochs_run);
+        cout << "Test RMSE of the best epoch      : " << rmse << endl;
+        free_early_stopping(&es);
+    }
+
+    cout << "\nPrefetch distance                : " << mf_info->params.prefetch_distance << endl;
+    cout << "Interleaved ratings              : " << mf_info->params.interleave << endl;
+    cout << "Updates per sec                  : " << (double)mf_info->n * epochs_run / (sgd_update_execution_time / 1e6) << endl;
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / epochs_run << endl; 
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
+    print_remote_access_ratio(&pool);
+    cout << "NUMA placement time              : " << numa_placement_exec_time << endl;
+    cout << "Replica averaging time           : " << replica_averaging_exec_time << endl;
+    cout << "Total test evaluation time       : " << evaluation_exec_time << endl;
+    cout << "Total MF time(ms)                : " << (numa_placement_exec_time + sgd_update_execution_time)/1000 << endl;
+
+    destroy_cpu_thread_pool(&pool);
+}
+
+void cpu_mascot_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    // A resumed run (-rm) regenerates the order of R from the seed of the checkpoint and takes its grouping.
+    // A checkpoint that can't be read or doesn't match the run ends it; the loaders report why.
+    bool resume = mf_info->resume_path != "";
+    Training_checkpoint ckpt;
+    if (resume && !load_training_checkpoint(mf_info->resume_path, &ckpt)) exit(1);
+    unsigned int shuffle_seed = resume ? ckpt.header.shuffle_seed : time(0);
+    srand(shuffle_seed); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    prepare_validation_set(mf_info);
+    if (resume && !checkpoint_matches(&ckpt, mf_info, mf_info->params.num_threads, 0)) exit(1);
+
+    double rating_histogram_execution_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> rating_histogram_start_point = std::chrono::system_clock::now();
+    if (!resume) user_item_rating_histogram_cpu(mf_info);
+    rating_histogram_execution_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - rating_histogram_start_point).count();
+
+    double grouping_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> grouping_start_point = std::chrono::system_clock::now();
+    if (resume) restore_checkpoint_grouping(mf_info, &ckpt, false);
+    else split_group_based_equal_size_not_strict_ret_end_idx(mf_info, false);
+    grouping_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - grouping_start_point).count();
+
+    double reconst_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> reconst_start_point = std::chrono::system_clock::now();
+    matrix_reconstruction_cpu(mf_info);
+    reconst_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - reconst_start_point).count();
+
+    unsigned int user_group_num = mf_info->params.user_group_num;
+    unsigned int item_group_num = mf_info->params.item_group_num;
+    unsigned int k = mf_info->params.k;
+
+    double cpy2grouped_parameters_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> cpy2grouped_parameters_start_point = std::chrono::system_clock::now();
+    sgd_info->user_group_ptr = new void*[user_group_num];
+    sgd_info->item_group_ptr = new void*[item_group_num];
+    if (resume){
+        mf_info->user_group_prec_info = new unsigned char[user_group_num];
+        mf_info->item_group_prec_info = new unsigned char[item_group_num];
+        memcpy(mf_info->user_group_prec_info, ckpt.user_group_prec.data(), user_group_num);
+        memcpy(mf_info->item_group_prec_info, ckpt.item_group_prec.data(), item_group_num);
+        restore_grouped_parameters_cpu(mf_info, sgd_info, &ckpt);
+    }
+    else cpy2grouped_parameters_cpu(mf_info, sgd_info);
+    cpy2grouped_parameters_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - cpy2grouped_parameters_start_point).count();
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    unsigned int num_threads = mf_info->params.num_threads;
+    unsigned int shard_size = (mf_info->n + num_threads - 1) / num_threads;
+    unsigned int sample_ratings_num = (float)shard_size * mf_info->params.sample_ratio;
+    unsigned int start_idx = 5;
+    bool train_loss = mf_info->params.train_loss;
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, mf_info->params.numa_nodes);
+
+    double additional_info_init_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> additional_info_init_start_point = std::chrono::system_clock::now();
+    if (!resume){
+        mf_info->user_group_prec_info = new unsigned char[user_group_num]();
+        mf_info->item_group_prec_info = new unsigned char[item_group_num]();
+        if (mf_info->params.half_format == 1) init_bf16_groups(mf_info, sgd_info);
+    }
+    mf_info->user_group_error = new float[user_group_num]();
+    mf_info->item_group_error = new float[item_group_num]();
+
+    Cpu_group_layout user_layout, item_layout;
+    build_cpu_group_layout(&user_layout, sgd_info->user_group_ptr, mf_info->user_group_prec_info, mf_info->user_group_end_idx, user_group_num);
+    build_cpu_group_layout(&item_layout, sgd_info->item_group_ptr, mf_info->item_group_prec_info, mf_info->item_group_end_idx, item_group_num);
+
+    // Tiered storage (-tb): the flat P/Q are only needed again for the copy of the trained model.
+    bool tiered = mf_info->params.tier_budget_mb > 0;
+    Tiered_storage tiers;
+    if (tiered){
+        if (!init_tiered_storage(&tiers, mf_info, sgd_info, &user_layout, &item_layout, (size_t)(mf_info->params.tier_budget_mb * (1 << 20)), mf_info->tier_path)){
+            destroy_cpu_thread_pool(&pool);
+            exit(1);
+        }
+        delete [] sgd_info->p;
+        delete [] sgd_info->q;
+    }
+
+    // Per-thread gradient statistics, merged after each epoch
+    float* grad_sum_norm_p = new float[(size_t)num_threads * user_group_num * k];
+    float* grad_sum_norm_q = new float[(size_t)num_threads * item_group_num * k];
+    float* norm_sum_p = new float[(size_t)num_threads * user_group_num];
+    float* norm_sum_q = new float[(size_t)num_threads * item_group_num];
+    float* work = new float[(size_t)num_threads * 2 * MAX_INTERLEAVE * k];
+
+    // Per-thread squared residuals per group (-tl 1); the ratings per group turn them into group RMSEs.
+    vector<double> user_group_loss(train_loss ? (size_t)num_threads * user_group_num : 0);
+    vector<double> item_group_loss(train_loss ? (size_t)num_threads * item_group_num : 0);
+    vector<double> user_group_ratings(user_group_num, 0);
+    vector<double> item_group_ratings(item_group_num, 0);
+    for (unsigned int j = 0; j < mf_info->n; j++){
+        user_group_ratings[user_layout.sorted_idx2group[mf_info->R[j].u]]++;
+        item_group_ratings[item_layout.sorted_idx2group[mf_info->R[j].i]]++;
+    }
+
+    // Parameter bytes moved per epoch: every rating reads and writes its two rows in their group's precision,
+    // plus the bytes of the precision conversions after the epoch.
+    size_t converted_bytes = 0;
+    if (mf_info->params.int8_group_ratio > 0 && !resume)
+        converted_bytes += init_int8_groups_by_degree(mf_info, sgd_info, user_group_ratings, item_group_ratings);
+    vector<size_t> bytes_moved;
+    auto epoch_row_bytes = [&](){
+        double bytes = 0;
+        for (int i = 0; i < user_group_num; i++) bytes += 2 * user_group_ratings[i] * grouped_row_bytes(mf_info->user_group_prec_info[i], k);
+        for (int i = 0; i < item_group_num; i++) bytes += 2 * item_group_ratings[i] * grouped_row_bytes(mf_info->item_group_prec_info[i], k);
+        return bytes;
+    };
+
+    float* initial_user_group_error = new float[user_group_num];
+    float* initial_item_group_error = new float[item_group_num];
+    for (int i = 0; i < user_group_num; i++) initial_user_group_error[i] = 1.0f;
+    for (int i = 0; i < item_group_num; i++) initial_item_group_error[i] = 1.0f;
+    int first_epoch = 0;
+    if (resume){
+        memcpy(mf_info->user_group_error, ckpt.user_group_error.data(), sizeof(float) * user_group_num);
+        memcpy(mf_info->item_group_error, ckpt.item_group_error.data(), sizeof(float) * item_group_num);
+        memcpy(initial_user_group_error, ckpt.initial_user_group_error.data(), sizeof(float) * user_group_num);
+        memcpy(initial_item_group_error, ckpt.initial_item_group_error.data(), sizeof(float) * item_group_num);
+        first_epoch = ckpt.header.epochs_done;
+    }
+    additional_info_init_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - additional_info_init_start_point).count();
+
+    // Precision planning (-pb): the degree proxy (-ps 1) needs no estimate and plans before the first epoch,
+    // the estimates of the error checks replan from the first check after the calibration on.
+    bool planned = mf_info->params.precision_budget_mb > 0;
+    Precision_planner planner;
+    if (planned){
+        init_precision_planner(&planner, mf_info, user_layout.sorted_idx2group, item_layout.sorted_idx2group,
+                               (size_t)(mf_info->params.precision_budget_mb * (1 << 20)), mf_info->params.precision_plan_proxy);
+        if (mf_info->params.precision_plan_proxy){
+            plan_group_precisions(&planner, mf_info);
+            apply_precision_plan(&planner, mf_info, sgd_info);
+            converted_bytes += planner.converted_bytes;
+            print_precision_plan(&planner, mf_info, sgd_info, -1);
+        }
+    }
+
+    double error_computation_time = 0;
+    double precision_switching_exec_time = 0;
+    double sgd_update_execution_time = 0;
+    double evaluation_exec_time = 0;
+    bool async_eval = mf_info->params.eval_sample_ratio > 0;
+    Async_evaluator evaluator;
+    bool early_stopping = mf_info->params.patience > 0;
+    Early_stopping es;
+    init_early_stopping(&es, mf_info);
+    int epochs_run = first_epoch;
+    Checkpoint_writer checkpoint_writer;
+    if (mf_info->checkpoint_path != "") init_checkpoint_writer(&checkpoint_writer, mf_info->checkpoint_path, mf_info->params.checkpoint_delta_threshold, mf_info->params.checkpoint_full_interval);
+    if (async_eval) init_async_evaluator(&evaluator, mf_info, mf_info->user2sorted_idx);
+    double rmse = 0;
+    Shm_snapshot_publisher publisher;
+    bool publish_snapshots = mf_info->snapshot_name != "" && init_shm_snapshot_publisher(&publisher, mf_info->snapshot_name);
+    auto publish_snapshot = [&](int epochs_done){
+        cpy_grouped2flat_parameters_cpu(mf_info, sgd_info);
+        publish_shm_snapshot(&publisher, mf_info, sgd_info->p, sgd_info->q, SNAPSHOT_INTERNAL_ORDER, SNAPSHOT_SORTED_ORDER, true, epochs_done);
+    };
+
+    for (int e = first_epoch; e < mf_info->params.epoch; e++){
+        bool error_check = false;
+        fill(user_group_loss.begin(), user_group_loss.end(), 0.0);
+        fill(item_group_loss.begin(), item_group_loss.end(), 0.0);
+        unsigned int first_sample_rating_idx = shard_size;
+
+        if ((e >= start_idx ) && (e % mf_info->params.interval == (start_idx % mf_info->params.interval)) && mf_info->params.epoch - 1 != e) {
+            error_check = true;
+            first_sample_rating_idx = shard_size - sample_ratings_num;
+        }
+
+        std::chrono::time_point<std::chrono::system_clock> error_computation_start_time = std::chrono::system_clock::now();
+        if (error_check){
+            memset(grad_sum_norm_p, 0, sizeof(float) * num_threads * user_group_num * k);
+            memset(grad_sum_norm_q, 0, sizeof(float) * num_threads * item_group_num * k);
+            memset(norm_sum_p, 0, sizeof(float) * num_threads * user_group_num);
+            memset(norm_sum_q, 0, sizeof(float) * num_threads * item_group_num);
+        }
+        error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+
+        double epoch_bytes_moved = epoch_row_bytes();
+        size_t epoch_converted_bytes = converted_bytes;
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        run_cpu_thread_pool(&pool, [&](unsigned int t){
+            unsigned int begin = min(t * shard_size, mf_info->n);
+            unsigned int end = min(begin + shard_size, mf_info->n);
+            cpu_mascot_sgd_worker(mf_info->R, begin, end, &user_layout, &item_layout, lr_decay_arr[e], k, mf_info->params.lambda,
+                                  grad_sum_norm_p + (size_t)t * user_group_num * k, grad_sum_norm_q + (size_t)t * item_group_num * k,
+                                  norm_sum_p + (size_t)t * user_group_num, norm_sum_q + (size_t)t * item_group_num,
+                                  first_sample_rating_idx, mf_info->params.prefetch_distance, mf_info->params.interleave,
+                                  work + (size_t)t * 2 * MAX_INTERLEAVE * k,
+                                  train_loss ? &user_group_loss[(size_t)t * user_group_num] : NULL,
+                                  train_loss ? &item_group_loss[(size_t)t * item_group_num] : NULL, shuffle_seed + e * num_threads + t);
+        });
+        sgd_update_execution_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+
+        if (error_check){
+            error_computation_start_time = std::chrono::system_clock::now();
+            cout << "\n<User groups>\n";
+            for (int i = 0; i < user_group_num; i++){
+                if (mf_info->user_group_prec_info[i] != 1){
+                    float each_group_grad_sum_norm_acc = 0;
+                    float each_group_norm_acc = 0;
+                    for (int d = 0; d < k; d++){
+                        float grad_sum = 0;
+                        for (int t = 0; t < num_threads; t++) grad_sum += grad_sum_norm_p[((size_t)t * user_group_num + i) * k + d];
+                        each_group_grad_sum_norm_acc += powf(grad_sum, 2);
+                    }
+                    for (int t = 0; t < num_threads; t++) each_group_norm_acc += norm_sum_p[(size_t)t * user_group_num + i];
+                    mf_info->user_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
+                    mf_info->user_group_error[i] /= initial_user_group_error[i];
+                }
+                else{
+                    mf_info->user_group_error[i] = -1;
+                }
+                cout << mf_info->user_group_error[i] << " ";
+            }
+
+            cout << "\n<Item groups>\n";
+            for (int i = 0; i < item_group_num; i++){
+                if (mf_info->item_group_prec_info[i] != 1){
+                    float each_group_grad_sum_norm_acc = 0;
+                    float each_group_norm_acc = 0;
+                    for (int d = 0; d < k; d++){
+                        float grad_sum = 0;
+                        for (int t = 0; t < num_threads; t++) grad_sum += grad_sum_norm_q[((size_t)t * item_group_num + i) * k + d];
+                        each_group_grad_sum_norm_acc += powf(grad_sum, 2);
+                    }
+                    for (int t = 0; t < num_threads; t++) each_group_norm_acc += norm_sum_q[(size_t)t * item_group_num + i];
+                    mf_info->item_group_error[i] = each_group_grad_sum_norm_acc/(float)each_group_norm_acc;
+                    mf_info->item_group_error[i] /= initial_item_group_error[i];
+                }
+                else{
+                    mf_info->item_group_error[i] = -1;
+                }
+                cout << mf_info->item_group_error[i] << " ";
+            }
+            cout << "\n";
+
+            if (e == start_idx){
+                for (int i = 0; i < user_group_num; i++) initial_user_group_error[i] = mf_info->user_group_error[i];
+                for (int i = 0; i < item_group_num; i++) initial_item_group_error[i] = mf_info->item_group_error[i];
+            }
+            error_computation_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - error_computation_start_time).count();
+        }
+
+        std::chrono::time_point<std::chrono::system_clock> precision_switching_start_point = std::chrono::system_clock::now();
+        if (tiered && error_check && e > start_idx) promote_groups_to_widen(&tiers, mf_info, sgd_info);
+        if (error_check && e > start_idx){
+            if (planned){
+                plan_group_precisions(&planner, mf_info);
+                size_t planned_bytes = planner.converted_bytes;
+                apply_precision_plan(&planner, mf_info, sgd_info);
+                converted_bytes += planner.converted_bytes - planned_bytes;
+            }
+            else converted_bytes += precision_switching_by_groups_grad_diversity_cpu(mf_info, sgd_info);
+        }
+        precision_switching_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - precision_switching_start_point).count();
+        if (tiered && error_check && e > start_idx) plan_tiers(&tiers, mf_info, sgd_info);
+        if (planned && error_check && e > start_idx) print_precision_plan(&planner, mf_info, sgd_info, e);
+
+        double valid_rmse = 0;
+        if (early_stopping) valid_rmse = early_stopping_epoch(&es, e, [&](){ return (double)cpu_set_rmse_grouped(mf_info, mf_info->valid_COO, mf_info->valid_n, &user_layout, &item_layout, &pool); },
+                                                              [&](){ save_grouped_shadow(&es, mf_info, sgd_info); });
+        epochs_run = e + 1;
+        bytes_moved.push_back((size_t)epoch_bytes_moved + converted_bytes - epoch_converted_bytes);
+
+        std::chrono::time_point<std::chrono::system_clock> evaluation_start_point = std::chrono::system_clock::now();
+        bool evaluated = cpu_eval_epoch(mf_info, e);
+        if (async_eval) publish_eval_snapshot(&evaluator, e, lr_decay_arr[e], cpu_train_rmse(user_group_loss, mf_info->n), valid_rmse, evaluated,
+                                              [&](float* p, float* q){ cpy_grouped2flat_parameters_cpu(mf_info, sgd_info, p, q); });
+        else if (evaluated) rmse = cpu_test_rmse_grouped(mf_info, &user_layout, &item_layout, &pool);
+        evaluation_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - evaluation_start_point).count();
+        if (!async_eval) print_cpu_epoch(mf_info, e, lr_decay_arr[e], evaluated, rmse, cpu_train_rmse(user_group_loss, mf_info->n), valid_rmse);
+        if (publish_snapshots && shm_snapshot_due(mf_info, e)) publish_snapshot(e + 1);
+        if (checkpoint_due(mf_info, e))
+            queue_training_checkpoint(&checkpoint_writer, mf_info, sgd_info->user_group_ptr, sgd_info->item_group_ptr, initial_user_group_error,
+                                      initial_item_group_error, num_threads, shuffle_seed, e + 1, NULL, 0);
+        if (tiered) trim_tiered_storage(&tiers, mf_info);
+        if (es.stop) break;
+    }
+    if (async_eval) rmse = finish_async_evaluator(&evaluator);
+    if (mf_info->checkpoint_path != "") finish_checkpoint_writer(&checkpoint_writer);
+    if (planned) print_precision_planner(&planner, mf_info, sgd_info);
+    if (tiered){
+        release_tiered_storage(&tiers, mf_info, sgd_info);
+        sgd_info->p = new float[(size_t)mf_info->max_user * k];
+        sgd_info->q = new float[(size_t)mf_info->max_item * k];
+    }
+    if (early_stopping){
+        if (restore_best_epoch(&es, epochs_run)) restore_grouped_shadow(&es, mf_info, sgd_info);
+        rmse = cpu_test_rmse_grouped(mf_info, &user_layout, &item_layout, &pool);
+        print_early_stopping(&es, mf_info, epochs_run);
+        cout << "Test RMSE of the best epoch      : " << rmse << endl;
+        free_early_stopping(&es);
+    }
+    if (publish_snapshots){
+        // After an early stop the restored best epoch is what gets served.
+        int final_epoch = restore_best_epoch(&es, epochs_run) ? es.best_epoch + 1 : epochs_run;
+        if (shm_snapshot_pending(&publisher, final_epoch) || final_epoch != epochs_run) publish_snapshot(final_epoch);
+        close_shm_snapshot_publisher(&publisher);
+    }
+
+    if (train_loss){
+        cout << "\n<Training RMSE of the last epoch per user group>\n";
+        for (int i = 0; i < user_group_num; i++){
+            double loss = 0;
+            for (int t = 0; t < num_threads; t++) loss += user_group_loss[(size_t)t * user_group_num + i];
+            cout << sqrt(loss / max(user_group_ratings[i], 1.0)) << " ";
+        }
+        cout << "\n<Training RMSE of the last epoch per item group>\n";
+        for (int i = 0; i < item_group_num; i++){
+            double loss = 0;
+            for (int t = 0; t < num_threads; t++) loss += item_group_loss[(size_t)t * item_group_num + i];
+            cout << sqrt(loss / max(item_group_ratings[i], 1.0)) << " ";
+        }
+        cout << "\n";
+    }
+
+    cout << "\n<Parameter bytes moved per epoch>\n";
+    for (size_t i = 0; i < bytes_moved.size(); i++) cout << bytes_moved[i] << " ";
+    cout << "\n";
+
+    unsigned int user_fp32_groups = 0, item_fp32_groups = 0, user_int8_groups = 0, item_int8_groups = 0, user_bf16_groups = 0, item_bf16_groups = 0;
+    for (int i = 0; i < user_group_num; i++) user_fp32_groups += mf_info->user_group_prec_info[i] == 1;
+    for (int i = 0; i < item_group_num; i++) item_fp32_groups += mf_info->item_group_prec_info[i] == 1;
+    for (int i = 0; i < user_group_num; i++) user_int8_groups += mf_info->user_group_prec_info[i] == GROUP_PREC_INT8;
+    for (int i = 0; i < item_group_num; i++) item_int8_groups += mf_info->item_group_prec_info[i] == GROUP_PREC_INT8;
+    for (int i = 0; i < user_group_num; i++) user_bf16_groups += mf_info->user_group_prec_info[i] == GROUP_PREC_BF16;
+    for (int i = 0; i < item_group_num; i++) item_bf16_groups += mf_info->item_group_prec_info[i] == GROUP_PREC_BF16;
+
+    double preprocess_exec_time = rating_histogram_execution_time + grouping_exec_time + reconst_exec_time + cpy2grouped_parameters_exec_time + additional_info_init_exec_time;
+    cout << "\n<Preprocessing time (micro sec)>" << endl;
+    cout << "Rating histogram                 : " << rating_histogram_execution_time << endl;
+    cout << "Grouping                         : " << grouping_exec_time << endl;
+    cout << "Matrix reconstruction            : " << reconst_exec_time << endl;
+    cout << "Copy to grouped params           : " << cpy2grouped_parameters_exec_time << endl;
+    cout << "Additional info init             : " << additional_info_init_exec_time << endl;
+    cout << "Total preprocessing time         : " << preprocess_exec_time << endl;
+    cout << "\n<Precision>" << endl;
+    cout << "FP32 user groups                 : " << user_fp32_groups << " / " << user_group_num << endl;
+    cout << "FP32 item groups                 : " << item_fp32_groups << " / " << item_group_num << endl;
+    if (mf_info->params.int8_group_ratio > 0 || planned){
+        cout << "INT8 user groups                 : " << user_int8_groups << " / " << user_group_num << endl;
+        cout << "INT8 item groups                 : " << item_int8_groups << " / " << item_group_num << endl;
+    }
+    if (mf_info->params.half_format){
+        cout << "BF16 user groups                 : " << user_bf16_groups << " / " << user_group_num << endl;
+        cout << "BF16 item groups                 : " << item_bf16_groups << " / " << item_group_num << endl;
+    }
+    cout << "Grouped parameters (bytes)       : " << grouped_parameters_footprint(mf_info, sgd_info) << endl;
+    cout << "Precision conversions (bytes)    : " << converted_bytes << endl;
+    cout << "Prefetch distance                : " << mf_info->params.prefetch_distance << endl;
+    cout << "Interleaved ratings              : " << mf_info->params.interleave << endl;
+    cout << "\nTotal precision switching time   : " << precision_switching_exec_time << endl;
+    cout << "Total error computation time     : " << error_computation_time << endl;
+    cout << "Total test evaluation time       : " << evaluation_exec_time << endl;
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / max(epochs_run - first_epoch, 1) << endl; 
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
+    cout << "Total MF time(ms)                : " << (preprocess_exec_time + precision_switching_exec_time + error_computation_time + sgd_update_execution_time)/1000 << endl;
+
+    destroy_cpu_thread_pool(&pool);
+    delete [] grad_sum_norm_p;
+    delete [] grad_sum_norm_q;
+    delete [] norm_sum_p;
+    delete [] norm_sum_q;
+    delete [] work;
+    delete [] user_layout.sorted_idx2group;
+    delete [] user_layout.group_start_idx;
+    delete [] item_layout.sorted_idx2group;
+    delete [] item_layout.group_start_idx;
+}
+
+// Incremental -v 11 run on a delta rating file (-dl) from a model trained on the training set (-im, loaded
+// into p/q by main). The degree groups of the training set are rebuilt and the delta's new users and items
+// are inserted into them, then -l epochs of MASCOT updates run over the delta plus -rr times as many ratings
+// replayed from the training set, sampled anew every epoch. The groups stay in fp16 since the calibration of
+// the base run is not available. With -rf, the time to come within -ep of that RMSE (a full retrain on
+// training set plus delta) is reported.
+void cpu_incremental_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    mf_info->test_COO = test_set_preprocess(mf_info);
+
+    // Grouping of the base, over the entities of the model only
+    unsigned int max_user = mf_info->max_user;
+    unsigned int max_item = mf_info->max_item;
+    double grouping_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> grouping_start_point = std::chrono::system_clock::now();
+    mf_info->max_user = mf_info->base_max_user;
+    mf_info->max_item = mf_info->base_max_item;
+    user_item_rating_histogram_cpu(mf_info);
+    split_group_based_equal_size_not_strict_ret_end_idx(mf_info, false);
+    matrix_reconstruction_cpu(mf_info);
+    mf_info->max_user = max_user;
+    mf_info->max_item = max_item;
+    grouping_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - grouping_start_point).count();
+
+    unsigned int user_group_num = mf_info->params.user_group_num;
+    unsigned int item_group_num = mf_info->params.item_group_num;
+    unsigned int k = mf_info->params.k;
+
+    double growth_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> growth_start_point = std::chrono::system_clock::now();
+    vector<unsigned int> user_added, item_added;
+    grow_groups_with_delta(mf_info, &user_added, &item_added);
+    sgd_info->user_group_ptr = new void*[user_group_num];
+    sgd_info->item_group_ptr = new void*[item_group_num];
+    cpy2grouped_parameters_cpu(mf_info, sgd_info);
+    mf_info->user_group_prec_info = new unsigned char[user_group_num]();
+    mf_info->item_group_prec_info = new unsigned char[item_group_num]();
+    Cpu_group_layout user_layout, item_layout;
+    build_cpu_group_layout(&user_layout, sgd_info->user_group_ptr, mf_info->user_group_prec_info, mf_info->user_group_end_idx, user_group_num);
+    build_cpu_group_layout(&item_layout, sgd_info->item_group_ptr, mf_info->item_group_prec_info, mf_info->item_group_end_idx, item_group_num);
+    growth_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - growth_start_point).count();
+
+    cout << "\n<Delta>" << endl;
+    cout << "Delta ratings                    : " << mf_info->delta_R.size() << endl;
+    cout << "New users / items                : " << max_user - mf_info->base_max_user << " / " << max_item - mf_info->base_max_item << endl;
+    cout << "New users per user group         : ";
+    for (unsigned int g = 0; g < user_group_num; g++) cout << user_added[g] << " ";
+    cout << "\nNew items per item group         : ";
+    for (unsigned int g = 0; g < item_group_num; g++) cout << item_added[g] << " ";
+    cout << endl;
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    size_t delta_n = mf_info->delta_R.size();
+    size_t replay_n = min((size_t)(delta_n * mf_info->params.replay_ratio), (size_t)mf_info->n);
+    vector<Node> epoch_R(delta_n + replay_n);
+    unsigned int num_threads = mf_info->params.num_threads;
+    unsigned int shard_size = (epoch_R.size() + num_threads - 1) / num_threads;
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, mf_info->params.numa_nodes);
+    mt19937 gen(time(0));
+    uniform_int_distribution<unsigned int> replay_dist(0, max(mf_info->n, 1u) - 1);
+
+    // No gradient statistics are sampled (first_sample_rating_idx past the shard), but the worker wants them.
+    float* grad_sum_norm_p = new float[(size_t)num_threads * user_group_num * k];
+    float* grad_sum_norm_q = new float[(size_t)num_threads * item_group_num * k];
+    float* norm_sum_p = new float[(size_t)num_threads * user_group_num];
+    float* norm_sum_q = new float[(size_t)num_threads * item_group_num];
+    float* work = new float[(size_t)num_threads * 2 * MAX_INTERLEAVE * k];
+
+    double replay_exec_time = 0;
+    double sgd_update_execution_time = 0;
+    double evaluation_exec_time = 0;
+    double reached_time = -1;
+    int reached_epoch = -1;
+    double target_rmse = mf_info->params.reference_rmse + mf_info->params.rmse_epsilon;
+    double rmse = cpu_test_rmse_grouped(mf_info, &user_layout, &item_layout, &pool);
+    cout << "\nTest RMSE before the delta       : " << rmse << endl;
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        std::chrono::time_point<std::chrono::system_clock> replay_start_point = std::chrono::system_clock::now();
+        copy(mf_info->delta_R.begin(), mf_info->delta_R.end(), epoch_R.begin());
+        for (size_t j = 0; j < replay_n; j++) epoch_R[delta_n + j] = mf_info->R[replay_dist(gen)];
+        shuffle(epoch_R.begin(), epoch_R.end(), gen);
+        replay_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - replay_start_point).count();
+
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        run_cpu_thread_pool(&pool, [&](unsigned int t){
+            unsigned int begin = min((size_t)t * shard_size, epoch_R.size());
+            unsigned int end = min((size_t)begin + shard_size, epoch_R.size());
+            cpu_mascot_sgd_worker(epoch_R.data(), begin, end, &user_layout, &item_layout, lr_decay_arr[e], k, mf_info->params.lambda,
+                                  grad_sum_norm_p + (size_t)t * user_group_num * k, grad_sum_norm_q + (size_t)t * item_group_num * k,
+                                  norm_sum_p + (size_t)t * user_group_num, norm_sum_q + (size_t)t * item_group_num,
+                                  shard_size, mf_info->params.prefetch_distance, mf_info->params.interleave,
+                                  work + (size_t)t * 2 * MAX_INTERLEAVE * k, NULL, NULL, e * num_threads + t);
+        });
+        sgd_update_execution_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+
+        std::chrono::time_point<std::chrono::system_clock> evaluation_start_point = std::chrono::system_clock::now();
+        bool evaluated = cpu_eval_epoch(mf_info, e);
+        if (evaluated) rmse = cpu_test_rmse_grouped(mf_info, &user_layout, &item_layout, &pool);
+        evaluation_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - evaluation_start_point).count();
+        print_cpu_epoch(mf_info, e, lr_decay_arr[e], evaluated, rmse, 0, 0);
+        if (evaluated && reached_epoch < 0 && mf_info->params.reference_rmse > 0 && rmse <= target_rmse){
+            reached_epoch = e + 1;
+            reached_time = grouping_exec_time + growth_exec_time + replay_exec_time + sgd_update_execution_time;
+        }
+    }
+
+    double preprocess_exec_time = grouping_exec_time + growth_exec_time;
+    cout << "\n<Incremental training time (micro sec)>" << endl;
+    cout << "Grouping of the base             : " << grouping_exec_time << endl;
+    cout << "Group growth and grouped params  : " << growth_exec_time << endl;
+    cout << "Replay sampling                  : " << replay_exec_time << endl;
+    cout << "Ratings per epoch (delta+replay) : " << delta_n << " + " << replay_n << endl;
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / mf_info->params.epoch << endl;
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl;
+    cout << "Total test evaluation time       : " << evaluation_exec_time << endl;
+    cout << "Total MF time(ms)                : " << (preprocess_exec_time + replay_exec_time + sgd_update_execution_time)/1000 << endl;
+    if (mf_info->params.reference_rmse > 0){
+        cout << "\n<Reference>" << endl;
+        cout << "Full retrain RMSE + epsilon      : " << mf_info->params.reference_rmse << " + " << mf_info->params.rmse_epsilon << endl;
+        if (reached_epoch > 0) cout << "Reached after epochs / time(ms)  : " << reached_epoch << " / " << reached_time / 1000 << endl;
+        else cout << "Reached after epochs / time(ms)  : not within " << mf_info->params.epoch << " epochs" << endl;
+    }
+
+    destroy_cpu_thread_pool(&pool);
+    free(lr_decay_arr);
+    delete [] grad_sum_norm_p;
+    delete [] grad_sum_norm_q;
+    delete [] norm_sum_p;
+    delete [] norm_sum_q;
+    delete [] work;
+    delete [] user_layout.sorted_idx2group;
+    delete [] user_layout.group_start_idx;
+    delete [] item_layout.sorted_idx2group;
+    delete [] item_layout.group_start_idx;
+}
+
+void cpu_contention_aware_training_mf(Mf_info* mf_info, SGD* sgd_info){
+    srand(time(0)); 
+    random_shuffle(mf_info->R, mf_info->R + mf_info->n);
+    mf_info->test_COO = test_set_preprocess(mf_info);
+    prepare_validation_set(mf_info);
+
+    unsigned int num_threads = mf_info->params.num_threads;
+    unsigned int k = mf_info->params.k;
+    unsigned int shard_size = (mf_info->n + num_threads - 1) / num_threads;
+    unsigned int merge_interval = max(1u, mf_info->params.merge_interval);
+    unsigned int merge_num = (shard_size + merge_interval - 1) / merge_interval;
+
+    double hot_item_selection_exec_time = 0;
+    std::chrono::time_point<std::chrono::system_clock> hot_item_selection_start_point = std::chrono::system_clock::now();
+    user_item_rating_histogram_cpu(mf_info);
+    unsigned int* item2hot = new unsigned int[mf_info->max_item];
+    unsigned int* hot_items = new unsigned int[mf_info->max_item];
+    unsigned int hot_num = select_hot_items(mf_info, num_threads, mf_info->params.target_contention, item2hot, hot_items);
+    hot_item_selection_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - hot_item_selection_start_point).count();
+
+    unsigned long long hot_ratings = 0;
+    for (unsigned int s = mf_info->max_item - hot_num; s < mf_info->max_item; s++) hot_ratings += mf_info->item2cnt[s];
+    double max_contention = (num_threads - 1) * (double)mf_info->item2cnt[mf_info->max_item - 1] / mf_info->n;
+    double cold_max_contention = hot_num < mf_info->max_item ? (num_threads - 1) * (double)mf_info->item2cnt[mf_info->max_item - 1 - hot_num] / mf_info->n : 0;
+
+    Hot_item_buffer* bufs = new Hot_item_buffer[num_threads];
+    for (unsigned int t = 0; t < num_threads; t++){
+        bufs[t].delta = new float[(size_t)max(hot_num, 1u) * k];
+        bufs[t].touched = new unsigned char[max(hot_num, 1u)]();
+    }
+    float* merge_sum = new float[(size_t)num_threads * k];
+
+    float* lr_decay_arr = (float*)malloc(sizeof(float)*mf_info->params.epoch);
+    for (int i = 0; i < mf_info->params.epoch; i++){
+        lr_decay_arr[i] = mf_info->params.learning_rate/(1.0 + (mf_info->params.decay*pow(i,1.5f)));
+    }
+
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, mf_info->params.numa_nodes);
+    double sgd_update_execution_time = 0;
+    double merge_exec_time = 0;
+    double evaluation_exec_time = 0;
+    bool async_eval = mf_info->params.eval_sample_ratio > 0;
+    Async_evaluator evaluator;
+    bool early_stopping = mf_info->params.patience > 0;
+    Early_stopping es;
+    init_early_stopping(&es, mf_info);
+    int epochs_run = 0;
+    if (async_eval) init_async_evaluator(&evaluator, mf_info, NULL);
+    double rmse = 0;
+    vector<double> thread_loss(num_threads);
+
+    for (int e = 0; e < mf_info->params.epoch; e++){
+        fill(thread_loss.begin(), thread_loss.end(), 0.0);
+        std::chrono::time_point<std::chrono::system_clock> sgd_update_start_time = std::chrono::system_clock::now();
+        for (unsigned int m = 0; m < merge_num; m++){
+            run_cpu_thread_pool(&pool, [&](unsigned int t){
+                unsigned long long shard_end = min((unsigned long long)(t + 1) * shard_size, (unsigned long long)mf_info->n);
+                unsigned int begin = min((unsigned long long)t * shard_size + (unsigned long long)m * merge_interval, shard_end);
+                unsigned int end = min((unsigned long long)begin + merge_interval, shard_end);
+                cpu_contention_aware_sgd_worker(mf_info->R, begin, end, sgd_info->p, sgd_info->q, lr_decay_arr[e], k, mf_info->params.lambda,
+                                                mf_info->params.prefetch_distance, item2hot, &bufs[t],
+                                                mf_info->params.train_loss ? &thread_loss[t] : NULL);
+            });
+
+            std::chrono::time_point<std::chrono::system_clock> merge_start_point = std::chrono::system_clock::now();
+            if (hot_num) run_cpu_thread_pool(&pool, [&](unsigned int t){
+                merge_hot_item_buffers(sgd_info->q, hot_items, bufs, num_threads,
+                                       (unsigned long long)hot_num * t / num_threads, (unsigned long long)hot_num * (t + 1) / num_threads, k,
+                                       merge_sum + (size_t)t * k);
+            });
+            merge_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - merge_start_point).count();
+        }
+        sgd_update_execution_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - sgd_update_start_time).count();
+
+        double valid_rmse = 0;
+        if (early_stopping) valid_rmse = early_stopping_epoch(&es, e, [&](){ return (double)cpu_set_rmse(&pool, mf_info->valid_COO, mf_info->valid_n, sgd_info->p, sgd_info->q, k); },
+                                                              [&](){ save_flat_shadow(&es, &pool, mf_info, sgd_info); });
+        epochs_run = e + 1;
+
+        std::chrono::time_point<std::chrono::system_clock> evaluation_start_point = std::chrono::system_clock::now();
+        bool evaluated = cpu_eval_epoch(mf_info, e);
+        if (async_eval) publish_eval_snapshot(&evaluator, e, lr_decay_arr[e], cpu_train_rmse(thread_loss, mf_info->n), valid_rmse, evaluated,
+                                              [&](float* p, float* q){ copy_flat_parameters(&pool, mf_info, sgd_info, p, q); });
+        else if (evaluated) rmse = cpu_test_rmse(mf_info, sgd_info, &pool);
+        evaluation_exec_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - evaluation_start_point).count();
+        if (!async_eval) print_cpu_epoch(mf_info, e, lr_decay_arr[e], evaluated, rmse, cpu_train_rmse(thread_loss, mf_info->n), valid_rmse);
+        if (es.stop) break;
+    }
+    if (async_eval) rmse = finish_async_evaluator(&evaluator);
+    if (early_stopping){
+        if (restore_best_epoch(&es, epochs_run)) restore_flat_shadow(&es, &pool, mf_info, sgd_info);
+        rmse = cpu_test_rmse(mf_info, sgd_info, &pool);
+        print_early_stopping(&es, mf_info, epochs_run);
+        cout << "Test RMSE of the best epoch      : " << rmse << endl;
+        free_early_stopping(&es);
+    }
+
+    cout << "\n<Contention-aware hogwild>" << endl;
+    cout << "Target contention rate           : " << mf_info->params.target_contention << endl;
+    cout << "Hot items                        : " << hot_num << " / " << mf_info->max_item << endl;
+    cout << "Ratings on hot items (%)         : " << 100.0 * hot_ratings / mf_info->n << endl;
+    cout << "Max contention rate (all items)  : " << max_contention << endl;
+    cout << "Max contention rate (cold items) : " << cold_max_contention << endl;
+    cout << "Merges per epoch                 : " << merge_num << endl;
+    cout << "\nHot item selection time          : " << hot_item_selection_exec_time << endl;
+    cout << "Total merge time                 : " << merge_exec_time << endl;
+    cout << "Total test evaluation time       : " << evaluation_exec_time << endl;
+    cout << "Parameters update per epoch      : " << sgd_update_execution_time / epochs_run << endl; 
+    cout << "Total parameters update          : " << sgd_update_execution_time << endl; 
+    cout << "Total MF time(ms)                : " << (hot_item_selection_exec_time + sgd_update_execution_time)/1000 << endl;
+
+    destroy_cpu_thread_pool(&pool);
+    for (unsigned int t = 0; t < num_threads; t++){
+        delete [] bufs[t].delta;
+        delete [] bufs[t].touched;
+    }
+    delete [] bufs;
+    delete [] merge_sum;
+    delete [] item2hot;
+    delete [] hot_items;
+}
@@ -1,11 +1,16 @@
-#ifndef MODEL_INIT_H
-#define MODEL_INIT_H
-#include "common_struct.h"
-
-void init_model_single(Mf_info *mf_info, SGD *sgd_info);
-void cpy2grouped_parameters_gpu_for_comparison_indexing(Mf_info *mf_info, SGD *sgd_info);
-void transform_feature_vector_half2float(short *half_feature, float *float_feature, unsigned int dim, unsigned int k);
-void conversion_features_half(short *feature_vec, float *feature_vec_from ,unsigned int dim, unsigned int k);
-void init_model_half(Mf_info *mf_info, SGD *sgd_info);
-void transition_params_half2float(Mf_info *mf_info, SGD *sgd_info);
+#ifndef MODEL_INIT_H
+#define MODEL_INIT_H
+#include "common_struct.h"
+
+void init_model_single(Mf_info *mf_info, SGD *sgd_info);
+void init_model_single_cpu(Mf_info *mf_info, SGD *sgd_info);
+void cpy2grouped_parameters_gpu_for_comparison_indexing(Mf_info *mf_info, SGD *sgd_info);
+void cpy2grouped_parameters_cpu(Mf_info *mf_info, SGD *sgd_info);
+void cpy_grouped2flat_parameters_cpu(Mf_info *mf_info, SGD *sgd_info);
+void cpy_grouped2flat_parameters_cpu(Mf_info *mf_info, SGD *sgd_info, float *p, float *q);
+void cpy_grouped2flat_parameters_gpu(Mf_info *mf_info, SGD *sgd_info);
+void transform_feature_vector_half2float(short *half_feature, float *float_feature, unsigned int dim, unsigned int k);
+void conversion_features_half(short *feature_vec, float *feature_vec_from ,unsigned int dim, unsigned int k);
+void init_model_half(Mf_info *mf_info, SGD *sgd_info);
+void transition_params_half2float(Mf_info *mf_info, SGD *sgd_info);
 #endif
\ No newline at end of file
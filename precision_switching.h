@@ -1,52 +1,124 @@
-__global__ void mem_cpy_fp162fp32(float* out, __half* in, int n){
-    int i = threadIdx.x + blockIdx.x * blockDim.x;
-
-    for (; i < n; i += gridDim.x * blockDim.x)
-        out[i] = __half2float(in[i]);
-}
-
-void precision_switching_by_groups_grad_diversity(Mf_info* mf_info, SGD* sgd_info){
-    int num_groups = 10000;
-    float threshold = mf_info->params.error_threshold;
-    
-    for (int i = 0; i < mf_info->params.user_group_num; i++){
-        if (mf_info->user_group_error[i] > threshold){
-            float* d_new_group_ptr;
-            __half* temp_ptr;
-            unsigned int group_params_size = mf_info->user_group_size[i] * mf_info->params.k;
-            cudaMalloc(&d_new_group_ptr, sizeof(float) * group_params_size);
-            mem_cpy_fp162fp32<<<num_groups, 512>>>(d_new_group_ptr, (__half*)sgd_info->user_group_d_ptr[i], group_params_size);
-            cudaDeviceSynchronize();
-            temp_ptr = (__half*)sgd_info->user_group_d_ptr[i];
-            (sgd_info->user_group_d_ptr[i]) = d_new_group_ptr;
-            cudaFree(temp_ptr);
-            mf_info->user_group_prec_info[i] = (unsigned char)1;
-            cudaFreeHost(sgd_info->user_group_ptr[i]);
-            cudaMallocHost((&(sgd_info->user_group_ptr[i])), sizeof(float)*group_params_size);
-        }
-    }
-
-    cudaMemcpy(mf_info->d_user_group_prec_info, mf_info->user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num, cudaMemcpyHostToDevice);
-    cudaMemcpy(sgd_info->d_user_group_ptr, sgd_info->user_group_d_ptr, sizeof(void*) * mf_info->params.user_group_num, cudaMemcpyHostToDevice);
-    
-    for (int i = 0; i < mf_info->params.item_group_num; i++){
-        if (mf_info->item_group_error[i] > threshold){
-            float* d_new_group_ptr;
-            __half* temp_ptr;
-            unsigned int group_params_size = mf_info->item_group_size[i] * mf_info->params.k;
-            cudaMalloc(&d_new_group_ptr, sizeof(float) * group_params_size);
-            mem_cpy_fp162fp32<<<num_groups, 512>>>(d_new_group_ptr, (__half*)sgd_info->item_group_d_ptr[i], group_params_size);
-            cudaDeviceSynchronize();
-            temp_ptr = (__half*)sgd_info->item_group_d_ptr[i];
-            (sgd_info->item_group_d_ptr[i]) = d_new_group_ptr;
-            cudaFree(temp_ptr);
-            mf_info->item_group_prec_info[i] = (unsigned char)1;  
-            cudaFreeHost(sgd_info->item_group_ptr[i]);
-            cudaMallocHost(&sgd_info->item_group_ptr[i], sizeof(float)*group_params_size);
-        }
-    }
-
-    cudaMemcpy(mf_info->d_item_group_prec_info,  mf_info->item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num, cudaMemcpyHostToDevice);
-    cudaMemcpy(sgd_info->d_item_group_ptr, sgd_info->item_group_d_ptr, sizeof(void**) * mf_info->params.item_group_num, cudaMemcpyHostToDevice);
-}
-
+__global__ void mem_cpy_fp162fp32(float* out, __half* in, int n){
+    int i = threadIdx.x + blockIdx.x * blockDim.x;
+
+    for (; i < n; i += gridDim.x * blockDim.x)
+        out[i] = __half2float(in[i]);
+}
+
+void precision_switching_by_groups_grad_diversity(Mf_info* mf_info, SGD* sgd_info){
+    int num_groups = 10000;
+    float threshold = mf_info->params.error_threshold;
+    
+    for (int i = 0; i < mf_info->params.user_group_num; i++){
+        if (mf_info->user_group_error[i] > threshold){
+            float* d_new_group_ptr;
+            __half* temp_ptr;
+            unsigned int group_params_size = mf_info->user_group_size[i] * mf_info->params.k;
+            cudaMalloc(&d_new_group_ptr, sizeof(float) * group_params_size);
+            mem_cpy_fp162fp32<<<num_groups, 512>>>(d_new_group_ptr, (__half*)sgd_info->user_group_d_ptr[i], group_params_size);
+            cudaDeviceSynchronize();
+            temp_ptr = (__half*)sgd_info->user_group_d_ptr[i];
+            (sgd_info->user_group_d_ptr[i]) = d_new_group_ptr;
+            cudaFree(temp_ptr);
+            mf_info->user_group_prec_info[i] = (unsigned char)1;
+            cudaFreeHost(sgd_info->user_group_ptr[i]);
+            cudaMallocHost((&(sgd_info->user_group_ptr[i])), sizeof(float)*group_params_size);
+        }
+    }
+
+    cudaMemcpy(mf_info->d_user_group_prec_info, mf_info->user_group_prec_info, sizeof(unsigned char) * mf_info->params.user_group_num, cudaMemcpyHostToDevice);
+    cudaMemcpy(sgd_info->d_user_group_ptr, sgd_info->user_group_d_ptr, sizeof(void*) * mf_info->params.user_group_num, cudaMemcpyHostToDevice);
+    
+    for (int i = 0; i < mf_info->params.item_group_num; i++){
+        if (mf_info->item_group_error[i] > threshold){
+            float* d_new_group_ptr;
+            __half* temp_ptr;
+            unsigned int group_params_size = mf_info->item_group_size[i] * mf_info->params.k;
+            cudaMalloc(&d_new_group_ptr, sizeof(float) * group_params_size);
+            mem_cpy_fp162fp32<<<num_groups, 512>>>(d_new_group_ptr, (__half*)sgd_info->item_group_d_ptr[i], group_params_size);
+            cudaDeviceSynchronize();
+            temp_ptr = (__half*)sgd_info->item_group_d_ptr[i];
+            (sgd_info->item_group_d_ptr[i]) = d_new_group_ptr;
+            cudaFree(temp_ptr);
+            mf_info->item_group_prec_info[i] = (unsigned char)1;  
+            cudaFreeHost(sgd_info->item_group_ptr[i]);
+            cudaMallocHost(&sgd_info->item_group_ptr[i], sizeof(float)*group_params_size);
+        }
+    }
+
+    cudaMemcpy(mf_info->d_item_group_prec_info,  mf_info->item_group_prec_info, sizeof(unsigned char) * mf_info->params.item_group_num, cudaMemcpyHostToDevice);
+    cudaMemcpy(sgd_info->d_item_group_ptr, sgd_info->item_group_d_ptr, sizeof(void**) * mf_info->params.item_group_num, cudaMemcpyHostToDevice);
+}
+
+
+// -hf 1 stores every fp16 group in bf16, re-stored from the flat P/Q rather than from the rounded fp16 values.
+// (-hf 2 decides per group at the precision checks, see wider_group_prec.) Returns the number of bf16 groups.
+unsigned int init_bf16_groups(Mf_info* mf_info, SGD* sgd_info){
+    unsigned int k = mf_info->params.k;
+    unsigned int bf16_group_num = 0;
+    for (int side = 0; side < 2; side++){
+        unsigned int group_num = side ? mf_info->params.item_group_num : mf_info->params.user_group_num;
+        unsigned int* group_size = side ? mf_info->item_group_size : mf_info->user_group_size;
+        unsigned char* group_prec = side ? mf_info->item_group_prec_info : mf_info->user_group_prec_info;
+        void** group_ptr = side ? sgd_info->item_group_ptr : sgd_info->user_group_ptr;
+        unsigned int* sorted_idx2orig = side ? mf_info->sorted_idx2item : mf_info->sorted_idx2user;
+        const float* flat = side ? sgd_info->q : sgd_info->p;
+        unsigned int start_idx = 0;
+        for (unsigned int g = 0; g < group_num; start_idx += group_size[g], g++){
+            if (group_prec[g] != 0) continue;
+            unsigned short* group = (unsigned short*)new_grouped_params(GROUP_PREC_BF16, group_size[g], k);
+            for (unsigned int local = 0; local < group_size[g]; local++)
+                cpu_float2bfloat16_row(group + (size_t)local * k, flat + (size_t)sorted_idx2orig[start_idx + local] * k, k);
+            delete_grouped_params(group_ptr[g], group_prec[g]);
+            group_ptr[g] = group;
+            group_prec[g] = GROUP_PREC_BF16;
+            bf16_group_num++;
+        }
+    }
+    return bf16_group_num;
+}
+
+// The ratio (-i8) of the groups of each side with the fewest ratings per row start in int8, given the ratings
+// per group. Returns the bytes read and written.
+size_t init_int8_groups_by_degree(Mf_info* mf_info, SGD* sgd_info, const vector<double>& user_group_ratings, const vector<double>& item_group_ratings){
+    size_t converted_bytes = 0;
+    for (int side = 0; side < 2; side++){
+        unsigned int group_num = side ? mf_info->params.item_group_num : mf_info->params.user_group_num;
+        unsigned int* group_size = side ? mf_info->item_group_size : mf_info->user_group_size;
+        unsigned char* group_prec = side ? mf_info->item_group_prec_info : mf_info->user_group_prec_info;
+        void** group_ptr = side ? sgd_info->item_group_ptr : sgd_info->user_group_ptr;
+        const vector<double>& ratings = side ? item_group_ratings : user_group_ratings;
+        vector<unsigned int> order(group_num);
+        for (unsigned int g = 0; g < group_num; g++) order[g] = g;
+        stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b){ return ratings[a] / group_size[a] < ratings[b] / group_size[b]; });
+        unsigned int int8_group_num = min(group_num, (unsigned int)(group_num * mf_info->params.int8_group_ratio + 0.5f));
+        for (unsigned int j = 0; j < int8_group_num; j++)
+            if (group_prec[order[j]] != 1)
+                converted_bytes += convert_grouped_params(&group_ptr[order[j]], &group_prec[order[j]], GROUP_PREC_INT8, group_size[order[j]], mf_info->params.k);
+    }
+    return converted_bytes;
+}
+
+// A group over the threshold moves one tier up (int8 -> fp16 or bf16 -> fp32, see wider_group_prec). Returns
+// the bytes read and written.
+size_t precision_switching_by_groups_grad_diversity_cpu(Mf_info* mf_info, SGD* sgd_info){
+    float threshold = mf_info->params.error_threshold;
+    size_t converted_bytes = 0;
+
+    for (int i = 0; i < mf_info->params.user_group_num; i++){
+        if (mf_info->user_group_error[i] > threshold && mf_info->user_group_prec_info[i] != 1){
+            converted_bytes += convert_grouped_params(&sgd_info->user_group_ptr[i], &mf_info->user_group_prec_info[i],
+                                                      wider_group_prec(sgd_info->user_group_ptr[i], mf_info->user_group_prec_info[i], mf_info->user_group_size[i],
+                                                                       mf_info->params.k, mf_info->params.half_format), mf_info->user_group_size[i], mf_info->params.k);
+        }
+    }
+
+    for (int i = 0; i < mf_info->params.item_group_num; i++){
+        if (mf_info->item_group_error[i] > threshold && mf_info->item_group_prec_info[i] != 1){
+            converted_bytes += convert_grouped_params(&sgd_info->item_group_ptr[i], &mf_info->item_group_prec_info[i],
+                                                      wider_group_prec(sgd_info->item_group_ptr[i], mf_info->item_group_prec_info[i], mf_info->item_group_size[i],
+                                                                       mf_info->params.k, mf_info->params.half_format), mf_info->item_group_size[i], mf_info->params.k);
+        }
+    }
+    return converted_bytes;
+}
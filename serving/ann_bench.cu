@@ -0,0 +1,118 @@
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include "common_struct.h"
+#include "io_utils.h"
+#include "cpu_thread_pool.h"
+#include "serving_model.h"
+#include "topk.h"
+#include "ivf_index.h"
+using namespace std;
+
+// Builds (or loads) the IVF index of a trained model, stored next to it as <model>.ivf, and sweeps the
+// number of probed lists against the exact top-K: recall@K and queries per second.
+
+bool exists (const std::string& name) {
+    struct stat buffer;
+    return (stat(name.c_str(), &buffer) == 0);
+}
+
+vector<unsigned int> parse_list(const string& s){
+    vector<unsigned int> out;
+    stringstream ss(s);
+    string tok;
+    while (getline(ss, tok, ',')) if (tok != "") out.push_back(atoi(tok.c_str()));
+    return out;
+}
+
+void usage(const char* name){
+    cout << name << " -m <model> -i <train-tsv> [-K <items/user> -nl <lists> -it <k-means iterations> -np <probes,...> -t <threads> -n <users> -rb 1]" << endl;
+}
+
+int main (int argc, const char* argv[]){
+    string model_file = "";
+    string train_file = "";
+    unsigned int K = 10;
+    unsigned int nlist = 0;
+    unsigned int iterations = 10;
+    string probe_list = "1,2,4,8,16,32,64";
+    unsigned int num_threads = thread::hardware_concurrency();
+    unsigned int user_limit = 0;
+    bool rebuild = false;
+
+    for(int i = 0; i < argc; i++){
+        if(string(argv[i]) == "-m" && i < argc-1) model_file = string(argv[i+1]);
+        if(string(argv[i]) == "-i" && i < argc-1) train_file = string(argv[i+1]);
+        if(string(argv[i]) == "-K" && i < argc-1) K = stoi(argv[i+1]);
+        if(string(argv[i]) == "-nl" && i < argc-1) nlist = stoi(argv[i+1]);
+        if(string(argv[i]) == "-it" && i < argc-1) iterations = stoi(argv[i+1]);
+        if(string(argv[i]) == "-np" && i < argc-1) probe_list = string(argv[i+1]);
+        if(string(argv[i]) == "-t" && i < argc-1) num_threads = stoi(argv[i+1]);
+        if(string(argv[i]) == "-n" && i < argc-1) user_limit = stoi(argv[i+1]);
+        if(string(argv[i]) == "-rb" && i < argc-1) rebuild = stoi(argv[i+1]) != 0;
+        if(string(argv[i]) == "-h"){
+            usage(argv[0]);
+            return(0);
+        }
+    }
+
+    if(!exists(model_file) || !exists(train_file) || K == 0){
+        usage(argv[0]);
+        return(0);
+    }
+
+    Serving_model model;
+    load_serving_model(&model, model_file, train_file);
+    unsigned int user_num = user_limit ? min(user_limit, model.user_num) : model.user_num;
+    if (nlist == 0) nlist = max(1u, (unsigned int)(4 * sqrt((double)model.item_num)));
+
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, 0);
+
+    cout << endl;
+    cout << "Model file                       : " << model_file << endl;
+    cout << "Users / items / k                : " << model.user_num << " / " << model.item_num << " / " << model.k << endl;
+    cout << "Threads                          : " << num_threads << endl;
+
+    string index_file = model_file + ".ivf";
+    Ivf_index index;
+    std::chrono::time_point<std::chrono::system_clock> build_start_point = std::chrono::system_clock::now();
+    bool loaded = !rebuild && load_ivf_index(&index, &model, index_file);
+    if (!loaded){
+        build_ivf_index(&pool, &model, nlist, iterations, &index);
+        save_ivf_index(&index, &model, index_file);
+    }
+    double build_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - build_start_point).count();
+    cout << "Index file                       : " << index_file << (loaded ? " (loaded)" : " (built)") << endl;
+    cout << "Lists / k-means iterations       : " << index.nlist << " / " << (loaded ? string("-") : to_string(iterations)) << endl;
+    cout << (loaded ? "Load time                        : " : "Build time                       : ") << build_exec_time << endl;
+
+    Item_panels panels;
+    pack_item_panels(&pool, model.q, model.item_num, model.k, &panels);
+    vector<Topk_entry> exact, approx;
+    vector<unsigned int> exact_counts, approx_counts;
+    std::chrono::time_point<std::chrono::system_clock> exact_start_point = std::chrono::system_clock::now();
+    topk_recommend(&pool, &model, &panels, K, user_num, &exact, &exact_counts);
+    double exact_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - exact_start_point).count();
+
+    cout << "\n<Recall@" << K << " vs QPS, " << user_num << " queries>" << endl;
+    cout << "Exact batch scan                 : " << user_num / (exact_exec_time / 1000000) << " QPS" << endl;
+    vector<unsigned int> probes = parse_list(probe_list);
+    for (unsigned int j = 0; j < probes.size(); j++){
+        std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+        size_t scored = ivf_recommend(&pool, &index, &model, probes[j], K, user_num, &approx, &approx_counts);
+        double exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+        string label = "nprobe " + to_string(probes[j]);
+        cout << label << string(label.size() < 33 ? 33 - label.size() : 1, ' ') << ": "
+             << user_num / (exec_time / 1000000) << " QPS, recall " << topk_recall(exact, exact_counts, approx, approx_counts, K)
+             << ", " << 100.0 * scored / ((double)user_num * model.item_num) << "% of items scored" << endl;
+    }
+
+    free_item_panels(&panels);
+    free_serving_model(&model);
+    destroy_cpu_thread_pool(&pool);
+    return 0;
+}
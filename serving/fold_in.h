@@ -0,0 +1,174 @@
+#ifndef FOLD_IN_H
+#define FOLD_IN_H
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include "cpu_thread_pool.h"
+#include "cpu_rmse.h"
+#include "serving_model.h"
+#include "topk.h"
+using namespace std;
+
+// Fold-in of a user that is not in the model: with Q fixed, p_u minimizes the training objective over the
+// user's ratings, sum (r - p_u q_i)^2 + lambda * n * |p_u|^2 (SGD regularizes p_u once per rating), whose
+// solution is (Q_u^T Q_u + lambda n I) p_u = Q_u^T r. The upper triangle of the k x k Gram matrix is
+// accumulated FOLD_IN_RATING_BLOCK ratings at a time with the vector FMAs of topk.h, so every row of it is
+// loaded and stored once per block; the Cholesky factorization that solves the system runs on the same vectors.
+#define FOLD_IN_RATING_BLOCK 4
+#define FOLD_IN_PANEL 4
+
+struct Fold_in_rating{
+    unsigned int item;      // serving index
+    float r;
+};
+
+// Scratch of one solver thread, sized for k.
+struct Fold_in_workspace{
+    unsigned int k;
+    unsigned int stride;    // k rounded up to TOPK_LANES
+    float* a;               // k x stride Gram matrix, then its Cholesky factor in the upper triangle
+    float* b;
+};
+
+void init_fold_in_workspace(Fold_in_workspace* ws, unsigned int k){
+    ws->k = k;
+    ws->stride = (k + TOPK_LANES - 1) / TOPK_LANES * TOPK_LANES;
+    ws->a = (float*)aligned_alloc(64, sizeof(float) * (size_t)ws->stride * (k + 1));
+    ws->b = (float*)aligned_alloc(64, sizeof(float) * ws->stride);
+}
+
+void free_fold_in_workspace(Fold_in_workspace* ws){
+    free(ws->a);
+    free(ws->b);
+}
+
+inline topk_vec fold_in_loadu(const float* a){
+#if defined(__AVX512F__)
+    return _mm512_loadu_ps(a);
+#elif defined(__AVX2__) && defined(__FMA__)
+    return _mm256_loadu_ps(a);
+#else
+    return topk_load(a);
+#endif
+}
+
+// Upper triangle of a = Q_u^T Q_u over the n ratings, b = Q_u^T r. Row d is accumulated from the lane group of
+// column d on; the entries left of it and the columns past k are don't-care. Q rows are read in whole vectors,
+// which stays inside the SERVING_ROW_PADDING rows after the last item.
+void fold_in_gram(const Serving_model* model, const Fold_in_rating* ratings, unsigned int n, Fold_in_workspace* ws){
+    unsigned int k = ws->k, stride = ws->stride;
+    memset(ws->a, 0, sizeof(float) * (size_t)stride * k);
+    memset(ws->b, 0, sizeof(float) * stride);
+    unsigned int j = 0;
+    for (; j + FOLD_IN_RATING_BLOCK <= n; j += FOLD_IN_RATING_BLOCK){
+        const float* q[FOLD_IN_RATING_BLOCK];
+        for (unsigned int l = 0; l < FOLD_IN_RATING_BLOCK; l++) q[l] = model->q + (size_t)ratings[j + l].item * k;
+        for (unsigned int l = 0; l < FOLD_IN_RATING_BLOCK; l++) __builtin_prefetch(model->q + (size_t)ratings[min(j + FOLD_IN_RATING_BLOCK + l, n - 1)].item * k);
+        for (unsigned int d = 0; d < k; d++){
+            float* row = ws->a + (size_t)d * stride;
+            float f[FOLD_IN_RATING_BLOCK];
+            for (unsigned int l = 0; l < FOLD_IN_RATING_BLOCK; l++) f[l] = q[l][d];
+            for (unsigned int c = d / TOPK_LANES * TOPK_LANES; c < stride; c += TOPK_LANES){
+                topk_vec acc = topk_load(row + c);
+                for (unsigned int l = 0; l < FOLD_IN_RATING_BLOCK; l++) acc = topk_fmadd(f[l], fold_in_loadu(q[l] + c), acc);
+                topk_store(row + c, acc);
+            }
+        }
+        for (unsigned int l = 0; l < FOLD_IN_RATING_BLOCK; l++)
+            for (unsigned int d = 0; d < k; d++) ws->b[d] += ratings[j + l].r * q[l][d];
+    }
+    for (; j < n; j++){
+        const float* q = model->q + (size_t)ratings[j].item * k;
+        for (unsigned int d = 0; d < k; d++){
+            float* row = ws->a + (size_t)d * stride;
+            for (unsigned int c = d / TOPK_LANES * TOPK_LANES; c < stride; c += TOPK_LANES)
+                topk_store(row + c, topk_fmadd(q[d], fold_in_loadu(q + c), topk_load(row + c)));
+            ws->b[d] += ratings[j].r * q[d];
+        }
+    }
+}
+
+// Solves (a + reg I) x = b with a = U^T U, U overwriting the upper triangle of a. The factorization is
+// right-looking over panels of FOLD_IN_PANEL rows: the rows of a panel are factored among themselves, then
+// every later row i loses U[j][i] times row j for all rows j of the panel in one pass, FOLD_IN_PANEL vector
+// FMAs per TOPK_LANES columns from the lane group of column i on (columns left of the diagonal are don't-care).
+// Returns false when the matrix is not positive definite, which only happens for reg = 0.
+bool fold_in_cholesky_solve(Fold_in_workspace* ws, float reg, float* x){
+    unsigned int k = ws->k, stride = ws->stride;
+    float* a = ws->a;
+    for (unsigned int d = 0; d < k; d++) a[(size_t)d * stride + d] += reg;
+    for (unsigned int j0 = 0; j0 < k; j0 += FOLD_IN_PANEL){
+        unsigned int j_end = min(j0 + FOLD_IN_PANEL, k);
+        for (unsigned int j = j0; j < j_end; j++){
+            float* row_j = a + (size_t)j * stride;
+            if (!(row_j[j] > 0)) return false;
+            row_j[j] = sqrt(row_j[j]);
+            float inv = 1.0f / row_j[j];
+            for (unsigned int c = j + 1; c < k; c++) row_j[c] *= inv;
+            for (unsigned int i = j + 1; i < j_end; i++){
+                float* row_i = a + (size_t)i * stride;
+                float f = -row_j[i];
+                for (unsigned int c = i / TOPK_LANES * TOPK_LANES; c < stride; c += TOPK_LANES)
+                    topk_store(row_i + c, topk_fmadd(f, topk_load(row_j + c), topk_load(row_i + c)));
+            }
+        }
+        // Only the last panel can be short, and no rows follow it.
+        const float* panel = a + (size_t)j0 * stride;
+        for (unsigned int i = j_end; i < k; i++){
+            float* row_i = a + (size_t)i * stride;
+            float f[FOLD_IN_PANEL];
+            for (unsigned int l = 0; l < FOLD_IN_PANEL; l++) f[l] = -panel[(size_t)l * stride + i];
+            for (unsigned int c = i / TOPK_LANES * TOPK_LANES; c < stride; c += TOPK_LANES){
+                topk_vec acc = topk_load(row_i + c);
+                for (unsigned int l = 0; l < FOLD_IN_PANEL; l++) acc = topk_fmadd(f[l], topk_load(panel + (size_t)l * stride + c), acc);
+                topk_store(row_i + c, acc);
+            }
+        }
+    }
+    // U^T y = b column by column, then U x = y.
+    float* b = ws->b;
+    for (unsigned int i = 0; i < k; i++){
+        const float* row_i = a + (size_t)i * stride;
+        x[i] = b[i] / row_i[i];
+        for (unsigned int c = i + 1; c < k; c++) b[c] -= x[i] * row_i[c];
+    }
+    for (unsigned int i = k; i-- > 0;){
+        const float* row_i = a + (size_t)i * stride;
+        x[i] = (x[i] - cpu_dot(row_i + i + 1, x + i + 1, k - i - 1)) / row_i[i];
+    }
+    return true;
+}
+
+// p_u of one user from its n ratings; a user without ratings gets the zero vector.
+bool fold_in_user(const Serving_model* model, const Fold_in_rating* ratings, unsigned int n, float lambda, Fold_in_workspace* ws, float* p){
+    if (n == 0){
+        memset(p, 0, sizeof(float) * model->k);
+        return true;
+    }
+    fold_in_gram(model, ratings, n, ws);
+    if (fold_in_cholesky_solve(ws, lambda * n, p)) return true;
+    memset(p, 0, sizeof(float) * model->k);
+    return false;
+}
+
+// Batched fold-in of user_cnt users: the ratings of user u are ratings[begin[u], begin[u + 1]) and its
+// vector goes to p + u * k. Users are spread over the pool threads, or solved by the calling thread when pool
+// is NULL. Returns the number of users whose system could not be solved (left at zero).
+unsigned int fold_in_users(Cpu_thread_pool* pool, const Serving_model* model, const Fold_in_rating* ratings, const size_t* begin,
+                           unsigned int user_cnt, float lambda, float* p){
+    atomic<unsigned int> next_user(0), failed(0);
+    auto solve = [&](unsigned int t){
+        Fold_in_workspace ws;
+        init_fold_in_workspace(&ws, model->k);
+        for (unsigned int u = next_user.fetch_add(1); u < user_cnt; u = next_user.fetch_add(1))
+            if (!fold_in_user(model, ratings + begin[u], begin[u + 1] - begin[u], lambda, &ws, p + (size_t)u * model->k)) failed++;
+        free_fold_in_workspace(&ws);
+    };
+    if (pool == NULL) solve(0);
+    else run_cpu_thread_pool(pool, solve);
+    return failed;
+}
+
+#endif
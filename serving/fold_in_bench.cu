@@ -0,0 +1,178 @@
+#include <iostream>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cmath>
+#include "common_struct.h"
+#include "io_utils.h"
+#include "cpu_thread_pool.h"
+#include "serving_model.h"
+#include "fold_in.h"
+using namespace std;
+
+// Cold-start benchmark of fold_in.h. Users of the model are treated as new: their vectors are folded in
+// from -r of their training ratings (and from all of them), with Q fixed, and scored on their test ratings
+// next to the trained vectors. Reports the latency of one fold-in and the throughput of the batched one.
+
+bool exists (const std::string& name) {
+    struct stat buffer;
+    return (stat(name.c_str(), &buffer) == 0);
+}
+
+void usage(const char* name){
+    cout << name << " -m <model> -i <train-tsv> -y <test-tsv> [-r <ratings/user> -n <users> -b <lambda> -t <threads>]" << endl;
+}
+
+void print_label(const string& name){
+    cout << name << string(name.size() < 33 ? 33 - name.size() : 1, ' ') << ": ";
+}
+
+double test_rmse(const Serving_model* model, const vector<vector<Fold_in_rating>>& tests, const float* p){
+    double sum = 0;
+    size_t n = 0;
+    for (unsigned int u = 0; u < tests.size(); u++)
+        for (unsigned int j = 0; j < tests[u].size(); j++){
+            double e = tests[u][j].r - cpu_dot(p + (size_t)u * model->k, model->q + (size_t)tests[u][j].item * model->k, model->k);
+            sum += e * e;
+            n++;
+        }
+    return n ? sqrt(sum / n) : 0;
+}
+
+int main (int argc, const char* argv[]){
+    string model_file = "";
+    string train_file = "";
+    string test_file = "";
+    unsigned int ratings_per_user = 10;
+    unsigned int user_limit = 1000;
+    float lambda = 0.015;
+    unsigned int num_threads = thread::hardware_concurrency();
+
+    for(int i = 0; i < argc; i++){
+        if(string(argv[i]) == "-m" && i < argc-1) model_file = string(argv[i+1]);
+        if(string(argv[i]) == "-i" && i < argc-1) train_file = string(argv[i+1]);
+        if(string(argv[i]) == "-y" && i < argc-1) test_file = string(argv[i+1]);
+        if(string(argv[i]) == "-r" && i < argc-1) ratings_per_user = stoi(argv[i+1]);
+        if(string(argv[i]) == "-n" && i < argc-1) user_limit = stoi(argv[i+1]);
+        if(string(argv[i]) == "-b" && i < argc-1) lambda = atof(argv[i+1]);
+        if(string(argv[i]) == "-t" && i < argc-1) num_threads = stoi(argv[i+1]);
+        if(string(argv[i]) == "-h"){
+            usage(argv[0]);
+            return(0);
+        }
+    }
+
+    if(!exists(model_file) || !exists(train_file) || !exists(test_file) || ratings_per_user == 0 || user_limit == 0){
+        usage(argv[0]);
+        return(0);
+    }
+
+    Serving_model model;
+    load_serving_model(&model, model_file, train_file);
+    Mf_info info;
+    read_training_dataset(&info, train_file);
+    read_test_dataset(&info, test_file);
+
+    vector<unsigned int> user2serving(info.max_user), item2serving(info.max_item);
+    for (map<unsigned int, unsigned int>::iterator it = info.user_map.begin(); it != info.user_map.end(); it++)
+        user2serving[it->second] = find_serving_id(model.user2orig, model.user_num, it->first);
+    for (map<unsigned int, unsigned int>::iterator it = info.item_map.begin(); it != info.item_map.end(); it++)
+        item2serving[it->second] = find_serving_id(model.item2orig, model.item_num, it->first);
+
+    vector<vector<Fold_in_rating>> train(info.max_user);
+    for (size_t j = 0; j < info.n; j++){
+        Fold_in_rating x = {item2serving[info.R[j].i], info.R[j].r};
+        train[info.R[j].u].push_back(x);
+    }
+
+    // New users: a deterministic sample of the users with test ratings, each with a random handful of its
+    // training ratings.
+    vector<unsigned int> candidates;
+    for (unsigned int u = 0; u < info.max_user; u++) if (info.test_R[u].size() && train[u].size()) candidates.push_back(u);
+    mt19937 gen(1234);
+    shuffle(candidates.begin(), candidates.end(), gen);
+    unsigned int user_num = min((size_t)user_limit, candidates.size());
+    vector<Fold_in_rating> handful, all;
+    vector<size_t> handful_begin(1, 0), all_begin(1, 0);
+    vector<vector<Fold_in_rating>> tests(user_num);
+    float* trained_p = alloc_serving_rows(user_num, model.k);
+    for (unsigned int s = 0; s < user_num; s++){
+        unsigned int u = candidates[s];
+        vector<Fold_in_rating>& r = train[u];
+        shuffle(r.begin(), r.end(), gen);
+        handful.insert(handful.end(), r.begin(), r.begin() + min((size_t)ratings_per_user, r.size()));
+        all.insert(all.end(), r.begin(), r.end());
+        handful_begin.push_back(handful.size());
+        all_begin.push_back(all.size());
+        for (map<unsigned int, float>::iterator it = info.test_R[u].begin(); it != info.test_R[u].end(); it++){
+            Fold_in_rating x = {item2serving[it->first], it->second};
+            tests[s].push_back(x);
+        }
+        memcpy(trained_p + (size_t)s * model.k, model.p + (size_t)user2serving[u] * model.k, sizeof(float) * model.k);
+    }
+
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, 0);
+
+    cout << endl;
+    cout << "Model file                       : " << model_file << endl;
+    cout << "Users / items / k                : " << model.user_num << " / " << model.item_num << " / " << model.k << endl;
+    cout << "New users / ratings each         : " << user_num << " / " << (double)handful.size() / max(user_num, 1u) << " (at most " << ratings_per_user << ")" << endl;
+    cout << "Lambda                           : " << lambda << endl;
+
+    // One user at a time, as a request would: Gram accumulation and Cholesky solve timed separately.
+    float* p = alloc_serving_rows(user_num, model.k);
+    Fold_in_workspace ws;
+    init_fold_in_workspace(&ws, model.k);
+    vector<double> latency(user_num);
+    double gram_time = 0, solve_time = 0;
+    unsigned int failed = 0;
+    for (unsigned int s = 0; s < user_num; s++){
+        std::chrono::time_point<std::chrono::steady_clock> start_point = std::chrono::steady_clock::now();
+        unsigned int n = handful_begin[s + 1] - handful_begin[s];
+        fold_in_gram(&model, handful.data() + handful_begin[s], n, &ws);
+        std::chrono::time_point<std::chrono::steady_clock> gram_point = std::chrono::steady_clock::now();
+        if (!fold_in_cholesky_solve(&ws, lambda * n, p + (size_t)s * model.k)) failed++;
+        std::chrono::time_point<std::chrono::steady_clock> end_point = std::chrono::steady_clock::now();
+        gram_time += std::chrono::duration_cast<std::chrono::nanoseconds>(gram_point - start_point).count() / 1000.0;
+        solve_time += std::chrono::duration_cast<std::chrono::nanoseconds>(end_point - gram_point).count() / 1000.0;
+        latency[s] = std::chrono::duration_cast<std::chrono::nanoseconds>(end_point - start_point).count() / 1000.0;
+    }
+    free_fold_in_workspace(&ws);
+    double single_rmse = test_rmse(&model, tests, p);
+    sort(latency.begin(), latency.end());
+
+    std::chrono::time_point<std::chrono::steady_clock> batch_start_point = std::chrono::steady_clock::now();
+    failed += fold_in_users(&pool, &model, handful.data(), handful_begin.data(), user_num, lambda, p);
+    double batch_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - batch_start_point).count();
+    double handful_rmse = test_rmse(&model, tests, p);
+
+    std::chrono::time_point<std::chrono::steady_clock> all_start_point = std::chrono::steady_clock::now();
+    failed += fold_in_users(&pool, &model, all.data(), all_begin.data(), user_num, lambda, p);
+    double all_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - all_start_point).count();
+    double all_rmse = test_rmse(&model, tests, p);
+
+    cout << "\n<Fold-in latency (micro sec)>" << endl;
+    cout << "Single user mean / p50 / p99     : " << (gram_time + solve_time) / user_num << " / " << latency[user_num / 2] << " / "
+         << latency[min(user_num - 1, (unsigned int)(user_num * 0.99))] << endl;
+    cout << "Gram accumulation / Cholesky     : " << gram_time / user_num << " / " << solve_time / user_num << endl;
+    print_label("Batched, " + to_string(num_threads) + " threads");
+    cout << batch_exec_time / user_num << " per user (" << user_num / (batch_exec_time / 1000000) << " users/s)" << endl;
+    cout << "Batched, all training ratings    : " << all_exec_time / user_num << " per user (" << (double)all.size() / max(user_num, 1u) << " ratings each)" << endl;
+    cout << "Failed solves                    : " << failed << endl;
+
+    cout << "\n<Test RMSE of the new users>" << endl;
+    cout << "Trained vectors                  : " << test_rmse(&model, tests, trained_p) << endl;
+    print_label("Fold-in, " + to_string(ratings_per_user) + " ratings");
+    cout << handful_rmse
+         << (handful_rmse == single_rmse ? "" : " (single-user path differs)") << endl;
+    cout << "Fold-in, all training ratings    : " << all_rmse << endl;
+
+    free(p);
+    free(trained_p);
+    delete [] info.R;
+    free_serving_model(&model);
+    destroy_cpu_thread_pool(&pool);
+    return 0;
+}
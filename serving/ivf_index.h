@@ -0,0 +1,267 @@
+#ifndef IVF_INDEX_H
+#define IVF_INDEX_H
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include "cpu_thread_pool.h"
+#include "cpu_rmse.h"
+#include "serving_model.h"
+#include "topk.h"
+using namespace std;
+
+// IVF index for maximum inner product search over the item rows. Inner products are turned into L2
+// distances by appending sqrt(M^2 - |x|^2) to every item x (M = the largest item norm) and 0 to the query:
+// |q' - x'|^2 = |q|^2 + M^2 - 2 q.x, so the nearest augmented item is the one with the largest inner product.
+// A k-means coarse quantizer over the augmented items assigns every item to one of nlist inverted lists; a
+// query scans the nprobe lists whose centroids are nearest and scores their items exactly.
+#define IVF_MAGIC 0x32465649   // "IVF2"
+
+struct Ivf_index{
+    unsigned int k;
+    unsigned int item_num;
+    unsigned int nlist;
+    float max_norm;
+    vector<float> centroids;            // nlist x (k + 1), augmented space
+    vector<float> centroid_norm;        // |c|^2 of each augmented centroid
+    vector<unsigned int> list_begin;    // list c holds positions [list_begin[c], list_begin[c+1])
+    vector<unsigned int> items;         // serving item index at each position
+    vector<float> vectors;              // item rows in list order, item_num x k
+};
+
+inline float augmented_coord(const float* x, unsigned int k, float max_norm){
+    float norm2 = 0;
+    for (unsigned int d = 0; d < k; d++) norm2 += x[d] * x[d];
+    return sqrt(max(0.0f, max_norm * max_norm - norm2));
+}
+
+// Squared L2 distance from augmented item (x, x_aug) to augmented centroid c, up to the constant |x'|^2.
+inline float centroid_distance(const Ivf_index* index, unsigned int c, const float* x, float x_aug){
+    const float* centroid = index->centroids.data() + (size_t)c * (index->k + 1);
+    return index->centroid_norm[c] - 2 * (cpu_dot(x, centroid, index->k) + x_aug * centroid[index->k]);
+}
+
+unsigned int nearest_centroid(const Ivf_index* index, const float* x, float x_aug){
+    unsigned int best = 0;
+    float best_dist = INFINITY;
+    for (unsigned int c = 0; c < index->nlist; c++){
+        float dist = centroid_distance(index, c, x, x_aug);
+        if (dist < best_dist){
+            best_dist = dist;
+            best = c;
+        }
+    }
+    return best;
+}
+
+void update_centroid_norms(Ivf_index* index){
+    index->centroid_norm.resize(index->nlist);
+    for (unsigned int c = 0; c < index->nlist; c++){
+        const float* centroid = index->centroids.data() + (size_t)c * (index->k + 1);
+        index->centroid_norm[c] = cpu_dot(centroid, centroid, index->k + 1);
+    }
+}
+
+// Lloyd's k-means on the augmented items, seeded with nlist distinct random items. The assignment step is
+// split over the pool; each thread sums its items into its own buffer, and empty lists are re-seeded.
+void build_ivf_index(Cpu_thread_pool* pool, const Serving_model* model, unsigned int nlist, unsigned int iterations, Ivf_index* index){
+    unsigned int k = model->k;
+    unsigned int item_num = model->item_num;
+    index->k = k;
+    index->item_num = item_num;
+    index->nlist = max(1u, min(nlist, item_num));
+    index->max_norm = 0;
+    for (unsigned int i = 0; i < item_num; i++) index->max_norm = max(index->max_norm, cpu_row_norm(model->q + (size_t)i * k, k));
+
+    vector<float> aug(item_num);
+    for (unsigned int i = 0; i < item_num; i++) aug[i] = augmented_coord(model->q + (size_t)i * k, k, index->max_norm);
+
+    mt19937 gen(1234);
+    vector<unsigned int> seeds(item_num);
+    for (unsigned int i = 0; i < item_num; i++) seeds[i] = i;
+    shuffle(seeds.begin(), seeds.end(), gen);
+    index->centroids.assign((size_t)index->nlist * (k + 1), 0);
+    for (unsigned int c = 0; c < index->nlist; c++){
+        memcpy(index->centroids.data() + (size_t)c * (k + 1), model->q + (size_t)seeds[c] * k, sizeof(float) * k);
+        index->centroids[(size_t)c * (k + 1) + k] = aug[seeds[c]];
+    }
+
+    vector<unsigned int> assign(item_num, 0);
+    vector<vector<double>> sums(pool->num_threads);
+    vector<vector<unsigned int>> counts(pool->num_threads);
+    for (unsigned int it = 0; it < iterations; it++){
+        update_centroid_norms(index);
+        run_cpu_thread_pool(pool, [&](unsigned int t){
+            sums[t].assign((size_t)index->nlist * (k + 1), 0);
+            counts[t].assign(index->nlist, 0);
+            unsigned int begin = (unsigned long long)item_num * t / pool->num_threads;
+            unsigned int end = (unsigned long long)item_num * (t + 1) / pool->num_threads;
+            for (unsigned int i = begin; i < end; i++){
+                const float* x = model->q + (size_t)i * k;
+                unsigned int c = nearest_centroid(index, x, aug[i]);
+                assign[i] = c;
+                double* sum = sums[t].data() + (size_t)c * (k + 1);
+                for (unsigned int d = 0; d < k; d++) sum[d] += x[d];
+                sum[k] += aug[i];
+                counts[t][c]++;
+            }
+        });
+
+        for (unsigned int c = 0; c < index->nlist; c++){
+            unsigned long long cnt = 0;
+            for (unsigned int t = 0; t < pool->num_threads; t++) cnt += counts[t][c];
+            float* centroid = index->centroids.data() + (size_t)c * (k + 1);
+            if (cnt == 0){
+                unsigned int i = seeds[gen() % item_num];
+                memcpy(centroid, model->q + (size_t)i * k, sizeof(float) * k);
+                centroid[k] = aug[i];
+                continue;
+            }
+            for (unsigned int d = 0; d <= k; d++){
+                double sum = 0;
+                for (unsigned int t = 0; t < pool->num_threads; t++) sum += sums[t][(size_t)c * (k + 1) + d];
+                centroid[d] = sum / cnt;
+            }
+        }
+    }
+
+    // Final assignment against the last centroids; the lists are filled in item order.
+    update_centroid_norms(index);
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        unsigned int begin = (unsigned long long)item_num * t / pool->num_threads;
+        unsigned int end = (unsigned long long)item_num * (t + 1) / pool->num_threads;
+        for (unsigned int i = begin; i < end; i++) assign[i] = nearest_centroid(index, model->q + (size_t)i * k, aug[i]);
+    });
+    index->list_begin.assign(index->nlist + 1, 0);
+    for (unsigned int i = 0; i < item_num; i++) index->list_begin[assign[i] + 1]++;
+    for (unsigned int c = 0; c < index->nlist; c++) index->list_begin[c + 1] += index->list_begin[c];
+    index->items.resize(item_num);
+    index->vectors.resize((size_t)item_num * k);
+    vector<unsigned int> fill(index->list_begin.begin(), index->list_begin.end() - 1);
+    for (unsigned int i = 0; i < item_num; i++){
+        unsigned int pos = fill[assign[i]]++;
+        index->items[pos] = i;
+        memcpy(index->vectors.data() + (size_t)pos * k, model->q + (size_t)i * k, sizeof(float) * k);
+    }
+}
+
+// FNV-1a over the item ids and rows of the model. The index file records it, so that an index built before the
+// model was retrained is rebuilt rather than scored with its stale copy of the rows.
+unsigned long long item_rows_checksum(const Serving_model* model){
+    unsigned long long h = 14695981039346656037ULL;
+    const unsigned int* words = (const unsigned int*)model->q;
+    for (size_t x = 0; x < (size_t)model->item_num * model->k; x++) h = (h ^ words[x]) * 1099511628211ULL;
+    for (unsigned int i = 0; i < model->item_num; i++) h = (h ^ model->item2orig[i]) * 1099511628211ULL;
+    return h;
+}
+
+// Binary layout: magic, k, item count, nlist, item rows checksum, max norm, centroids, list_begin, item ids
+// (original ids), item rows in list order.
+bool save_ivf_index(const Ivf_index* index, const Serving_model* model, string outfile){
+    ofstream out(outfile.c_str(), ios::binary);
+    if (out.fail()){
+        cout << "fail to write file named " << outfile << endl;
+        return false;
+    }
+    unsigned int header[4] = {IVF_MAGIC, index->k, index->item_num, index->nlist};
+    unsigned long long checksum = item_rows_checksum(model);
+    out.write((const char*)header, sizeof(header));
+    out.write((const char*)&checksum, sizeof(checksum));
+    out.write((const char*)&index->max_norm, sizeof(float));
+    out.write((const char*)index->centroids.data(), sizeof(float) * index->centroids.size());
+    out.write((const char*)index->list_begin.data(), sizeof(unsigned int) * index->list_begin.size());
+    for (unsigned int j = 0; j < index->item_num; j++)
+        out.write((const char*)&model->item2orig[index->items[j]], sizeof(unsigned int));
+    out.write((const char*)index->vectors.data(), sizeof(float) * index->vectors.size());
+    out.close();
+    return true;
+}
+
+// Loads an index saved for the same item rows; returns false when the file is missing, was built for other
+// rows or is inconsistent.
+bool load_ivf_index(Ivf_index* index, const Serving_model* model, string infile){
+    ifstream in(infile.c_str(), ios::binary);
+    if (in.fail()) return false;
+    unsigned int header[4];
+    unsigned long long checksum;
+    in.read((char*)header, sizeof(header));
+    in.read((char*)&checksum, sizeof(checksum));
+    if (!in || header[0] != IVF_MAGIC || header[1] != model->k || header[2] != model->item_num) return false;
+    if (header[3] == 0 || header[3] > header[2] || checksum != item_rows_checksum(model)) return false;
+    index->k = header[1];
+    index->item_num = header[2];
+    index->nlist = header[3];
+    in.read((char*)&index->max_norm, sizeof(float));
+    index->centroids.resize((size_t)index->nlist * (index->k + 1));
+    in.read((char*)index->centroids.data(), sizeof(float) * index->centroids.size());
+    index->list_begin.resize(index->nlist + 1);
+    in.read((char*)index->list_begin.data(), sizeof(unsigned int) * index->list_begin.size());
+    index->items.resize(index->item_num);
+    in.read((char*)index->items.data(), sizeof(unsigned int) * index->item_num);
+    index->vectors.resize((size_t)index->item_num * index->k);
+    in.read((char*)index->vectors.data(), sizeof(float) * index->vectors.size());
+    if (!in) return false;
+
+    if (index->list_begin[0] != 0 || index->list_begin[index->nlist] != index->item_num) return false;
+    for (unsigned int c = 0; c < index->nlist; c++)
+        if (index->list_begin[c] > index->list_begin[c + 1]) return false;
+    for (unsigned int j = 0; j < index->item_num; j++){
+        index->items[j] = find_serving_id(model->item2orig, model->item_num, index->items[j]);
+        if (index->items[j] == NO_SERVING_ID) return false;
+    }
+    update_centroid_norms(index);
+    return true;
+}
+
+// Top-K of user u over the nprobe lists nearest to the augmented query (p_u, 0). Returns the number of
+// items scored. probe is scratch space of nlist entries.
+size_t ivf_search(const Ivf_index* index, const Serving_model* model, unsigned int u, unsigned int nprobe, Topk_heap* h,
+                  vector<pair<float, unsigned int>>* probe){
+    unsigned int k = index->k;
+    const float* p_row = model->p + (size_t)u * k;
+    nprobe = min(nprobe, index->nlist);
+    probe->resize(index->nlist);
+    for (unsigned int c = 0; c < index->nlist; c++) (*probe)[c] = make_pair(centroid_distance(index, c, p_row, 0), c);
+    partial_sort(probe->begin(), probe->begin() + nprobe, probe->end());
+
+    size_t scored = 0;
+    for (unsigned int j = 0; j < nprobe; j++){
+        unsigned int c = (*probe)[j].second;
+        for (unsigned int pos = index->list_begin[c]; pos < index->list_begin[c + 1]; pos++){
+            float score = cpu_dot(p_row, index->vectors.data() + (size_t)pos * k, k);
+            unsigned int i = index->items[pos];
+            if (score >= h->threshold && !is_seen(model, u, i)) topk_push(h, score, i);
+        }
+        scored += index->list_begin[c + 1] - index->list_begin[c];
+    }
+    sort_heap(h->e, h->e + h->size, topk_better);
+    return scored;
+}
+
+// One query per user, spread over the pool. Same output as topk_recommend; returns the items scored.
+size_t ivf_recommend(Cpu_thread_pool* pool, const Ivf_index* index, const Serving_model* model, unsigned int nprobe, unsigned int K,
+                     unsigned int user_num, vector<Topk_entry>* results, vector<unsigned int>* counts){
+    results->resize((size_t)user_num * K);
+    counts->resize(user_num);
+    atomic<unsigned int> next_user(0);
+    atomic<size_t> scored(0);
+
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        vector<pair<float, unsigned int>> probe;
+        size_t local_scored = 0;
+        for (unsigned int u = next_user.fetch_add(1); u < user_num; u = next_user.fetch_add(1)){
+            Topk_heap h;
+            topk_reset(&h, K, results->data() + (size_t)u * K);
+            local_scored += ivf_search(index, model, u, nprobe, &h, &probe);
+            (*counts)[u] = h.size;
+        }
+        scored += local_scored;
+    });
+    return scored;
+}
+
+#endif
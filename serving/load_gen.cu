@@ -0,0 +1,241 @@
+#include <iostream>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <vector>
+#include "serving_model.h"
+#include "shm_snapshot_reader.h"
+#include "predict_protocol.h"
+using namespace std;
+
+// Load generator for predict_server. Every connection keeps up to depth requests in flight with random ids
+// drawn from the serving file or the current shared memory snapshot (mapped read-only), measures the latency
+// of each reply and finally asks the server for its own latency counters. With -ud 1 users are drawn in
+// proportion to their number of training ratings, so heavy users repeat as they do in production traffic.
+
+bool exists (const std::string& name) {
+    struct stat buffer;
+    return (stat(name.c_str(), &buffer) == 0);
+}
+
+void usage(const char* name){
+    cout << name << " -m <serving file> | -sn <snapshot name> [-s <socket> -p <tcp port> -r score|batch|topk|foldin -b <pairs, users or ratings/request> -K <items/user> -f seen|none -ud 0|1"
+         << " -c <connections> -q <requests in flight/connection> -n <requests/connection> -d <seconds>]" << endl;
+}
+
+struct Load_config{
+    unsigned int type;
+    unsigned int batch;
+    unsigned int K;
+    unsigned int filter;
+    bool degree_users;
+    unsigned int depth;
+    unsigned int requests;
+    unsigned int duration;
+    string socket_path;
+    unsigned int port;
+};
+
+struct Load_result{
+    unsigned long long requests;
+    unsigned long long errors;
+};
+
+// A random serving user; with degree_users the user of a random training rating.
+unsigned int draw_user(const Load_config& cfg, const Serving_model* model, mt19937& gen){
+    if (!cfg.degree_users || model->seen_n == 0) return gen() % model->user_num;
+    size_t r = ((unsigned long long)gen() << 32 | gen()) % model->seen_n;
+    return upper_bound(model->seen_begin, model->seen_begin + model->user_num + 1, r) - model->seen_begin - 1;
+}
+
+Predict_request make_probe(const Load_config& cfg, unsigned int tag){
+    bool topk = cfg.type == PREDICT_TOPK || cfg.type == PREDICT_FOLD_IN;
+    Predict_request h = {cfg.type, tag, cfg.type == PREDICT_SCORE ? 1 : cfg.batch, topk ? predict_topk_arg(cfg.K, cfg.filter) : 0};
+    return h;
+}
+
+// A fold-in request rates cfg.batch random items 1 to 5.
+Predict_request make_request(const Load_config& cfg, const Serving_model* model, mt19937& gen, unsigned int tag, vector<unsigned int>* payload){
+    Predict_request h = make_probe(cfg, tag);
+    payload->clear();
+    if (cfg.type == PREDICT_FOLD_IN){
+        for (unsigned int j = 0; j < h.count; j++){
+            float r = 1 + gen() % 5;
+            unsigned int r_bits;
+            memcpy(&r_bits, &r, sizeof(float));
+            payload->push_back(model->item2orig[gen() % model->item_num]);
+            payload->push_back(r_bits);
+        }
+        return h;
+    }
+    for (unsigned int j = 0; j < h.count; j++){
+        payload->push_back(model->user2orig[draw_user(cfg, model, gen)]);
+        if (cfg.type != PREDICT_TOPK) payload->push_back(model->item2orig[gen() % model->item_num]);
+    }
+    return h;
+}
+
+void run_connection(const Load_config& cfg, const Serving_model* model, unsigned int c, Latency_histogram* latency, Load_result* result){
+    result->requests = 0;
+    result->errors = 0;
+    int fd = connect_predict_server(cfg.socket_path, cfg.port);
+    if (fd < 0){
+        result->errors++;
+        return;
+    }
+    mt19937 gen(1234 + c);
+    vector<std::chrono::time_point<std::chrono::steady_clock>> sent(cfg.depth);
+    vector<unsigned int> payload;
+    vector<char> reply;
+    std::chrono::time_point<std::chrono::steady_clock> end_point = std::chrono::steady_clock::now() + std::chrono::seconds(cfg.duration);
+    unsigned int issued = 0, in_flight = 0;
+
+    // The tag of a request is its slot in sent.
+    auto issue = [&](unsigned int slot){
+        Predict_request h = make_request(cfg, model, gen, slot, &payload);
+        sent[slot] = std::chrono::steady_clock::now();
+        if (!write_full(fd, &h, sizeof(h)) || !write_full(fd, payload.data(), payload.size() * sizeof(unsigned int))) return false;
+        issued++;
+        in_flight++;
+        return true;
+    };
+    auto more = [&](){
+        return cfg.duration ? std::chrono::steady_clock::now() < end_point : issued < cfg.requests;
+    };
+
+    bool ok = true;
+    for (unsigned int slot = 0; slot < cfg.depth && more() && ok; slot++) ok = issue(slot);
+    while (ok && in_flight > 0){
+        Predict_reply r;
+        if (!read_full(fd, &r, sizeof(r))) break;
+        reply.resize(r.bytes);
+        if (r.bytes && !read_full(fd, reply.data(), r.bytes)) break;
+        in_flight--;
+        if (r.status != PREDICT_OK || r.tag >= cfg.depth){
+            result->errors++;
+            break;
+        }
+        record_latency(latency, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent[r.tag]).count());
+        result->requests++;
+        if (more()) ok = issue(r.tag);
+    }
+    close(fd);
+}
+
+bool query_server_stats(const Load_config& cfg, Predict_stats_entry* stats){
+    int fd = connect_predict_server(cfg.socket_path, cfg.port);
+    if (fd < 0) return false;
+    Predict_request h = {PREDICT_STATS, 0, 0, 0};
+    Predict_reply r;
+    bool ok = write_full(fd, &h, sizeof(h)) && read_full(fd, &r, sizeof(r)) && r.status == PREDICT_OK
+              && r.bytes == sizeof(Predict_stats_entry) * PREDICT_TYPES && read_full(fd, stats, r.bytes);
+    close(fd);
+    return ok;
+}
+
+int main (int argc, const char* argv[]){
+    string model_file = "";
+    string snapshot_name = "";
+    string request_type = "score";
+    string filter = "seen";
+    unsigned int connections = 4;
+    Load_config cfg;
+    cfg.batch = 64;
+    cfg.K = 10;
+    cfg.degree_users = false;
+    cfg.depth = 1;
+    cfg.requests = 10000;
+    cfg.duration = 0;
+    cfg.socket_path = "/tmp/mascot_predict.sock";
+    cfg.port = 0;
+
+    for(int i = 0; i < argc; i++){
+        if(string(argv[i]) == "-m" && i < argc-1) model_file = string(argv[i+1]);
+        if(string(argv[i]) == "-sn" && i < argc-1) snapshot_name = string(argv[i+1]);
+        if(string(argv[i]) == "-s" && i < argc-1) cfg.socket_path = string(argv[i+1]);
+        if(string(argv[i]) == "-p" && i < argc-1) cfg.port = stoi(argv[i+1]);
+        if(string(argv[i]) == "-r" && i < argc-1) request_type = string(argv[i+1]);
+        if(string(argv[i]) == "-b" && i < argc-1) cfg.batch = stoi(argv[i+1]);
+        if(string(argv[i]) == "-K" && i < argc-1) cfg.K = stoi(argv[i+1]);
+        if(string(argv[i]) == "-f" && i < argc-1) filter = string(argv[i+1]);
+        if(string(argv[i]) == "-ud" && i < argc-1) cfg.degree_users = stoi(argv[i+1]);
+        if(string(argv[i]) == "-c" && i < argc-1) connections = stoi(argv[i+1]);
+        if(string(argv[i]) == "-q" && i < argc-1) cfg.depth = stoi(argv[i+1]);
+        if(string(argv[i]) == "-n" && i < argc-1) cfg.requests = stoi(argv[i+1]);
+        if(string(argv[i]) == "-d" && i < argc-1) cfg.duration = stoi(argv[i+1]);
+        if(string(argv[i]) == "-h"){
+            usage(argv[0]);
+            return(0);
+        }
+    }
+    if (request_type == "score") cfg.type = PREDICT_SCORE;
+    else if (request_type == "batch") cfg.type = PREDICT_SCORE_BATCH;
+    else if (request_type == "topk") cfg.type = PREDICT_TOPK;
+    else if (request_type == "foldin") cfg.type = PREDICT_FOLD_IN;
+    else cfg.type = PREDICT_TYPES;
+    cfg.filter = filter == "seen" ? PREDICT_FILTER_SEEN : filter == "none" ? PREDICT_FILTER_NONE : PREDICT_FILTERS;
+
+    if((!exists(model_file) && snapshot_name == "") || cfg.type == PREDICT_TYPES || cfg.filter == PREDICT_FILTERS || connections == 0 || cfg.depth == 0 || cfg.batch == 0){
+        usage(argv[0]);
+        return(0);
+    }
+    shared_ptr<Model_snapshot> snapshot;
+    Shm_snapshot_reader reader;
+    if (snapshot_name != ""){
+        if (open_shm_snapshot_reader(&reader, snapshot_name)) snapshot = acquire_shm_snapshot(&reader);
+        close_shm_snapshot_reader(&reader);
+    }
+    else snapshot = map_serving_snapshot(model_file);
+    if (!snapshot){
+        cout << (snapshot_name != "" ? "no snapshot named /dev/shm/" + snapshot_name : model_file + " is not a serving file") << endl;
+        return 1;
+    }
+    const Serving_model& model = snapshot->model;
+    if (!valid_request(make_probe(cfg, 0))){
+        cout << "Request exceeds the protocol limits (" << PREDICT_MAX_COUNT << " ids, " << PREDICT_MAX_FOLD_IN << " fold-in ratings, K <= " << PREDICT_MAX_K << ")" << endl;
+        return 1;
+    }
+
+    cout << endl;
+    cout << "Server                           : " << (cfg.port ? "127.0.0.1:" + to_string(cfg.port) : cfg.socket_path) << endl;
+    cout << "Request type                     : " << predict_type_name(cfg.type);
+    if (cfg.type == PREDICT_TOPK || cfg.type == PREDICT_FOLD_IN)
+        cout << ", " << cfg.batch << (cfg.type == PREDICT_TOPK ? " users" : " ratings") << ", K=" << cfg.K << ", filter " << filter;
+    else if (cfg.type == PREDICT_SCORE_BATCH) cout << ", " << cfg.batch << " pairs";
+    cout << endl;
+    cout << "User distribution                : " << (cfg.degree_users ? "by training degree" : "uniform") << endl;
+    cout << "Connections / in flight          : " << connections << " / " << cfg.depth << endl;
+
+    Latency_histogram* latency = new Latency_histogram;
+    reset_latency_histogram(latency);
+    vector<Load_result> results(connections);
+    vector<thread> clients;
+    std::chrono::time_point<std::chrono::steady_clock> start_point = std::chrono::steady_clock::now();
+    for (unsigned int c = 0; c < connections; c++) clients.push_back(thread(run_connection, cref(cfg), &model, c, latency, &results[c]));
+    for (unsigned int c = 0; c < connections; c++) clients[c].join();
+    double exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_point).count();
+
+    unsigned long long requests = 0, errors = 0;
+    for (unsigned int c = 0; c < connections; c++){
+        requests += results[c].requests;
+        errors += results[c].errors;
+    }
+    unsigned int per_request = cfg.type == PREDICT_SCORE || cfg.type == PREDICT_FOLD_IN ? 1 : cfg.batch;
+    cout << "\n<Client>" << endl;
+    cout << "Requests / errors                : " << requests << " / " << errors << endl;
+    cout << "Requests/s                       : " << requests / (exec_time / 1000000) << endl;
+    cout << (cfg.type == PREDICT_TOPK || cfg.type == PREDICT_FOLD_IN ? "Users/s                          : " : "Scores/s                         : ")
+         << requests * per_request / (exec_time / 1000000) << endl;
+    print_latency_stats("Round trip", latency_stats(latency));
+
+    Predict_stats_entry stats[PREDICT_TYPES];
+    if (query_server_stats(cfg, stats)){
+        cout << "\n<Server, since start>" << endl;
+        for (unsigned int t = 0; t < PREDICT_TYPES; t++)
+            if (stats[t].requests) print_latency_stats(string("Latency ") + predict_type_name(t), stats[t]);
+    }
+
+    delete latency;
+    return errors ? 1 : 0;
+}
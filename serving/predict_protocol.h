@@ -0,0 +1,223 @@
+#ifndef PREDICT_PROTOCOL_H
+#define PREDICT_PROTOCOL_H
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+using namespace std;
+
+// Binary protocol of predict_server, little endian. Every request is a Predict_request header followed by
+// its payload, every reply a Predict_reply header followed by bytes of payload. Replies carry the tag of their
+// request and may come back out of order when a client pipelines requests. Ids are original ids.
+//   PREDICT_SCORE, PREDICT_SCORE_BATCH  payload: count x (uint32 user, uint32 item)
+//                                       reply:   count x float32 score (NaN for unknown ids)
+//   PREDICT_TOPK                        payload: count x uint32 user, arg = K | filter << 16
+//                                       reply:   per user uint32 n, then n x (uint32 item, float32 score)
+//   PREDICT_FOLD_IN                     payload: count x (uint32 item, float32 rating) of a new user,
+//                                       arg = K | filter << 16 (K may be 0)
+//                                       reply:   k x float32 p_u, then uint32 n, n x (uint32 item, float32 score)
+//   PREDICT_STATS                       reply:   PREDICT_TYPES x Predict_stats_entry (latency in us)
+#define PREDICT_SCORE 0
+#define PREDICT_SCORE_BATCH 1
+#define PREDICT_TOPK 2
+#define PREDICT_FOLD_IN 3
+#define PREDICT_STATS 4
+#define PREDICT_TYPES 4
+
+#define PREDICT_OK 0
+#define PREDICT_BAD_REQUEST 1
+
+// Filters of a top-K request.
+#define PREDICT_FILTER_SEEN 0       // leave out the items the user rated in training
+#define PREDICT_FILTER_NONE 1
+#define PREDICT_FILTERS 2
+
+#define PREDICT_MAX_COUNT 65536
+#define PREDICT_MAX_K 1024
+#define PREDICT_MAX_FOLD_IN 1024     // ratings of one fold-in request
+
+struct Predict_request{
+    unsigned int type;
+    unsigned int tag;
+    unsigned int count;
+    unsigned int arg;
+};
+
+struct Predict_reply{
+    unsigned int status;
+    unsigned int tag;
+    unsigned int type;
+    unsigned int bytes;
+};
+
+struct Predict_stats_entry{
+    unsigned long long requests;
+    float p50;
+    float p99;
+    float p999;
+    float max;
+};
+
+const char* predict_type_name(unsigned int type){
+    static const char* names[PREDICT_TYPES] = {"score", "score-batch", "top-K", "fold-in"};
+    return type < PREDICT_TYPES ? names[type] : "unknown";
+}
+
+inline size_t predict_payload_bytes(const Predict_request& r){
+    if (r.type == PREDICT_SCORE || r.type == PREDICT_SCORE_BATCH || r.type == PREDICT_FOLD_IN) return (size_t)r.count * 2 * sizeof(unsigned int);
+    if (r.type == PREDICT_TOPK) return (size_t)r.count * sizeof(unsigned int);
+    return 0;
+}
+
+inline unsigned int predict_topk_arg(unsigned int K, unsigned int filter){
+    return K | filter << 16;
+}
+
+inline unsigned int predict_topk_K(const Predict_request& r){
+    return r.arg & 0xffff;
+}
+
+inline unsigned int predict_topk_filter(const Predict_request& r){
+    return r.arg >> 16;
+}
+
+inline bool valid_request(const Predict_request& r){
+    if (r.type == PREDICT_STATS) return true;
+    if (r.type > PREDICT_FOLD_IN || r.count == 0 || r.count > PREDICT_MAX_COUNT) return false;
+    if (r.type == PREDICT_SCORE && r.count != 1) return false;
+    if (r.type == PREDICT_FOLD_IN)
+        return r.count <= PREDICT_MAX_FOLD_IN && predict_topk_K(r) <= PREDICT_MAX_K && predict_topk_filter(r) < PREDICT_FILTERS;
+    return r.type != PREDICT_TOPK || (predict_topk_K(r) > 0 && predict_topk_K(r) <= PREDICT_MAX_K && predict_topk_filter(r) < PREDICT_FILTERS);
+}
+
+// Full-length read/write on a blocking socket; false on EOF or error.
+bool read_full(int fd, void* buf, size_t bytes){
+    char* p = (char*)buf;
+    while (bytes > 0){
+        ssize_t r = read(fd, p, bytes);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        bytes -= r;
+    }
+    return true;
+}
+
+bool write_full(int fd, const void* buf, size_t bytes){
+    const char* p = (const char*)buf;
+    while (bytes > 0){
+        ssize_t r = send(fd, p, bytes, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        bytes -= r;
+    }
+    return true;
+}
+
+// Connects to a Unix domain socket, or to 127.0.0.1:port when port > 0. Returns -1 on failure.
+int connect_predict_server(string socket_path, unsigned int port){
+    int fd;
+    if (port > 0){
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return fd;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0){
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Log-linear latency histogram in microseconds: exact below 64 us, then 16 buckets per power of two
+// (about 6% resolution). Buckets are atomic so that any thread may record.
+#define LATENCY_LINEAR 64
+#define LATENCY_SUB_BUCKETS 16
+#define LATENCY_BUCKETS (LATENCY_LINEAR + 40 * LATENCY_SUB_BUCKETS)
+
+struct Latency_histogram{
+    atomic<unsigned long long> buckets[LATENCY_BUCKETS];
+    atomic<unsigned long long> count;
+    atomic<unsigned long long> max_us;
+};
+
+void reset_latency_histogram(Latency_histogram* h){
+    for (unsigned int b = 0; b < LATENCY_BUCKETS; b++) h->buckets[b] = 0;
+    h->count = 0;
+    h->max_us = 0;
+}
+
+inline unsigned int latency_bucket(unsigned long long us){
+    if (us < LATENCY_LINEAR) return us;
+    unsigned int e = 63 - __builtin_clzll(us);
+    unsigned int b = LATENCY_LINEAR + (e - 6) * LATENCY_SUB_BUCKETS + ((us >> (e - 4)) & (LATENCY_SUB_BUCKETS - 1));
+    return min(b, (unsigned int)LATENCY_BUCKETS - 1);
+}
+
+// Upper edge of bucket b.
+inline double latency_bucket_value(unsigned int b){
+    if (b < LATENCY_LINEAR) return b;
+    unsigned int e = (b - LATENCY_LINEAR) / LATENCY_SUB_BUCKETS + 6;
+    unsigned int sub = (b - LATENCY_LINEAR) % LATENCY_SUB_BUCKETS;
+    return ldexp(1.0 + (sub + 1) / (double)LATENCY_SUB_BUCKETS, e) - 1;
+}
+
+inline void record_latency(Latency_histogram* h, unsigned long long us){
+    h->buckets[latency_bucket(us)]++;
+    h->count++;
+    unsigned long long prev = h->max_us;
+    while (us > prev && !h->max_us.compare_exchange_weak(prev, us));
+}
+
+double latency_percentile(const Latency_histogram* h, double q){
+    unsigned long long total = h->count;
+    if (total == 0) return 0;
+    unsigned long long rank = (unsigned long long)ceil(q * total);
+    unsigned long long seen = 0;
+    for (unsigned int b = 0; b < LATENCY_BUCKETS; b++){
+        seen += h->buckets[b];
+        if (seen >= max(rank, 1ull)) return min(latency_bucket_value(b), (double)h->max_us);
+    }
+    return h->max_us;
+}
+
+Predict_stats_entry latency_stats(const Latency_histogram* h){
+    Predict_stats_entry s;
+    s.requests = h->count;
+    s.p50 = latency_percentile(h, 0.5);
+    s.p99 = latency_percentile(h, 0.99);
+    s.p999 = latency_percentile(h, 0.999);
+    s.max = h->max_us;
+    return s;
+}
+
+void print_latency_stats(const string& name, const Predict_stats_entry& s){
+    cout << name << string(name.size() < 33 ? 33 - name.size() : 1, ' ') << ": " << s.requests << " requests, p50 " << s.p50
+         << " us, p99 " << s.p99 << " us, p99.9 " << s.p999 << " us, max " << s.max << " us" << endl;
+}
+
+#endif
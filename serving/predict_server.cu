@@ -0,0 +1,638 @@
+#include <iostream>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <sstream>
+#include <memory>
+#include <atomic>
+#include <csignal>
+#include <poll.h>
+#include "common_struct.h"
+#include "io_utils.h"
+#include "cpu_thread_pool.h"
+#include "cpu_rmse.h"
+#include "serving_model.h"
+#include "topk.h"
+#include "topk_cache.h"
+#include "fold_in.h"
+#include "shm_snapshot_reader.h"
+#include "predict_protocol.h"
+using namespace std;
+
+// Long-running prediction server over a memory-mapped serving file. One reader thread per connection parses
+// requests into a shared queue; the workers of the thread pool take the queue in micro-batches, score the
+// pairs of all score requests of a batch back to back and run the top-K requests of a batch together, up to
+// TOPK_USER_BLOCK users per pass over the item panels. Latency is measured from the end of a request's
+// payload to the end of its reply.
+// With -sn the model comes from a shared memory snapshot published by the trainer and is swapped while the
+// server runs: the new version is mapped and its item panels are packed off the request path, then one atomic
+// pointer store switches the workers over between two batches.
+// With -cb the top-K results go through a cache keyed by (user, K, filter) with one budget per user degree
+// group (topk_cache.h); a swap invalidates it in one step.
+// Fold-in requests carry the ratings of a user the model does not know: the fold-in requests of a batch are
+// solved together against the fixed Q (fold_in.h) and their top-K runs through the same item panels.
+
+bool exists (const std::string& name) {
+    struct stat buffer;
+    return (stat(name.c_str(), &buffer) == 0);
+}
+
+void usage(const char* name){
+    cout << name << " -m <serving file | model> | -sn <snapshot name> [-i <train-tsv> -s <socket> -p <tcp port> -t <workers> -mb <requests/batch> -bw <batch wait us>"
+         << " -cb <cache MB per degree group, heaviest first,...> -b <fold-in lambda> -si <stats interval s> -d <seconds>]" << endl;
+}
+
+// Closed by its last owner: the reader, or a request of it still queued or being scored.
+struct Connection{
+    int fd;
+    mutex write_m;
+    ~Connection(){ close(fd); }
+};
+
+struct Pending_request{
+    shared_ptr<Connection> conn;
+    Predict_request h;
+    vector<unsigned int> payload;
+    std::chrono::time_point<std::chrono::steady_clock> received;
+};
+
+struct Request_queue{
+    mutex m;
+    condition_variable cv;
+    deque<Pending_request*> q;
+};
+
+vector<double> parse_list(const string& s){
+    vector<double> out;
+    stringstream ss(s);
+    string tok;
+    while (getline(ss, tok, ',')) if (tok != "") out.push_back(atof(tok.c_str()));
+    return out;
+}
+
+// A model version, its packed items and the cache degree group of its users; workers hold one for a whole batch.
+struct Served_model{
+    shared_ptr<Model_snapshot> snapshot;
+    Item_panels panels;
+    vector<unsigned char> degree_group;
+};
+
+void release_served_model(Served_model* served){
+    free_item_panels(&served->panels);
+    delete served;
+}
+
+shared_ptr<Served_model> make_served_model(shared_ptr<Model_snapshot> snapshot, Cpu_thread_pool* pool, unsigned int cache_groups){
+    Served_model* served = new Served_model;
+    served->snapshot = snapshot;
+    pack_item_panels(pool, snapshot->model.q, snapshot->model.item_num, snapshot->model.k, &served->panels);
+    topk_cache_degree_groups(&snapshot->model, cache_groups, &served->degree_group);
+    return shared_ptr<Served_model>(served, release_served_model);
+}
+
+struct Server_state{
+    shared_ptr<Served_model> current;   // only accessed through atomic_load/atomic_store
+    Request_queue queue;
+    Topk_cache cache;
+    Latency_histogram latency[PREDICT_TYPES];
+    atomic<unsigned long long> batches;
+    atomic<unsigned long long> batched_requests;
+    unsigned int max_batch;
+    unsigned int batch_wait;
+    float lambda;
+
+    mutex conn_m;
+    condition_variable conn_cv;
+    vector<shared_ptr<Connection>> connections;     // open connections, each read by a detached thread
+};
+
+volatile sig_atomic_t stop_requested = 0;
+
+void handle_stop(int){
+    stop_requested = 1;
+}
+
+bool send_reply(Connection* conn, const Predict_reply& r, const void* payload){
+    lock_guard<mutex> lk(conn->write_m);
+    return write_full(conn->fd, &r, sizeof(r)) && (r.bytes == 0 || write_full(conn->fd, payload, r.bytes));
+}
+
+void finish_request(Server_state* s, Pending_request* req, unsigned int status, const void* payload, unsigned int bytes){
+    Predict_reply r = {status, req->h.tag, req->h.type, bytes};
+    send_reply(req->conn.get(), r, payload);
+    if (req->h.type < PREDICT_TYPES)
+        record_latency(&s->latency[req->h.type],
+                       std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - req->received).count());
+}
+
+// Reads requests until the peer closes the connection or sends a malformed header. Stats requests are
+// answered right away, everything else goes to the workers. On exit the connection leaves s->connections.
+void read_connection(Server_state* s, shared_ptr<Connection> conn){
+    while (!stop_requested){
+        Predict_request h;
+        if (!read_full(conn->fd, &h, sizeof(h))) break;
+        if (!valid_request(h)){
+            Predict_reply r = {PREDICT_BAD_REQUEST, h.tag, h.type, 0};
+            send_reply(conn.get(), r, NULL);
+            break;
+        }
+        if (h.type == PREDICT_STATS){
+            Predict_stats_entry stats[PREDICT_TYPES];
+            for (unsigned int t = 0; t < PREDICT_TYPES; t++) stats[t] = latency_stats(&s->latency[t]);
+            Predict_reply r = {PREDICT_OK, h.tag, h.type, (unsigned int)sizeof(stats)};
+            send_reply(conn.get(), r, stats);
+            continue;
+        }
+        Pending_request* req = new Pending_request;
+        req->conn = conn;
+        req->h = h;
+        req->payload.resize(predict_payload_bytes(h) / sizeof(unsigned int));
+        if (!read_full(conn->fd, req->payload.data(), predict_payload_bytes(h))){
+            delete req;
+            break;
+        }
+        req->received = std::chrono::steady_clock::now();
+        {
+            lock_guard<mutex> lk(s->queue.m);
+            s->queue.q.push_back(req);
+        }
+        s->queue.cv.notify_one();
+    }
+    shutdown(conn->fd, SHUT_RDWR);
+    lock_guard<mutex> lk(s->conn_m);
+    s->connections.erase(find(s->connections.begin(), s->connections.end(), conn));
+    s->conn_cv.notify_all();
+}
+
+// Takes up to max_batch requests, waiting up to batch_wait us for the batch to fill once the first request is
+// in. Returns false when the server stops.
+bool take_batch(Server_state* s, vector<Pending_request*>* batch){
+    batch->clear();
+    unique_lock<mutex> lk(s->queue.m);
+    while (s->queue.q.empty()){
+        if (stop_requested) return false;
+        s->queue.cv.wait_for(lk, std::chrono::milliseconds(100));
+    }
+    if (s->queue.q.size() < s->max_batch && s->batch_wait > 0){
+        std::chrono::time_point<std::chrono::steady_clock> deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(s->batch_wait);
+        s->queue.cv.wait_until(lk, deadline, [&]{ return s->queue.q.size() >= s->max_batch || stop_requested; });
+    }
+    while (!s->queue.q.empty() && batch->size() < s->max_batch){
+        batch->push_back(s->queue.q.front());
+        s->queue.q.pop_front();
+    }
+    return true;
+}
+
+// Scores the (user, item) pairs of every score request of the batch, NaN for unknown ids. The rows of the
+// next pair are prefetched while the current one is scored.
+void serve_scores(Server_state* s, const Served_model* served, const vector<Pending_request*>& batch, vector<float>* scores){
+    const Serving_model* model = &served->snapshot->model;
+    unsigned int k = model->k;
+    for (unsigned int r = 0; r < batch.size(); r++){
+        Pending_request* req = batch[r];
+        if (req->h.type != PREDICT_SCORE && req->h.type != PREDICT_SCORE_BATCH) continue;
+        unsigned int n = req->h.count;
+        scores->resize(n);
+        vector<const float*> rows(2 * n + 2, NULL);
+        for (unsigned int j = 0; j < n; j++){
+            unsigned int u = find_serving_id(model->user2orig, model->user_num, req->payload[2 * j]);
+            unsigned int i = find_serving_id(model->item2orig, model->item_num, req->payload[2 * j + 1]);
+            if (u == NO_SERVING_ID || i == NO_SERVING_ID) continue;
+            rows[2 * j] = model->p + (size_t)u * k;
+            rows[2 * j + 1] = model->q + (size_t)i * k;
+        }
+        for (unsigned int j = 0; j < n; j++){
+            if (rows[2 * j + 2]){
+                __builtin_prefetch(rows[2 * j + 2]);
+                __builtin_prefetch(rows[2 * j + 3]);
+            }
+            (*scores)[j] = rows[2 * j] ? cpu_dot(rows[2 * j], rows[2 * j + 1], k) : NAN;
+        }
+        finish_request(s, req, PREDICT_OK, scores->data(), n * sizeof(float));
+    }
+}
+
+// TOPK_MICRO_USERS zero rows past a block, as topk_rows_block reads whole micro-kernel groups. A new version
+// may come with another k.
+void prepare_topk_rows(float** rows, unsigned int* rows_k, unsigned int k){
+    if (*rows_k == k) return;
+    free(*rows);
+    *rows = alloc_serving_rows(TOPK_USER_BLOCK + TOPK_MICRO_USERS, k);
+    *rows_k = k;
+}
+
+struct Topk_slot{
+    unsigned int user;      // serving index
+    unsigned int filter;
+    unsigned long long key;
+    Topk_heap* heap;
+};
+
+// Runs the users of all top-K requests of the batch that miss the cache in blocks of TOPK_USER_BLOCK: their P
+// rows are gathered into rows so that one pass over the item panels serves the whole block, each user with the
+// K and filter of its request. The results of a block go into the cache.
+void serve_topk(Server_state* s, const Served_model* served, const vector<Pending_request*>& batch, float** rows, unsigned int* rows_k,
+                vector<Topk_entry>* storage, vector<Topk_heap>* heaps, vector<unsigned int>* reply){
+    const Serving_model* model = &served->snapshot->model;
+    unsigned int k = model->k;
+    size_t slot_num = 0, entry_num = 0;
+    for (unsigned int r = 0; r < batch.size(); r++){
+        if (batch[r]->h.type != PREDICT_TOPK) continue;
+        slot_num += batch[r]->h.count;
+        entry_num += (size_t)batch[r]->h.count * predict_topk_K(batch[r]->h);
+    }
+    if (slot_num == 0) return;
+    prepare_topk_rows(rows, rows_k, k);
+    storage->resize(entry_num);
+    heaps->resize(slot_num);
+
+    vector<Topk_slot> block;
+    size_t slot = 0, entry = 0;
+    unsigned long long version = served->snapshot->version;
+    for (unsigned int r = 0; r < batch.size(); r++){
+        Pending_request* req = batch[r];
+        if (req->h.type != PREDICT_TOPK) continue;
+        unsigned int K = predict_topk_K(req->h), filter = predict_topk_filter(req->h);
+        for (unsigned int j = 0; j < req->h.count; j++, slot++, entry += K){
+            Topk_heap* h = &(*heaps)[slot];
+            topk_reset(h, K, storage->data() + entry);
+            unsigned int u = find_serving_id(model->user2orig, model->user_num, req->payload[j]);
+            if (u == NO_SERVING_ID) continue;
+            unsigned long long key = topk_cache_key(req->payload[j], K, filter);
+            if (topk_cache_enabled(&s->cache, served->degree_group[u]) && topk_cache_lookup(&s->cache, served->degree_group[u], key, version, h)) continue;
+            Topk_slot b = {u, filter, key, h};
+            block.push_back(b);
+        }
+    }
+
+    Topk_heap block_heaps[TOPK_USER_BLOCK];
+    unsigned int users[TOPK_USER_BLOCK];
+    for (size_t b0 = 0; b0 < block.size(); b0 += TOPK_USER_BLOCK){
+        unsigned int cnt = min((size_t)TOPK_USER_BLOCK, block.size() - b0);
+        for (unsigned int b = 0; b < cnt; b++){
+            memcpy(*rows + (size_t)b * k, model->p + (size_t)block[b0 + b].user * k, sizeof(float) * k);
+            users[b] = block[b0 + b].filter == PREDICT_FILTER_SEEN ? block[b0 + b].user : NO_SERVING_ID;
+            block_heaps[b] = *block[b0 + b].heap;
+        }
+        topk_rows_block(model, &served->panels, *rows, users, cnt, block_heaps);
+        for (unsigned int b = 0; b < cnt; b++){
+            sort_heap(block_heaps[b].e, block_heaps[b].e + block_heaps[b].size, topk_better);
+            *block[b0 + b].heap = block_heaps[b];
+            unsigned int group = served->degree_group[block[b0 + b].user];
+            if (topk_cache_enabled(&s->cache, group)) topk_cache_insert(&s->cache, group, block[b0 + b].key, version, &block_heaps[b]);
+        }
+    }
+
+    slot = 0;
+    for (unsigned int r = 0; r < batch.size(); r++){
+        Pending_request* req = batch[r];
+        if (req->h.type != PREDICT_TOPK) continue;
+        reply->clear();
+        for (unsigned int j = 0; j < req->h.count; j++, slot++){
+            Topk_heap* h = &(*heaps)[slot];
+            reply->push_back(h->size);
+            for (unsigned int e = 0; e < h->size; e++){
+                float score = h->e[e].score;
+                unsigned int score_bits;
+                memcpy(&score_bits, &score, sizeof(float));
+                reply->push_back(model->item2orig[h->e[e].item]);
+                reply->push_back(score_bits);
+            }
+        }
+        finish_request(s, req, PREDICT_OK, reply->data(), reply->size() * sizeof(unsigned int));
+    }
+}
+
+// Folds in the new users of all fold-in requests of the batch with one batched solve, then runs the top-K of
+// those that ask for it in blocks of TOPK_USER_BLOCK over the item panels. With the seen filter a heap keeps K
+// more entries than the request has ratings, so that K are left once the rated items are dropped.
+void serve_fold_in(Server_state* s, const Served_model* served, const vector<Pending_request*>& batch, float** rows, unsigned int* rows_k,
+                   vector<Topk_entry>* storage, vector<Topk_heap>* heaps, vector<unsigned int>* reply){
+    const Serving_model* model = &served->snapshot->model;
+    unsigned int k = model->k;
+    vector<Pending_request*> reqs;
+    vector<Fold_in_rating> ratings;
+    vector<size_t> begin(1, 0);
+    for (unsigned int r = 0; r < batch.size(); r++){
+        Pending_request* req = batch[r];
+        if (req->h.type != PREDICT_FOLD_IN) continue;
+        for (unsigned int j = 0; j < req->h.count; j++){
+            Fold_in_rating x;
+            x.item = find_serving_id(model->item2orig, model->item_num, req->payload[2 * j]);
+            memcpy(&x.r, &req->payload[2 * j + 1], sizeof(float));
+            if (x.item != NO_SERVING_ID && isfinite(x.r)) ratings.push_back(x);
+        }
+        begin.push_back(ratings.size());
+        reqs.push_back(req);
+    }
+    if (reqs.empty()) return;
+    vector<float> p((size_t)reqs.size() * k);
+    fold_in_users(NULL, model, ratings.data(), begin.data(), reqs.size(), s->lambda, p.data());
+
+    size_t entry_num = 0;
+    vector<size_t> entry_begin(reqs.size());
+    for (unsigned int r = 0; r < reqs.size(); r++){
+        unsigned int K = predict_topk_K(reqs[r]->h);
+        entry_begin[r] = entry_num;
+        if (K) entry_num += K + (predict_topk_filter(reqs[r]->h) == PREDICT_FILTER_SEEN ? begin[r + 1] - begin[r] : 0);
+    }
+    storage->resize(entry_num);
+    heaps->resize(reqs.size());
+    vector<unsigned int> block;
+    for (unsigned int r = 0; r < reqs.size(); r++){
+        unsigned int K = predict_topk_K(reqs[r]->h);
+        unsigned int extra = predict_topk_filter(reqs[r]->h) == PREDICT_FILTER_SEEN ? begin[r + 1] - begin[r] : 0;
+        topk_reset(&(*heaps)[r], K ? K + extra : 0, storage->data() + entry_begin[r]);
+        if (K) block.push_back(r);
+    }
+    if (!block.empty()) prepare_topk_rows(rows, rows_k, k);
+    Topk_heap block_heaps[TOPK_USER_BLOCK];
+    unsigned int users[TOPK_USER_BLOCK];
+    for (size_t b0 = 0; b0 < block.size(); b0 += TOPK_USER_BLOCK){
+        unsigned int cnt = min((size_t)TOPK_USER_BLOCK, block.size() - b0);
+        for (unsigned int b = 0; b < cnt; b++){
+            memcpy(*rows + (size_t)b * k, p.data() + (size_t)block[b0 + b] * k, sizeof(float) * k);
+            users[b] = NO_SERVING_ID;
+            block_heaps[b] = (*heaps)[block[b0 + b]];
+        }
+        topk_rows_block(model, &served->panels, *rows, users, cnt, block_heaps);
+        for (unsigned int b = 0; b < cnt; b++){
+            sort_heap(block_heaps[b].e, block_heaps[b].e + block_heaps[b].size, topk_better);
+            (*heaps)[block[b0 + b]] = block_heaps[b];
+        }
+    }
+
+    for (unsigned int r = 0; r < reqs.size(); r++){
+        Pending_request* req = reqs[r];
+        Topk_heap* h = &(*heaps)[r];
+        unsigned int K = predict_topk_K(req->h);
+        bool filter_seen = predict_topk_filter(req->h) == PREDICT_FILTER_SEEN;
+        reply->resize(k);
+        memcpy(reply->data(), p.data() + (size_t)r * k, sizeof(float) * k);
+        reply->push_back(0);
+        unsigned int n = 0;
+        for (unsigned int e = 0; e < h->size && n < K; e++){
+            unsigned int item = h->e[e].item;
+            bool rated = false;
+            for (size_t j = begin[r]; filter_seen && j < begin[r + 1] && !rated; j++) rated = ratings[j].item == item;
+            if (rated) continue;
+            unsigned int score_bits;
+            memcpy(&score_bits, &h->e[e].score, sizeof(float));
+            reply->push_back(model->item2orig[item]);
+            reply->push_back(score_bits);
+            n++;
+        }
+        (*reply)[k] = n;
+        finish_request(s, req, PREDICT_OK, reply->data(), reply->size() * sizeof(unsigned int));
+    }
+}
+
+void serve_worker(Server_state* s){
+    float* rows = NULL;
+    unsigned int rows_k = 0;
+    vector<Pending_request*> batch;
+    vector<float> scores;
+    vector<Topk_entry> storage;
+    vector<Topk_heap> heaps;
+    vector<unsigned int> reply;
+    while (take_batch(s, &batch)){
+        s->batches++;
+        s->batched_requests += batch.size();
+        shared_ptr<Served_model> served = atomic_load(&s->current);
+        serve_scores(s, served.get(), batch, &scores);
+        serve_topk(s, served.get(), batch, &rows, &rows_k, &storage, &heaps, &reply);
+        serve_fold_in(s, served.get(), batch, &rows, &rows_k, &storage, &heaps, &reply);
+        for (unsigned int r = 0; r < batch.size(); r++) delete batch[r];
+    }
+    free(rows);
+}
+
+int open_listener(string socket_path, unsigned int port){
+    int fd;
+    if (port > 0){
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0){
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    unlink(socket_path.c_str());
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void accept_connections(Server_state* s, int listen_fd, bool tcp){
+    while (!stop_requested){
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        if (tcp){
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        shared_ptr<Connection> conn = make_shared<Connection>();
+        conn->fd = fd;
+        lock_guard<mutex> lk(s->conn_m);
+        s->connections.push_back(conn);
+        thread(read_connection, s, conn).detach();
+    }
+}
+
+void print_server_stats(Server_state* s){
+    for (unsigned int t = 0; t < PREDICT_TYPES; t++){
+        if (s->latency[t].count == 0) continue;
+        print_latency_stats(string("Latency ") + predict_type_name(t), latency_stats(&s->latency[t]));
+    }
+    unsigned long long batches = s->batches;
+    cout << "Micro-batches / mean size        : " << batches << " / " << (batches ? (double)s->batched_requests / batches : 0) << endl;
+    if (s->cache.group_num) print_topk_cache_stats(&s->cache);
+}
+
+int main (int argc, const char* argv[]){
+    string model_file = "";
+    string train_file = "";
+    string snapshot_name = "";
+    string socket_path = "/tmp/mascot_predict.sock";
+    unsigned int port = 0;
+    unsigned int num_threads = thread::hardware_concurrency();
+    unsigned int max_batch = 32;
+    unsigned int batch_wait = 50;
+    unsigned int stats_interval = 0;
+    unsigned int duration = 0;
+    string cache_budgets = "";
+    float lambda = 0.015;
+
+    for(int i = 0; i < argc; i++){
+        if(string(argv[i]) == "-m" && i < argc-1) model_file = string(argv[i+1]);
+        if(string(argv[i]) == "-i" && i < argc-1) train_file = string(argv[i+1]);
+        if(string(argv[i]) == "-sn" && i < argc-1) snapshot_name = string(argv[i+1]);
+        if(string(argv[i]) == "-s" && i < argc-1) socket_path = string(argv[i+1]);
+        if(string(argv[i]) == "-p" && i < argc-1) port = stoi(argv[i+1]);
+        if(string(argv[i]) == "-t" && i < argc-1) num_threads = stoi(argv[i+1]);
+        if(string(argv[i]) == "-mb" && i < argc-1) max_batch = stoi(argv[i+1]);
+        if(string(argv[i]) == "-bw" && i < argc-1) batch_wait = stoi(argv[i+1]);
+        if(string(argv[i]) == "-cb" && i < argc-1) cache_budgets = string(argv[i+1]);
+        if(string(argv[i]) == "-b" && i < argc-1) lambda = atof(argv[i+1]);
+        if(string(argv[i]) == "-si" && i < argc-1) stats_interval = stoi(argv[i+1]);
+        if(string(argv[i]) == "-d" && i < argc-1) duration = stoi(argv[i+1]);
+        if(string(argv[i]) == "-h"){
+            usage(argv[0]);
+            return(0);
+        }
+    }
+
+    vector<double> cache_mb = parse_list(cache_budgets);
+    if((!exists(model_file) && snapshot_name == "") || max_batch == 0 || cache_mb.size() > TOPK_CACHE_MAX_GROUPS){
+        usage(argv[0]);
+        return(0);
+    }
+
+    Server_state* s = new Server_state;
+    s->max_batch = max_batch;
+    s->batch_wait = batch_wait;
+    s->lambda = lambda;
+    s->batches = 0;
+    s->batched_requests = 0;
+    for (unsigned int t = 0; t < PREDICT_TYPES; t++) reset_latency_histogram(&s->latency[t]);
+    vector<size_t> cache_bytes;
+    for (unsigned int g = 0; g < cache_mb.size(); g++) cache_bytes.push_back((size_t)(cache_mb[g] * 1048576));
+    init_topk_cache(&s->cache, cache_bytes);
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    // A text model is converted once to <model>.srv next to it, which later runs map directly as long as the
+    // model and training file are unchanged.
+    string source = model_file;
+    Shm_snapshot_reader reader;
+    shared_ptr<Model_snapshot> snapshot;
+    if (snapshot_name != ""){
+        source = "/dev/shm/" + snapshot_name;
+        if (!open_shm_snapshot_reader(&reader, snapshot_name)){
+            cout << "no snapshot named " << source << endl;
+            return 1;
+        }
+        while (!(snapshot = acquire_shm_snapshot(&reader)) && !stop_requested){
+            this_thread::sleep_for(std::chrono::milliseconds(100));
+            refresh_shm_snapshot(&reader);
+        }
+        if (!snapshot) return 0;
+    }
+    else if (!(snapshot = map_serving_snapshot(model_file))){
+        source = model_file + ".srv";
+        if (!serving_file_is_current(source, model_file, train_file) || !(snapshot = map_serving_snapshot(source))){
+            if (!exists(train_file)){
+                if (exists(source)) cout << source << " was not built from the current " << model_file << "; give the training file with -i to rebuild it" << endl;
+                else cout << model_file << " is not a serving file; give the training file with -i to build one" << endl;
+                return 1;
+            }
+            Serving_model loaded;
+            load_serving_model(&loaded, model_file, train_file);
+            bool saved = save_serving_model(&loaded, source, model_file, train_file);
+            free_serving_model(&loaded);
+            if (!saved || !(snapshot = map_serving_snapshot(source))){
+                cout << "fail to map serving file " << source << endl;
+                return 1;
+            }
+        }
+    }
+
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, 0);
+    atomic_store(&s->current, make_served_model(snapshot, &pool, s->cache.group_num));
+    s->cache.version = snapshot->version;
+
+    int listen_fd = open_listener(socket_path, port);
+    if (listen_fd < 0){
+        cout << "fail to listen on " << (port ? "127.0.0.1:" + to_string(port) : socket_path) << endl;
+        return 1;
+    }
+
+    cout << endl;
+    cout << (snapshot_name != "" ? "Snapshot                         : " : "Serving file                     : ") << source
+         << " (" << snapshot->model.mapping_bytes / 1048576.0 << " MB mapped)" << endl;
+    if (snapshot_name != "") cout << "Version / epoch                  : " << snapshot->version << " / " << snapshot->epoch << endl;
+    cout << "Users / items / k                : " << snapshot->model.user_num << " / " << snapshot->model.item_num << " / " << snapshot->model.k << endl;
+    cout << "Listening on                     : " << (port ? "127.0.0.1:" + to_string(port) : socket_path) << endl;
+    cout << "Workers                          : " << num_threads << endl;
+    cout << "Micro-batch size / wait          : " << max_batch << " / " << batch_wait << " us" << endl;
+    if (s->cache.group_num){
+        cout << "Top-K cache budget (MB)          : ";
+        for (unsigned int g = 0; g < cache_mb.size(); g++) cout << (g ? ", " : "") << cache_mb[g];
+        cout << " for " << cache_mb.size() << " degree group" << (cache_mb.size() > 1 ? "s" : "") << endl;
+    }
+    // From here on only the served model keeps the first version mapped, so that a swap releases it.
+    snapshot.reset();
+
+    thread acceptor(accept_connections, s, listen_fd, port > 0);
+    std::chrono::time_point<std::chrono::steady_clock> start_point = std::chrono::steady_clock::now();
+    unsigned long long swaps = 0;
+    thread monitor([&]{
+        std::chrono::time_point<std::chrono::steady_clock> next_stats = start_point + std::chrono::seconds(stats_interval);
+        while (!stop_requested){
+            this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (snapshot_name != "" && refresh_shm_snapshot(&reader)){
+                std::chrono::time_point<std::chrono::steady_clock> swap_start_point = std::chrono::steady_clock::now();
+                shared_ptr<Model_snapshot> next = acquire_shm_snapshot(&reader);
+                atomic_store(&s->current, make_served_model(next, NULL, s->cache.group_num));
+                invalidate_topk_cache(&s->cache, next->version);
+                swaps++;
+                cout << "Swapped to version " << next->version << " (epoch " << next->epoch << ") in "
+                     << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - swap_start_point).count() << " us" << endl;
+            }
+            std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+            if (duration && now - start_point >= std::chrono::seconds(duration)) stop_requested = 1;
+            if (stats_interval && now >= next_stats){
+                cout << "\n<Stats after " << std::chrono::duration_cast<std::chrono::seconds>(now - start_point).count() << " s>" << endl;
+                print_server_stats(s);
+                next_stats += std::chrono::seconds(stats_interval);
+            }
+        }
+        s->queue.cv.notify_all();
+    });
+
+    run_cpu_thread_pool(&pool, [&](unsigned int t){ serve_worker(s); });
+
+    monitor.join();
+    acceptor.join();
+    close(listen_fd);
+    if (port == 0) unlink(socket_path.c_str());
+    {
+        unique_lock<mutex> lk(s->conn_m);
+        for (unsigned int c = 0; c < s->connections.size(); c++) shutdown(s->connections[c]->fd, SHUT_RDWR);
+        s->conn_cv.wait(lk, [&]{ return s->connections.empty(); });
+    }
+    for (unsigned int r = 0; r < s->queue.q.size(); r++) delete s->queue.q[r];
+
+    cout << "\n<Final stats>" << endl;
+    print_server_stats(s);
+    if (snapshot_name != "") cout << "Snapshot swaps                   : " << swaps << endl;
+    atomic_store(&s->current, shared_ptr<Served_model>());
+    if (snapshot_name != "") close_shm_snapshot_reader(&reader);
+    destroy_cpu_thread_pool(&pool);
+    free_topk_cache(&s->cache);
+    delete s;
+    return 0;
+}
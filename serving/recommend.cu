@@ -0,0 +1,174 @@
+#include <iostream>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include "common_struct.h"
+#include "io_utils.h"
+#include "cpu_thread_pool.h"
+#include "serving_model.h"
+#include "topk.h"
+#include "topk_int8.h"
+#include "topk_lemp.h"
+using namespace std;
+
+// Batch top-K recommendation of unseen items for every user of a trained model.
+
+bool exists (const std::string& name) {
+    struct stat buffer;
+    return (stat(name.c_str(), &buffer) == 0);
+}
+
+void usage(const char* name){
+    cout << name << " -m <model> -i <train-tsv> [-K <items/user> -o <output> -f tsv|bin -t <threads> -n <users> -q8 <alpha> -lp <prefix> -bm 1]" << endl;
+}
+
+// Prints name padded to the report column.
+void print_label(const string& name){
+    cout << name << string(name.size() < 33 ? 33 - name.size() : 1, ' ') << ": ";
+}
+
+// Exact fp32 scan, the norm-pruned exact scan when lemp is given, or the int8 scan with ceil(alpha * K)
+// candidates re-ranked in fp32 when q8 is given.
+double run_topk(Cpu_thread_pool* pool, Serving_model* model, Item_panels* panels, Int8_panels* q8, float alpha, Lemp_index* lemp,
+                unsigned int K, unsigned int user_num, vector<Topk_entry>* results, vector<unsigned int>* counts){
+    std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+    if (q8) topk8_recommend(pool, model, q8, K, max(K, (unsigned int)ceilf(alpha * K)), user_num, results, counts);
+    else if (lemp) lemp_recommend(pool, model, panels, lemp, K, user_num, results, counts);
+    else topk_recommend(pool, model, panels, K, user_num, results, counts);
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+}
+
+void print_lemp_counters(Lemp_index* lemp){
+    cout << "Pairs skipped by norm bound      : " << 100.0 * lemp->bound_skipped / max(lemp->pairs, 1ull) << "%" << endl;
+    cout << "Micro-kernel early exits         : " << lemp->early_exits << endl;
+}
+
+int main (int argc, const char* argv[]){
+    string model_file = "";
+    string train_file = "";
+    string outfile = "";
+    string format = "tsv";
+    unsigned int K = 10;
+    unsigned int num_threads = thread::hardware_concurrency();
+    unsigned int user_limit = 0;
+    bool benchmark = false;
+    float alpha = 0;
+    unsigned int lemp_prefix = 0;
+
+    for(int i = 0; i < argc; i++){
+        if(string(argv[i]) == "-m" && i < argc-1) model_file = string(argv[i+1]);
+        if(string(argv[i]) == "-i" && i < argc-1) train_file = string(argv[i+1]);
+        if(string(argv[i]) == "-o" && i < argc-1) outfile = string(argv[i+1]);
+        if(string(argv[i]) == "-f" && i < argc-1) format = string(argv[i+1]);
+        if(string(argv[i]) == "-K" && i < argc-1) K = stoi(argv[i+1]);
+        if(string(argv[i]) == "-t" && i < argc-1) num_threads = stoi(argv[i+1]);
+        if(string(argv[i]) == "-n" && i < argc-1) user_limit = stoi(argv[i+1]);
+        if(string(argv[i]) == "-q8" && i < argc-1) alpha = stof(argv[i+1]);
+        if(string(argv[i]) == "-lp" && i < argc-1) lemp_prefix = stoi(argv[i+1]);
+        if(string(argv[i]) == "-bm" && i < argc-1) benchmark = stoi(argv[i+1]) != 0;
+        if(string(argv[i]) == "-h"){
+            usage(argv[0]);
+            return(0);
+        }
+    }
+
+    if(!exists(model_file) || !exists(train_file) || K == 0){
+        usage(argv[0]);
+        return(0);
+    }
+
+    cout << endl;
+    cout << "Model file                       : " << model_file << endl;
+    cout << "Training file                    : " << train_file << endl;
+    cout << "Threads                          : " << num_threads << endl;
+    cout << "SIMD lanes                       : " << TOPK_LANES << endl;
+
+    std::chrono::time_point<std::chrono::system_clock> load_start_point = std::chrono::system_clock::now();
+    Serving_model model;
+    load_serving_model(&model, model_file, train_file);
+    double load_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - load_start_point).count();
+
+    unsigned int user_num = user_limit ? min(user_limit, model.user_num) : model.user_num;
+    cout << "Users / items / k                : " << model.user_num << " / " << model.item_num << " / " << model.k << endl;
+    cout << "Seen ratings                     : " << model.seen_n << endl;
+    cout << "Load time                        : " << load_exec_time << endl;
+
+    Cpu_thread_pool pool;
+    init_cpu_thread_pool(&pool, num_threads, 0);
+
+    std::chrono::time_point<std::chrono::system_clock> pack_start_point = std::chrono::system_clock::now();
+    Item_panels panels;
+    pack_item_panels(&pool, model.q, model.item_num, model.k, &panels);
+    double pack_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - pack_start_point).count();
+    cout << "Item packing time                : " << pack_exec_time << endl;
+
+    Int8_panels q8;
+    if (alpha > 0){
+        std::chrono::time_point<std::chrono::system_clock> q8_start_point = std::chrono::system_clock::now();
+        pack_int8_panels(&pool, &model, &panels, &q8);
+        double q8_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - q8_start_point).count();
+        cout << "Int8 lanes / candidates          : " << TOPK8_LANES << " / " << alpha << " x K" << endl;
+        cout << "Int8 quantization time           : " << q8_exec_time << endl;
+    }
+    Int8_panels* scan_q8 = alpha > 0 ? &q8 : NULL;
+
+    Lemp_index lemp;
+    if (lemp_prefix > 0 && scan_q8 == NULL){
+        build_lemp_index(&model, &panels, lemp_prefix, &lemp);
+        cout << "Pruning prefix dimensions        : " << lemp.prefix << endl;
+        cout << "Item norm skew (max / median)    : " << lemp_norm_skew(&lemp, model.item_num) << endl;
+    }
+    Lemp_index* scan_lemp = lemp_prefix > 0 && scan_q8 == NULL ? &lemp : NULL;
+
+    vector<Topk_entry> results;
+    vector<unsigned int> counts;
+
+    if (benchmark){
+        cout << "\n<Top-K throughput>" << endl;
+        unsigned int bench_K[2] = {10, 100};
+        for (unsigned int b = 0; b < 2; b++){
+            double exec_time = run_topk(&pool, &model, &panels, NULL, 0, NULL, bench_K[b], user_num, &results, &counts);
+            print_label("Users/s at K=" + to_string(bench_K[b]));
+            cout << user_num / (exec_time / 1000000) << " (" << exec_time << " us)" << endl;
+            if (scan_q8 == NULL && scan_lemp == NULL) continue;
+            vector<Topk_entry> approx;
+            vector<unsigned int> approx_counts;
+            double fast_exec_time = run_topk(&pool, &model, &panels, scan_q8, alpha, scan_lemp, bench_K[b], user_num, &approx, &approx_counts);
+            print_label((scan_q8 ? "Int8 users/s at K=" : "Pruned users/s at K=") + to_string(bench_K[b]));
+            cout << user_num / (fast_exec_time / 1000000) << " (" << exec_time / fast_exec_time << "x, recall@" << bench_K[b] << " "
+                 << topk_recall(results, counts, approx, approx_counts, bench_K[b]) << ")" << endl;
+        }
+    }
+
+    double exec_time = run_topk(&pool, &model, &panels, scan_q8, alpha, scan_lemp, K, user_num, &results, &counts);
+    cout << "\n<Top-" << K << " recommendation>" << endl;
+    cout << "Users                            : " << user_num << endl;
+    cout << "Recommendation time              : " << exec_time << endl;
+    cout << "Users/s                          : " << user_num / (exec_time / 1000000) << endl;
+    if (scan_lemp) print_lemp_counters(scan_lemp);
+    if (scan_q8 || scan_lemp){
+        vector<Topk_entry> exact;
+        vector<unsigned int> exact_counts;
+        double exact_exec_time = run_topk(&pool, &model, &panels, NULL, 0, NULL, K, user_num, &exact, &exact_counts);
+        print_label("Recall@" + to_string(K));
+        cout << topk_recall(exact, exact_counts, results, counts, K) << endl;
+        cout << "Speedup over fp32 scan           : " << exact_exec_time / exec_time << endl;
+    }
+
+    if (outfile != ""){
+        std::chrono::time_point<std::chrono::system_clock> write_start_point = std::chrono::system_clock::now();
+        if (format == "bin") write_topk_binary(&model, results, counts, K, outfile);
+        else write_topk_tsv(&model, results, counts, K, outfile);
+        double write_exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - write_start_point).count();
+        print_label("Output (" + format + ")");
+        cout << outfile << endl;
+        cout << "Write time                       : " << write_exec_time << endl;
+    }
+
+    if (scan_q8) free_int8_panels(&q8);
+    if (scan_lemp) free_lemp_index(&lemp);
+    free_item_panels(&panels);
+    free_serving_model(&model);
+    destroy_cpu_thread_pool(&pool);
+    return 0;
+}
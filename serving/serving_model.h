@@ -0,0 +1,264 @@
+#ifndef SERVING_MODEL_H
+#define SERVING_MODEL_H
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common_struct.h"
+#include "io_utils.h"
+using namespace std;
+
+// Extra zero rows after the last user, so that blocked kernels may read a few rows past the end.
+#define SERVING_ROW_PADDING 8
+#define SERVING_FILE_MAGIC 0x5652534d   // "MSRV"
+#define SERVING_FILE_VERSION 2
+#define NO_SERVING_ID UINT_MAX
+
+// A trained model restricted to the users and items of its training set. Serving indices follow the
+// ascending original ids, so they map back with user2orig/item2orig and output comes out sorted.
+// The items each user rated in training are kept sorted per user (CSR) to exclude them from recommendations.
+// The arrays are either owned (load_serving_model) or point into a read-only mapping of a serving file
+// (map_serving_model), in which case mapping is set.
+struct Serving_model{
+    unsigned int k;
+    unsigned int user_num;
+    unsigned int item_num;
+    size_t seen_n;
+    float* p;
+    float* q;
+    unsigned int* user2orig;
+    unsigned int* item2orig;
+    size_t* seen_begin;             // seen items of user u are seen_items[seen_begin[u], seen_begin[u+1])
+    unsigned int* seen_items;
+
+    void* mapping;
+    size_t mapping_bytes;
+};
+
+// Binary serving file: this header, then the sections at the 64-byte aligned offsets it lists. P and Q carry
+// SERVING_ROW_PADDING zero rows each, so the file can be used in place by the blocked kernels. The size and
+// modification time (ns) of the text model and training file it was built from tell a stale file apart.
+struct Serving_file_header{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int k;
+    unsigned int user_num;
+    unsigned int item_num;
+    unsigned int reserved;
+    unsigned long long seen_n;
+    unsigned long long p_offset;
+    unsigned long long q_offset;
+    unsigned long long user2orig_offset;
+    unsigned long long item2orig_offset;
+    unsigned long long seen_begin_offset;
+    unsigned long long seen_items_offset;
+    unsigned long long bytes;
+    unsigned long long model_bytes;
+    unsigned long long model_mtime;
+    unsigned long long train_bytes;
+    unsigned long long train_mtime;
+};
+
+inline bool is_seen(const Serving_model* model, unsigned int u, unsigned int i){
+    return binary_search(model->seen_items + model->seen_begin[u], model->seen_items + model->seen_begin[u + 1], i);
+}
+
+// Serving index of an original id, NO_SERVING_ID when the id is not in the model.
+inline unsigned int find_serving_id(const unsigned int* serving2orig, unsigned int n, unsigned int orig){
+    const unsigned int* it = lower_bound(serving2orig, serving2orig + n, orig);
+    return it != serving2orig + n && *it == orig ? it - serving2orig : NO_SERVING_ID;
+}
+
+float* alloc_serving_rows(size_t rows, unsigned int k){
+    size_t bytes = ((rows + SERVING_ROW_PADDING) * k * sizeof(float) + 63) / 64 * 64;
+    float* ptr = (float*)aligned_alloc(64, bytes);
+    memset(ptr, 0, bytes);
+    return ptr;
+}
+
+// Copies the rows of the ids in orig_map (original id -> internal id) out of a model file indexed by
+// original id. The serving index of an id is its position in ascending original id order.
+void gather_serving_rows(float* dst, const float* src, unsigned int src_rows, const map<unsigned int, unsigned int>& orig_map,
+                         unsigned int* serving2orig, vector<unsigned int>* internal2serving, unsigned int k){
+    internal2serving->resize(orig_map.size());
+    unsigned int s = 0;
+    for (map<unsigned int, unsigned int>::const_iterator it = orig_map.begin(); it != orig_map.end(); it++, s++){
+        if (it->first >= src_rows){
+            cout << "Model has no row for id " << it->first << " of the training set" << endl;
+            exit(1);
+        }
+        memcpy(dst + (size_t)s * k, src + (size_t)it->first * k, sizeof(float) * k);
+        serving2orig[s] = it->first;
+        (*internal2serving)[it->second] = s;
+    }
+}
+
+// Reads a model saved by quantized_mf (-o) and the training file it was trained on.
+void load_serving_model(Serving_model* model, string model_file, string train_file){
+    Mf_info model_info;
+    SGD model_params;
+    read_trained_model(&model_info, &model_params, model_file);
+
+    Mf_info train_info;
+    read_training_dataset(&train_info, train_file);
+
+    model->k = model_info.params.k;
+    model->user_num = train_info.max_user;
+    model->item_num = train_info.max_item;
+    model->seen_n = train_info.n;
+    model->p = alloc_serving_rows(model->user_num, model->k);
+    model->q = alloc_serving_rows(model->item_num, model->k);
+    model->user2orig = new unsigned int[model->user_num];
+    model->item2orig = new unsigned int[model->item_num];
+    model->seen_begin = new size_t[model->user_num + 1];
+    model->seen_items = new unsigned int[max(model->seen_n, (size_t)1)];
+    model->mapping = NULL;
+    model->mapping_bytes = 0;
+
+    vector<unsigned int> user2serving, item2serving;
+    gather_serving_rows(model->p, model_params.p, model_info.max_user, train_info.user_map, model->user2orig, &user2serving, model->k);
+    gather_serving_rows(model->q, model_params.q, model_info.max_item, train_info.item_map, model->item2orig, &item2serving, model->k);
+    delete [] model_params.p;
+    delete [] model_params.q;
+
+    fill(model->seen_begin, model->seen_begin + model->user_num + 1, 0);
+    for (unsigned int j = 0; j < train_info.n; j++) model->seen_begin[user2serving[train_info.R[j].u] + 1]++;
+    for (unsigned int u = 0; u < model->user_num; u++) model->seen_begin[u + 1] += model->seen_begin[u];
+    vector<size_t> fill_pos(model->seen_begin, model->seen_begin + model->user_num);
+    for (unsigned int j = 0; j < train_info.n; j++)
+        model->seen_items[fill_pos[user2serving[train_info.R[j].u]]++] = item2serving[train_info.R[j].i];
+    for (unsigned int u = 0; u < model->user_num; u++)
+        sort(model->seen_items + model->seen_begin[u], model->seen_items + model->seen_begin[u + 1]);
+    delete [] train_info.R;
+}
+
+inline unsigned long long align64(unsigned long long offset){
+    return (offset + 63) / 64 * 64;
+}
+
+void write_section(ofstream& out, unsigned long long offset, const void* data, size_t bytes){
+    out.seekp(offset);
+    out.write((const char*)data, bytes);
+}
+
+// Size and modification time of a source file; zeros when it cannot be read.
+void stat_serving_source(string file, unsigned long long* bytes, unsigned long long* mtime){
+    struct stat st;
+    if (file == "" || stat(file.c_str(), &st) != 0){
+        *bytes = *mtime = 0;
+        return;
+    }
+    *bytes = st.st_size;
+    *mtime = (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+}
+
+// Writes the model loaded from model_file and train_file as a serving file that map_serving_model can use in place.
+bool save_serving_model(const Serving_model* model, string outfile, string model_file, string train_file){
+    ofstream out(outfile.c_str(), ios::binary | ios::trunc);
+    if (out.fail()){
+        cout << "fail to write file named " << outfile << endl;
+        return false;
+    }
+    Serving_file_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SERVING_FILE_MAGIC;
+    h.version = SERVING_FILE_VERSION;
+    h.k = model->k;
+    h.user_num = model->user_num;
+    h.item_num = model->item_num;
+    h.seen_n = model->seen_n;
+    stat_serving_source(model_file, &h.model_bytes, &h.model_mtime);
+    stat_serving_source(train_file, &h.train_bytes, &h.train_mtime);
+    size_t p_bytes = ((size_t)model->user_num + SERVING_ROW_PADDING) * model->k * sizeof(float);
+    size_t q_bytes = ((size_t)model->item_num + SERVING_ROW_PADDING) * model->k * sizeof(float);
+    h.p_offset = align64(sizeof(h));
+    h.q_offset = align64(h.p_offset + p_bytes);
+    h.user2orig_offset = align64(h.q_offset + q_bytes);
+    h.item2orig_offset = align64(h.user2orig_offset + sizeof(unsigned int) * model->user_num);
+    h.seen_begin_offset = align64(h.item2orig_offset + sizeof(unsigned int) * model->item_num);
+    h.seen_items_offset = align64(h.seen_begin_offset + sizeof(size_t) * (model->user_num + 1));
+    h.bytes = align64(h.seen_items_offset + sizeof(unsigned int) * model->seen_n);
+
+    write_section(out, 0, &h, sizeof(h));
+    write_section(out, h.p_offset, model->p, p_bytes);
+    write_section(out, h.q_offset, model->q, q_bytes);
+    write_section(out, h.user2orig_offset, model->user2orig, sizeof(unsigned int) * model->user_num);
+    write_section(out, h.item2orig_offset, model->item2orig, sizeof(unsigned int) * model->item_num);
+    write_section(out, h.seen_begin_offset, model->seen_begin, sizeof(size_t) * (model->user_num + 1));
+    write_section(out, h.seen_items_offset, model->seen_items, sizeof(unsigned int) * model->seen_n);
+    char zero = 0;
+    write_section(out, h.bytes - 1, &zero, 1);
+    out.close();
+    return !out.fail();
+}
+
+// True when infile is a serving file built from model_file as it is now, and from train_file unless that is empty.
+bool serving_file_is_current(string infile, string model_file, string train_file){
+    ifstream in(infile.c_str(), ios::binary);
+    Serving_file_header h;
+    in.read((char*)&h, sizeof(h));
+    if (!in || h.magic != SERVING_FILE_MAGIC || h.version != SERVING_FILE_VERSION) return false;
+    unsigned long long bytes, mtime;
+    stat_serving_source(model_file, &bytes, &mtime);
+    if (bytes != h.model_bytes || mtime != h.model_mtime) return false;
+    if (train_file == "") return true;
+    stat_serving_source(train_file, &bytes, &mtime);
+    return bytes == h.train_bytes && mtime == h.train_mtime;
+}
+
+// Maps a serving file read-only; nothing is copied, pages are faulted in on first use.
+bool map_serving_model(Serving_model* model, string infile){
+    int fd = open(infile.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Serving_file_header)){
+        close(fd);
+        return false;
+    }
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+
+    const Serving_file_header* h = (const Serving_file_header*)base;
+    if (h->magic != SERVING_FILE_MAGIC || h->version != SERVING_FILE_VERSION || h->bytes > (unsigned long long)st.st_size){
+        munmap(base, st.st_size);
+        return false;
+    }
+    char* bytes = (char*)base;
+    model->k = h->k;
+    model->user_num = h->user_num;
+    model->item_num = h->item_num;
+    model->seen_n = h->seen_n;
+    model->p = (float*)(bytes + h->p_offset);
+    model->q = (float*)(bytes + h->q_offset);
+    model->user2orig = (unsigned int*)(bytes + h->user2orig_offset);
+    model->item2orig = (unsigned int*)(bytes + h->item2orig_offset);
+    model->seen_begin = (size_t*)(bytes + h->seen_begin_offset);
+    model->seen_items = (unsigned int*)(bytes + h->seen_items_offset);
+    model->mapping = base;
+    model->mapping_bytes = st.st_size;
+    return true;
+}
+
+void free_serving_model(Serving_model* model){
+    if (model->mapping){
+        munmap(model->mapping, model->mapping_bytes);
+        model->mapping = NULL;
+        return;
+    }
+    free(model->p);
+    free(model->q);
+    delete [] model->user2orig;
+    delete [] model->item2orig;
+    delete [] model->seen_begin;
+    delete [] model->seen_items;
+}
+
+#endif
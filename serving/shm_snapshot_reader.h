@@ -0,0 +1,149 @@
+#ifndef SHM_SNAPSHOT_READER_H
+#define SHM_SNAPSHOT_READER_H
+#include <iostream>
+#include <string>
+#include <memory>
+#include <atomic>
+#include "shm_snapshot.h"
+#include "serving_model.h"
+using namespace std;
+
+static_assert(SHM_SNAPSHOT_ROW_PADDING == SERVING_ROW_PADDING, "snapshot rows must be padded like serving rows");
+
+// Reader side of the shared memory snapshots of shm_snapshot.h. A Model_snapshot is a Serving_model whose arrays
+// point into a read-only mapping of one segment, so it can go wherever a mapped serving file goes. The reader
+// holds the newest snapshot in a shared_ptr that refresh_shm_snapshot replaces atomically; a thread that took
+// the previous one with acquire_shm_snapshot keeps using it, and its mapping is released when the last such
+// thread drops it.
+struct Model_snapshot{
+    Serving_model model;
+    unsigned long long version;     // 0 for a serving file
+    int epoch;
+    unsigned int user_group_num;
+    unsigned int item_group_num;
+    const unsigned int* user_group;             // group of each serving user, NULL when ungrouped
+    const unsigned int* item_group;
+    const unsigned char* user_group_prec;       // 0 = fp16, 1 = fp32, 2 = int8, 3 = bf16
+    const unsigned char* item_group_prec;
+    const unsigned int* user_group_end_idx;
+    const unsigned int* item_group_end_idx;
+};
+
+struct Shm_snapshot_reader{
+    string name;
+    const Shm_snapshot_control* control;
+    shared_ptr<Model_snapshot> current;         // only accessed through atomic_load/atomic_store
+    unsigned long long swaps;
+};
+
+void release_model_snapshot(Model_snapshot* snap){
+    free_serving_model(&snap->model);
+    delete snap;
+}
+
+// Wraps a mapped serving file, so that servers handle both sources alike.
+shared_ptr<Model_snapshot> map_serving_snapshot(string infile){
+    Model_snapshot* snap = new Model_snapshot;
+    memset(snap, 0, sizeof(Model_snapshot));
+    if (!map_serving_model(&snap->model, infile)){
+        delete snap;
+        return shared_ptr<Model_snapshot>();
+    }
+    return shared_ptr<Model_snapshot>(snap, release_model_snapshot);
+}
+
+// Maps segment version of the snapshot name; empty when it is gone or does not match.
+shared_ptr<Model_snapshot> map_shm_snapshot(const string& name, unsigned long long version){
+    int fd = shm_open(shm_snapshot_segment_name(name, version).c_str(), O_RDONLY, 0);
+    if (fd < 0) return shared_ptr<Model_snapshot>();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Shm_snapshot_header)){
+        close(fd);
+        return shared_ptr<Model_snapshot>();
+    }
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return shared_ptr<Model_snapshot>();
+
+    const Shm_snapshot_header* h = (const Shm_snapshot_header*)base;
+    if (h->magic != SHM_SNAPSHOT_MAGIC || h->layout != SHM_SNAPSHOT_LAYOUT || h->version != version || h->bytes > (unsigned long long)st.st_size){
+        munmap(base, st.st_size);
+        return shared_ptr<Model_snapshot>();
+    }
+    const char* bytes = (const char*)base;
+    Model_snapshot* snap = new Model_snapshot;
+    snap->model.k = h->k;
+    snap->model.user_num = h->user_num;
+    snap->model.item_num = h->item_num;
+    snap->model.seen_n = h->seen_n;
+    snap->model.p = (float*)(bytes + h->p_offset);
+    snap->model.q = (float*)(bytes + h->q_offset);
+    snap->model.user2orig = (unsigned int*)(bytes + h->user2orig_offset);
+    snap->model.item2orig = (unsigned int*)(bytes + h->item2orig_offset);
+    snap->model.seen_begin = (size_t*)(bytes + h->seen_begin_offset);
+    snap->model.seen_items = (unsigned int*)(bytes + h->seen_items_offset);
+    snap->model.mapping = base;
+    snap->model.mapping_bytes = st.st_size;
+    snap->version = h->version;
+    snap->epoch = h->epoch;
+    snap->user_group_num = h->user_group_num;
+    snap->item_group_num = h->item_group_num;
+    bool grouped = h->user_group_num > 0;
+    snap->user_group = grouped ? (const unsigned int*)(bytes + h->user_group_offset) : NULL;
+    snap->item_group = grouped ? (const unsigned int*)(bytes + h->item_group_offset) : NULL;
+    snap->user_group_prec = (const unsigned char*)(bytes + h->user_group_prec_offset);
+    snap->item_group_prec = (const unsigned char*)(bytes + h->item_group_prec_offset);
+    snap->user_group_end_idx = (const unsigned int*)(bytes + h->user_group_end_offset);
+    snap->item_group_end_idx = (const unsigned int*)(bytes + h->item_group_end_offset);
+    return shared_ptr<Model_snapshot>(snap, release_model_snapshot);
+}
+
+inline shared_ptr<Model_snapshot> acquire_shm_snapshot(Shm_snapshot_reader* reader){
+    return atomic_load(&reader->current);
+}
+
+// Swaps in the newest published version when it differs from the current one. Returns true after a swap.
+// A version unlinked between reading the control segment and opening it is simply retried.
+bool refresh_shm_snapshot(Shm_snapshot_reader* reader){
+    for (unsigned int attempt = 0; attempt < 8; attempt++){
+        unsigned long long version, bytes;
+        long long epoch;
+        read_shm_snapshot_control(reader->control, &version, &bytes, &epoch);
+        shared_ptr<Model_snapshot> cur = acquire_shm_snapshot(reader);
+        if (version == 0 || (cur && cur->version == version)) return false;
+        shared_ptr<Model_snapshot> next = map_shm_snapshot(reader->name, version);
+        if (!next) continue;
+        atomic_store(&reader->current, next);
+        reader->swaps++;
+        return true;
+    }
+    return false;
+}
+
+// Maps the control segment read-only and the current version. Returns false when the name does not exist;
+// acquire_shm_snapshot stays empty until a first version is published.
+bool open_shm_snapshot_reader(Shm_snapshot_reader* reader, string name){
+    reader->name = name;
+    reader->swaps = 0;
+    reader->control = NULL;
+    int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    void* base = mmap(NULL, sizeof(Shm_snapshot_control), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+    reader->control = (const Shm_snapshot_control*)base;
+    if (reader->control->magic != SHM_SNAPSHOT_MAGIC || reader->control->layout != SHM_SNAPSHOT_LAYOUT){
+        munmap(base, sizeof(Shm_snapshot_control));
+        reader->control = NULL;
+        return false;
+    }
+    refresh_shm_snapshot(reader);
+    return true;
+}
+
+void close_shm_snapshot_reader(Shm_snapshot_reader* reader){
+    atomic_store(&reader->current, shared_ptr<Model_snapshot>());
+    if (reader->control) munmap((void*)reader->control, sizeof(Shm_snapshot_control));
+}
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef TOPK_H
+#define TOPK_H
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <immintrin.h>
+#include "cpu_thread_pool.h"
+#include "serving_model.h"
+using namespace std;
+
+// Batch top-K is a GEMM P * Q^T whose output is reduced on the fly. Q is packed into panels of
+// TOPK_LANES items stored dimension-major, so a micro-kernel of TOPK_MICRO_USERS users x 2 panels
+// keeps its scores in registers: per dimension it loads 2 panel vectors, broadcasts one element of each
+// user row and issues 2 * TOPK_MICRO_USERS FMAs. A block of TOPK_USER_BLOCK user rows stays in L1/L2
+// while it is scored against one tile of panels (about TOPK_TILE_BYTES, sized for L2) after another.
+// A score only leaves the registers when it can displace the worst entry of its user's heap.
+#define TOPK_USER_BLOCK 64
+#define TOPK_MICRO_USERS 4
+#define TOPK_TILE_BYTES (256 * 1024)
+
+#if defined(__AVX512F__)
+#define TOPK_LANES 16
+typedef __m512 topk_vec;
+inline topk_vec topk_zero(){ return _mm512_setzero_ps(); }
+inline topk_vec topk_load(const float* a){ return _mm512_load_ps(a); }
+inline topk_vec topk_fmadd(float a, topk_vec b, topk_vec c){ return _mm512_fmadd_ps(_mm512_set1_ps(a), b, c); }
+inline void topk_store(float* a, topk_vec v){ _mm512_storeu_ps(a, v); }
+inline unsigned int topk_ge_mask(topk_vec v, float t){ return _mm512_cmp_ps_mask(v, _mm512_set1_ps(t), _CMP_GE_OQ); }
+#elif defined(__AVX2__) && defined(__FMA__)
+#define TOPK_LANES 8
+typedef __m256 topk_vec;
+inline topk_vec topk_zero(){ return _mm256_setzero_ps(); }
+inline topk_vec topk_load(const float* a){ return _mm256_load_ps(a); }
+inline topk_vec topk_fmadd(float a, topk_vec b, topk_vec c){ return _mm256_fmadd_ps(_mm256_set1_ps(a), b, c); }
+inline void topk_store(float* a, topk_vec v){ _mm256_storeu_ps(a, v); }
+inline unsigned int topk_ge_mask(topk_vec v, float t){ return _mm256_movemask_ps(_mm256_cmp_ps(v, _mm256_set1_ps(t), _CMP_GE_OQ)); }
+#else
+#define TOPK_LANES 8
+struct topk_vec{ float v[TOPK_LANES]; };
+inline topk_vec topk_zero(){ topk_vec r; for (int l = 0; l < TOPK_LANES; l++) r.v[l] = 0; return r; }
+inline topk_vec topk_load(const float* a){ topk_vec r; for (int l = 0; l < TOPK_LANES; l++) r.v[l] = a[l]; return r; }
+inline topk_vec topk_fmadd(float a, topk_vec b, topk_vec c){ for (int l = 0; l < TOPK_LANES; l++) c.v[l] += a * b.v[l]; return c; }
+inline void topk_store(float* a, topk_vec v){ for (int l = 0; l < TOPK_LANES; l++) a[l] = v.v[l]; }
+inline unsigned int topk_ge_mask(topk_vec v, float t){ unsigned int m = 0; for (int l = 0; l < TOPK_LANES; l++) m |= (v.v[l] >= t) << l; return m; }
+#endif
+
+inline float cpu_row_norm(const float* a, unsigned int k){
+    float sum = 0;
+    for (unsigned int d = 0; d < k; d++) sum += a[d] * a[d];
+    return sqrt(sum);
+}
+
+struct Topk_entry{
+    float score;
+    unsigned int item;
+};
+
+// Higher score first; ties go to the lower item index, so results do not depend on the thread count.
+inline bool topk_better(const Topk_entry& a, const Topk_entry& b){
+    return a.score > b.score || (a.score == b.score && a.item < b.item);
+}
+
+// Bounded min-heap of the best K entries; e[0] is the worst of them once the heap is full.
+struct Topk_heap{
+    unsigned int K;
+    unsigned int size;
+    float threshold;
+    Topk_entry* e;
+};
+
+inline void topk_reset(Topk_heap* h, unsigned int K, Topk_entry* storage){
+    h->K = K;
+    h->size = 0;
+    h->threshold = -INFINITY;
+    h->e = storage;
+}
+
+inline void topk_push(Topk_heap* h, float score, unsigned int item){
+    Topk_entry x = {score, item};
+    if (h->size < h->K){
+        h->e[h->size++] = x;
+        push_heap(h->e, h->e + h->size, topk_better);
+    }
+    else{
+        // Replace the worst entry and sift it down: one pass instead of pop_heap + push_heap.
+        if (!topk_better(x, h->e[0])) return;
+        unsigned int j = 0;
+        for (unsigned int c = 1; c < h->K; c = 2 * j + 1){
+            if (c + 1 < h->K && topk_better(h->e[c], h->e[c + 1])) c++;
+            if (!topk_better(x, h->e[c])) break;
+            h->e[j] = h->e[c];
+            j = c;
+        }
+        h->e[j] = x;
+    }
+    if (h->size == h->K) h->threshold = h->e[0].score;
+}
+
+// Q packed into panels of TOPK_LANES items: element (d, l) of panel p is data[(p * k + d) * TOPK_LANES + l]
+// and belongs to item order[p * TOPK_LANES + l]. Items are packed by descending norm, so the heaps meet the
+// likely winners first and their thresholds rise early. The panel count is even and the missing items are
+// zero, so the micro-kernel never needs a tail.
+struct Item_panels{
+    unsigned int k;
+    unsigned int item_num;
+    unsigned int panel_num;
+    float* data;
+    vector<unsigned int> order;
+};
+
+void pack_item_panels(Cpu_thread_pool* pool, const float* q, unsigned int item_num, unsigned int k, Item_panels* panels){
+    panels->k = k;
+    panels->item_num = item_num;
+    panels->panel_num = ((item_num + TOPK_LANES - 1) / TOPK_LANES + 1) / 2 * 2;
+    size_t bytes = ((size_t)panels->panel_num * k * TOPK_LANES * sizeof(float) + 63) / 64 * 64;
+    panels->data = (float*)aligned_alloc(64, bytes);
+
+    vector<float> norm(item_num);
+    for (unsigned int i = 0; i < item_num; i++) norm[i] = cpu_row_norm(q + (size_t)i * k, k);
+    panels->order.resize(item_num);
+    for (unsigned int i = 0; i < item_num; i++) panels->order[i] = i;
+    stable_sort(panels->order.begin(), panels->order.end(), [&](unsigned int a, unsigned int b){ return norm[a] > norm[b]; });
+
+    auto pack_range = [&](unsigned int begin, unsigned int end){
+        for (unsigned int p = begin; p < end; p++){
+            float* panel = panels->data + (size_t)p * k * TOPK_LANES;
+            for (unsigned int l = 0; l < TOPK_LANES; l++){
+                unsigned int j = p * TOPK_LANES + l;
+                const float* q_row = j < item_num ? q + (size_t)panels->order[j] * k : NULL;
+                for (unsigned int d = 0; d < k; d++) panel[d * TOPK_LANES + l] = q_row ? q_row[d] : 0.0f;
+            }
+        }
+    };
+    // Without a pool (its workers may be busy serving) the calling thread packs everything.
+    if (pool == NULL){
+        pack_range(0, panels->panel_num);
+        return;
+    }
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        pack_range((unsigned long long)panels->panel_num * t / pool->num_threads, (unsigned long long)panels->panel_num * (t + 1) / pool->num_threads);
+    });
+}
+
+void free_item_panels(Item_panels* panels){
+    free(panels->data);
+}
+
+// Adds dimensions [d_begin, d_end) of TOPK_MICRO_USERS consecutive user rows times panel and the panel
+// after it to acc.
+inline void topk_micro_kernel_range(const float* p_rows, const float* panel, unsigned int k, unsigned int d_begin, unsigned int d_end,
+                                    topk_vec acc[TOPK_MICRO_USERS][2]){
+    const float* panel1 = panel + (size_t)k * TOPK_LANES;
+    for (unsigned int d = d_begin; d < d_end; d++){
+        topk_vec b0 = topk_load(panel + d * TOPK_LANES);
+        topk_vec b1 = topk_load(panel1 + d * TOPK_LANES);
+        for (unsigned int u = 0; u < TOPK_MICRO_USERS; u++){
+            float a = p_rows[(size_t)u * k + d];
+            acc[u][0] = topk_fmadd(a, b0, acc[u][0]);
+            acc[u][1] = topk_fmadd(a, b1, acc[u][1]);
+        }
+    }
+}
+
+inline void topk_micro_zero(topk_vec acc[TOPK_MICRO_USERS][2]){
+    for (unsigned int u = 0; u < TOPK_MICRO_USERS; u++){
+        acc[u][0] = topk_zero();
+        acc[u][1] = topk_zero();
+    }
+}
+
+// Scores TOPK_MICRO_USERS consecutive user rows against panel and the panel after it.
+inline void topk_micro_kernel(const float* p_rows, const float* panel, unsigned int k, topk_vec acc[TOPK_MICRO_USERS][2]){
+    topk_micro_zero(acc);
+    topk_micro_kernel_range(p_rows, panel, k, 0, k, acc);
+}
+
+// Pushes the lanes in mask that may still displace the user's worst entry and were not rated by the user in
+// training; user NO_SERVING_ID keeps rated items as well. Lane l holds the item at position first + l of order.
+inline void topk_offer_lanes(const Serving_model* model, const unsigned int* order, unsigned int item_num, unsigned int user, Topk_heap* h,
+                             const float* scores, unsigned int mask, unsigned int first){
+    for (; mask; mask &= mask - 1){
+        unsigned int l = __builtin_ctz(mask);
+        if (first + l >= item_num || scores[l] < h->threshold) continue;
+        unsigned int i = order[first + l];
+        if (user == NO_SERVING_ID || !is_seen(model, user, i)) topk_push(h, scores[l], i);
+    }
+}
+
+// Equal scores pass the filter because the tie is decided by the item index.
+inline void topk_offer(const Serving_model* model, const Item_panels* panels, unsigned int user, Topk_heap* h, topk_vec v, unsigned int first){
+    unsigned int mask = topk_ge_mask(v, h->threshold);
+    if (mask == 0) return;
+    float scores[TOPK_LANES];
+    topk_store(scores, v);
+    topk_offer_lanes(model, panels->order.data(), panels->item_num, user, h, scores, mask, first);
+}
+
+// Top-K of user_cnt <= TOPK_USER_BLOCK users: heaps[u] collects the scores of row u of rows, which belongs to
+// serving user users[u] (NO_SERVING_ID for no seen-item filter). rows must have TOPK_MICRO_USERS readable rows
+// past the last one.
+void topk_rows_block(const Serving_model* model, const Item_panels* panels, const float* rows, const unsigned int* users, unsigned int user_cnt,
+                     Topk_heap* heaps){
+    unsigned int k = model->k;
+    unsigned int tile_panels = max(2u, (unsigned int)(TOPK_TILE_BYTES / (k * TOPK_LANES * sizeof(float))) / 2 * 2);
+    topk_vec acc[TOPK_MICRO_USERS][2];
+
+    for (unsigned int tile = 0; tile < panels->panel_num; tile += tile_panels){
+        unsigned int tile_end = min(tile + tile_panels, panels->panel_num);
+        for (unsigned int u0 = 0; u0 < user_cnt; u0 += TOPK_MICRO_USERS){
+            const float* p_rows = rows + (size_t)u0 * k;
+            unsigned int micro_users = min((unsigned int)TOPK_MICRO_USERS, user_cnt - u0);
+            for (unsigned int p = tile; p < tile_end; p += 2){
+                topk_micro_kernel(p_rows, panels->data + (size_t)p * k * TOPK_LANES, k, acc);
+                for (unsigned int u = 0; u < micro_users; u++){
+                    topk_offer(model, panels, users[u0 + u], &heaps[u0 + u], acc[u][0], p * TOPK_LANES);
+                    topk_offer(model, panels, users[u0 + u], &heaps[u0 + u], acc[u][1], (p + 1) * TOPK_LANES);
+                }
+            }
+        }
+    }
+}
+
+// Top-K of the users [user_begin, user_begin + user_cnt), user_cnt <= TOPK_USER_BLOCK.
+void topk_user_block(const Serving_model* model, const Item_panels* panels, unsigned int user_begin, unsigned int user_cnt, Topk_heap* heaps){
+    unsigned int users[TOPK_USER_BLOCK];
+    for (unsigned int u = 0; u < user_cnt; u++) users[u] = user_begin + u;
+    topk_rows_block(model, panels, model->p + (size_t)user_begin * model->k, users, user_cnt, heaps);
+}
+
+// Top-K unseen items of the users [0, user_num), best first. User u's list is
+// results[u * K, u * K + counts[u]); counts[u] < K only when the user has fewer than K unseen items.
+void topk_recommend(Cpu_thread_pool* pool, const Serving_model* model, const Item_panels* panels, unsigned int K, unsigned int user_num,
+                    vector<Topk_entry>* results, vector<unsigned int>* counts){
+    results->resize((size_t)user_num * K);
+    counts->resize(user_num);
+    unsigned int block_num = (user_num + TOPK_USER_BLOCK - 1) / TOPK_USER_BLOCK;
+    atomic<unsigned int> next_block(0);
+
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        Topk_heap heaps[TOPK_USER_BLOCK];
+        for (unsigned int b = next_block.fetch_add(1); b < block_num; b = next_block.fetch_add(1)){
+            unsigned int user_begin = b * TOPK_USER_BLOCK;
+            unsigned int user_cnt = min((unsigned int)TOPK_USER_BLOCK, user_num - user_begin);
+            for (unsigned int u = 0; u < user_cnt; u++) topk_reset(&heaps[u], K, results->data() + (size_t)(user_begin + u) * K);
+            topk_user_block(model, panels, user_begin, user_cnt, heaps);
+            for (unsigned int u = 0; u < user_cnt; u++){
+                sort_heap(heaps[u].e, heaps[u].e + heaps[u].size, topk_better);
+                (*counts)[user_begin + u] = heaps[u].size;
+            }
+        }
+    });
+}
+
+// Share of the exact top-K items of each user that an approximate top-K also returns, averaged over the
+// users that have recommendations.
+double topk_recall(const vector<Topk_entry>& exact, const vector<unsigned int>& exact_counts,
+                   const vector<Topk_entry>& approx, const vector<unsigned int>& approx_counts, unsigned int K){
+    double recall_sum = 0;
+    unsigned int users = 0;
+    vector<unsigned int> a(K), b(K), both(K);
+    for (unsigned int u = 0; u < exact_counts.size(); u++){
+        if (exact_counts[u] == 0) continue;
+        for (unsigned int j = 0; j < exact_counts[u]; j++) a[j] = exact[(size_t)u * K + j].item;
+        for (unsigned int j = 0; j < approx_counts[u]; j++) b[j] = approx[(size_t)u * K + j].item;
+        sort(a.begin(), a.begin() + exact_counts[u]);
+        sort(b.begin(), b.begin() + approx_counts[u]);
+        size_t hits = set_intersection(a.begin(), a.begin() + exact_counts[u], b.begin(), b.begin() + approx_counts[u], both.begin()) - both.begin();
+        recall_sum += (double)hits / exact_counts[u];
+        users++;
+    }
+    return users ? recall_sum / users : 1.0;
+}
+
+// One line "user<TAB>item<TAB>score" per recommendation, in original ids.
+void write_topk_tsv(const Serving_model* model, const vector<Topk_entry>& results, const vector<unsigned int>& counts, unsigned int K, string outfile){
+    ofstream out(outfile.c_str());
+    if (out.fail()){
+        cout << "fail to write file named " << outfile << endl;
+        return;
+    }
+    for (unsigned int u = 0; u < counts.size(); u++)
+        for (unsigned int j = 0; j < counts[u]; j++){
+            const Topk_entry& r = results[(size_t)u * K + j];
+            out << model->user2orig[u] << "\t" << model->item2orig[r.item] << "\t" << r.score << "\n";
+        }
+    out.close();
+}
+
+// Binary layout (little endian): uint32 user count, uint32 K, then per user uint32 user id, uint32 count
+// and count pairs of (uint32 item id, float32 score), in original ids.
+void write_topk_binary(const Serving_model* model, const vector<Topk_entry>& results, const vector<unsigned int>& counts, unsigned int K, string outfile){
+    ofstream out(outfile.c_str(), ios::binary);
+    if (out.fail()){
+        cout << "fail to write file named " << outfile << endl;
+        return;
+    }
+    unsigned int header[2] = {(unsigned int)counts.size(), K};
+    out.write((const char*)header, sizeof(header));
+    for (unsigned int u = 0; u < counts.size(); u++){
+        unsigned int user_header[2] = {model->user2orig[u], counts[u]};
+        out.write((const char*)user_header, sizeof(user_header));
+        for (unsigned int j = 0; j < counts[u]; j++){
+            const Topk_entry& r = results[(size_t)u * K + j];
+            unsigned int item = model->item2orig[r.item];
+            out.write((const char*)&item, sizeof(unsigned int));
+            out.write((const char*)&r.score, sizeof(float));
+        }
+    }
+    out.close();
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef TOPK_CACHE_H
+#define TOPK_CACHE_H
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include "serving_model.h"
+#include "topk.h"
+using namespace std;
+
+// Cache of top-K results in front of the scorer, keyed by (original user id, K, filter). Users are split into
+// degree groups by their number of training ratings, heaviest first, and every group has its own byte budget
+// over TOPK_CACHE_SHARDS independently locked shards, so the heavy users that repeat most can be given most of
+// the memory and a budget of 0 keeps a group out of the cache. Each shard evicts with CLOCK: a hit sets the
+// entry's reference bit, the hand clears it and evicts the first entry it finds without one.
+// Entries remember the model version they were computed on. invalidate_topk_cache only moves the cache to the
+// new version, which turns every older entry into a miss at once; their memory is taken back by the hand, which
+// evicts stale entries before it looks at reference bits.
+#define TOPK_CACHE_SHARDS 16
+#define TOPK_CACHE_NODE_BYTES 64        // slot, hash node and bucket of one entry, about
+#define TOPK_CACHE_MAX_GROUPS 255
+
+struct Topk_cache_slot{
+    unsigned long long key;
+    unsigned long long version;
+    bool used;
+    bool referenced;
+    vector<Topk_entry> entries;         // best first, serving item indices of version
+};
+
+struct Topk_cache_shard{
+    mutex m;
+    unordered_map<unsigned long long, unsigned int> index;     // key -> slot
+    vector<Topk_cache_slot> slots;
+    vector<unsigned int> free_slots;
+    unsigned int hand;
+    size_t bytes;
+    size_t capacity;
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long stale;
+    unsigned long long inserts;
+    unsigned long long evictions;
+};
+
+struct Topk_cache_group{
+    size_t budget;
+    Topk_cache_shard shards[TOPK_CACHE_SHARDS];
+};
+
+struct Topk_cache{
+    unsigned int group_num;
+    Topk_cache_group* groups;
+    atomic<unsigned long long> version;
+    atomic<unsigned long long> invalidations;
+};
+
+inline unsigned long long topk_cache_key(unsigned int orig_user, unsigned int K, unsigned int filter){
+    return (unsigned long long)orig_user << 32 | (unsigned long long)K << 16 | filter;
+}
+
+inline Topk_cache_shard* topk_cache_shard(Topk_cache* cache, unsigned int group, unsigned long long key){
+    unsigned long long h = key * 0x9E3779B97F4A7C15ULL;
+    return &cache->groups[group].shards[h >> 60];
+}
+
+inline size_t topk_cache_entry_bytes(unsigned int n){
+    return TOPK_CACHE_NODE_BYTES + (size_t)n * sizeof(Topk_entry);
+}
+
+// budgets[g] is the byte budget of degree group g, group 0 holding the heaviest users.
+void init_topk_cache(Topk_cache* cache, const vector<size_t>& budgets){
+    cache->group_num = budgets.size();
+    cache->groups = new Topk_cache_group[cache->group_num];
+    cache->version = 0;
+    cache->invalidations = 0;
+    for (unsigned int g = 0; g < cache->group_num; g++){
+        cache->groups[g].budget = budgets[g];
+        for (unsigned int s = 0; s < TOPK_CACHE_SHARDS; s++){
+            Topk_cache_shard* shard = &cache->groups[g].shards[s];
+            shard->hand = 0;
+            shard->bytes = 0;
+            shard->capacity = budgets[g] / TOPK_CACHE_SHARDS;
+            shard->lookups = shard->hits = shard->stale = shard->inserts = shard->evictions = 0;
+        }
+    }
+}
+
+void free_topk_cache(Topk_cache* cache){
+    delete [] cache->groups;
+}
+
+inline bool topk_cache_enabled(const Topk_cache* cache, unsigned int group){
+    return group < cache->group_num && cache->groups[group].budget > 0;
+}
+
+// Degree group of every serving user: users ranked by their number of training ratings, most first, cut into
+// group_num groups of equal size.
+void topk_cache_degree_groups(const Serving_model* model, unsigned int group_num, vector<unsigned char>* groups){
+    groups->assign(model->user_num, 0);
+    if (group_num <= 1) return;
+    vector<unsigned int> order(model->user_num);
+    for (unsigned int u = 0; u < model->user_num; u++) order[u] = u;
+    stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b){
+        return model->seen_begin[a + 1] - model->seen_begin[a] > model->seen_begin[b + 1] - model->seen_begin[b];
+    });
+    for (unsigned int r = 0; r < model->user_num; r++) (*groups)[order[r]] = (unsigned long long)r * group_num / model->user_num;
+}
+
+void topk_cache_drop(Topk_cache_shard* shard, unsigned int s){
+    Topk_cache_slot* slot = &shard->slots[s];
+    shard->index.erase(slot->key);
+    shard->bytes -= topk_cache_entry_bytes(slot->entries.size());
+    slot->used = false;
+    vector<Topk_entry>().swap(slot->entries);
+    shard->free_slots.push_back(s);
+}
+
+// Fills h, reset to the K of the key, from the cache. Only an entry of the given model version is a hit.
+bool topk_cache_lookup(Topk_cache* cache, unsigned int group, unsigned long long key, unsigned long long version, Topk_heap* h){
+    Topk_cache_shard* shard = topk_cache_shard(cache, group, key);
+    lock_guard<mutex> lk(shard->m);
+    shard->lookups++;
+    unordered_map<unsigned long long, unsigned int>::iterator it = shard->index.find(key);
+    if (it == shard->index.end()) return false;
+    Topk_cache_slot* slot = &shard->slots[it->second];
+    if (slot->version != version){
+        shard->stale++;
+        if (slot->version < cache->version) topk_cache_drop(shard, it->second);
+        return false;
+    }
+    slot->referenced = true;
+    h->size = slot->entries.size();
+    copy(slot->entries.begin(), slot->entries.end(), h->e);
+    shard->hits++;
+    return true;
+}
+
+// Stores the sorted result h of the key, computed on the given model version. Results of a version the cache
+// has already left are not kept.
+void topk_cache_insert(Topk_cache* cache, unsigned int group, unsigned long long key, unsigned long long version, const Topk_heap* h){
+    if (version != cache->version) return;
+    Topk_cache_shard* shard = topk_cache_shard(cache, group, key);
+    size_t need = topk_cache_entry_bytes(h->size);
+    if (need > shard->capacity) return;
+    lock_guard<mutex> lk(shard->m);
+    unordered_map<unsigned long long, unsigned int>::iterator it = shard->index.find(key);
+    if (it != shard->index.end()) topk_cache_drop(shard, it->second);
+
+    unsigned long long current = cache->version;
+    while (shard->bytes + need > shard->capacity){
+        if (shard->hand >= shard->slots.size()) shard->hand = 0;
+        Topk_cache_slot* victim = &shard->slots[shard->hand];
+        if (victim->used){
+            if (victim->referenced && victim->version == current) victim->referenced = false;
+            else{
+                topk_cache_drop(shard, shard->hand);
+                shard->evictions++;
+            }
+        }
+        shard->hand++;
+    }
+
+    unsigned int s;
+    if (shard->free_slots.empty()){
+        s = shard->slots.size();
+        shard->slots.push_back(Topk_cache_slot());
+    }
+    else{
+        s = shard->free_slots.back();
+        shard->free_slots.pop_back();
+    }
+    Topk_cache_slot* slot = &shard->slots[s];
+    slot->key = key;
+    slot->version = version;
+    slot->used = true;
+    slot->referenced = false;
+    slot->entries.assign(h->e, h->e + h->size);
+    shard->index[key] = s;
+    shard->bytes += need;
+    shard->inserts++;
+}
+
+// Moves the cache to a new model version; every entry of an older version stops matching right away.
+void invalidate_topk_cache(Topk_cache* cache, unsigned long long version){
+    if (cache->version.exchange(version) != version) cache->invalidations++;
+}
+
+void print_topk_cache_stats(Topk_cache* cache){
+    unsigned long long all_lookups = 0, all_hits = 0;
+    for (unsigned int g = 0; g < cache->group_num; g++){
+        unsigned long long lookups = 0, hits = 0, stale = 0, inserts = 0, evictions = 0, entries = 0;
+        size_t bytes = 0;
+        for (unsigned int s = 0; s < TOPK_CACHE_SHARDS; s++){
+            Topk_cache_shard* shard = &cache->groups[g].shards[s];
+            lock_guard<mutex> lk(shard->m);
+            lookups += shard->lookups;
+            hits += shard->hits;
+            stale += shard->stale;
+            inserts += shard->inserts;
+            evictions += shard->evictions;
+            entries += shard->index.size();
+            bytes += shard->bytes;
+        }
+        all_lookups += lookups;
+        all_hits += hits;
+        if (cache->groups[g].budget == 0) continue;
+        string label = "Top-K cache group " + to_string(g);
+        label.resize(33, ' ');
+        cout << label << ": " << hits << " hits / " << lookups << " lookups (" << (lookups ? 100.0 * hits / lookups : 0) << "%), "
+             << stale << " stale, " << entries << " entries, " << bytes / 1048576.0 << " / " << cache->groups[g].budget / 1048576.0 << " MB, "
+             << inserts << " inserts, " << evictions << " evictions" << endl;
+    }
+    cout << "Top-K cache hit rate             : " << (all_lookups ? 100.0 * all_hits / all_lookups : 0) << "% of " << all_lookups
+         << " lookups, " << cache->invalidations << " version invalidations" << endl;
+}
+
+#endif
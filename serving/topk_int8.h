@@ -0,0 +1,244 @@
+#ifndef TOPK_INT8_H
+#define TOPK_INT8_H
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <immintrin.h>
+#include "cpu_thread_pool.h"
+#include "cpu_rmse.h"
+#include "serving_model.h"
+#include "topk.h"
+using namespace std;
+
+// Two-stage top-K: Q is quantized per row to int8 with a power-of-two scale (the scheme of
+// get_only_scaling_factor in the MuPPET kernels) and scanned with int8 dot products, keeping the
+// ceil(alpha * K) best approximate scores per user as candidates. The candidates are then re-ranked with
+// exact fp32 dot products. The scan reads a quarter of the bytes of the fp32 scan and issues a quarter of the
+// multiply instructions (VNNI vpdpbusd takes 4 byte pairs per 32-bit lane).
+//
+// Panels hold TOPK8_LANES items in chunks of 4 dimensions: bytes d..d+3 of lane l are contiguous, so one
+// broadcast 32-bit word of the user row multiplies all lanes. Items are packed in the order of the fp32
+// panels (descending norm).
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+#define TOPK8_LANES 16
+typedef __m512i topk8_acc;
+inline topk8_acc topk8_zero(){ return _mm512_setzero_si512(); }
+// vpdpbusd multiplies unsigned by signed bytes, so user rows are stored as p + 128 and the scan subtracts
+// 128 * (sum of the item's bytes) afterwards.
+#define TOPK8_USER_OFFSET 128
+inline topk8_acc topk8_dot4(topk8_acc acc, int user4, const signed char* panel){
+    return _mm512_dpbusd_epi32(acc, _mm512_set1_epi32(user4), _mm512_load_si512((const void*)panel));
+}
+inline unsigned int topk8_ge_mask(topk8_acc acc, const int* offset, const float* scale, float user_scale, float threshold, float* scores){
+    __m512 v = _mm512_cvtepi32_ps(_mm512_sub_epi32(acc, _mm512_loadu_si512((const void*)offset)));
+    v = _mm512_mul_ps(v, _mm512_mul_ps(_mm512_loadu_ps(scale), _mm512_set1_ps(user_scale)));
+    _mm512_storeu_ps(scores, v);
+    return _mm512_cmp_ps_mask(v, _mm512_set1_ps(threshold), _CMP_GE_OQ);
+}
+#elif defined(__AVX2__)
+#define TOPK8_LANES 8
+typedef __m256i topk8_acc;
+inline topk8_acc topk8_zero(){ return _mm256_setzero_si256(); }
+// vpmaddubsw multiplies unsigned by signed bytes and saturates the pair sums at 16 bits. Feeding it |p| and
+// q * sign(p) keeps every pair sum within 2 * 127 * 127, since both sides are clamped to [-127, 127].
+#define TOPK8_USER_OFFSET 0
+inline topk8_acc topk8_dot4(topk8_acc acc, int user4, const signed char* panel){
+    __m256i a = _mm256_set1_epi32(user4);
+    __m256i b = _mm256_load_si256((const __m256i*)panel);
+    __m256i pairs = _mm256_maddubs_epi16(_mm256_abs_epi8(a), _mm256_sign_epi8(b, a));
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, _mm256_set1_epi16(1)));
+}
+inline unsigned int topk8_ge_mask(topk8_acc acc, const int* offset, const float* scale, float user_scale, float threshold, float* scores){
+    __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(acc), _mm256_mul_ps(_mm256_loadu_ps(scale), _mm256_set1_ps(user_scale)));
+    _mm256_storeu_ps(scores, v);
+    return _mm256_movemask_ps(_mm256_cmp_ps(v, _mm256_set1_ps(threshold), _CMP_GE_OQ));
+}
+#else
+#define TOPK8_LANES 8
+struct topk8_acc{ int v[TOPK8_LANES]; };
+inline topk8_acc topk8_zero(){ topk8_acc r; for (int l = 0; l < TOPK8_LANES; l++) r.v[l] = 0; return r; }
+#define TOPK8_USER_OFFSET 0
+inline topk8_acc topk8_dot4(topk8_acc acc, int user4, const signed char* panel){
+    signed char a[4];
+    memcpy(a, &user4, 4);
+    for (int l = 0; l < TOPK8_LANES; l++)
+        for (int b = 0; b < 4; b++) acc.v[l] += a[b] * panel[l * 4 + b];
+    return acc;
+}
+inline unsigned int topk8_ge_mask(topk8_acc acc, const int* offset, const float* scale, float user_scale, float threshold, float* scores){
+    unsigned int mask = 0;
+    for (int l = 0; l < TOPK8_LANES; l++){
+        scores[l] = acc.v[l] * scale[l] * user_scale;
+        mask |= (scores[l] >= threshold) << l;
+    }
+    return mask;
+}
+#endif
+
+// Power-of-two scaling exponent of a row for bitwidth-bit integers, as get_only_scaling_factor: the largest
+// e with max|x| * 2^e <= 2^(bitwidth-1) - 0.5. Rounded values are still clamped, since x * 2^e may round up.
+inline int cpu_scaling_exponent(unsigned int bitwidth, const float* row, unsigned int k){
+    float max_abs = 0;
+    for (unsigned int d = 0; d < k; d++) max_abs = max(max_abs, fabsf(row[d]));
+    if (max_abs == 0) return 0;
+    float max_val = (1 << (bitwidth - 1)) - 0.5f;
+    return (int)floorf(log2f(max_val / max_abs));
+}
+
+inline signed char quantize_int8(float x, float scale){
+    return (signed char)max(-127.0f, min(127.0f, roundf(x * scale)));
+}
+
+// Q in int8 panels: dimension d of lane l of panel p is data[(p * k4 + d - d % 4) * TOPK8_LANES + l * 4 + d % 4].
+// scale[j] is 2^-e of the item packed at position j and offset[j] its TOPK8_USER_OFFSET correction.
+struct Int8_panels{
+    unsigned int k;
+    unsigned int k4;
+    unsigned int item_num;
+    unsigned int panel_num;
+    signed char* data;
+    float* scale;
+    int* offset;
+    const unsigned int* order;
+};
+
+void pack_int8_panels(Cpu_thread_pool* pool, const Serving_model* model, const Item_panels* panels, Int8_panels* q8){
+    unsigned int k = model->k;
+    q8->k = k;
+    q8->k4 = (k + 3) / 4 * 4;
+    q8->item_num = model->item_num;
+    q8->panel_num = ((model->item_num + TOPK8_LANES - 1) / TOPK8_LANES + 1) / 2 * 2;
+    q8->order = panels->order.data();
+    size_t slots = (size_t)q8->panel_num * TOPK8_LANES;
+    q8->data = (signed char*)aligned_alloc(64, (slots * q8->k4 + 63) / 64 * 64);
+    q8->scale = new float[slots];
+    q8->offset = new int[slots];
+
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        size_t begin = slots * t / pool->num_threads;
+        size_t end = slots * (t + 1) / pool->num_threads;
+        for (size_t j = begin; j < end; j++){
+            size_t p = j / TOPK8_LANES;
+            unsigned int l = j % TOPK8_LANES;
+            const float* q_row = j < q8->item_num ? model->q + (size_t)q8->order[j] * k : NULL;
+            int e = q_row ? cpu_scaling_exponent(8, q_row, k) : 0;
+            float scale = exp2f(e);
+            int sum = 0;
+            for (unsigned int d = 0; d < q8->k4; d++){
+                signed char v = q_row && d < k ? quantize_int8(q_row[d], scale) : 0;
+                q8->data[(p * q8->k4 + d / 4 * 4) * TOPK8_LANES + l * 4 + d % 4] = v;
+                sum += v;
+            }
+            q8->scale[j] = exp2f(-e);
+            q8->offset[j] = TOPK8_USER_OFFSET * sum;
+        }
+    });
+}
+
+void free_int8_panels(Int8_panels* q8){
+    free(q8->data);
+    delete [] q8->scale;
+    delete [] q8->offset;
+}
+
+// Quantizes cnt user rows into k4 bytes each (plus TOPK8_USER_OFFSET) and returns their 2^-e scales.
+void quantize_user_rows(const float* p, unsigned int cnt, unsigned int k, unsigned int k4, unsigned char* rows, float* scale){
+    for (unsigned int u = 0; u < cnt; u++){
+        const float* p_row = p + (size_t)u * k;
+        int e = cpu_scaling_exponent(8, p_row, k);
+        float s = exp2f(e);
+        for (unsigned int d = 0; d < k4; d++)
+            rows[(size_t)u * k4 + d] = (unsigned char)((d < k ? quantize_int8(p_row[d], s) : 0) + TOPK8_USER_OFFSET);
+        scale[u] = exp2f(-e);
+    }
+}
+
+// Scores TOPK_MICRO_USERS (4) quantized user rows against panel and the panel after it. The accumulators are
+// named locals: kept in an array, the compiler copies them between registers on every step because
+// vpdpbusd overwrites its accumulator.
+inline void topk8_micro_kernel(const unsigned char* rows, const signed char* panel, unsigned int k4, topk8_acc acc[TOPK_MICRO_USERS][2]){
+    topk8_acc a00 = topk8_zero(), a01 = topk8_zero(), a10 = topk8_zero(), a11 = topk8_zero();
+    topk8_acc a20 = topk8_zero(), a21 = topk8_zero(), a30 = topk8_zero(), a31 = topk8_zero();
+    const signed char* panel1 = panel + (size_t)k4 * TOPK8_LANES;
+    for (unsigned int d = 0; d < k4; d += 4){
+        int u0, u1, u2, u3;
+        memcpy(&u0, rows + d, 4);
+        memcpy(&u1, rows + (size_t)k4 + d, 4);
+        memcpy(&u2, rows + (size_t)2 * k4 + d, 4);
+        memcpy(&u3, rows + (size_t)3 * k4 + d, 4);
+        const signed char* b0 = panel + (size_t)d * TOPK8_LANES;
+        const signed char* b1 = panel1 + (size_t)d * TOPK8_LANES;
+        a00 = topk8_dot4(a00, u0, b0); a01 = topk8_dot4(a01, u0, b1);
+        a10 = topk8_dot4(a10, u1, b0); a11 = topk8_dot4(a11, u1, b1);
+        a20 = topk8_dot4(a20, u2, b0); a21 = topk8_dot4(a21, u2, b1);
+        a30 = topk8_dot4(a30, u3, b0); a31 = topk8_dot4(a31, u3, b1);
+    }
+    acc[0][0] = a00; acc[0][1] = a01; acc[1][0] = a10; acc[1][1] = a11;
+    acc[2][0] = a20; acc[2][1] = a21; acc[3][0] = a30; acc[3][1] = a31;
+}
+
+// Candidate scan of the users [user_begin, user_begin + user_cnt), blocked like topk_user_block.
+void topk8_user_block(const Serving_model* model, const Int8_panels* q8, const unsigned char* rows, const float* user_scale,
+                      unsigned int user_begin, unsigned int user_cnt, Topk_heap* heaps){
+    unsigned int tile_panels = max(2u, (unsigned int)(TOPK_TILE_BYTES / (q8->k4 * TOPK8_LANES)) / 2 * 2);
+    topk8_acc acc[TOPK_MICRO_USERS][2];
+    float scores[TOPK8_LANES];
+
+    for (unsigned int tile = 0; tile < q8->panel_num; tile += tile_panels){
+        unsigned int tile_end = min(tile + tile_panels, q8->panel_num);
+        for (unsigned int u0 = 0; u0 < user_cnt; u0 += TOPK_MICRO_USERS){
+            unsigned int micro_users = min((unsigned int)TOPK_MICRO_USERS, user_cnt - u0);
+            for (unsigned int p = tile; p < tile_end; p += 2){
+                topk8_micro_kernel(rows + (size_t)u0 * q8->k4, q8->data + (size_t)p * q8->k4 * TOPK8_LANES, q8->k4, acc);
+                for (unsigned int u = 0; u < micro_users; u++){
+                    Topk_heap* h = &heaps[u0 + u];
+                    for (unsigned int j = 0; j < 2; j++){
+                        size_t first = (size_t)(p + j) * TOPK8_LANES;
+                        unsigned int mask = topk8_ge_mask(acc[u][j], q8->offset + first, q8->scale + first, user_scale[u0 + u], h->threshold, scores);
+                        if (mask) topk_offer_lanes(model, q8->order, q8->item_num, user_begin + u0 + u, h, scores, mask, first);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Same output as topk_recommend. cand_num >= K approximate candidates per user are re-ranked in fp32.
+void topk8_recommend(Cpu_thread_pool* pool, const Serving_model* model, const Int8_panels* q8, unsigned int K, unsigned int cand_num,
+                     unsigned int user_num, vector<Topk_entry>* results, vector<unsigned int>* counts){
+    results->resize((size_t)user_num * K);
+    counts->resize(user_num);
+    unsigned int k = model->k;
+    unsigned int block_num = (user_num + TOPK_USER_BLOCK - 1) / TOPK_USER_BLOCK;
+    atomic<unsigned int> next_block(0);
+
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        Topk_heap heaps[TOPK_USER_BLOCK];
+        vector<Topk_entry> cand((size_t)TOPK_USER_BLOCK * cand_num);
+        vector<unsigned char> rows((size_t)(TOPK_USER_BLOCK + TOPK_MICRO_USERS) * q8->k4, TOPK8_USER_OFFSET);
+        float user_scale[TOPK_USER_BLOCK];
+
+        for (unsigned int b = next_block.fetch_add(1); b < block_num; b = next_block.fetch_add(1)){
+            unsigned int user_begin = b * TOPK_USER_BLOCK;
+            unsigned int user_cnt = min((unsigned int)TOPK_USER_BLOCK, user_num - user_begin);
+            quantize_user_rows(model->p + (size_t)user_begin * k, user_cnt, k, q8->k4, rows.data(), user_scale);
+            for (unsigned int u = 0; u < user_cnt; u++) topk_reset(&heaps[u], cand_num, cand.data() + (size_t)u * cand_num);
+            topk8_user_block(model, q8, rows.data(), user_scale, user_begin, user_cnt, heaps);
+
+            for (unsigned int u = 0; u < user_cnt; u++){
+                const float* p_row = model->p + (size_t)(user_begin + u) * k;
+                Topk_heap exact;
+                topk_reset(&exact, K, results->data() + (size_t)(user_begin + u) * K);
+                for (unsigned int j = 0; j < heaps[u].size; j++){
+                    unsigned int i = heaps[u].e[j].item;
+                    topk_push(&exact, cpu_dot(p_row, model->q + (size_t)i * k, k), i);
+                }
+                sort_heap(exact.e, exact.e + exact.size, topk_better);
+                (*counts)[user_begin + u] = exact.size;
+            }
+        }
+    });
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef TOPK_LEMP_H
+#define TOPK_LEMP_H
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include "cpu_thread_pool.h"
+#include "serving_model.h"
+#include "topk.h"
+using namespace std;
+
+// Exact top-K with norm-based pruning in the spirit of LEMP. The item panels are already sorted by descending
+// norm, so before a user scores the panel pair starting at position j, |p_u| * |q_j| bounds every score that
+// is left (Cauchy-Schwarz): once that bound is below the user's K-th best score the user is finished and
+// skips the rest of the items. Within a panel pair the first prefix dimensions are scored first; a lane can
+// only still win when partial + |p_u tail| * |q tail| reaches the threshold, and when no lane of the
+// micro-kernel can, the remaining dimensions are skipped. Both bounds are loosened by a relative slack so
+// that float rounding can never drop an item the plain scan would keep.
+#define LEMP_SLACK 1e-5f
+
+struct Lemp_index{
+    unsigned int prefix;
+    float* item_norm;       // |q| of the item packed at each position, zero for padding
+    float* item_tail;       // |q[prefix:]| of the item packed at each position
+
+    // counters of the last lemp_recommend
+    unsigned long long pairs;
+    unsigned long long bound_skipped;
+    unsigned long long early_exits;
+};
+
+float* alloc_lemp_array(size_t n){
+    float* ptr = (float*)aligned_alloc(64, (n * sizeof(float) + 63) / 64 * 64);
+    fill(ptr, ptr + n, 0.0f);
+    return ptr;
+}
+
+void build_lemp_index(const Serving_model* model, const Item_panels* panels, unsigned int prefix, Lemp_index* lemp){
+    unsigned int k = model->k;
+    size_t slots = (size_t)panels->panel_num * TOPK_LANES;
+    lemp->prefix = min(prefix, k);
+    lemp->item_norm = alloc_lemp_array(slots);
+    lemp->item_tail = alloc_lemp_array(slots);
+    for (unsigned int j = 0; j < panels->item_num; j++){
+        const float* q_row = model->q + (size_t)panels->order[j] * k;
+        lemp->item_norm[j] = cpu_row_norm(q_row, k);
+        lemp->item_tail[j] = cpu_row_norm(q_row + lemp->prefix, k - lemp->prefix);
+    }
+}
+
+void free_lemp_index(Lemp_index* lemp){
+    free(lemp->item_norm);
+    free(lemp->item_tail);
+}
+
+// Max item norm over the median item norm; the larger it is, the more the norm bound prunes.
+float lemp_norm_skew(const Lemp_index* lemp, unsigned int item_num){
+    if (item_num == 0 || lemp->item_norm[item_num / 2] == 0) return 0;
+    return lemp->item_norm[0] / lemp->item_norm[item_num / 2];
+}
+
+// Pruned version of topk_user_block. Counters are added to pairs/skipped/exits.
+void lemp_user_block(const Serving_model* model, const Item_panels* panels, const Lemp_index* lemp, unsigned int user_begin, unsigned int user_cnt,
+                     Topk_heap* heaps, unsigned long long* skipped, unsigned long long* exits){
+    unsigned int k = model->k;
+    unsigned int prefix = lemp->prefix;
+    unsigned int tile_panels = max(2u, (unsigned int)(TOPK_TILE_BYTES / (k * TOPK_LANES * sizeof(float))) / 2 * 2);
+    float user_norm[TOPK_USER_BLOCK], user_tail[TOPK_USER_BLOCK];
+    bool done[TOPK_USER_BLOCK];
+    for (unsigned int u = 0; u < user_cnt; u++){
+        const float* p_row = model->p + (size_t)(user_begin + u) * k;
+        user_norm[u] = cpu_row_norm(p_row, k);
+        user_tail[u] = cpu_row_norm(p_row + prefix, k - prefix);
+        done[u] = false;
+    }
+    unsigned int active_users = user_cnt;
+    topk_vec acc[TOPK_MICRO_USERS][2];
+
+    for (unsigned int tile = 0; tile < panels->panel_num && active_users > 0; tile += tile_panels){
+        unsigned int tile_end = min(tile + tile_panels, panels->panel_num);
+        for (unsigned int u0 = 0; u0 < user_cnt; u0 += TOPK_MICRO_USERS){
+            const float* p_rows = model->p + (size_t)(user_begin + u0) * k;
+            unsigned int micro_users = min((unsigned int)TOPK_MICRO_USERS, user_cnt - u0);
+            for (unsigned int p = tile; p < tile_end; p += 2){
+                unsigned int first = p * TOPK_LANES;
+                bool any_active = false;
+                for (unsigned int u = u0; u < u0 + micro_users; u++){
+                    if (done[u]) continue;
+                    float slack = LEMP_SLACK * user_norm[u] * lemp->item_norm[0];
+                    if (heaps[u].size == heaps[u].K && user_norm[u] * lemp->item_norm[first] + slack < heaps[u].threshold){
+                        done[u] = true;
+                        active_users--;
+                        *skipped += first < panels->item_num ? panels->item_num - first : 0;
+                    }
+                    else any_active = true;
+                }
+                if (!any_active) break;
+
+                topk_micro_zero(acc);
+                topk_micro_kernel_range(p_rows, panels->data + (size_t)p * k * TOPK_LANES, k, 0, prefix, acc);
+                if (prefix < k){
+                    bool alive = false;
+                    for (unsigned int u = 0; u < micro_users && !alive; u++){
+                        if (done[u0 + u]) continue;
+                        float limit = heaps[u0 + u].threshold - LEMP_SLACK * user_norm[u0 + u] * lemp->item_norm[0];
+                        for (unsigned int j = 0; j < 2; j++)
+                            if (topk_ge_mask(topk_fmadd(user_tail[u0 + u], topk_load(lemp->item_tail + first + j * TOPK_LANES), acc[u][j]), limit)) alive = true;
+                    }
+                    if (!alive){
+                        *exits += 1;
+                        continue;
+                    }
+                    topk_micro_kernel_range(p_rows, panels->data + (size_t)p * k * TOPK_LANES, k, prefix, k, acc);
+                }
+                for (unsigned int u = 0; u < micro_users; u++){
+                    if (done[u0 + u]) continue;
+                    topk_offer(model, panels, user_begin + u0 + u, &heaps[u0 + u], acc[u][0], first);
+                    topk_offer(model, panels, user_begin + u0 + u, &heaps[u0 + u], acc[u][1], first + TOPK_LANES);
+                }
+            }
+        }
+    }
+}
+
+// Same output as topk_recommend.
+void lemp_recommend(Cpu_thread_pool* pool, const Serving_model* model, const Item_panels* panels, Lemp_index* lemp, unsigned int K,
+                    unsigned int user_num, vector<Topk_entry>* results, vector<unsigned int>* counts){
+    results->resize((size_t)user_num * K);
+    counts->resize(user_num);
+    unsigned int block_num = (user_num + TOPK_USER_BLOCK - 1) / TOPK_USER_BLOCK;
+    atomic<unsigned int> next_block(0);
+    atomic<unsigned long long> skipped(0), exits(0);
+
+    run_cpu_thread_pool(pool, [&](unsigned int t){
+        Topk_heap heaps[TOPK_USER_BLOCK];
+        unsigned long long local_skipped = 0, local_exits = 0;
+        for (unsigned int b = next_block.fetch_add(1); b < block_num; b = next_block.fetch_add(1)){
+            unsigned int user_begin = b * TOPK_USER_BLOCK;
+            unsigned int user_cnt = min((unsigned int)TOPK_USER_BLOCK, user_num - user_begin);
+            for (unsigned int u = 0; u < user_cnt; u++) topk_reset(&heaps[u], K, results->data() + (size_t)(user_begin + u) * K);
+            lemp_user_block(model, panels, lemp, user_begin, user_cnt, heaps, &local_skipped, &local_exits);
+            for (unsigned int u = 0; u < user_cnt; u++){
+                sort_heap(heaps[u].e, heaps[u].e + heaps[u].size, topk_better);
+                (*counts)[user_begin + u] = heaps[u].size;
+            }
+        }
+        skipped += local_skipped;
+        exits += local_exits;
+    });
+    lemp->pairs = (unsigned long long)user_num * model->item_num;
+    lemp->bound_skipped = skipped;
+    lemp->early_exits = exits;
+}
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef SHM_SNAPSHOT_H
+#define SHM_SNAPSHOT_H
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common_struct.h"
+using namespace std;
+
+// Model snapshots in POSIX shared memory for serving processes on the same host. Every publish writes a
+// complete segment /dev/shm/<name>.<version> that is never modified afterwards, then points the small control
+// segment /dev/shm/<name> at it under a seqlock. Readers map segments read-only and use them in place, so
+// switching versions costs one mmap and no copy. Versions older than the last SHM_SNAPSHOT_KEEP are unlinked;
+// readers that still map one keep it until they drop it.
+//
+// A segment follows the serving file conventions: users and items in ascending original id order, P and Q
+// with SHM_SNAPSHOT_ROW_PADDING zero rows each, and the items each user rated in training as sorted CSR.
+// The group tables of the grouped versions come along: the group of every user and item, the precision of
+// every group (0 = fp16, 1 = fp32, 2 = int8, 3 = bf16; GROUP_PREC_INT8 and GROUP_PREC_BF16 in cpu/cpu_int8.h)
+// and the group end indices in the sorted index space of training.
+#define SHM_SNAPSHOT_MAGIC 0x504e534d   // "MSNP"
+#define SHM_SNAPSHOT_LAYOUT 1
+#define SHM_SNAPSHOT_KEEP 2
+#define SHM_SNAPSHOT_ROW_PADDING 8
+
+// Row order of the P/Q arrays and of the ratings handed to publish_shm_snapshot.
+#define SNAPSHOT_INTERNAL_ORDER 0
+#define SNAPSHOT_SORTED_ORDER 1
+
+struct Shm_snapshot_control{
+    unsigned int magic;
+    unsigned int layout;
+    atomic<unsigned long long> seq;         // odd while the fields below change
+    atomic<unsigned long long> version;     // newest complete segment, 0 before the first publish
+    atomic<unsigned long long> bytes;
+    atomic<long long> epoch;
+};
+
+struct Shm_snapshot_header{
+    unsigned int magic;
+    unsigned int layout;
+    unsigned long long version;
+    int epoch;
+    unsigned int k;
+    unsigned int user_num;
+    unsigned int item_num;
+    unsigned int user_group_num;            // 0 for ungrouped versions
+    unsigned int item_group_num;
+    unsigned long long seen_n;
+    unsigned long long p_offset;
+    unsigned long long q_offset;
+    unsigned long long user2orig_offset;
+    unsigned long long item2orig_offset;
+    unsigned long long user_group_offset;
+    unsigned long long item_group_offset;
+    unsigned long long user_group_prec_offset;
+    unsigned long long item_group_prec_offset;
+    unsigned long long user_group_end_offset;
+    unsigned long long item_group_end_offset;
+    unsigned long long seen_begin_offset;
+    unsigned long long seen_items_offset;
+    unsigned long long bytes;
+};
+
+struct Shm_snapshot_publisher{
+    string name;
+    Shm_snapshot_control* control;
+    unsigned long long version;
+    int epoch;                              // epoch of the last publish, -1 before it
+    unsigned int publishes;
+    double publish_time;
+    unsigned long long last_bytes;
+};
+
+inline string shm_snapshot_segment_name(const string& name, unsigned long long version){
+    return "/" + name + "." + to_string(version);
+}
+
+inline unsigned long long shm_align64(unsigned long long offset){
+    return (offset + 63) / 64 * 64;
+}
+
+// Opens (or creates) the control segment. Versions continue from the last one published under this name, so a
+// restarted trainer never reuses the name of a segment that a reader may still be opening.
+bool init_shm_snapshot_publisher(Shm_snapshot_publisher* pub, string name){
+    pub->name = name;
+    pub->epoch = -1;
+    pub->publishes = 0;
+    pub->publish_time = 0;
+    pub->last_bytes = 0;
+    int fd = shm_open(("/" + name).c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(Shm_snapshot_control)) != 0){
+        cout << "fail to create shared memory segment /dev/shm/" << name << endl;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    void* base = mmap(NULL, sizeof(Shm_snapshot_control), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+    pub->control = (Shm_snapshot_control*)base;
+    if (pub->control->magic != SHM_SNAPSHOT_MAGIC || pub->control->layout != SHM_SNAPSHOT_LAYOUT){
+        pub->control->seq = 0;
+        pub->control->version = 0;
+        pub->control->bytes = 0;
+        pub->control->epoch = -1;
+        pub->control->layout = SHM_SNAPSHOT_LAYOUT;
+        atomic_thread_fence(memory_order_release);
+        pub->control->magic = SHM_SNAPSHOT_MAGIC;
+    }
+    pub->version = pub->control->version;
+    return true;
+}
+
+// Serving index of every internal id (ascending original id order) and the inverse map to original ids.
+void shm_snapshot_order(const map<unsigned int, unsigned int>& orig_map, vector<unsigned int>* internal2serving, vector<unsigned int>* serving2internal){
+    internal2serving->resize(orig_map.size());
+    serving2internal->resize(orig_map.size());
+    unsigned int s = 0;
+    for (map<unsigned int, unsigned int>::const_iterator it = orig_map.begin(); it != orig_map.end(); it++, s++){
+        (*internal2serving)[it->second] = s;
+        (*serving2internal)[s] = it->second;
+    }
+}
+
+// Writes the model into a new segment and makes it the current version. p/q rows are indexed by internal id
+// (SNAPSHOT_INTERNAL_ORDER) or by sorted index (SNAPSHOT_SORTED_ORDER), and so are the ids in mf_info->R as
+// given by rating_order. grouped adds the group tables. Returns the published version, 0 on failure.
+unsigned long long publish_shm_snapshot(Shm_snapshot_publisher* pub, Mf_info* mf_info, const float* p, const float* q,
+                                        unsigned int param_order, unsigned int rating_order, bool grouped, int epoch){
+    std::chrono::time_point<std::chrono::system_clock> publish_start_point = std::chrono::system_clock::now();
+    unsigned int k = mf_info->params.k;
+    vector<unsigned int> user2serving, serving2user, item2serving, serving2item;
+    shm_snapshot_order(mf_info->user_map, &user2serving, &serving2user);
+    shm_snapshot_order(mf_info->item_map, &item2serving, &serving2item);
+    unsigned int user_num = serving2user.size();
+    unsigned int item_num = serving2item.size();
+
+    Shm_snapshot_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SHM_SNAPSHOT_MAGIC;
+    h.layout = SHM_SNAPSHOT_LAYOUT;
+    h.version = pub->version + 1;
+    h.epoch = epoch;
+    h.k = k;
+    h.user_num = user_num;
+    h.item_num = item_num;
+    h.user_group_num = grouped ? mf_info->params.user_group_num : 0;
+    h.item_group_num = grouped ? mf_info->params.item_group_num : 0;
+    h.seen_n = mf_info->n;
+    h.p_offset = shm_align64(sizeof(h));
+    h.q_offset = shm_align64(h.p_offset + ((size_t)user_num + SHM_SNAPSHOT_ROW_PADDING) * k * sizeof(float));
+    h.user2orig_offset = shm_align64(h.q_offset + ((size_t)item_num + SHM_SNAPSHOT_ROW_PADDING) * k * sizeof(float));
+    h.item2orig_offset = shm_align64(h.user2orig_offset + sizeof(unsigned int) * user_num);
+    h.user_group_offset = shm_align64(h.item2orig_offset + sizeof(unsigned int) * item_num);
+    h.item_group_offset = shm_align64(h.user_group_offset + (grouped ? sizeof(unsigned int) * user_num : 0));
+    h.user_group_prec_offset = shm_align64(h.item_group_offset + (grouped ? sizeof(unsigned int) * item_num : 0));
+    h.item_group_prec_offset = shm_align64(h.user_group_prec_offset + h.user_group_num);
+    h.user_group_end_offset = shm_align64(h.item_group_prec_offset + h.item_group_num);
+    h.item_group_end_offset = shm_align64(h.user_group_end_offset + sizeof(unsigned int) * h.user_group_num);
+    h.seen_begin_offset = shm_align64(h.item_group_end_offset + sizeof(unsigned int) * h.item_group_num);
+    h.seen_items_offset = shm_align64(h.seen_begin_offset + sizeof(size_t) * (user_num + 1));
+    h.bytes = shm_align64(h.seen_items_offset + sizeof(unsigned int) * h.seen_n);
+
+    string segment = shm_snapshot_segment_name(pub->name, h.version);
+    shm_unlink(segment.c_str());
+    int fd = shm_open(segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, h.bytes) != 0){
+        cout << "fail to create shared memory segment /dev/shm" << segment << endl;
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    void* base = mmap(NULL, h.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED){
+        shm_unlink(segment.c_str());
+        return 0;
+    }
+
+    // ftruncate zero-fills, which covers the padding rows.
+    char* bytes = (char*)base;
+    float* seg_p = (float*)(bytes + h.p_offset);
+    float* seg_q = (float*)(bytes + h.q_offset);
+    unsigned int* user2orig = (unsigned int*)(bytes + h.user2orig_offset);
+    unsigned int* item2orig = (unsigned int*)(bytes + h.item2orig_offset);
+    for (unsigned int s = 0; s < user_num; s++){
+        unsigned int u = serving2user[s];
+        unsigned int row = param_order == SNAPSHOT_SORTED_ORDER ? mf_info->user2sorted_idx[u] : u;
+        memcpy(seg_p + (size_t)s * k, p + (size_t)row * k, sizeof(float) * k);
+        user2orig[s] = mf_info->user_map2orig[u];
+    }
+    for (unsigned int s = 0; s < item_num; s++){
+        unsigned int i = serving2item[s];
+        unsigned int row = param_order == SNAPSHOT_SORTED_ORDER ? mf_info->item2sorted_idx[i] : i;
+        memcpy(seg_q + (size_t)s * k, q + (size_t)row * k, sizeof(float) * k);
+        item2orig[s] = mf_info->item_map2orig[i];
+    }
+
+    if (grouped){
+        unsigned int* user_group = (unsigned int*)(bytes + h.user_group_offset);
+        unsigned int* item_group = (unsigned int*)(bytes + h.item_group_offset);
+        for (unsigned int s = 0; s < user_num; s++) user_group[s] = mf_info->user_group_idx[serving2user[s]];
+        for (unsigned int s = 0; s < item_num; s++) item_group[s] = mf_info->item_group_idx[serving2item[s]];
+        memcpy(bytes + h.user_group_prec_offset, mf_info->user_group_prec_info, h.user_group_num);
+        memcpy(bytes + h.item_group_prec_offset, mf_info->item_group_prec_info, h.item_group_num);
+        memcpy(bytes + h.user_group_end_offset, mf_info->user_group_end_idx, sizeof(unsigned int) * h.user_group_num);
+        memcpy(bytes + h.item_group_end_offset, mf_info->item_group_end_idx, sizeof(unsigned int) * h.item_group_num);
+    }
+
+    size_t* seen_begin = (size_t*)(bytes + h.seen_begin_offset);
+    unsigned int* seen_items = (unsigned int*)(bytes + h.seen_items_offset);
+    bool sorted_ratings = rating_order == SNAPSHOT_SORTED_ORDER;
+    for (unsigned int j = 0; j < mf_info->n; j++){
+        unsigned int u = sorted_ratings ? mf_info->sorted_idx2user[mf_info->R[j].u] : mf_info->R[j].u;
+        seen_begin[user2serving[u] + 1]++;
+    }
+    for (unsigned int s = 0; s < user_num; s++) seen_begin[s + 1] += seen_begin[s];
+    vector<size_t> fill_pos(seen_begin, seen_begin + user_num);
+    for (unsigned int j = 0; j < mf_info->n; j++){
+        unsigned int u = sorted_ratings ? mf_info->sorted_idx2user[mf_info->R[j].u] : mf_info->R[j].u;
+        unsigned int i = sorted_ratings ? mf_info->sorted_idx2item[mf_info->R[j].i] : mf_info->R[j].i;
+        seen_items[fill_pos[user2serving[u]]++] = item2serving[i];
+    }
+    for (unsigned int s = 0; s < user_num; s++) sort(seen_items + seen_begin[s], seen_items + seen_begin[s + 1]);
+    memcpy(bytes, &h, sizeof(h));
+    munmap(base, h.bytes);
+
+    // Seqlock: readers retry while seq is odd or changed under them.
+    Shm_snapshot_control* c = pub->control;
+    unsigned long long seq = c->seq.load(memory_order_relaxed);
+    c->seq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    c->version.store(h.version, memory_order_relaxed);
+    c->bytes.store(h.bytes, memory_order_relaxed);
+    c->epoch.store(epoch, memory_order_relaxed);
+    c->seq.store(seq + 2, memory_order_release);
+
+    pub->version = h.version;
+    pub->epoch = epoch;
+    if (h.version > SHM_SNAPSHOT_KEEP) shm_unlink(shm_snapshot_segment_name(pub->name, h.version - SHM_SNAPSHOT_KEEP).c_str());
+    pub->publishes++;
+    pub->last_bytes = h.bytes;
+    pub->publish_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - publish_start_point).count();
+    return h.version;
+}
+
+// True after epoch e when -sp asks for a snapshot every snapshot_interval epochs. The final model is always
+// published, see shm_snapshot_pending.
+inline bool shm_snapshot_due(const Mf_info* mf_info, int e){
+    return mf_info->params.snapshot_interval > 0 && (e + 1) % mf_info->params.snapshot_interval == 0;
+}
+
+inline bool shm_snapshot_pending(const Shm_snapshot_publisher* pub, int epochs_run){
+    return pub->epoch != epochs_run;
+}
+
+// The last segments stay in /dev/shm for the readers.
+void close_shm_snapshot_publisher(Shm_snapshot_publisher* pub){
+    cout << "\n<Shared memory snapshots>" << endl;
+    cout << "Snapshot name                    : /dev/shm/" << pub->name << endl;
+    cout << "Versions published / last        : " << pub->publishes << " / " << pub->version << endl;
+    cout << "Snapshot size (bytes)            : " << pub->last_bytes << endl;
+    cout << "Publish time per version         : " << (pub->publishes ? pub->publish_time / pub->publishes : 0) << endl;
+    munmap(pub->control, sizeof(Shm_snapshot_control));
+}
+
+// Consistent (version, bytes, epoch) of the control segment.
+void read_shm_snapshot_control(const Shm_snapshot_control* c, unsigned long long* version, unsigned long long* bytes, long long* epoch){
+    while (true){
+        unsigned long long seq = c->seq.load(memory_order_acquire);
+        if (seq & 1){
+            sched_yield();
+            continue;
+        }
+        *version = c->version.load(memory_order_relaxed);
+        *bytes = c->bytes.load(memory_order_relaxed);
+        *epoch = c->epoch.load(memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (c->seq.load(memory_order_relaxed) == seq) return;
+    }
+}
+
+#endif
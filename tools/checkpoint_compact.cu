@@ -0,0 +1,66 @@
+#include <iostream>
+#include <sys/stat.h>
+#include <chrono>
+#include "common_struct.h"
+#include "checkpoint.h"
+using namespace std;
+
+// Merges the chain of a checkpoint written with -cd (the full checkpoint and its deltas path.delta.1, 2, ...)
+// into one full checkpoint that -rm resumes from without the deltas. With -r the merged deltas are removed;
+// they no longer continue the chain when the output replaces the input.
+
+bool exists (const std::string& name) {
+    struct stat buffer;
+    return (stat(name.c_str(), &buffer) == 0);
+}
+
+void usage(const char* name){
+    cout << name << " -i <checkpoint> -o <output> [-r]" << endl;
+}
+
+int main (int argc, const char* argv[]){
+    string input = "";
+    string output = "";
+    bool remove_deltas = false;
+
+    for(int i = 0; i < argc; i++){
+        if(string(argv[i]) == "-i" && i < argc-1) input = string(argv[i+1]);
+        if(string(argv[i]) == "-o" && i < argc-1) output = string(argv[i+1]);
+        if(string(argv[i]) == "-r") remove_deltas = true;
+        if(string(argv[i]) == "-h"){
+            usage(argv[0]);
+            return(0);
+        }
+    }
+
+    if(!exists(input) || output == ""){
+        usage(argv[0]);
+        return(0);
+    }
+
+    std::chrono::time_point<std::chrono::system_clock> start_point = std::chrono::system_clock::now();
+    vector<char> image;
+    unsigned int deltas_applied;
+    if (!read_checkpoint_chain(input, &image, &deltas_applied)){
+        cout << "fail to read checkpoint " << input << endl;
+        return 1;
+    }
+    size_t chain_bytes = 0;
+    struct stat st;
+    if (stat(input.c_str(), &st) == 0) chain_bytes += st.st_size;
+    for (unsigned int n = 1; n <= deltas_applied; n++)
+        if (stat(checkpoint_delta_path(input, n).c_str(), &st) == 0) chain_bytes += st.st_size;
+    Checkpoint_layout layout;
+    checkpoint_image_layout(image.data(), image.size(), &layout);
+
+    if (!write_checkpoint_file(output, image.data(), image.size())) return 1;
+    if (remove_deltas || output == input) remove_checkpoint_deltas(input);
+    double exec_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start_point).count();
+
+    cout << "Checkpoint                       : " << input << endl;
+    cout << "Deltas merged                    : " << deltas_applied << endl;
+    cout << "Epochs done                      : " << layout.header.epochs_done << endl;
+    cout << "Chain / compacted bytes          : " << chain_bytes << " / " << image.size() << endl;
+    cout << "Compaction time (micro sec)      : " << exec_time << endl;
+    return 0;
+}